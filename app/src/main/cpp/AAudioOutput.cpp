@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AAudioOutput.cpp
+ * @brief Implementation of AAudioOutput class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "AAudioOutput.h"
+
+/* @brief Number of output channels (interleaved stereo). */
+static const int kAAudioOutputChannels = 2;
+/* @brief Minimum stream buffer, in bursts (double buffering). */
+static const int kAAudioOutputMinBursts = 2;
+
+// -----------------------------------------------------------------------------------------------
+
+AAudioOutput::AAudioOutput(AAudioOutputListener *listener):
+    listener(listener), sampleRate(0), latencyMs(0), stream(nullptr), running(false),
+    restarting(false), left(), right() {
+}
+
+AAudioOutput::~AAudioOutput() {
+    stop();
+}
+
+bool AAudioOutput::start(int rate, int latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) return false;
+    sampleRate = rate;
+    latencyMs = latency;
+    if (!openStream()) return false;
+    running = true;
+    return true;
+}
+
+void AAudioOutput::stop() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        thread = std::move(restartThread);
+    }
+    if (thread.joinable()) thread.join();
+    std::lock_guard<std::mutex> lock(mutex);
+    closeStream();
+}
+
+bool AAudioOutput::isRunning() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running && stream != nullptr;
+}
+
+bool AAudioOutput::openStream() {
+    AAudioStreamBuilder *builder = nullptr;
+    if (AAudio_createStreamBuilder(&builder) != AAUDIO_OK) return false;
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+    AAudioStreamBuilder_setChannelCount(builder, kAAudioOutputChannels);
+    AAudioStreamBuilder_setSampleRate(builder, sampleRate);
+    AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+    AAudioStreamBuilder_setDataCallback(builder, dataCallback, this);
+    AAudioStreamBuilder_setErrorCallback(builder, errorCallback, this);
+    aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &stream);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        stream = nullptr;
+        return false;
+    }
+    // the render core runs at a fixed rate
+    if (AAudioStream_getSampleRate(stream) != sampleRate) {
+        closeStream();
+        return false;
+    }
+    int burst = AAudioStream_getFramesPerBurst(stream);
+    if (burst > 0) {
+        int bursts = (sampleRate * latencyMs / 1000 + burst - 1) / burst;
+        AAudioStream_setBufferSizeInFrames(stream,
+                                           std::max(bursts, kAAudioOutputMinBursts) * burst);
+    }
+    if (AAudioStream_requestStart(stream) != AAUDIO_OK) {
+        closeStream();
+        return false;
+    }
+    return true;
+}
+
+void AAudioOutput::closeStream() {
+    if (stream == nullptr) return;
+    AAudioStream_requestStop(stream);
+    AAudioStream_close(stream);
+    stream = nullptr;
+}
+
+void AAudioOutput::restart() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        closeStream();
+        openStream();
+    }
+    restarting = false;
+}
+
+aaudio_data_callback_result_t AAudioOutput::dataCallback(AAudioStream *, void *data,
+                                                         void *audioData, int32_t numFrames) {
+    auto *output = static_cast<AAudioOutput*>(data);
+    auto *samples = static_cast<float*>(audioData);
+    for (int done = 0; done < numFrames;) {
+        int frames = std::min(numFrames - done, kAAudioOutputBlockFrames);
+        std::fill_n(output->left, frames, 0.0f);
+        std::fill_n(output->right, frames, 0.0f);
+        output->listener->onAudioOutput(output->left, output->right, frames);
+        for (int i = 0; i < frames; i++) {
+            *samples++ = output->left[i];
+            *samples++ = output->right[i];
+        }
+        done += frames;
+    }
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+void AAudioOutput::errorCallback(AAudioStream *, void *data, aaudio_result_t error) {
+    if (error != AAUDIO_ERROR_DISCONNECTED) return;
+    auto *output = static_cast<AAudioOutput*>(data);
+    // if the lock is taken the stream is being closed already (close waits for this callback)
+    std::unique_lock<std::mutex> lock(output->mutex, std::try_to_lock);
+    if (!lock.owns_lock() || !output->running || output->restarting) return;
+    output->restarting = true;
+    // the stream can not be closed from its own callback: reopen it from a thread
+    if (output->restartThread.joinable()) output->restartThread.join();
+    output->restartThread = std::thread(&AAudioOutput::restart, output);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AAudioOutput.h
+ * @brief Header of AAudioOutput class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_AAUDIOOUTPUT_H
+#define ANDROID_MIDI_SYNTH_AAUDIOOUTPUT_H
+
+#include <aaudio/AAudio.h>
+#include <mutex>
+#include <thread>
+
+/** @brief Maximum frames passed to the listener per call (longer callbacks are split). */
+static const int kAAudioOutputBlockFrames = 1024;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief AAudioOutputListener interface.
+ * @details Fills the audio of an AAudioOutput (called from the audio thread).
+ */
+class AAudioOutputListener {
+public:
+    /** @brief Destructor. */
+    virtual ~AAudioOutputListener() = default;
+    /**
+     * @brief Render audio.
+     * @param left Left channel, zeroed (the listener mixes into it).
+     * @param right Right channel, zeroed (the listener mixes into it).
+     * @param frames Number of frames (up to kAAudioOutputBlockFrames).
+     */
+    virtual void onAudioOutput(float *left, float *right, int frames) = 0;
+};
+
+/**
+ * @brief AAudioOutput class.
+ * @details Owns a stereo float AAudio output stream (low latency, exclusive if the device
+ *          allows it) and renders it from the data callback through the listener. When the
+ *          device is disconnected (e.g. headphones unplugged) the stream is reopened on the
+ *          new default device, from a separate thread.
+ */
+class AAudioOutput {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Renders the audio. Must outlive the output.
+     */
+    explicit AAudioOutput(AAudioOutputListener *listener);
+    /** @brief Destructor. Stops the stream. */
+    ~AAudioOutput();
+    /**
+     * @brief Open and start the stream.
+     * @param sampleRate Sample rate, in Hz (the stream fails if the device can not give it).
+     * @param latencyMs Target latency of the stream buffer, in milliseconds (rounded up to
+     *        whole bursts, at least two).
+     * @return True if successful. False otherwise.
+     */
+    bool start(int sampleRate, int latencyMs);
+    /** @brief Stop and close the stream. */
+    void stop();
+    /**
+     * @brief Check if the stream is running.
+     * @return True if running. False otherwise.
+     */
+    bool isRunning();
+private:
+    /* @brief Open and start the stream (mutex held).
+     * @return True if successful. False otherwise. */
+    bool openStream();
+    /* @brief Stop and close the stream, if any (mutex held). */
+    void closeStream();
+    /* @brief Reopen the stream after a disconnection (restart thread body). */
+    void restart();
+    /* @brief AAudio data callback. */
+    static aaudio_data_callback_result_t dataCallback(AAudioStream *stream, void *data,
+                                                      void *audioData, int32_t numFrames);
+    /* @brief AAudio error callback. */
+    static void errorCallback(AAudioStream *stream, void *data, aaudio_result_t error);
+private:
+    /* @brief Renders the audio. */
+    AAudioOutputListener *listener;
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Target latency, in milliseconds. */
+    int latencyMs;
+    /* @brief The stream (nullptr if closed). */
+    AAudioStream *stream;
+    /* @brief True between start() and stop(). */
+    bool running;
+    /* @brief True while the restart thread is pending. */
+    bool restarting;
+    /* @brief Guards the stream and the flags (never waited on by the callbacks). */
+    std::mutex mutex;
+    /* @brief Reopens the stream after a disconnection. */
+    std::thread restartThread;
+    /* @brief Left channel of a block (audio thread). */
+    float left[kAAudioOutputBlockFrames];
+    /* @brief Right channel of a block (audio thread). */
+    float right[kAAudioOutputBlockFrames];
+};
+
+#endif //ANDROID_MIDI_SYNTH_AAUDIOOUTPUT_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AMidiPort.cpp
+ * @brief Implementation of AMidi (NDK MIDI) port classes.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "AMidiPort.h"
+
+// -----------------------------------------------------------------------------------------------
+
+AMidiOutput* AMidiOutput::open(AMidiDevice *device, int portNumber) {
+    AMidiInputPort *port = nullptr;
+    if (AMidiInputPort_open(device, portNumber, &port) != AMEDIA_OK) return nullptr;
+    return new AMidiOutput(port);
+}
+
+AMidiOutput::~AMidiOutput() {
+    AMidiInputPort_close(port);
+}
+
+bool AMidiOutput::send(const uint8_t *data, int length, int64_t timestampNs) {
+    if (timestampNs <= 0) return AMidiInputPort_send(port, data, length) == length;
+    return AMidiInputPort_sendWithTimestamp(port, data, length, timestampNs) == length;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+AMidiInput* AMidiInput::open(AMidiDevice *device, int portNumber) {
+    AMidiOutputPort *port = nullptr;
+    if (AMidiOutputPort_open(device, portNumber, &port) != AMEDIA_OK) return nullptr;
+    return new AMidiInput(port);
+}
+
+AMidiInput::~AMidiInput() {
+    AMidiOutputPort_close(port);
+}
+
+int AMidiInput::receive(uint8_t *buffer, int maxLength, int64_t *timestampNs) {
+    int32_t opcode;
+    size_t length = 0;
+    int64_t timestamp = 0;
+    // skip flush notifications, they carry no data
+    for (;;) {
+        ssize_t count = AMidiOutputPort_receive(port, &opcode, buffer, maxLength,
+                                                &length, &timestamp);
+        if (count < 0) return -1;
+        if (count == 0) return 0;
+        if (opcode == AMIDI_OPCODE_DATA) break;
+    }
+    if (timestampNs) *timestampNs = timestamp;
+    return (int) length;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AMidiPort.h
+ * @brief Header of AMidi (NDK MIDI) port classes.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_AMIDIPORT_H
+#define ANDROID_MIDI_SYNTH_AMIDIPORT_H
+
+#include <amidi/AMidi.h>
+
+#include "MidiPort.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief AMidiOutput class.
+ * @details Sends MIDI bytes to an input port of an AMidiDevice.
+ */
+class AMidiOutput: public MidiOutputPort {
+public:
+    /**
+     * @brief Open an input port of a device.
+     * @param device The device.
+     * @param portNumber Number of the device input port.
+     * @return The port, or nullptr on error.
+     */
+    static AMidiOutput* open(AMidiDevice *device, int portNumber);
+    /** @brief Destructor. Closes the port. */
+    ~AMidiOutput() override;
+    /**
+     * @brief Send MIDI bytes, with their timestamp.
+     * @param data MIDI bytes.
+     * @param length Number of bytes.
+     * @param timestampNs Time the bytes are due (CLOCK_MONOTONIC, in ns), or 0 for now.
+     * @return True if successful. False otherwise.
+     */
+    bool send(const uint8_t *data, int length, int64_t timestampNs) override;
+private:
+    /* @brief Constructor. */
+    explicit AMidiOutput(AMidiInputPort *port): port(port) {}
+    /* @brief AMidi port. */
+    AMidiInputPort *port;
+};
+
+/**
+ * @brief AMidiInput class.
+ * @details Receives MIDI bytes from an output port of an AMidiDevice.
+ */
+class AMidiInput: public MidiInputPort {
+public:
+    /**
+     * @brief Open an output port of a device.
+     * @param device The device.
+     * @param portNumber Number of the device output port.
+     * @return The port, or nullptr on error.
+     */
+    static AMidiInput* open(AMidiDevice *device, int portNumber);
+    /** @brief Destructor. Closes the port. */
+    ~AMidiInput() override;
+    /**
+     * @brief Receive MIDI bytes, without blocking.
+     * @param buffer Receives the bytes.
+     * @param maxLength Size of the buffer.
+     * @param timestampNs Receives the timestamp of the bytes.
+     * @return The number of bytes received, 0 if none is available, or -1 on error.
+     */
+    int receive(uint8_t *buffer, int maxLength, int64_t *timestampNs) override;
+private:
+    /* @brief Constructor. */
+    explicit AMidiInput(AMidiOutputPort *port): port(port) {}
+    /* @brief AMidi port. */
+    AMidiOutputPort *port;
+};
+
+#endif //ANDROID_MIDI_SYNTH_AMIDIPORT_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ASensorHeartRateSource.cpp
+ * @brief Implementation of ASensorHeartRateSource class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <time.h>
+
+#include "ASensorHeartRateSource.h"
+
+/* @brief Looper identifier of the sensor event queue. */
+static const int kSensorLooperIdent = 1;
+/* @brief Number of events read per call. */
+static const int kSensorEventBatch = 16;
+
+/* @brief Read a clock, in nanoseconds. */
+static int64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+ASensorHeartRateSource::ASensorHeartRateSource(
+        const char *packageName, int samplingUs, int64_t batchLatencyUs):
+    packageName(packageName), samplingUs(samplingUs), batchLatencyUs(batchLatencyUs),
+    manager(nullptr), sensor(nullptr), beatSensor(nullptr), listener(nullptr), looper(nullptr), registration(0),
+    running(false), wakeups(0) {
+}
+
+ASensorHeartRateSource::~ASensorHeartRateSource() {
+    stop();
+}
+
+bool ASensorHeartRateSource::start(HeartRateListener *heartRateListener) {
+    if (running.load()) return false;
+    if (thread.joinable()) thread.join();
+    if (manager == nullptr) {
+        manager = ASensorManager_getInstanceForPackage(packageName.c_str());
+        if (manager == nullptr) return false;
+    }
+    sensor = ASensorManager_getDefaultSensor(manager, ASENSOR_TYPE_HEART_RATE);
+    if (sensor == nullptr) return false;
+    beatSensor = ASensorManager_getDefaultSensor(manager, ASENSOR_TYPE_HEART_BEAT);
+    listener = heartRateListener;
+    wakeups.store(0);
+    registration = 0;
+    running.store(true);
+    thread = std::thread(&ASensorHeartRateSource::run, this);
+    // the queue belongs to the looper of the thread: wait for it to register the sensor
+    std::unique_lock<std::mutex> lock(looperMutex);
+    registeredCondition.wait(lock, [this] { return registration != 0; });
+    if (registration > 0) return true;
+    lock.unlock();
+    thread.join();
+    return false;
+}
+
+void ASensorHeartRateSource::stop() {
+    running.store(false);
+    {
+        std::lock_guard<std::mutex> lock(looperMutex);
+        if (looper) ALooper_wake(looper);
+    }
+    if (thread.joinable()) thread.join();
+    listener = nullptr;
+}
+
+void ASensorHeartRateSource::run() {
+    ALooper *threadLooper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+    ASensorEventQueue *queue = ASensorManager_createEventQueue(
+            manager, threadLooper, kSensorLooperIdent, nullptr, nullptr);
+    if (queue == nullptr ||
+            ASensorEventQueue_registerSensor(queue, sensor, samplingUs, batchLatencyUs) < 0) {
+        if (queue) ASensorManager_destroyEventQueue(manager, queue);
+        running.store(false);
+        std::lock_guard<std::mutex> lock(looperMutex);
+        registration = -1;
+        registeredCondition.notify_all();
+        return;
+    }
+    // the beats are optional: the rate alone still drives the music
+    if (beatSensor != nullptr &&
+            ASensorEventQueue_registerSensor(queue, beatSensor, 0, batchLatencyUs) < 0) {
+        beatSensor = nullptr;
+    }
+    {
+        // stop() wakes the looper from now on; it may have been called before
+        std::lock_guard<std::mutex> lock(looperMutex);
+        looper = threadLooper;
+        registration = 1;
+        registeredCondition.notify_all();
+    }
+    ASensorEvent events[kSensorEventBatch];
+    while (running.load()) {
+        int ident = ALooper_pollOnce(-1, nullptr, nullptr, nullptr);
+        if (ident == ALOOPER_POLL_ERROR) break;
+        if (ident != kSensorLooperIdent) continue;
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        // a batch comes in one wakeup; sensor timestamps are CLOCK_BOOTTIME
+        int64_t offset = clockNs(CLOCK_MONOTONIC) - clockNs(CLOCK_BOOTTIME);
+        ssize_t count;
+        while ((count = ASensorEventQueue_getEvents(queue, events, kSensorEventBatch)) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                if (events[i].type == ASENSOR_TYPE_HEART_RATE) {
+                    listener->onHeartRateSample(events[i].timestamp + offset,
+                            events[i].heart_rate.bpm, events[i].heart_rate.status);
+                } else if (events[i].type == ASENSOR_TYPE_HEART_BEAT) {
+                    // the event time is the peak of the beat, the value its confidence
+                    listener->onHeartBeat(events[i].timestamp + offset, events[i].data[0]);
+                }
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(looperMutex);
+        looper = nullptr;
+    }
+    ASensorEventQueue_disableSensor(queue, sensor);
+    if (beatSensor != nullptr) ASensorEventQueue_disableSensor(queue, beatSensor);
+    ASensorManager_destroyEventQueue(manager, queue);
+    running.store(false);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ASensorHeartRateSource.h
+ * @brief Header of ASensorHeartRateSource class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_ASENSORHEARTRATESOURCE_H
+#define ANDROID_MIDI_SYNTH_ASENSORHEARTRATESOURCE_H
+
+#include <android/looper.h>
+#include <android/sensor.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "HeartRateSource.h"
+
+/** @brief Default sampling period of the heart-rate sensor, in microseconds. */
+static const int kHeartRateSamplingUs = 1000000;
+/** @brief Default maximum report latency (FIFO batching) of the sensor, in microseconds. */
+static const int64_t kHeartRateBatchLatencyUs = 5000000;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief ASensorHeartRateSource class.
+ * @details Reads the platform heart-rate sensor through ASensorManager on a dedicated looper
+ *          thread, so the samples never wake the JVM. A maximum report latency lets the
+ *          sensor hub batch samples in its FIFO and deliver them together, one wakeup per
+ *          batch. The heart-beat sensor, if the device has one, is read on the same queue:
+ *          its events are the detected beats, the only source of real RR intervals.
+ *          Timestamps are converted from CLOCK_BOOTTIME to CLOCK_MONOTONIC.
+ */
+class ASensorHeartRateSource: public HeartRateSource {
+public:
+    /**
+     * @brief Constructor.
+     * @param packageName Package name of the application (for ASensorManager).
+     * @param samplingUs Sampling period, in microseconds.
+     * @param batchLatencyUs Maximum report latency, in microseconds (0 disables batching).
+     */
+    ASensorHeartRateSource(const char *packageName, int samplingUs, int64_t batchLatencyUs);
+    /** @brief Destructor. Stops the thread. */
+    ~ASensorHeartRateSource() override;
+    bool start(HeartRateListener *listener) override;
+    void stop() override;
+    uint64_t getWakeups() const override { return wakeups.load(); }
+private:
+    /* @brief Thread body. */
+    void run();
+private:
+    /* @brief Package name of the application. */
+    std::string packageName;
+    /* @brief Sampling period, in microseconds. */
+    int samplingUs;
+    /* @brief Maximum report latency, in microseconds. */
+    int64_t batchLatencyUs;
+    /* @brief Sensor manager. */
+    ASensorManager *manager;
+    /* @brief Heart-rate sensor. */
+    const ASensor *sensor;
+    /* @brief Heart-beat sensor (nullptr if the device has none). */
+    const ASensor *beatSensor;
+    /* @brief Receives the samples. */
+    HeartRateListener *listener;
+    /* @brief Looper of the reader thread (nullptr when not polling). */
+    ALooper *looper;
+    /* @brief Guards the looper pointer and the registration result. */
+    std::mutex looperMutex;
+    /* @brief Signals the registration result to start(). */
+    std::condition_variable registeredCondition;
+    /* @brief Registration of the sensor by the thread: 0 pending, 1 done, -1 failed. */
+    int registration;
+    /* @brief Reader thread. */
+    std::thread thread;
+    /* @brief True while the thread should keep running. */
+    std::atomic<bool> running;
+    /* @brief Number of wakeups. */
+    std::atomic<uint64_t> wakeups;
+};
+
+#endif //ANDROID_MIDI_SYNTH_ASENSORHEARTRATESOURCE_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ApiTrace.cpp
+ * @brief Implementation of ApiTrace class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "ApiTrace.h"
+
+/* @brief Source of the identifiers of the traces. */
+static std::atomic<uint64_t> nextTraceId(1);
+
+/* @brief Guards liveTraces. */
+static std::mutex liveTracesMutex;
+/* @brief Identifiers of the traces not yet destroyed. */
+static std::vector<uint64_t> liveTraces;
+
+/* @brief Ring of the calling thread, cached per thread and left when the thread exits. */
+struct ApiTraceThreadRing {
+    /* @brief Identifier of the trace owning the ring (a new trace may reuse an address). */
+    uint64_t owner;
+    /* @brief The ring. */
+    void *ring;
+    /* @brief Destructor. Leaves the ring to the writer thread. */
+    ~ApiTraceThreadRing() { ApiTrace::leaveRing(owner, ring); }
+};
+
+/* @brief Ring of the calling thread. */
+static thread_local ApiTraceThreadRing threadRingCache = { 0, nullptr };
+
+// -----------------------------------------------------------------------------------------------
+
+ApiTrace::ApiTrace():
+    id(nextTraceId.fetch_add(1)), sequence(0), file(nullptr), tracing(false), records(0),
+    dropped(0) {
+    for (Ring &ring : rings) {
+        ring.claimed.store(false);
+        ring.exited.store(false);
+        ring.head.store(0);
+        ring.tail.store(0);
+    }
+    std::lock_guard<std::mutex> lock(liveTracesMutex);
+    liveTraces.push_back(id);
+}
+
+ApiTrace::~ApiTrace() {
+    stop();
+    // no thread may leave a ring after this
+    std::lock_guard<std::mutex> lock(liveTracesMutex);
+    liveTraces.erase(std::find(liveTraces.begin(), liveTraces.end(), id));
+}
+
+bool ApiTrace::start(const char *path, int sampleRate, float gain) {
+    if (tracing.load()) return false;
+    file = fopen(path, "wb");
+    if (file == nullptr) return false;
+    ApiTraceHeader header;
+    memcpy(header.magic, kApiTraceMagic, sizeof(header.magic));
+    header.version = kApiTraceVersion;
+    header.sampleRate = (uint32_t) sampleRate;
+    header.gain = gain;
+    header.dropped = 0;
+    fwrite(&header, sizeof(header), 1, file);
+    // the owner threads keep writing to their rings: drop what they left there,
+    // and take back the rings of the threads gone since the last trace
+    for (Ring &ring : rings) {
+        ring.tail.store(ring.head.load(std::memory_order_acquire), std::memory_order_release);
+        releaseRing(ring);
+    }
+    records.store(0);
+    dropped.store(0);
+    tracing.store(true);
+    thread = std::thread(&ApiTrace::run, this);
+    return true;
+}
+
+void ApiTrace::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        if (!tracing.load()) return;
+        tracing.store(false);
+    }
+    stopCondition.notify_all();
+    if (thread.joinable()) thread.join();
+    flush();
+    // the calls dropped are known only now
+    uint64_t count = dropped.load();
+    fseek(file, offsetof(ApiTraceHeader, dropped), SEEK_SET);
+    fwrite(&count, sizeof(count), 1, file);
+    fclose(file);
+    file = nullptr;
+}
+
+bool ApiTrace::trace(int64_t frame, int op, int chan, int arg1, int arg2) {
+    if (!tracing.load(std::memory_order_relaxed)) return false;
+    Ring *ring = threadRing();
+    uint32_t head = ring ? ring->head.load(std::memory_order_relaxed) : 0;
+    if (ring == nullptr ||
+            head - ring->tail.load(std::memory_order_acquire) >= (uint32_t) kApiTraceRingSize) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ApiTraceRecord &record = ring->records[head & (kApiTraceRingSize - 1)];
+    record.frame = frame;
+    record.sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+    record.op = (uint8_t) op;
+    record.chan = (uint8_t) chan;
+    record.reserved = 0;
+    record.arg1 = arg1;
+    record.arg2 = arg2;
+    ring->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+ApiTrace::Ring *ApiTrace::threadRing() {
+    if (threadRingCache.owner == id) return static_cast<Ring*>(threadRingCache.ring);
+    // first call of the thread: a bounded scan, no retry
+    for (Ring &ring : rings) {
+        bool expected = false;
+        if (ring.claimed.compare_exchange_strong(expected, true)) {
+            // a thread caches one ring: leave the one of the previous trace
+            leaveRing(threadRingCache.owner, threadRingCache.ring);
+            threadRingCache.owner = id;
+            threadRingCache.ring = &ring;
+            return &ring;
+        }
+    }
+    return nullptr;
+}
+
+void ApiTrace::leaveRing(uint64_t owner, void *ring) {
+    if (ring == nullptr) return;
+    std::lock_guard<std::mutex> lock(liveTracesMutex);
+    if (std::find(liveTraces.begin(), liveTraces.end(), owner) == liveTraces.end()) return;
+    // after the last record of the thread
+    static_cast<Ring*>(ring)->exited.store(true, std::memory_order_release);
+}
+
+void ApiTrace::releaseRing(Ring &ring) {
+    if (!ring.exited.load(std::memory_order_acquire)) return;
+    if (ring.tail.load(std::memory_order_relaxed) != ring.head.load(std::memory_order_relaxed)) {
+        return;
+    }
+    ring.exited.store(false, std::memory_order_relaxed);
+    ring.claimed.store(false, std::memory_order_release);
+}
+
+void ApiTrace::run() {
+    bool running = true;
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            running = !stopCondition.wait_for(lock, std::chrono::milliseconds(kApiTraceFlushMs),
+                                              [this] { return !tracing.load(); });
+        }
+        flush();
+    }
+}
+
+void ApiTrace::flush() {
+    int count = 0;
+    for (Ring &ring : rings) {
+        uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+        uint32_t head = ring.head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            batch[count++] = ring.records[tail & (kApiTraceRingSize - 1)];
+        }
+        ring.tail.store(tail, std::memory_order_release);
+        releaseRing(ring);
+    }
+    if (count == 0) return;
+    std::sort(batch, batch + count, [](const ApiTraceRecord &a, const ApiTraceRecord &b) {
+        return (int32_t) (a.sequence - b.sequence) < 0;
+    });
+    fwrite(batch, sizeof(ApiTraceRecord), count, file);
+    fflush(file);
+    records.fetch_add(count);
+}
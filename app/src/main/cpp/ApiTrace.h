@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ApiTrace.h
+ * @brief Header of ApiTrace class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_APITRACE_H
+#define ANDROID_MIDI_SYNTH_APITRACE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+/** @brief Magic number of the API trace files. */
+static const char kApiTraceMagic[] = "HBAT";
+/** @brief Version of the API trace format. */
+static const int kApiTraceVersion = 2;
+/** @brief Maximum number of threads traced. */
+static const int kApiTraceThreads = 16;
+/** @brief Capacity of the ring of each thread, in records (power of two). */
+static const int kApiTraceRingSize = 512;
+/** @brief Period of the writer thread, in milliseconds. */
+static const int kApiTraceFlushMs = 100;
+
+/** @brief Traced synth calls. */
+enum ApiTraceOp {
+    /** @brief fluid_synth_noteon(chan, arg1 = key, arg2 = velocity), or a heartbeat voice. */
+    kApiTraceOp_NoteOn = 1,
+    /** @brief fluid_synth_noteoff(chan, arg1 = key). */
+    kApiTraceOp_NoteOff,
+    /** @brief fluid_synth_cc(chan, arg1 = controller, arg2 = value). */
+    kApiTraceOp_Control,
+    /** @brief fluid_synth_program_change(chan, arg1 = program). */
+    kApiTraceOp_ProgramChange,
+    /** @brief fluid_synth_bank_select(chan, arg1 = bank). */
+    kApiTraceOp_BankSelect,
+    /** @brief fluid_synth_pitch_bend(chan, arg1 = value). */
+    kApiTraceOp_PitchBend,
+    /** @brief fluid_synth_key_pressure(chan, arg1 = key, arg2 = value). */
+    kApiTraceOp_KeyPressure,
+    /** @brief fluid_synth_channel_pressure(chan, arg1 = value). */
+    kApiTraceOp_ChannelPressure,
+    /** @brief Reverb level (arg1 = 0-127). */
+    kApiTraceOp_Reverb,
+    /** @brief Chorus level (arg1 = 0-127). */
+    kApiTraceOp_Chorus,
+    /** @brief fluid_synth_set_gen(chan, arg1 = generator, arg2 = float bits). */
+    kApiTraceOp_SetGen,
+    /** @brief Soundfont loaded and selected (arg1 = file size, arg2 = hash of the name). */
+    kApiTraceOp_LoadSoundFont,
+    /** @brief fluid_synth_system_reset(). */
+    kApiTraceOp_SystemReset,
+    /** @brief Render period (arg1 = frames), traced when it changes. */
+    kApiTraceOp_Period,
+    /** @brief Quality tier (arg1 = QualityTier): interpolation, polyphony and effects. */
+    kApiTraceOp_Quality,
+    /** @brief Voice priority of a channel (chan, arg1 = VoicePriority, arg2 = budget). */
+    kApiTraceOp_VoicePriority,
+    /** @brief Channel played by the heartbeat voices (arg1 = channel, -1 for none). */
+    kApiTraceOp_HeartbeatChannel,
+    /** @brief Heart of the heartbeat voices (arg1 = BPM, arg2 = RMSSD in ms, float bits). */
+    kApiTraceOp_Heart,
+    /** @brief Gain of the output stage (arg1 = linear gain, float bits). */
+    kApiTraceOp_OutputGain
+};
+
+/**
+ * @brief Header of an API trace file.
+ * @details Followed by ApiTraceRecord entries, in blocks ordered by sequence number
+ *          (a record may land in a later block than records with greater numbers).
+ */
+struct ApiTraceHeader {
+    /** @brief Magic number (kApiTraceMagic). */
+    char magic[4];
+    /** @brief Format version. */
+    uint32_t version;
+    /** @brief Sample rate of the synth, in Hz. */
+    uint32_t sampleRate;
+    /** @brief Gain of the synth. */
+    float gain;
+    /** @brief Calls dropped while tracing (the trace is incomplete if not zero). */
+    uint64_t dropped;
+};
+
+/** @brief A traced call. */
+struct ApiTraceRecord {
+    /** @brief Audio frame of the call. */
+    int64_t frame;
+    /** @brief Global order of the call. */
+    uint32_t sequence;
+    /** @brief The call (ApiTraceOp). */
+    uint8_t op;
+    /** @brief Channel number. */
+    uint8_t chan;
+    /** @brief Reserved (zero). */
+    uint16_t reserved;
+    /** @brief First argument. */
+    int32_t arg1;
+    /** @brief Second argument. */
+    int32_t arg2;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief ApiTrace class.
+ * @details Captures the calls made to the synth into a binary trace, for offline replay.
+ *          trace() is wait-free: each thread owns a single-producer ring (claimed on its
+ *          first call, among kApiTraceThreads, and released once drained after the thread
+ *          exits), and the global order comes from one atomic counter. A full ring, or a
+ *          thread without ring, drops the call and counts it in the header of the file.
+ *          A writer thread drains the rings and appends the records to the file.
+ */
+class ApiTrace {
+public:
+    /** @brief Constructor. */
+    ApiTrace();
+    /** @brief Destructor. Stops tracing. */
+    ~ApiTrace();
+    /**
+     * @brief Start tracing.
+     * @param path Path of the trace file (overwritten).
+     * @param sampleRate Sample rate of the synth, in Hz.
+     * @param gain Gain of the synth.
+     * @return True if successful. False otherwise.
+     */
+    bool start(const char *path, int sampleRate, float gain);
+    /** @brief Stop tracing, write the remaining records and close the file. */
+    void stop();
+    /**
+     * @brief Check if tracing.
+     * @return True if tracing.
+     */
+    bool isTracing() const { return tracing.load(std::memory_order_relaxed); }
+    /**
+     * @brief Trace a call (any thread, wait-free).
+     * @param frame Audio frame of the call.
+     * @param op The call (ApiTraceOp).
+     * @param chan Channel number.
+     * @param arg1 First argument.
+     * @param arg2 Second argument.
+     * @return True if successful. False if not tracing or dropped.
+     */
+    bool trace(int64_t frame, int op, int chan, int arg1, int arg2);
+    /**
+     * @brief Get the number of records written.
+     * @return The number of records.
+     */
+    uint64_t getRecords() const { return records.load(); }
+    /**
+     * @brief Get the number of calls dropped (ring full or too many threads).
+     * @return The number of calls.
+     */
+    uint64_t getDropped() const { return dropped.load(); }
+private:
+    /* @brief Ring of a thread. */
+    struct Ring {
+        /* @brief True once a thread owns the ring. */
+        std::atomic<bool> claimed;
+        /* @brief True once the owner thread exits (released when drained). */
+        std::atomic<bool> exited;
+        /* @brief Records written (owner thread). */
+        std::atomic<uint32_t> head;
+        /* @brief Records read (writer thread). */
+        std::atomic<uint32_t> tail;
+        /* @brief Records. */
+        ApiTraceRecord records[kApiTraceRingSize];
+    };
+    /* @brief Get the ring of the calling thread, claiming one if needed.
+     * @return The ring, or nullptr if all rings are taken. */
+    Ring *threadRing();
+    /* @brief Mark a ring as left by its thread, if its trace still exists.
+     * @param owner Identifier of the trace owning the ring.
+     * @param ring The ring. */
+    static void leaveRing(uint64_t owner, void *ring);
+    /* @brief Release a ring left by its thread, if drained.
+     * @param ring The ring. */
+    static void releaseRing(Ring &ring);
+    /* @brief Writer thread body. */
+    void run();
+    /* @brief Drain the rings into the file. */
+    void flush();
+private:
+    /* @brief Unique identifier of the trace. */
+    uint64_t id;
+    /* @brief Rings of the threads. */
+    Ring rings[kApiTraceThreads];
+    /* @brief Records of the current flush. */
+    ApiTraceRecord batch[kApiTraceThreads * kApiTraceRingSize];
+    /* @brief Next sequence number. */
+    std::atomic<uint32_t> sequence;
+    /* @brief Output file. */
+    FILE *file;
+    /* @brief True while tracing. */
+    std::atomic<bool> tracing;
+    /* @brief Number of written records. */
+    std::atomic<uint64_t> records;
+    /* @brief Number of dropped calls. */
+    std::atomic<uint64_t> dropped;
+    /* @brief Writer thread. */
+    std::thread thread;
+    /* @brief Guards the stop condition. */
+    std::mutex stopMutex;
+    /* @brief Wakes the writer thread up to stop. */
+    std::condition_variable stopCondition;
+    friend struct ApiTraceThreadRing;
+};
+
+#endif //ANDROID_MIDI_SYNTH_APITRACE_H
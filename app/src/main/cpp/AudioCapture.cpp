@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AudioCapture.cpp
+ * @brief Implementation of AudioCapture class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <time.h>
+#include <chrono>
+#include <cstring>
+
+#include "AudioCapture.h"
+
+/* @brief Sample rate of Opus streams, in Hz. */
+static const int kOpusSampleRate = 48000;
+/* @brief Number of channels of the captured audio. */
+static const int kAudioCaptureChannels = 2;
+
+/* @brief Read the CPU time of the calling thread, in nanoseconds. */
+static int64_t threadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* @brief Write a little endian 16-bit value. */
+static void writeU16(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+}
+
+/* @brief Write a little endian 32-bit value. */
+static void writeU32(uint8_t *p, uint32_t value) {
+    writeU16(p, value);
+    writeU16(p + 2, value >> 16);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+AudioCapture::AudioCapture():
+    writePos(0), readPos(0), encoder(nullptr), file(nullptr), sampleRate(kOpusSampleRate),
+    resampleStep(1.0), resamplePos(1.0), lastFrame{ 0.0f, 0.0f }, packetFrames(0),
+    packetNumber(0), granulePos(0), preSkip(0), capturing(false), encoderCpuNs(0),
+    encodedFrames(0), bytesWritten(0), overruns(0) {
+    memset(&stream, 0, sizeof(stream));
+}
+
+AudioCapture::~AudioCapture() {
+    stop();
+}
+
+bool AudioCapture::start(const char *path, int rate, int bitrate, int complexity) {
+    if (capturing.load() || rate <= 0) return false;
+    int error;
+    encoder = opus_encoder_create(kOpusSampleRate, kAudioCaptureChannels,
+                                  OPUS_APPLICATION_AUDIO, &error);
+    if (encoder == nullptr || error != OPUS_OK) return false;
+    file = fopen(path, "wb");
+    if (file == nullptr) {
+        opus_encoder_destroy(encoder);
+        encoder = nullptr;
+        return false;
+    }
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(bitrate));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    sampleRate = rate;
+    resampleStep = (double) rate / kOpusSampleRate;
+    resamplePos = 1.0;
+    lastFrame[0] = lastFrame[1] = 0.0f;
+    packetFrames = 0;
+    packetNumber = 0;
+    preSkip = lookahead;
+    granulePos = preSkip;
+    encoderCpuNs.store(0);
+    encodedFrames.store(0);
+    bytesWritten.store(0);
+    overruns.store(0);
+    ogg_stream_init(&stream, (int) (std::chrono::steady_clock::now().time_since_epoch().count()));
+    // identification header (RFC 7845): version, channels, pre-skip, input rate, gain, mapping
+    uint8_t head[19] = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, kAudioCaptureChannels };
+    writeU16(head + 10, preSkip);
+    writeU32(head + 12, rate);
+    ogg_packet op = { head, sizeof(head), 1, 0, 0, packetNumber++ };
+    ogg_stream_packetin(&stream, &op);
+    writePages(true);
+    // comment header: vendor string, no comments
+    const char *vendor = opus_get_version_string();
+    uint32_t vendorLength = (uint32_t) strlen(vendor);
+    uint8_t tags[8 + 4 + 64 + 4] = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+    if (vendorLength > 64) vendorLength = 64;
+    writeU32(tags + 8, vendorLength);
+    memcpy(tags + 12, vendor, vendorLength);
+    writeU32(tags + 12 + vendorLength, 0);
+    op = { tags, 16 + vendorLength, 0, 0, 0, packetNumber++ };
+    ogg_stream_packetin(&stream, &op);
+    writePages(true);
+    // the render thread owns writePos: drop whatever it left in the ring
+    readPos.store(writePos.load(std::memory_order_acquire), std::memory_order_release);
+    capturing.store(true);
+    thread = std::thread(&AudioCapture::run, this);
+    return true;
+}
+
+void AudioCapture::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        if (!capturing.load()) return;
+        capturing.store(false);
+    }
+    stopCondition.notify_all();
+    if (thread.joinable()) thread.join();
+    ogg_stream_clear(&stream);
+    opus_encoder_destroy(encoder);
+    encoder = nullptr;
+    fclose(file);
+    file = nullptr;
+}
+
+bool AudioCapture::write(const float *left, const float *right, int frames) {
+    if (!capturing.load(std::memory_order_relaxed)) return false;
+    uint32_t pos = writePos.load(std::memory_order_relaxed);
+    uint32_t used = pos - readPos.load(std::memory_order_acquire);
+    if (used + frames > (uint32_t) kAudioCaptureRingFrames) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    for (int i = 0; i < frames; i++) {
+        float *frame = ring + ((pos + i) & (kAudioCaptureRingFrames - 1)) * 2;
+        frame[0] = left[i];
+        frame[1] = right[i];
+    }
+    writePos.store(pos + frames, std::memory_order_release);
+    return true;
+}
+
+void AudioCapture::run() {
+    bool running = true;
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            running = !stopCondition.wait_for(lock, std::chrono::milliseconds(kAudioCapturePollMs),
+                                              [this] { return !capturing.load(); });
+        }
+        int64_t start = threadCpuNs();
+        encode(!running);
+        encoderCpuNs.fetch_add(threadCpuNs() - start);
+    }
+}
+
+void AudioCapture::encode(bool last) {
+    uint32_t pos = readPos.load(std::memory_order_relaxed);
+    uint32_t end = writePos.load(std::memory_order_acquire);
+    for (; pos != end; pos++) {
+        const float *frame = ring + (pos & (kAudioCaptureRingFrames - 1)) * 2;
+        // linear interpolation between the last and the current input frame
+        while (resamplePos <= 1.0) {
+            float t = (float) resamplePos;
+            float *out = packet + packetFrames * 2;
+            out[0] = lastFrame[0] + (frame[0] - lastFrame[0]) * t;
+            out[1] = lastFrame[1] + (frame[1] - lastFrame[1]) * t;
+            resamplePos += resampleStep;
+            if (++packetFrames == kPacketFrames) encodePacket(false);
+        }
+        resamplePos -= 1.0;
+        lastFrame[0] = frame[0];
+        lastFrame[1] = frame[1];
+    }
+    encodedFrames.fetch_add(end - readPos.load(std::memory_order_relaxed));
+    readPos.store(end, std::memory_order_release);
+    if (last) {
+        encodePacket(true);
+    } else {
+        writePages(false);
+    }
+}
+
+void AudioCapture::encodePacket(bool last) {
+    // the granule position of the last page trims the padding of the last packet
+    int frames = packetFrames;
+    memset(packet + packetFrames * 2, 0, (kPacketFrames - packetFrames) * 2 * sizeof(float));
+    packetFrames = 0;
+    opus_int32 bytes = opus_encode_float(encoder, packet, kPacketFrames, packetData,
+                                         kMaxPacketBytes);
+    if (bytes < 0) return;
+    granulePos += last ? frames : kPacketFrames;
+    ogg_packet op = { packetData, bytes, 0, last ? 1 : 0, granulePos, packetNumber++ };
+    ogg_stream_packetin(&stream, &op);
+    if (last) writePages(true);
+}
+
+void AudioCapture::writePages(bool flush) {
+    ogg_page page;
+    while (flush ? ogg_stream_flush(&stream, &page) : ogg_stream_pageout(&stream, &page)) {
+        fwrite(page.header, 1, page.header_len, file);
+        fwrite(page.body, 1, page.body_len, file);
+        bytesWritten.fetch_add(page.header_len + page.body_len);
+    }
+    if (flush) fflush(file);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/AudioCapture.h
+ * @brief Header of AudioCapture class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_AUDIOCAPTURE_H
+#define ANDROID_MIDI_SYNTH_AUDIOCAPTURE_H
+
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+/** @brief Capacity of the capture ring, in stereo frames (power of two). */
+static const int kAudioCaptureRingFrames = 65536;
+/** @brief Default bitrate of the encoded audio, in bits per second. */
+static const int kAudioCaptureBitrate = 24000;
+/** @brief Default complexity of the encoder (0 to 10). */
+static const int kAudioCaptureComplexity = 3;
+/** @brief Period of the encoder thread, in milliseconds. */
+static const int kAudioCapturePollMs = 100;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief AudioCapture class.
+ * @details Captures the stereo render output to an Ogg/Opus file. write() only copies the
+ *          block into a single-producer/single-consumer lock-free ring, so it can be called
+ *          from the render thread. An encoder thread drains the ring, resamples to 48 kHz
+ *          (the Opus rate; linear interpolation, the encoder low-passes anyway), encodes
+ *          20 ms packets and writes Ogg pages. The CPU time of the encoder is measured with
+ *          the thread CPU clock.
+ */
+class AudioCapture {
+public:
+    /** @brief Constructor. */
+    AudioCapture();
+    /** @brief Destructor. Stops the capture. */
+    ~AudioCapture();
+    /**
+     * @brief Start capturing.
+     * @param path Path of the Ogg/Opus file (overwritten).
+     * @param sampleRate Sample rate of the captured audio, in Hz.
+     * @param bitrate Bitrate of the encoded audio, in bits per second.
+     * @param complexity Complexity of the encoder (0 to 10).
+     * @return True if successful. False otherwise.
+     */
+    bool start(const char *path, int sampleRate, int bitrate = kAudioCaptureBitrate,
+               int complexity = kAudioCaptureComplexity);
+    /** @brief Stop capturing, encode the remaining audio and close the file. */
+    void stop();
+    /**
+     * @brief Check if capturing.
+     * @return True if capturing.
+     */
+    bool isCapturing() const { return capturing.load(std::memory_order_relaxed); }
+    /**
+     * @brief Capture a block (render thread, lock-free).
+     * @details The whole block is dropped if the ring has no room for it.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     * @return True if successful. False if not capturing or the ring is full.
+     */
+    bool write(const float *left, const float *right, int frames);
+    /**
+     * @brief Get the CPU time used by the encoder thread.
+     * @return CPU time, in nanoseconds.
+     */
+    int64_t getEncoderCpuNs() const { return encoderCpuNs.load(); }
+    /**
+     * @brief Get the number of encoded frames.
+     * @return Number of frames, at the capture sample rate.
+     */
+    int64_t getEncodedFrames() const { return encodedFrames.load(); }
+    /**
+     * @brief Get the number of bytes written to the file.
+     * @return Number of bytes.
+     */
+    int64_t getBytesWritten() const { return bytesWritten.load(); }
+    /**
+     * @brief Get the number of blocks dropped because the ring was full.
+     * @return Number of blocks.
+     */
+    uint64_t getOverruns() const { return overruns.load(); }
+private:
+    /* @brief Samples per channel of an Opus packet (20 ms at 48 kHz). */
+    static const int kPacketFrames = 960;
+    /* @brief Maximum size of an Opus packet, in bytes. */
+    static const int kMaxPacketBytes = 1500;
+    /* @brief Encoder thread body. */
+    void run();
+    /* @brief Encode the audio available in the ring.
+     * @param last True to flush a partial packet and end the stream. */
+    void encode(bool last);
+    /* @brief Encode the pending packet and write the full pages.
+     * @param last True if it is the last packet of the stream. */
+    void encodePacket(bool last);
+    /* @brief Write the pages of the stream.
+     * @param flush True to write a partial page too. */
+    void writePages(bool flush);
+private:
+    /* @brief Interleaved stereo samples. */
+    float ring[kAudioCaptureRingFrames * 2];
+    /* @brief Frames written so far (render thread). */
+    std::atomic<uint32_t> writePos;
+    /* @brief Frames read so far (encoder thread). */
+    std::atomic<uint32_t> readPos;
+    /* @brief Opus encoder. */
+    OpusEncoder *encoder;
+    /* @brief Ogg stream. */
+    ogg_stream_state stream;
+    /* @brief Output file. */
+    FILE *file;
+    /* @brief Sample rate of the captured audio, in Hz. */
+    int sampleRate;
+    /* @brief Input frames per output frame of the resampler. */
+    double resampleStep;
+    /* @brief Position of the next output frame, in input frames after lastFrame. */
+    double resamplePos;
+    /* @brief Last input frame of the resampler. */
+    float lastFrame[2];
+    /* @brief Pending samples of the next packet (48 kHz, interleaved). */
+    float packet[kPacketFrames * 2];
+    /* @brief Number of frames in the pending packet. */
+    int packetFrames;
+    /* @brief Encoded packet. */
+    uint8_t packetData[kMaxPacketBytes];
+    /* @brief Number of the next Ogg packet. */
+    int64_t packetNumber;
+    /* @brief Samples encoded (48 kHz), including the pre-skip. */
+    int64_t granulePos;
+    /* @brief Samples of the encoder delay at the start of the stream (48 kHz). */
+    int preSkip;
+    /* @brief True while capturing. */
+    std::atomic<bool> capturing;
+    /* @brief CPU time of the encoder thread, in nanoseconds. */
+    std::atomic<int64_t> encoderCpuNs;
+    /* @brief Captured frames encoded so far. */
+    std::atomic<int64_t> encodedFrames;
+    /* @brief Bytes written to the file. */
+    std::atomic<int64_t> bytesWritten;
+    /* @brief Number of dropped blocks. */
+    std::atomic<uint64_t> overruns;
+    /* @brief Encoder thread. */
+    std::thread thread;
+    /* @brief Guards the stop condition. */
+    std::mutex stopMutex;
+    /* @brief Wakes the encoder thread up to stop. */
+    std::condition_variable stopCondition;
+};
+
+#endif //ANDROID_MIDI_SYNTH_AUDIOCAPTURE_H
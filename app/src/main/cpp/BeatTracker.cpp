@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BeatTracker.cpp
+ * @brief Implementation of BeatTracker class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+
+#include "BeatTracker.h"
+
+/* @brief Initial beat period, in seconds (60 BPM). */
+static const double kBeatTrackerDefaultPeriod = 1.0;
+/* @brief Default time constant of the period loop, in seconds. */
+static const double kBeatTrackerDefaultTimeConstant = 2.0;
+
+// -----------------------------------------------------------------------------------------------
+
+BeatTracker::BeatTracker():
+    timeConstant(kBeatTrackerDefaultTimeConstant), targetPeriod(kBeatTrackerDefaultPeriod),
+    period(kBeatTrackerDefaultPeriod), phase(0.0), lastTime(0.0), started(false), beatCount(0),
+    pendingBeats(0) {
+}
+
+void BeatTracker::setTimeConstant(double seconds) {
+    timeConstant = seconds < 0.0 ? 0.0 : seconds;
+}
+
+void BeatTracker::update(double time, double bpm) {
+    if (bpm <= 0.0) return;
+    // beats up to now are reported by the next advance()
+    pendingBeats += advance(time);
+    targetPeriod = 60.0 / bpm;
+    if (timeConstant == 0.0) period = targetPeriod;
+}
+
+int BeatTracker::advance(double time) {
+    if (!started) {
+        lastTime = time;
+        started = true;
+        return 0;
+    }
+    double dt = time - lastTime;
+    if (dt <= 0.0) return takePendingBeats(0);
+    // the period follows the target exponentially, p(t) = T + (p0 - T) * exp(-t / tau), and
+    // the phase is its exact integral, so a gap of any length costs the same
+    double start = period;
+    if (timeConstant > 0.0) {
+        period = targetPeriod + (start - targetPeriod) * exp(-dt / timeConstant);
+        phase += (dt + timeConstant * log(period / start)) / targetPeriod;
+    } else {
+        phase += dt / period;
+    }
+    lastTime = time;
+    int beats = 0;
+    if (phase >= 1.0) {
+        double whole = floor(phase);
+        phase -= whole;
+        beats = (int) whole;
+    }
+    return takePendingBeats(beats);
+}
+
+int BeatTracker::takePendingBeats(int beats) {
+    beatCount += beats;
+    beats += pendingBeats;
+    pendingBeats = 0;
+    return beats;
+}
+
+double BeatTracker::getNextBeatTime() const {
+    return lastTime + (1.0 - phase) * period;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BeatTracker.h
+ * @brief Header of BeatTracker class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_BEATTRACKER_H
+#define ANDROID_MIDI_SYNTH_BEATTRACKER_H
+
+#include <cstdint>
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief BeatTracker class.
+ * @details Phase-locked beat clock driven by heart-rate samples. The beat phase is continuous:
+ *          a new heart rate only changes how fast the phase advances, and the period follows
+ *          the measured rate through a first-order loop, so a tempo change never fires a beat
+ *          twice nor skips one. Times are in seconds on any monotonic origin. Not thread safe.
+ */
+class BeatTracker {
+public:
+    /** @brief Constructor. */
+    BeatTracker();
+    /**
+     * @brief Set how fast the period follows the heart rate.
+     * @param seconds Time constant of the period loop, in seconds (0 follows at once).
+     */
+    void setTimeConstant(double seconds);
+    /**
+     * @brief Feed a heart-rate sample.
+     * @param time Time of the sample, in seconds.
+     * @param bpm Heart rate, in beats per minute (ignored if not positive).
+     */
+    void update(double time, double bpm);
+    /**
+     * @brief Advance the beat clock.
+     * @param time Current time, in seconds (not before the previous call).
+     * @return The number of beats that fell in (previous time, time].
+     */
+    int advance(double time);
+    /**
+     * @brief Get the time of the next beat, assuming the current period.
+     * @return Time of the next beat, in seconds.
+     */
+    double getNextBeatTime() const;
+    /**
+     * @brief Get the current beat period.
+     * @return Period, in seconds.
+     */
+    double getPeriod() const { return period; }
+    /**
+     * @brief Get the current beat phase.
+     * @return Fraction of the current beat elapsed (0 to 1).
+     */
+    double getPhase() const { return phase; }
+    /**
+     * @brief Get the number of beats so far.
+     * @return The number of beats.
+     */
+    int64_t getBeatCount() const { return beatCount; }
+private:
+    /* @brief Count the beats of an advance() and report the pending ones with them.
+     * @param beats Beats passed in the advance().
+     * @return The number of beats to report. */
+    int takePendingBeats(int beats);
+private:
+    /* @brief Time constant of the period loop, in seconds. */
+    double timeConstant;
+    /* @brief Period the loop converges to, in seconds. */
+    double targetPeriod;
+    /* @brief Current period, in seconds. */
+    double period;
+    /* @brief Fraction of the current beat elapsed. */
+    double phase;
+    /* @brief Time of the last advance(), in seconds. */
+    double lastTime;
+    /* @brief True once started (first advance() or update()). */
+    bool started;
+    /* @brief Number of beats so far. */
+    int64_t beatCount;
+    /* @brief Beats passed during update() and not yet reported by advance(). */
+    int pendingBeats;
+};
+
+#endif //ANDROID_MIDI_SYNTH_BEATTRACKER_H
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiDecoder.cpp
+ * @brief Implementation of BleMidiDecoder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "MidiSpec.h"
+#include "BleMidiDecoder.h"
+
+/* @brief Range of the BLE-MIDI timestamps, in milliseconds. */
+static const int kBleMidiTimestampRange = 8192;
+
+// -----------------------------------------------------------------------------------------------
+
+BleMidiDecoder::BleMidiDecoder(BleMidiListener *listener): listener(listener) {
+    reset();
+}
+
+void BleMidiDecoder::reset() {
+    timeMs = 0;
+    hasTime = false;
+    status = 0;
+    dataCount = 0;
+    inSysEx = false;
+    sysExOverflow = false;
+    sysExLength = 0;
+}
+
+void BleMidiDecoder::setTimestamp(int timestamp) {
+    if (!hasTime) {
+        timeMs = timestamp;
+        hasTime = true;
+        return;
+    }
+    // shortest distance on the 13-bit circle, so late or reordered messages go back in time
+    int delta = (timestamp - (int) (timeMs % kBleMidiTimestampRange) + kBleMidiTimestampRange)
+                % kBleMidiTimestampRange;
+    if (delta >= kBleMidiTimestampRange / 2) delta -= kBleMidiTimestampRange;
+    timeMs += delta;
+}
+
+bool BleMidiDecoder::decode(const uint8_t *packet, int length) {
+    // header: 10hh hhhh, then at least a timestamp byte
+    if (length < 2 || (packet[0] & 0xC0) != 0x80) return false;
+    int high = packet[0] & 0x3F;
+    int lastLow = -1;
+    bool expectTimestamp = !inSysEx;
+    int i = 1;
+    while (i < length) {
+        uint8_t b = packet[i];
+        if (b & 0x80) {
+            if (expectTimestamp || inSysEx) {
+                // timestamp byte, possibly inside a SysEx (before its end or a realtime byte)
+                int low = b & 0x7F;
+                if (lastLow >= 0 && low < lastLow) high = (high + 1) & 0x3F;
+                lastLow = low;
+                setTimestamp((high << 7) | low);
+                expectTimestamp = false;
+                i++;
+                if (i >= length) return false;
+                b = packet[i];
+                if (!(b & 0x80)) {
+                    // running status with a new timestamp
+                    if (status == 0) return false;
+                    continue;
+                }
+            }
+            // status byte
+            i++;
+            if (b >= kMIDISysCmd_TimingClock) {
+                listener->onBleMidiMessage(timeMs, b, 0, 0);
+                expectTimestamp = !inSysEx;
+                continue;
+            }
+            if (b == kMIDISysCmd_EndOfSysEx) {
+                if (inSysEx && !sysExOverflow) listener->onBleMidiSysEx(timeMs, sysEx, sysExLength);
+                inSysEx = false;
+                expectTimestamp = true;
+                continue;
+            }
+            inSysEx = false;
+            dataCount = 0;
+            if (b == kMIDISysCmd_SysEx) {
+                status = 0;
+                inSysEx = true;
+                sysExOverflow = false;
+                sysExLength = 0;
+                continue;
+            }
+            status = b;
+            if (MidiParser::dataLength(status) == 0) {
+                deliver();
+                expectTimestamp = true;
+            }
+            continue;
+        }
+        // data byte
+        i++;
+        if (inSysEx) {
+            if (sysExLength < kMidiParserMaxSysEx) sysEx[sysExLength++] = b;
+            else sysExOverflow = true;
+            continue;
+        }
+        if (status == 0) return false;
+        data[dataCount++] = b;
+        if (dataCount == MidiParser::dataLength(status)) {
+            deliver();
+            // the next byte is a timestamp or running status data with the same time
+            expectTimestamp = true;
+        }
+    }
+    return true;
+}
+
+void BleMidiDecoder::deliver() {
+    int count = MidiParser::dataLength(status);
+    listener->onBleMidiMessage(timeMs, status, count > 0 ? data[0] : 0, count > 1 ? data[1] : 0);
+    dataCount = 0;
+    // system common messages have no running status
+    if (status >= kMIDISysCmdChan) status = 0;
+}
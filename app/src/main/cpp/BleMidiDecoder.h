@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiDecoder.h
+ * @brief Header of BleMidiDecoder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_BLEMIDIDECODER_H
+#define ANDROID_MIDI_SYNTH_BLEMIDIDECODER_H
+
+#include <cstdint>
+
+#include "MidiParser.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief BleMidiListener interface.
+ * @details Receives the messages decoded by a BleMidiDecoder.
+ */
+class BleMidiListener {
+public:
+    /** @brief Destructor. */
+    virtual ~BleMidiListener() = default;
+    /**
+     * @brief A channel, system common or realtime message was received.
+     * @param timeMs Sender time of the message, in milliseconds, unwrapped (monotonic).
+     * @param status Status byte.
+     * @param data1 First data byte (0 if not used by the message).
+     * @param data2 Second data byte (0 if not used by the message).
+     */
+    virtual void onBleMidiMessage(int64_t timeMs, uint8_t status, uint8_t data1, uint8_t data2) = 0;
+    /**
+     * @brief A SysEx message was received.
+     * @param timeMs Sender time of the end of the message, in milliseconds.
+     * @param data Payload, without the SysEx and End Of SysEx bytes. Only valid during the call.
+     * @param length Payload length, in bytes.
+     */
+    virtual void onBleMidiSysEx(int64_t timeMs, const uint8_t *data, int length) = 0;
+};
+
+/**
+ * @brief BleMidiDecoder class.
+ * @details Decodes BLE-MIDI packets: the header and per-message timestamp bytes, running status
+ *          (with or without a new timestamp), interleaved realtime messages and SysEx spanning
+ *          several packets. The 13-bit timestamps are unwrapped into a monotonic sender time.
+ *          Not thread safe. Does not allocate memory.
+ */
+class BleMidiDecoder {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the decoded messages.
+     */
+    explicit BleMidiDecoder(BleMidiListener *listener);
+    /**
+     * @brief Decode a packet.
+     * @param packet Packet bytes (the value of one characteristic write or notification).
+     * @param length Packet length, in bytes.
+     * @return True if the packet is valid. False if it was (partially) discarded.
+     */
+    bool decode(const uint8_t *packet, int length);
+    /** @brief Forget the running status, any partial SysEx and the time reference. */
+    void reset();
+private:
+    /* @brief Set the current time from a 13-bit timestamp. */
+    void setTimestamp(int timestamp);
+    /* @brief Deliver the message being received if it is complete. */
+    void deliver();
+private:
+    /* @brief Receives the decoded messages. */
+    BleMidiListener *listener;
+    /* @brief Current unwrapped sender time, in milliseconds. */
+    int64_t timeMs;
+    /* @brief True once timeMs holds a received time. */
+    bool hasTime;
+    /* @brief Running status, or 0 if none. */
+    uint8_t status;
+    /* @brief Data bytes of the message being received. */
+    uint8_t data[2];
+    /* @brief Number of data bytes received. */
+    int dataCount;
+    /* @brief True while receiving a SysEx. */
+    bool inSysEx;
+    /* @brief True if the SysEx being received did not fit in the buffer. */
+    bool sysExOverflow;
+    /* @brief Length of the SysEx payload received so far. */
+    int sysExLength;
+    /* @brief SysEx payload. */
+    uint8_t sysEx[kMidiParserMaxSysEx];
+};
+
+#endif //ANDROID_MIDI_SYNTH_BLEMIDIDECODER_H
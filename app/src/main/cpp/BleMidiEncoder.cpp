@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiEncoder.cpp
+ * @brief Implementation of BleMidiEncoder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "MidiSpec.h"
+#include "BleMidiEncoder.h"
+
+/* @brief BLE-MIDI header byte for a timestamp (ms). */
+#define BLE_MIDI_HEADER(x) ((uint8_t) (0x80 | (((x) >> 7) & 0x3F)))
+/* @brief BLE-MIDI timestamp byte for a timestamp (ms). */
+#define BLE_MIDI_TIMESTAMP(x) ((uint8_t) (0x80 | ((x) & 0x7F)))
+
+/* @brief Largest time between two messages of a packet, in milliseconds (one timestamp wrap). */
+static const int64_t kBleMidiMaxGapMs = 127;
+
+// -----------------------------------------------------------------------------------------------
+
+BleMidiEncoder::BleMidiEncoder(BleMidiPacketListener *listener):
+    listener(listener), packetSize(kBleMidiDefaultPacket), maxDelayMs(0), length(0),
+    startMs(0), lastMs(0), runningStatus(0), packetCount(0), byteCount(0) {
+}
+
+void BleMidiEncoder::configure(int size, int delayMs) {
+    flush();
+    if (size < 5) size = 5;
+    if (size > kBleMidiMaxPacket) size = kBleMidiMaxPacket;
+    packetSize = size;
+    maxDelayMs = delayMs < 0 ? 0 : delayMs;
+}
+
+void BleMidiEncoder::add(int64_t timeMs, const uint8_t *message, int messageLength) {
+    if (messageLength < 1 || messageLength > 3) return;
+    uint8_t status = message[0];
+    uint8_t timestamp = BLE_MIDI_TIMESTAMP(timeMs);
+    // the header carries the high timestamp bits of the first message; the receiver counts
+    // a wrap of the low bits within the packet, so they may only wrap once between messages
+    if (length > 0 && (timeMs - startMs > maxDelayMs || timeMs < lastMs ||
+                       timeMs - lastMs > kBleMidiMaxGapMs)) {
+        flush();
+    }
+    // running status: same status and time, only the data bytes are needed
+    bool running = length > 0 && status == runningStatus && timeMs == lastMs;
+    int needed = running ? messageLength - 1 : messageLength + 1;
+    if (length > 0 && length + needed > packetSize) {
+        flush();
+        running = false;
+        needed = messageLength + 1;
+    }
+    if (length == 0) {
+        packet[length++] = BLE_MIDI_HEADER(timeMs);
+        startMs = timeMs;
+        runningStatus = 0;
+    }
+    if (running) {
+        for (int i = 1; i < messageLength; i++) packet[length++] = message[i];
+    } else {
+        packet[length++] = timestamp;
+        for (int i = 0; i < messageLength; i++) packet[length++] = message[i];
+    }
+    lastMs = timeMs;
+    // only omit the status right after a channel message of the same status, as some
+    // decoders do not resume the running status after an interleaved realtime message
+    runningStatus = status < kMIDISysCmdChan ? status : 0;
+}
+
+void BleMidiEncoder::poll(int64_t nowMs) {
+    if (length > 0 && nowMs - startMs >= maxDelayMs) flush();
+}
+
+void BleMidiEncoder::flush() {
+    if (length == 0) return;
+    listener->onBleMidiPacket(packet, length);
+    packetCount++;
+    byteCount += length;
+    length = 0;
+    runningStatus = 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiEncoder.h
+ * @brief Header of BleMidiEncoder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_BLEMIDIENCODER_H
+#define ANDROID_MIDI_SYNTH_BLEMIDIENCODER_H
+
+#include <cstdint>
+
+/** @brief Largest BLE-MIDI packet handled, in bytes (max. ATT MTU 517 minus 3 bytes of header). */
+static const int kBleMidiMaxPacket = 514;
+/** @brief Default BLE-MIDI packet size, for the default ATT MTU of 23 bytes. */
+static const int kBleMidiDefaultPacket = 20;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief BleMidiPacketListener interface.
+ * @details Receives the BLE-MIDI packets completed by a BleMidiEncoder.
+ */
+class BleMidiPacketListener {
+public:
+    /** @brief Destructor. */
+    virtual ~BleMidiPacketListener() = default;
+    /**
+     * @brief A packet is ready to be written to the BLE-MIDI characteristic.
+     * @param packet Packet bytes. Only valid during the call.
+     * @param length Packet length, in bytes.
+     */
+    virtual void onBleMidiPacket(const uint8_t *packet, int length) = 0;
+};
+
+/**
+ * @brief BleMidiEncoder class.
+ * @details Packs MIDI messages into BLE-MIDI packets: a header byte with the high 6 bits of the
+ *          13-bit millisecond timestamp, then each message preceded by a timestamp byte with
+ *          the low 7 bits. Running status is used within a packet. A packet is completed when
+ *          the next message does not fit, when it is older than the maximum delay (see
+ *          poll()), when the next message is earlier or more than 127 ms later than the last
+ *          one, or on flush(). The low timestamp bits may wrap within a packet, the receiver
+ *          carries the wrap into the high bits. SysEx is not supported.
+ *          Not thread safe. Does not allocate memory.
+ */
+class BleMidiEncoder {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the completed packets.
+     */
+    explicit BleMidiEncoder(BleMidiPacketListener *listener);
+    /**
+     * @brief Configure the encoder. Flushes the pending packet.
+     * @param packetSize Maximum packet size, in bytes (ATT MTU - 3).
+     * @param maxDelayMs Maximum time a message waits for other messages, in milliseconds.
+     */
+    void configure(int packetSize, int maxDelayMs);
+    /**
+     * @brief Add a MIDI message.
+     * @param timeMs Time of the message, in milliseconds (any monotonic origin).
+     * @param message Complete MIDI message (status byte included).
+     * @param length Message length, in bytes (1 to 3).
+     */
+    void add(int64_t timeMs, const uint8_t *message, int length);
+    /**
+     * @brief Complete the pending packet if it is older than the maximum delay.
+     * @param nowMs Current time, in milliseconds.
+     */
+    void poll(int64_t nowMs);
+    /** @brief Complete the pending packet, if any. */
+    void flush();
+    /**
+     * @brief Get the number of packets completed so far.
+     * @return The number of packets.
+     */
+    uint64_t getPacketCount() const { return packetCount; }
+    /**
+     * @brief Get the number of bytes completed so far.
+     * @return The number of bytes.
+     */
+    uint64_t getByteCount() const { return byteCount; }
+private:
+    /* @brief Receives the completed packets. */
+    BleMidiPacketListener *listener;
+    /* @brief Maximum packet size, in bytes. */
+    int packetSize;
+    /* @brief Maximum delay of a message, in milliseconds. */
+    int maxDelayMs;
+    /* @brief Pending packet. */
+    uint8_t packet[kBleMidiMaxPacket];
+    /* @brief Length of the pending packet (0 if none). */
+    int length;
+    /* @brief Time of the first message of the pending packet. */
+    int64_t startMs;
+    /* @brief Time of the last message of the pending packet. */
+    int64_t lastMs;
+    /* @brief Running status of the pending packet (0 if none). */
+    uint8_t runningStatus;
+    /* @brief Number of packets completed. */
+    uint64_t packetCount;
+    /* @brief Number of bytes completed. */
+    uint64_t byteCount;
+};
+
+#endif //ANDROID_MIDI_SYNTH_BLEMIDIENCODER_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiSync.cpp
+ * @brief Mapping of BLE-MIDI sender time to local time.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+
+#include "BleMidiSync.h"
+
+/* @brief Upward drift allowed to the clock offset, in ms per ms (above the crystal drift). */
+static const double kBleMidiDrift = 500e-6;
+/* @brief Time for the weight of a delivery delay to fall by e, in ms. */
+static const double kBleMidiJitterAgeMs = 300000.0;
+/* @brief Fraction of the jitter delay the quantile must fall below to lower it. */
+static const double kBleMidiJitterHysteresis = 0.25;
+/* @brief Largest weight of a new delay before the histogram is rescaled. */
+static const double kBleMidiMaxWeight = 1e6;
+
+// -----------------------------------------------------------------------------------------------
+
+BleMidiSync::BleMidiSync() {
+    reset();
+}
+
+void BleMidiSync::reset() {
+    offsetMs = 0.0;
+    jitterMs = kBleMidiJitterMs;
+    std::fill_n(histogram, kBleMidiJitterBins, 0.0);
+    histogramTotal = 0.0;
+    quantileBin = 0;
+    quantileBelow = 0.0;
+    delayWeight = 1.0;
+    lastArrivalMs = 0.0;
+    synced = false;
+}
+
+double BleMidiSync::toLocal(double arrivalMs, int64_t timeMs) {
+    // relaxed with the time elapsed, not per message: a busy stream would drift faster
+    double elapsedMs = synced ? std::max(arrivalMs - lastArrivalMs, 0.0) : 0.0;
+    offsetMs += elapsedMs * kBleMidiDrift;
+    lastArrivalMs = arrivalMs;
+    double offset = arrivalMs - timeMs;
+    if (!synced || offset < offsetMs) {
+        offsetMs = offset;
+        synced = true;
+    }
+    addDelay(offset - offsetMs, elapsedMs);
+    return timeMs + offsetMs + jitterMs;
+}
+
+void BleMidiSync::addDelay(double delayMs, double elapsedMs) {
+    delayWeight *= std::exp(elapsedMs / kBleMidiJitterAgeMs);
+    if (delayWeight > kBleMidiMaxWeight) {
+        for (double &weight : histogram) weight /= delayWeight;
+        histogramTotal /= delayWeight;
+        quantileBelow /= delayWeight;
+        delayWeight = 1.0;
+    }
+    int bin = std::min((int) delayMs, kBleMidiJitterBins - 1);
+    histogram[bin] += delayWeight;
+    histogramTotal += delayWeight;
+    if (bin < quantileBin) quantileBelow += delayWeight;
+    // move to the bin that reaches the quantile (one bin at a time as the weights change)
+    double target = histogramTotal * kBleMidiOnTimeRate;
+    while (quantileBin < kBleMidiJitterBins - 1 &&
+           quantileBelow + histogram[quantileBin] < target) {
+        quantileBelow += histogram[quantileBin++];
+    }
+    while (quantileBin > 0 && quantileBelow >= target) {
+        quantileBelow -= histogram[--quantileBin];
+    }
+    // the initial delay stays until the quantile has enough (recent) delays to go on
+    if (histogramTotal * (1.0 - kBleMidiOnTimeRate) < delayWeight) return;
+    // interpolated in the bin; raised at once, but only lowered well below, so the delay
+    // (and the timing of the messages) does not wander with the noise of the quantile
+    double weight = histogram[quantileBin];
+    double quantileMs = quantileBin + (weight > 0.0 ? (target - quantileBelow) / weight : 1.0);
+    if (quantileMs > jitterMs || quantileMs < jitterMs * (1.0 - kBleMidiJitterHysteresis)) {
+        jitterMs = quantileMs;
+    }
+}
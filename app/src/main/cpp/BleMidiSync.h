@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BleMidiSync.h
+ * @brief Mapping of BLE-MIDI sender time to local time.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_BLEMIDISYNC_H
+#define ANDROID_MIDI_SYNTH_BLEMIDISYNC_H
+
+#include <cstdint>
+
+/** @brief Delay added to received BLE-MIDI messages to absorb delivery jitter until the
+ *         delivery delays are known, in ms. */
+static const double kBleMidiJitterMs = 15.0;
+/** @brief Number of 1 ms bins of the delivery delays (largest delay added, in ms). */
+static const int kBleMidiJitterBins = 200;
+/** @brief Fraction of the received BLE-MIDI messages the delay should keep on time. */
+static const double kBleMidiOnTimeRate = 0.995;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief BleMidiSync class.
+ * @details Maps the sender time of received BLE-MIDI messages to local time. The fastest
+ *          delivery seen so far gives the clock offset, slowly relaxed to follow the drift
+ *          between the sender and local clocks. A delay on top absorbs the delivery jitter
+ *          (connection interval and retries), so the messages keep the sender timing: it is
+ *          the kBleMidiOnTimeRate quantile of a histogram of the recent delivery delays beyond
+ *          the fastest one, so it follows the connection interval the central negotiated.
+ *          Not thread safe.
+ */
+class BleMidiSync {
+public:
+    /** @brief Constructor. */
+    BleMidiSync();
+    /** @brief Forget the clock offset. */
+    void reset();
+    /**
+     * @brief Map a message to local time.
+     * @param arrivalMs Local arrival time of the packet of the message, in milliseconds.
+     * @param timeMs Sender time of the message, in milliseconds (unwrapped).
+     * @return Local time the message should be played at, in milliseconds.
+     */
+    double toLocal(double arrivalMs, int64_t timeMs);
+    /**
+     * @brief Get the estimated offset from sender to local time.
+     * @return The offset, in milliseconds (0 if nothing was received yet).
+     */
+    double getOffset() const { return offsetMs; }
+    /**
+     * @brief Get the delay added to absorb the delivery jitter.
+     * @return The delay, in milliseconds.
+     */
+    double getJitter() const { return jitterMs; }
+private:
+    /* @brief Add a delivery delay to the histogram and update the jitter delay.
+     * @param delayMs Delivery delay beyond the fastest one, in milliseconds.
+     * @param elapsedMs Time since the previous delay, in milliseconds. */
+    void addDelay(double delayMs, double elapsedMs);
+private:
+    /* @brief Estimated offset from sender to local time, in milliseconds. */
+    double offsetMs;
+    /* @brief Delay added to absorb the delivery jitter, in milliseconds. */
+    double jitterMs;
+    /* @brief Aged weights of the delivery delays, per 1 ms bin. */
+    double histogram[kBleMidiJitterBins];
+    /* @brief Sum of the histogram weights. */
+    double histogramTotal;
+    /* @brief Bin of the histogram that reaches the quantile. */
+    int quantileBin;
+    /* @brief Sum of the histogram weights below the quantile bin. */
+    double quantileBelow;
+    /* @brief Weight of a new delay (grows with time instead of aging the histogram). */
+    double delayWeight;
+    /* @brief Arrival time of the last message, in milliseconds. */
+    double lastArrivalMs;
+    /* @brief True once offsetMs holds an estimate. */
+    bool synced;
+};
+
+#endif //ANDROID_MIDI_SYNTH_BLEMIDISYNC_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/BoundedQueue.h
+ * @brief Header of BoundedQueue class template.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_BOUNDEDQUEUE_H
+#define ANDROID_MIDI_SYNTH_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief BoundedQueue class template.
+ * @details Takes items from any thread and hands them to a single consumer, in the order
+ *          they were queued. Lock-free and without allocation: each slot carries a sequence
+ *          number telling the producers when it is free and the consumer when it is filled,
+ *          so neither side ever waits for the other. A full queue drops the item and counts it.
+ * @tparam T Item type (copyable).
+ * @tparam Size Capacity, in items (power of 2).
+ */
+template<typename T, int Size>
+class BoundedQueue {
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0, "the size must be a power of 2");
+public:
+    /** @brief Constructor. */
+    BoundedQueue(): tail(0), head(0), dropped(0) {
+        for (uint32_t i = 0; i < (uint32_t) Size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    /**
+     * @brief Queue an item (any thread). Lock-free.
+     * @param item The item.
+     * @return True if successful. False if the queue is full (the item is dropped).
+     */
+    bool push(const T &item) {
+        uint32_t pos = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+            slot = &slots[pos & (Size - 1)];
+            auto diff = (int32_t) (slot->sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                // the slot is free: claim the position
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                // the slot still holds the item of the previous lap
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                // another producer claimed the position
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = item;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    /**
+     * @brief Remove the oldest item (single consumer). Wait-free.
+     * @param item Receives the item.
+     * @return True if an item was removed. False if none is ready.
+     */
+    bool pop(T &item) {
+        Slot &slot = slots[head & (Size - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) return false;
+        item = slot.item;
+        // free for the next lap
+        slot.sequence.store(head + Size, std::memory_order_release);
+        head++;
+        return true;
+    }
+    /**
+     * @brief Get the number of items dropped because the queue was full.
+     * @return The number of items.
+     */
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+    /** @brief Restart the count of the dropped items. */
+    void resetDropped() { dropped.store(0, std::memory_order_relaxed); }
+private:
+    /* @brief A slot of the queue. */
+    struct Slot {
+        /* @brief Position the slot is filled for, plus 1 once filled. */
+        std::atomic<uint32_t> sequence;
+        /* @brief The item. */
+        T item;
+    };
+    /* @brief Slots (ring buffer). */
+    Slot slots[Size];
+    /* @brief Next position to write (producers). */
+    std::atomic<uint32_t> tail;
+    /* @brief Next position to read (consumer). */
+    uint32_t head;
+    /* @brief Number of dropped items. */
+    std::atomic<uint64_t> dropped;
+};
+
+#endif //ANDROID_MIDI_SYNTH_BOUNDEDQUEUE_H
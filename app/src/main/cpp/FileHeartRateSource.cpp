@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/FileHeartRateSource.cpp
+ * @brief Implementation of FileHeartRateSource class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+
+#include "FileHeartRateSource.h"
+
+/* @brief Maximum length of a trace line. */
+static const int kTraceLineSize = 128;
+
+// -----------------------------------------------------------------------------------------------
+
+FileHeartRateSource::FileHeartRateSource(const char *path, double speed):
+    path(path), speed(speed), listener(nullptr), running(false), wakeups(0) {
+}
+
+FileHeartRateSource::~FileHeartRateSource() {
+    stop();
+}
+
+bool FileHeartRateSource::start(HeartRateListener *heartRateListener) {
+    if (running.load()) return false;
+    if (thread.joinable()) thread.join();
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) return false;
+    listener = heartRateListener;
+    wakeups.store(0);
+    running.store(true);
+    thread = std::thread(&FileHeartRateSource::run, this, file);
+    return true;
+}
+
+void FileHeartRateSource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        running.store(false);
+    }
+    stopCondition.notify_all();
+    join();
+}
+
+void FileHeartRateSource::join() {
+    if (thread.joinable()) thread.join();
+    listener = nullptr;
+}
+
+void FileHeartRateSource::run(FILE *file) {
+    using namespace std::chrono;
+    char line[kTraceLineSize];
+    steady_clock::time_point start = steady_clock::now();
+    int64_t startNs = duration_cast<nanoseconds>(start.time_since_epoch()).count();
+    double firstTime = -1.0;
+    double lastWait = -1.0;
+    while (running.load() && fgets(line, sizeof(line), file)) {
+        double time;
+        float bpm;
+        int accuracy = kSensorStatusAccuracyHigh;
+        if (line[0] == '#' || sscanf(line, "%lf %f %d", &time, &bpm, &accuracy) < 2) continue;
+        if (firstTime < 0.0) firstTime = time;
+        time -= firstTime;
+        if (speed > 0.0 && time > lastWait) {
+            // samples sharing a timestamp are delivered in one wakeup
+            std::unique_lock<std::mutex> lock(stopMutex);
+            stopCondition.wait_until(lock, start + duration<double>(time / speed),
+                    [this] { return !running.load(); });
+            if (!running.load()) break;
+            lastWait = time;
+            wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+        listener->onHeartRateSample(startNs + (int64_t) (time * 1e9), bpm, accuracy);
+    }
+    fclose(file);
+    running.store(false);
+}
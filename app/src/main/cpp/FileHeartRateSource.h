@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/FileHeartRateSource.h
+ * @brief Header of FileHeartRateSource class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_FILEHEARTRATESOURCE_H
+#define ANDROID_MIDI_SYNTH_FILEHEARTRATESOURCE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "HeartRateSource.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief FileHeartRateSource class.
+ * @details Replays a recorded heart-rate trace from a text file, one sample per line:
+ *          "time bpm [accuracy]", time in seconds (increasing), accuracy defaulting to
+ *          SENSOR_STATUS_ACCURACY_HIGH. Lines starting with '#' are ignored. The file is read
+ *          incrementally on the replay thread. Sample timestamps keep the trace timing
+ *          (start time plus trace time), whatever the replay speed. Portable (no Android API).
+ */
+class FileHeartRateSource: public HeartRateSource {
+public:
+    /**
+     * @brief Constructor.
+     * @param path Path of the trace file.
+     * @param speed Replay speed (1 = real time), or 0 to replay as fast as possible.
+     */
+    FileHeartRateSource(const char *path, double speed);
+    /** @brief Destructor. Stops the thread. */
+    ~FileHeartRateSource() override;
+    bool start(HeartRateListener *listener) override;
+    void stop() override;
+    uint64_t getWakeups() const override { return wakeups.load(); }
+    /**
+     * @brief Check if the replay is running.
+     * @return True until the end of the trace (or stop()).
+     */
+    bool isRunning() const { return running.load(); }
+    /** @brief Wait for the end of the trace and join the thread. */
+    void join();
+private:
+    /* @brief Thread body. */
+    void run(FILE *file);
+private:
+    /* @brief Path of the trace file. */
+    std::string path;
+    /* @brief Replay speed (0 = unlimited). */
+    double speed;
+    /* @brief Receives the samples. */
+    HeartRateListener *listener;
+    /* @brief Replay thread. */
+    std::thread thread;
+    /* @brief True while the thread should keep running. */
+    std::atomic<bool> running;
+    /* @brief Number of wakeups. */
+    std::atomic<uint64_t> wakeups;
+    /* @brief Guards the stop condition. */
+    std::mutex stopMutex;
+    /* @brief Interrupts the wait for the next sample. */
+    std::condition_variable stopCondition;
+};
+
+#endif //ANDROID_MIDI_SYNTH_FILEHEARTRATESOURCE_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/FrameClock.cpp
+ * @brief Time of the audio frames, smoothed over the callback wake-up jitter.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "FrameClock.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief Fraction of the error between the time read and the predicted one applied per
+ *        callback (1 / 2^n). */
+static const int kFrameClockSmoothingShift = 4;
+/* @brief Largest error taken as wake-up jitter, in nanoseconds. */
+static const int64_t kFrameClockMaxErrorNs = 20000000;
+
+// -----------------------------------------------------------------------------------------------
+
+FrameClock::FrameClock(int sampleRate):
+    sampleRate(sampleRate), lastFrame(-1), lastNs(0) {
+}
+
+int64_t FrameClock::update(int64_t frame, int64_t timeNs) {
+    if (lastFrame < 0 || frame < lastFrame) {
+        lastFrame = frame;
+        lastNs = timeNs;
+        return timeNs;
+    }
+    int64_t predictedNs = lastNs + (frame - lastFrame) * 1000000000LL / sampleRate;
+    int64_t errorNs = timeNs - predictedNs;
+    if (errorNs > kFrameClockMaxErrorNs || errorNs < -kFrameClockMaxErrorNs) {
+        predictedNs = timeNs;
+    } else {
+        predictedNs += errorNs / (1 << kFrameClockSmoothingShift);
+    }
+    lastFrame = frame;
+    lastNs = predictedNs;
+    return predictedNs;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/FrameClock.h
+ * @brief Time of the audio frames, smoothed over the callback wake-up jitter.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_FRAMECLOCK_H
+#define ANDROID_MIDI_SYNTH_FRAMECLOCK_H
+
+#include <cstdint>
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief FrameClock class.
+ * @details Maps the audio frames to the steady clock. The time read at each audio callback
+ *          is late by the wake-up jitter of the thread, so the clock predicts the time of the
+ *          callback from the previous one and only moves a fraction of the way to the time
+ *          read: the jitter is averaged out, and the drift between the audio and the steady
+ *          clocks is still followed. A gap too large for jitter (the first callback, an
+ *          underrun, a restart) takes the time read as is.
+ */
+class FrameClock {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Audio sample rate, in Hz.
+     */
+    explicit FrameClock(int sampleRate);
+    /**
+     * @brief Update the clock at an audio callback (render thread).
+     * @param frame First frame of the callback.
+     * @param timeNs Time read at the callback (steady clock), in nanoseconds.
+     * @return The time of the frame, in nanoseconds.
+     */
+    int64_t update(int64_t frame, int64_t timeNs);
+private:
+    /* @brief Audio sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Frame of the last update (-1 before the first one). */
+    int64_t lastFrame;
+    /* @brief Time of that frame, in nanoseconds. */
+    int64_t lastNs;
+};
+
+#endif //ANDROID_MIDI_SYNTH_FRAMECLOCK_H
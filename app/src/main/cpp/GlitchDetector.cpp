@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/GlitchDetector.cpp
+ * @brief Real-time glitch detector of the render output.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#include "GlitchDetector.h"
+
+/* @brief Smallest ratio of a jump to the local level flagged as a discontinuity. */
+static const float kGlitchJumpRatio = 8.0f;
+/* @brief Smallest jump flagged as a discontinuity (a step of -26 dBFS). */
+static const float kGlitchJumpFloor = 0.05f;
+/* @brief Time constant of the local level of the jumps, in seconds. */
+static const float kGlitchJumpSeconds = 0.05f;
+/* @brief Level of a clipped sample (full scale). */
+static const float kGlitchClipLevel = 1.0f;
+/* @brief Level below which a sample is silence (two 16-bit LSB: the dither of the output
+ *        stage turns digital silence into noise of one LSB). */
+static const float kGlitchSilence = 2.0f / 32768.0f;
+/* @brief Smallest level before a silence that makes it a dropout (-40 dBFS). */
+static const float kGlitchDropoutLevel = 0.01f;
+/* @brief Shortest silence of a dropout, in seconds. */
+static const float kGlitchDropoutSeconds = 0.0015f;
+/* @brief Callback interval, in periods, above which the callback is late. */
+static const int kGlitchLatePeriods = 2;
+/* @brief Callback interval above which the stream was restarted, in nanoseconds. */
+static const int64_t kGlitchRestartNs = 1000000000;
+
+/* @brief Check if a frame is digital silence, dither included. */
+static inline bool isSilent(float left, float right) {
+    return fabsf(left) < kGlitchSilence && fabsf(right) < kGlitchSilence;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+GlitchDetector::GlitchDetector(int sampleRate):
+    sampleRate(sampleRate), active(true), silentFrames(0), levelBeforeSilence(0.0f),
+    lastCallbackNs(0), lastCallbackFrames(0), head(0), tail(0), dropped(0) {
+    memset(history, 0, sizeof(history));
+    memset(jumpPower, 0, sizeof(jumpPower));
+    jumpPowerCoef = 1.0f / (kGlitchJumpSeconds * sampleRate);
+    dropoutFrames = (int) (kGlitchDropoutSeconds * sampleRate);
+    memset(events, 0, sizeof(events));
+    for (std::atomic<int64_t> &count : counts) count.store(0, std::memory_order_relaxed);
+}
+
+void GlitchDetector::callback(int64_t frame, int64_t timeNs, int frames) {
+    int64_t last = lastCallbackNs;
+    int lastFrames = lastCallbackFrames;
+    lastCallbackNs = timeNs;
+    lastCallbackFrames = frames;
+    if (last == 0 || !isEnabled()) return;
+    int64_t interval = timeNs - last;
+    int64_t periodNs = (int64_t) lastFrames * 1000000000 / sampleRate;
+    // the stream buffers about two periods: a later callback let it run dry
+    if (interval > kGlitchLatePeriods * periodNs && interval < kGlitchRestartNs) {
+        log(frame, kGlitch_LateCallback, (float) (interval - periodNs) * 1e-6f);
+    }
+}
+
+void GlitchDetector::process(int64_t frame, const float *left, const float *right, int frames) {
+    if (frames <= 0 || !isEnabled()) return;
+    float peakLeft, peakRight;
+    float jumpLeft = checkJumps(left, frames, 0, peakLeft);
+    float jumpRight = checkJumps(right, frames, 1, peakRight);
+    float jump = jumpLeft > jumpRight ? jumpLeft : jumpRight;
+    if (jump > 0.0f) log(frame, kGlitch_Discontinuity, jump);
+    float peak = peakLeft > peakRight ? peakLeft : peakRight;
+    if (peak >= kGlitchClipLevel) log(frame, kGlitch_Clipping, peak);
+    checkSilence(frame, left, right, frames, peak);
+}
+
+float GlitchDetector::checkJumps(const float *samples, int frames, int channel, float &peak) {
+    float x1 = history[channel][0];
+    float x2 = history[channel][1];
+    // the first two second differences reach into the previous block
+    float d0 = samples[0] - 2.0f * x1 + x2;
+    float maxJump = fabsf(d0);
+    float power = d0 * d0;
+    peak = fabsf(samples[0]);
+    if (frames > 1) {
+        float d1 = samples[1] - 2.0f * samples[0] + x1;
+        if (fabsf(d1) > maxJump) maxJump = fabsf(d1);
+        power += d1 * d1;
+        if (fabsf(samples[1]) > peak) peak = fabsf(samples[1]);
+    }
+    // the rest in lanes (plain comparisons, as fmaxf() is not turned into vector max)
+    float jumpLanes[kLanes] = {};
+    float powerLanes[kLanes] = {};
+    float peakLanes[kLanes] = {};
+    int i = 2;
+    for (; i + kLanes <= frames; i += kLanes) {
+        for (int lane = 0; lane < kLanes; lane++) {
+            float x = samples[i + lane];
+            float d = x - 2.0f * samples[i + lane - 1] + samples[i + lane - 2];
+            float jump = fabsf(d);
+            jumpLanes[lane] = jump > jumpLanes[lane] ? jump : jumpLanes[lane];
+            powerLanes[lane] += d * d;
+            peakLanes[lane] = fabsf(x) > peakLanes[lane] ? fabsf(x) : peakLanes[lane];
+        }
+    }
+    for (; i < frames; i++) {
+        float d = samples[i] - 2.0f * samples[i - 1] + samples[i - 2];
+        if (fabsf(d) > jumpLanes[0]) jumpLanes[0] = fabsf(d);
+        powerLanes[0] += d * d;
+        if (fabsf(samples[i]) > peakLanes[0]) peakLanes[0] = fabsf(samples[i]);
+    }
+    for (int lane = 0; lane < kLanes; lane++) {
+        if (jumpLanes[lane] > maxJump) maxJump = jumpLanes[lane];
+        power += powerLanes[lane];
+        if (peakLanes[lane] > peak) peak = peakLanes[lane];
+    }
+    history[channel][0] = samples[frames - 1];
+    history[channel][1] = frames > 1 ? samples[frames - 2] : x1;
+    // compare with the audio before the block, then let the block into the local level
+    float level = sqrtf(jumpPower[channel]);
+    if (level < kGlitchJumpFloor / kGlitchJumpRatio) level = kGlitchJumpFloor / kGlitchJumpRatio;
+    float weight = frames * jumpPowerCoef;
+    if (weight > 1.0f) weight = 1.0f;
+    jumpPower[channel] += weight * (power / frames - jumpPower[channel]);
+    float ratio = maxJump / level;
+    return ratio >= kGlitchJumpRatio ? ratio : 0.0f;
+}
+
+void GlitchDetector::checkSilence(int64_t frame, const float *left, const float *right,
+                                  int frames, float peak) {
+    // the silence of the previous blocks goes on up to the first audible frame
+    int leading = 0;
+    if (peak < kGlitchSilence) {
+        leading = frames;
+    } else if (silentFrames > 0) {
+        while (leading < frames && isSilent(left[leading], right[leading])) leading++;
+    }
+    int64_t before = silentFrames;
+    silentFrames += leading;
+    if (before < dropoutFrames && silentFrames >= dropoutFrames &&
+        levelBeforeSilence >= kGlitchDropoutLevel) {
+        log(frame + leading - silentFrames, kGlitch_Dropout, levelBeforeSilence);
+    }
+    if (leading == frames) return;
+    // a new silence may start at the end of the block, after the level taken here
+    int end = frames;
+    while (end > leading && isSilent(left[end - 1], right[end - 1])) end--;
+    float level = 0.0f;
+    for (int j = end - kLevelFrames > leading ? end - kLevelFrames : leading; j < end; j++) {
+        if (fabsf(left[j]) > level) level = fabsf(left[j]);
+        if (fabsf(right[j]) > level) level = fabsf(right[j]);
+    }
+    levelBeforeSilence = level;
+    silentFrames = frames - end;
+    if (silentFrames >= dropoutFrames && level >= kGlitchDropoutLevel) {
+        log(frame + end, kGlitch_Dropout, level);
+    }
+}
+
+void GlitchDetector::log(int64_t frame, int type, float value) {
+    counts[type].fetch_add(1, std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= (uint32_t) kGlitchLogSize) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    events[h & (kGlitchLogSize - 1)] = { frame, type, value };
+    head.store(h + 1, std::memory_order_release);
+}
+
+int GlitchDetector::read(GlitchEvent *out, int count) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    int n = 0;
+    for (; t != h && n < count; t++, n++) out[n] = events[t & (kGlitchLogSize - 1)];
+    tail.store(t, std::memory_order_release);
+    return n;
+}
+
+int64_t GlitchDetector::getCount(int type) const {
+    if (type < 0 || type >= kGlitchTypeCount) return 0;
+    return counts[type].load(std::memory_order_relaxed);
+}
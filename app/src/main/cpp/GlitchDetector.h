@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/GlitchDetector.h
+ * @brief Real-time glitch detector of the render output.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_GLITCHDETECTOR_H
+#define ANDROID_MIDI_SYNTH_GLITCHDETECTOR_H
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief Glitch types. */
+enum GlitchType {
+    /** @brief Sample jump much larger than the local high-frequency energy (click). */
+    kGlitch_Discontinuity = 0,
+    /** @brief Samples at or over full scale. */
+    kGlitch_Clipping = 1,
+    /** @brief Audio that stops abruptly into digital silence. */
+    kGlitch_Dropout = 2,
+    /** @brief Render callback later than two periods (the driver underran). */
+    kGlitch_LateCallback = 3,
+    /** @brief Number of glitch types. */
+    kGlitchTypeCount = 4
+};
+
+/** @brief Capacity of the event log (power of two). */
+static const int kGlitchLogSize = 256;
+
+/** @brief A detected glitch. */
+struct GlitchEvent {
+    /** @brief Audio frame of the glitch. */
+    int64_t frame;
+    /** @brief Glitch type (GlitchType). */
+    int type;
+    /**
+     * @brief Magnitude: ratio of the jump to the local level (discontinuity), peak
+     *        (clipping), level before the silence (dropout) or delay, in ms (late callback).
+     */
+    float value;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief GlitchDetector class.
+ * @details Analyses each rendered stereo block for audible glitches:
+ *          - discontinuities: the second difference of the signal (x[n] - 2x[n-1] + x[n-2])
+ *            is small for any smooth waveform and equals the size of a step, so a block is
+ *            flagged when its largest second difference goes well over the RMS of the
+ *            second difference of the preceding audio (voice stealing, parameter jumps);
+ *          - clipping: samples at or over full scale;
+ *          - dropouts: audio above -40 dBFS followed by at least 1.5 ms of digital silence,
+ *            dither included (a natural release fades out through the low levels first);
+ *          - late callbacks: a render callback that arrives more than two periods after the
+ *            previous one. The driver does not report its underruns, so this is the xrun
+ *            counter of the app.
+ *          The block statistics are computed in independent lanes, which the compiler
+ *          vectorizes; at most one event per type is logged per block. The events go to a
+ *          lock-free single-producer, single-consumer ring: the render thread never waits,
+ *          and the events that do not fit are counted as dropped.
+ */
+class GlitchDetector {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit GlitchDetector(int sampleRate);
+    /**
+     * @brief Enable the detection (any thread).
+     * @param enabled True to analyse the blocks (default).
+     */
+    void setEnabled(bool enabled) { active.store(enabled, std::memory_order_relaxed); }
+    /**
+     * @brief Check if the detection is enabled.
+     * @return True if enabled.
+     */
+    bool isEnabled() const { return active.load(std::memory_order_relaxed); }
+    /**
+     * @brief Check the timing of a render callback (render thread, at its start).
+     * @param frame Audio frame of the period.
+     * @param timeNs Steady clock time of the callback, in nanoseconds.
+     * @param frames Frames of the period.
+     */
+    void callback(int64_t frame, int64_t timeNs, int frames);
+    /**
+     * @brief Analyse a stereo block (render thread).
+     * @param frame Audio frame of the first sample.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    void process(int64_t frame, const float *left, const float *right, int frames);
+    /**
+     * @brief Take the logged events, oldest first (a single consumer thread).
+     * @param out Receives the events.
+     * @param count Capacity of out.
+     * @return Number of events copied.
+     */
+    int read(GlitchEvent *out, int count);
+    /**
+     * @brief Get the number of glitches of a type since the start.
+     * @param type Glitch type (GlitchType).
+     * @return The number of glitches (logged or not).
+     */
+    int64_t getCount(int type) const;
+    /**
+     * @brief Get the number of events not logged because the log was full.
+     * @return The number of dropped events.
+     */
+    int64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+private:
+    /* @brief Lanes of the vectorized statistics. */
+    static const int kLanes = 8;
+    /* @brief Frames of the level taken before a silence. */
+    static const int kLevelFrames = 16;
+    /* @brief Log an event (render thread). */
+    void log(int64_t frame, int type, float value);
+    /* @brief Find the discontinuities of a block of one channel.
+     * @param samples Samples of the channel.
+     * @param frames Number of frames.
+     * @param channel Channel index (0 or 1).
+     * @param peak Receives the sample peak of the block.
+     * @return Ratio of the largest jump to the local level, or 0 if below the threshold. */
+    float checkJumps(const float *samples, int frames, int channel, float &peak);
+    /* @brief Track the digital silence of a block and log the dropouts.
+     * @param frame Audio frame of the first sample.
+     * @param peak Sample peak of the block (both channels). */
+    void checkSilence(int64_t frame, const float *left, const float *right, int frames,
+                      float peak);
+private:
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief True to analyse the blocks (written by any thread). */
+    std::atomic<bool> active;
+    /* @brief Last two samples of each channel (x[n-1], x[n-2]). */
+    float history[2][2];
+    /* @brief Mean square of the second difference of the preceding audio, per channel. */
+    float jumpPower[2];
+    /* @brief Weight of a block of one frame in jumpPower. */
+    float jumpPowerCoef;
+    /* @brief Frames of digital silence at the end of the audio analysed so far. */
+    int64_t silentFrames;
+    /* @brief Frames of silence that make a dropout. */
+    int dropoutFrames;
+    /* @brief Peak of the audio just before the current silence. */
+    float levelBeforeSilence;
+    /* @brief Time of the previous callback, in nanoseconds (0 if none). */
+    int64_t lastCallbackNs;
+    /* @brief Frames of the previous callback. */
+    int lastCallbackFrames;
+    /* @brief Logged events (ring). */
+    GlitchEvent events[kGlitchLogSize];
+    /* @brief Events written (render thread). */
+    std::atomic<uint32_t> head;
+    /* @brief Events read (consumer thread). */
+    std::atomic<uint32_t> tail;
+    /* @brief Glitches per type. */
+    std::atomic<int64_t> counts[kGlitchTypeCount];
+    /* @brief Events not logged because the log was full. */
+    std::atomic<int64_t> dropped;
+};
+
+#endif //ANDROID_MIDI_SYNTH_GLITCHDETECTOR_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HeartRateFilter.cpp
+ * @brief Implementation of HeartRateFilter class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+
+#include "HeartRateFilter.h"
+
+/* @brief Lowest plausible heart rate, in BPM. */
+static const double kHeartRateMin = 30.0;
+/* @brief Highest plausible heart rate, in BPM. */
+static const double kHeartRateMax = 210.0;
+/* @brief Hampel threshold, in scaled MADs. */
+static const double kHampelThreshold = 3.0;
+/* @brief Scale from MAD to standard deviation (normal distribution). */
+static const double kMadScale = 1.4826;
+/* @brief Lowest deviation used by the Hampel test, in BPM (a constant signal has MAD 0). */
+static const double kHampelMinDeviation = 3.0;
+/* @brief Default one-euro cutoff frequency at rest, in Hz. */
+static const double kDefaultMinCutoff = 0.05;
+/* @brief Default one-euro cutoff increase per BPM/s. */
+static const double kDefaultBeta = 0.01;
+/* @brief Cutoff frequency of the derivative, in Hz. */
+static const double kDerivativeCutoff = 1.0;
+
+/* @brief Smoothing factor of a first-order low-pass filter. */
+static double smoothingFactor(double dt, double cutoff) {
+    double tau = 1.0 / (2.0 * M_PI * cutoff);
+    return 1.0 / (1.0 + tau / dt);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+HeartRateFilter::HeartRateFilter():
+    minAccuracy(kSensorStatusAccuracyLow), minCutoff(kDefaultMinCutoff), beta(kDefaultBeta),
+    rejectedCount(0) {
+    reset();
+}
+
+void HeartRateFilter::configure(double cutoff, double cutoffBeta) {
+    minCutoff = cutoff;
+    beta = cutoffBeta;
+}
+
+void HeartRateFilter::reset() {
+    windowCount = 0;
+    windowPos = 0;
+    sample = 0.0;
+    value = 0.0;
+    derivative = 0.0;
+    lastTime = 0.0;
+}
+
+double HeartRateFilter::median() const {
+    double sorted[kHeartRateWindow];
+    std::copy(window, window + windowCount, sorted);
+    std::nth_element(sorted, sorted + windowCount / 2, sorted + windowCount);
+    return sorted[windowCount / 2];
+}
+
+double HeartRateFilter::medianDeviation(double center) const {
+    double deviations[kHeartRateWindow];
+    for (int i = 0; i < windowCount; i++) deviations[i] = fabs(window[i] - center);
+    std::nth_element(deviations, deviations + windowCount / 2, deviations + windowCount);
+    return deviations[windowCount / 2];
+}
+
+bool HeartRateFilter::process(double time, float bpm, int accuracy) {
+    if (accuracy < minAccuracy || bpm < kHeartRateMin || bpm > kHeartRateMax) {
+        rejectedCount++;
+        return false;
+    }
+    double x = bpm;
+    // Hampel: replace samples too far from the median of the recent ones
+    if (windowCount == kHeartRateWindow) {
+        double center = median();
+        double deviation = kMadScale * medianDeviation(center);
+        if (deviation < kHampelMinDeviation) deviation = kHampelMinDeviation;
+        if (fabs(x - center) > kHampelThreshold * deviation) {
+            x = center;
+            rejectedCount++;
+        }
+    }
+    // the raw sample enters the window, so a real sustained change is accepted soon
+    window[windowPos] = bpm;
+    windowPos = (windowPos + 1) % kHeartRateWindow;
+    if (windowCount < kHeartRateWindow) windowCount++;
+    sample = x;
+    // one-euro smoother
+    if (value == 0.0) {
+        value = x;
+        derivative = 0.0;
+        lastTime = time;
+        return true;
+    }
+    double dt = time - lastTime;
+    if (dt <= 0.0) dt = 1e-3;
+    lastTime = time;
+    double dx = (x - value) / dt;
+    derivative += smoothingFactor(dt, kDerivativeCutoff) * (dx - derivative);
+    double cutoff = minCutoff + beta * fabs(derivative);
+    value += smoothingFactor(dt, cutoff) * (x - value);
+    return true;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HeartRateFilter.h
+ * @brief Header of HeartRateFilter class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_HEARTRATEFILTER_H
+#define ANDROID_MIDI_SYNTH_HEARTRATEFILTER_H
+
+#include <cstdint>
+
+/** @brief Number of samples in the outlier rejection window. */
+static const int kHeartRateWindow = 7;
+/** @brief Sensor accuracy: no contact with the skin (SensorManager.SENSOR_STATUS_NO_CONTACT). */
+static const int kSensorStatusNoContact = -1;
+/** @brief Sensor accuracy: unreliable (SensorManager.SENSOR_STATUS_UNRELIABLE). */
+static const int kSensorStatusUnreliable = 0;
+/** @brief Sensor accuracy: low (SensorManager.SENSOR_STATUS_ACCURACY_LOW). */
+static const int kSensorStatusAccuracyLow = 1;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief HeartRateFilter class.
+ * @details Streaming heart-rate pipeline: confidence gating from the sensor accuracy, a range
+ *          check, a Hampel filter (median and MAD over the last samples) that replaces outliers
+ *          with the median, and a one-euro smoother (low lag on real tempo changes, strong
+ *          smoothing at rest). O(1) per sample, does not allocate memory. Not thread safe.
+ */
+class HeartRateFilter {
+public:
+    /** @brief Constructor. */
+    HeartRateFilter();
+    /**
+     * @brief Configure the one-euro smoother.
+     * @param minCutoff Cutoff frequency at rest, in Hz.
+     * @param beta Cutoff increase per BPM/s of change.
+     */
+    void configure(double minCutoff, double beta);
+    /**
+     * @brief Set the lowest sensor accuracy accepted.
+     * @param accuracy Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+     */
+    void setMinAccuracy(int accuracy) { minAccuracy = accuracy; }
+    /**
+     * @brief Process a sample.
+     * @param time Time of the sample, in seconds.
+     * @param bpm Raw heart rate, in BPM.
+     * @param accuracy Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+     * @return True if the sample was used (getValue() updated). False if it was gated out.
+     */
+    bool process(double time, float bpm, int accuracy);
+    /**
+     * @brief Get the filtered heart rate.
+     * @return Heart rate, in BPM, or 0 if no sample was accepted yet.
+     */
+    float getValue() const { return (float) value; }
+    /**
+     * @brief Get the last accepted sample after outlier rejection, before smoothing.
+     * @return Heart rate, in BPM, or 0 if no sample was accepted yet.
+     */
+    float getSample() const { return (float) sample; }
+    /**
+     * @brief Get the number of samples rejected or replaced so far.
+     * @return The number of samples.
+     */
+    uint64_t getRejectedCount() const { return rejectedCount; }
+    /** @brief Forget all the samples. */
+    void reset();
+private:
+    /* @brief Get the median of the window. */
+    double median() const;
+    /* @brief Get the median absolute deviation of the window from a value. */
+    double medianDeviation(double center) const;
+private:
+    /* @brief Lowest sensor accuracy accepted. */
+    int minAccuracy;
+    /* @brief One-euro cutoff frequency at rest, in Hz. */
+    double minCutoff;
+    /* @brief One-euro cutoff increase per BPM/s. */
+    double beta;
+    /* @brief Last accepted samples (ring buffer). */
+    double window[kHeartRateWindow];
+    /* @brief Number of samples in the window. */
+    int windowCount;
+    /* @brief Next write position in the window. */
+    int windowPos;
+    /* @brief Last accepted sample after outlier rejection (0 if none yet). */
+    double sample;
+    /* @brief Filtered heart rate (0 if none yet). */
+    double value;
+    /* @brief Filtered rate of change, in BPM/s. */
+    double derivative;
+    /* @brief Time of the last accepted sample, in seconds. */
+    double lastTime;
+    /* @brief Number of samples rejected or replaced. */
+    uint64_t rejectedCount;
+};
+
+#endif //ANDROID_MIDI_SYNTH_HEARTRATEFILTER_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HeartRateSource.h
+ * @brief Definition of the heart-rate source interfaces.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_HEARTRATESOURCE_H
+#define ANDROID_MIDI_SYNTH_HEARTRATESOURCE_H
+
+#include <cstdint>
+
+/** @brief Sensor accuracy reported when the source gives none (SENSOR_STATUS_ACCURACY_HIGH). */
+static const int kSensorStatusAccuracyHigh = 3;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief HeartRateListener interface.
+ * @details Receives the raw samples and beats of a HeartRateSource (called from the source
+ *          thread).
+ */
+class HeartRateListener {
+public:
+    /** @brief Destructor. */
+    virtual ~HeartRateListener() = default;
+    /**
+     * @brief Receive a heart-rate sample.
+     * @param timeNs Time of the sample (CLOCK_MONOTONIC, steady clock), in nanoseconds.
+     * @param bpm Raw heart rate, in BPM.
+     * @param accuracy Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+     */
+    virtual void onHeartRateSample(int64_t timeNs, float bpm, int accuracy) = 0;
+    /**
+     * @brief Receive a detected heart beat (sources with a beat sensor).
+     * @param timeNs Time of the beat (CLOCK_MONOTONIC, steady clock), in nanoseconds.
+     * @param confidence Confidence of the detection (0 to 1).
+     */
+    virtual void onHeartBeat(int64_t timeNs, float confidence) = 0;
+};
+
+/**
+ * @brief HeartRateSource interface.
+ * @details A native producer of heart-rate samples (e.g. the platform sensor or a recorded
+ *          trace), running on its own thread.
+ */
+class HeartRateSource {
+public:
+    /** @brief Destructor. */
+    virtual ~HeartRateSource() = default;
+    /**
+     * @brief Start producing samples.
+     * @param listener Receives the samples. Must outlive the source (or the next stop()).
+     * @return True if successful. False otherwise.
+     */
+    virtual bool start(HeartRateListener *listener) = 0;
+    /** @brief Stop producing samples and join the thread. */
+    virtual void stop() = 0;
+    /**
+     * @brief Get the number of times the source thread woke up to deliver samples.
+     * @return The number of wakeups since start().
+     */
+    virtual uint64_t getWakeups() const = 0;
+};
+
+#endif //ANDROID_MIDI_SYNTH_HEARTRATESOURCE_H
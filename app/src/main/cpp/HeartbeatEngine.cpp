@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HeartbeatEngine.cpp
+ * @brief Procedural heartbeat voices (two damped resonators per beat).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#include "HeartbeatEngine.h"
+
+/* @brief Initial heart rate, in BPM. */
+static const float kHeartbeatDefaultBpm = 60.0f;
+/* @brief Initial heart-rate variability (RMSSD), in milliseconds. */
+static const float kHeartbeatDefaultRmssd = 40.0f;
+/* @brief Lowest heart rate used for the mapping, in BPM. */
+static const float kHeartbeatMinBpm = 30.0f;
+/* @brief Highest heart rate used for the mapping, in BPM. */
+static const float kHeartbeatMaxBpm = 220.0f;
+/* @brief Interval between the first and second sounds at 60 BPM, in seconds. */
+static const float kHeartbeatSystole = 0.3f;
+/* @brief Decay time (-60 dB) of the first sound at 60 BPM, in seconds. */
+static const float kHeartbeatLubDecay = 0.15f;
+/* @brief Decay time (-60 dB) of the second sound at 60 BPM, in seconds. */
+static const float kHeartbeatDubDecay = 0.1f;
+/* @brief Pitch raise of the sounds per doubling of the heart rate from 60 BPM, in semitones. */
+static const float kHeartbeatPitchPerOctave = 4.0f;
+/* @brief Pitch ratio of the second sound to the first one, at no variability (a fourth). */
+static const float kHeartbeatDubRatio = 4.0f / 3.0f;
+/* @brief Pitch ratio added to the second sound at full variability (up to a fifth). */
+static const float kHeartbeatDubRatioRange = 1.5f - 4.0f / 3.0f;
+/* @brief Level of the second sound relative to the first one, at no variability. */
+static const float kHeartbeatDubLevel = 0.5f;
+/* @brief Level added to the second sound at full variability. */
+static const float kHeartbeatDubLevelRange = 0.4f;
+/* @brief Variability (RMSSD) of full level, in milliseconds. */
+static const float kHeartbeatFullRmssd = 80.0f;
+
+// -----------------------------------------------------------------------------------------------
+
+HeartbeatEngine::HeartbeatEngine(int sampleRate):
+    sampleRate(sampleRate), bpm(kHeartbeatDefaultBpm), rmssd(kHeartbeatDefaultRmssd),
+    volume(1.0f), nextVoice(0) {
+    memset(c1, 0, sizeof(c1));
+    memset(c2, 0, sizeof(c2));
+    memset(excite, 0, sizeof(excite));
+    reset();
+}
+
+void HeartbeatEngine::setHeart(float bpm, float rmssd) {
+    this->bpm.store(bpm, std::memory_order_relaxed);
+    this->rmssd.store(rmssd, std::memory_order_relaxed);
+}
+
+void HeartbeatEngine::noteOn(int note, int velocity) {
+    if (velocity <= 0) return;
+    int voice = -1;
+    for (int i = 0; i < kHeartbeatVoices && voice < 0; i++) {
+        if (remaining[i] <= 0) voice = i;
+    }
+    if (voice < 0) {
+        // the resonator keeps its state: the new impulse adds to the old sound, no click
+        voice = nextVoice;
+        nextVoice = (nextVoice + 1) & (kHeartbeatVoices - 1);
+    }
+    float rate = bpm.load(std::memory_order_relaxed);
+    if (rate < kHeartbeatMinBpm) rate = kHeartbeatMinBpm;
+    if (rate > kHeartbeatMaxBpm) rate = kHeartbeatMaxBpm;
+    // Bazett: the systole and the sounds scale with the square root of the RR interval
+    float scale = sqrtf(60.0f / rate);
+    float variability = rmssd.load(std::memory_order_relaxed) / kHeartbeatFullRmssd;
+    if (variability < 0.0f) variability = 0.0f;
+    if (variability > 1.0f) variability = 1.0f;
+    // the note sets the pitch at 60 BPM; a faster heart sounds higher
+    float pitch = note - 69 + kHeartbeatPitchPerOctave * log2f(rate / 60.0f);
+    float freq = 440.0f * powf(2.0f, pitch / 12.0f);
+    float level = velocity / 127.0f;
+    float lubDecay = kHeartbeatLubDecay * scale;
+    float dubDecay = kHeartbeatDubDecay * scale;
+    int systole = (int) (kHeartbeatSystole * scale * sampleRate);
+    tune(voice, freq, lubDecay, level);
+    // a variable heart splits the second sound wider
+    float dubRatio = kHeartbeatDubRatio + kHeartbeatDubRatioRange * variability;
+    tune(voice + kHeartbeatVoices, freq * dubRatio, dubDecay,
+         level * (kHeartbeatDubLevel + kHeartbeatDubLevelRange * variability));
+    delay[voice] = 0;
+    delay[voice + kHeartbeatVoices] = systole;
+    int lubFrames = (int) (lubDecay * sampleRate);
+    int dubFrames = systole + (int) (dubDecay * sampleRate);
+    remaining[voice] = lubFrames > dubFrames ? lubFrames : dubFrames;
+}
+
+void HeartbeatEngine::tune(int index, float freq, float decaySec, float level) {
+    float w = 2.0f * (float) M_PI * freq / sampleRate;
+    if (w > (float) M_PI * 0.9f) w = (float) M_PI * 0.9f;
+    // pole radius of a 60 dB decay; the impulse response peaks at excite / sin(w)
+    float r = expf(-6.9078f / (decaySec * sampleRate));
+    c1[index] = 2.0f * r * cosf(w);
+    c2[index] = r * r;
+    excite[index] = level * sinf(w);
+}
+
+void HeartbeatEngine::reset() {
+    memset(y1, 0, sizeof(y1));
+    memset(y2, 0, sizeof(y2));
+    memset(remaining, 0, sizeof(remaining));
+    for (int i = 0; i < kHeartbeatResonators; i++) delay[i] = -1;
+}
+
+void HeartbeatEngine::process(float *left, float *right, int frames) {
+    if (getActiveVoices() == 0) return;
+    float gain = volume.load(std::memory_order_relaxed);
+    float sum[kHeartbeatResonators / 2];
+    for (int i = 0; i < frames; i++) {
+        // one lane per resonator: no branches and no reduction, so this loop is vectorized
+        for (int r = 0; r < kHeartbeatResonators; r++) {
+            int32_t d = delay[r];
+            float x = (float) (d == 0) * excite[r];
+            delay[r] = d - (d >= 0);
+            float y = c1[r] * y1[r] - c2[r] * y2[r] + x;
+            y2[r] = y1[r];
+            y1[r] = y;
+        }
+        // pairwise sum, in vector halves (a float reduction is not vectorized otherwise)
+        for (int r = 0; r < kHeartbeatResonators / 2; r++) {
+            sum[r] = y1[r] + y1[r + kHeartbeatResonators / 2];
+        }
+        for (int n = kHeartbeatResonators / 4; n > 0; n /= 2) {
+            for (int r = 0; r < n; r++) sum[r] += sum[r + n];
+        }
+        float out = sum[0] * gain;
+        left[i] += out;
+        right[i] += out;
+    }
+    for (int v = 0; v < kHeartbeatVoices; v++) {
+        if (remaining[v] <= 0) continue;
+        remaining[v] -= frames;
+        if (remaining[v] > 0) continue;
+        // below -60 dB: stop before the state decays into denormals
+        y1[v] = y2[v] = 0.0f;
+        y1[v + kHeartbeatVoices] = y2[v + kHeartbeatVoices] = 0.0f;
+    }
+}
+
+int HeartbeatEngine::getActiveVoices() const {
+    int count = 0;
+    for (int v = 0; v < kHeartbeatVoices; v++) {
+        if (remaining[v] > 0) count++;
+    }
+    return count;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HeartbeatEngine.h
+ * @brief Procedural heartbeat voices (two damped resonators per beat).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_HEARTBEATENGINE_H
+#define ANDROID_MIDI_SYNTH_HEARTBEATENGINE_H
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief Number of heartbeat voices (power of two). */
+static const int kHeartbeatVoices = 8;
+/** @brief Number of resonators (first and second heart sound of each voice). */
+static const int kHeartbeatResonators = 2 * kHeartbeatVoices;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief HeartbeatEngine class.
+ * @details Procedural alternative to the soundfont for the heartbeat sound. Each note
+ *          triggers a voice made of two damped resonators: the first heart sound ("lub"),
+ *          and the second ("dub"), a fourth to a fifth above, delayed by the systole.
+ *          A resonator is a two-pole recursion excited by a single impulse, so a voice costs
+ *          a few multiply-adds per frame. The state is kept as structure of arrays and every
+ *          resonator is processed each frame without branches, so the inner loop is
+ *          vectorized by the compiler (NEON/SSE).
+ *          The heart rate sets the systole and the decay times (both shorten as the rate
+ *          goes up, after Bazett) and raises the pitch set by the note; the heart-rate
+ *          variability (RMSSD) sets the level of the second sound and widens its interval. noteOn() and process() must be called by the render thread;
+ *          the heart parameters and the volume may be set from any thread.
+ */
+class HeartbeatEngine {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit HeartbeatEngine(int sampleRate);
+    /**
+     * @brief Set the heart parameters used by the next notes.
+     * @param bpm Heart rate, in BPM.
+     * @param rmssd Heart-rate variability (RMSSD), in milliseconds.
+     */
+    void setHeart(float bpm, float rmssd);
+    /**
+     * @brief Get the heart rate used by the next notes.
+     * @return The heart rate, in BPM.
+     */
+    float getBpm() const { return bpm.load(std::memory_order_relaxed); }
+    /**
+     * @brief Get the heart-rate variability used by the next notes.
+     * @return The RMSSD, in milliseconds.
+     */
+    float getRmssd() const { return rmssd.load(std::memory_order_relaxed); }
+    /**
+     * @brief Set the output volume.
+     * @param volume Volume (0 to 1).
+     */
+    void setVolume(float volume) { this->volume.store(volume, std::memory_order_relaxed); }
+    /**
+     * @brief Trigger a beat (render thread).
+     * @details Steals the oldest voice if none is free.
+     * @param note Note number (pitch of the first sound at 60 BPM).
+     * @param velocity Velocity (0 to 127).
+     */
+    void noteOn(int note, int velocity);
+    /** @brief Silence every voice (render thread). */
+    void reset();
+    /**
+     * @brief Add the voices to a stereo block (render thread).
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    void process(float *left, float *right, int frames);
+    /**
+     * @brief Get the number of sounding voices (render thread).
+     * @return The number of voices.
+     */
+    int getActiveVoices() const;
+private:
+    /* @brief Set the coefficients of a resonator.
+     * @param index Resonator index (voice for the first sound, plus kHeartbeatVoices
+     *        for the second).
+     * @param freq Frequency, in Hz.
+     * @param decaySec Time to decay by 60 dB, in seconds.
+     * @param level Peak level. */
+    void tune(int index, float freq, float decaySec, float level);
+private:
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Heart rate (written by any thread). */
+    std::atomic<float> bpm;
+    /* @brief Heart-rate variability, RMSSD (written by any thread). */
+    std::atomic<float> rmssd;
+    /* @brief Output volume (written by any thread). */
+    std::atomic<float> volume;
+    /* @brief Feedback coefficient of the last output (2 r cos w). */
+    alignas(16) float c1[kHeartbeatResonators];
+    /* @brief Feedback coefficient of the output before (r^2). */
+    alignas(16) float c2[kHeartbeatResonators];
+    /* @brief Impulse that starts each resonator. */
+    alignas(16) float excite[kHeartbeatResonators];
+    /* @brief Last output. */
+    alignas(16) float y1[kHeartbeatResonators];
+    /* @brief Output before the last one. */
+    alignas(16) float y2[kHeartbeatResonators];
+    /* @brief Frames until the impulse (0 fires it, negative once fired). */
+    alignas(16) int32_t delay[kHeartbeatResonators];
+    /* @brief Frames left before each voice is silent (below -60 dB). */
+    int remaining[kHeartbeatVoices];
+    /* @brief Voice stolen by the next note if none is free (round robin, the oldest one). */
+    int nextVoice;
+};
+
+#endif //ANDROID_MIDI_SYNTH_HEARTBEATENGINE_H
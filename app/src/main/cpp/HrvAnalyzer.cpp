@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HrvAnalyzer.cpp
+ * @brief Implementation of HrvAnalyzer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+
+#include "HrvAnalyzer.h"
+
+/* @brief Threshold of pNN50, in microseconds. */
+static const int64_t kNN50ThresholdUs = 50000;
+/* @brief Longest interval accepted, in microseconds (keeps the sums far from overflow). */
+static const int64_t kMaxIntervalUs = 10000000;
+/* @brief Lowest confidence of a beat detection. */
+static const float kHrvMinConfidence = 0.5f;
+/* @brief Shortest interval between beats, in microseconds (200 BPM). */
+static const int64_t kMinBeatIntervalUs = 300000;
+/* @brief Longest interval between beats, in microseconds (30 BPM). */
+static const int64_t kMaxBeatIntervalUs = 2000000;
+/* @brief Largest change from the last interval, as a fraction of it. */
+static const double kMaxBeatIntervalChange = 0.2;
+/* @brief Successive intervals off the last one after which the rate is taken as changed. */
+static const int kMaxOffIntervals = 3;
+
+// -----------------------------------------------------------------------------------------------
+
+HrvAnalyzer::HrvAnalyzer(): rejectedBeats(0) {
+    reset();
+}
+
+void HrvAnalyzer::reset() {
+    head = 0;
+    count = 0;
+    sum = 0;
+    sumSquares = 0;
+    sumDiffSquares = 0;
+    nn50 = 0;
+    lastBeatNs = -1;
+    lastBeatInterval = 0;
+    offIntervals = 0;
+    prematureBeat = false;
+}
+
+bool HrvAnalyzer::addBeat(int64_t timeNs, float confidence) {
+    if (confidence < kHrvMinConfidence) {
+        // an interval from or to an unsure beat is not an RR interval
+        lastBeatNs = -1;
+        prematureBeat = false;
+        rejectedBeats++;
+        return false;
+    }
+    int64_t previousNs = lastBeatNs;
+    lastBeatNs = timeNs;
+    if (previousNs < 0) return false;
+    int64_t rr = (timeNs - previousNs) / 1000;
+    // a premature beat (ectopic, or a false detection) ends a short interval and starts one
+    // that is no RR interval either
+    bool fromPremature = prematureBeat;
+    prematureBeat = false;
+    if (rr < kMinBeatIntervalUs || rr > kMaxBeatIntervalUs) {
+        prematureBeat = rr < kMinBeatIntervalUs;
+        rejectedBeats++;
+        return false;
+    }
+    if (lastBeatInterval > 0 && offIntervals < kMaxOffIntervals && (fromPremature ||
+            llabs(rr - lastBeatInterval) > lastBeatInterval * kMaxBeatIntervalChange)) {
+        prematureBeat = rr < lastBeatInterval * (1.0 - kMaxBeatIntervalChange);
+        offIntervals++;
+        rejectedBeats++;
+        return false;
+    }
+    lastBeatInterval = rr;
+    offIntervals = 0;
+    addInterval(rr / 1000.0);
+    return true;
+}
+
+void HrvAnalyzer::addInterval(double rrMs) {
+    int64_t rr = llround(rrMs * 1000.0);
+    if (rr <= 0 || rr > kMaxIntervalUs) return;
+    if (count == kHrvWindow) {
+        // drop the oldest interval and its difference to the next one
+        int64_t oldest = intervals[head];
+        int64_t diff = intervals[(head + 1) % kHrvWindow] - oldest;
+        sum -= oldest;
+        sumSquares -= oldest * oldest;
+        sumDiffSquares -= diff * diff;
+        if (llabs(diff) > kNN50ThresholdUs) nn50--;
+        head = (head + 1) % kHrvWindow;
+        count--;
+    }
+    if (count > 0) {
+        int64_t diff = rr - intervals[(head + count - 1) % kHrvWindow];
+        sumDiffSquares += diff * diff;
+        if (llabs(diff) > kNN50ThresholdUs) nn50++;
+    }
+    intervals[(head + count) % kHrvWindow] = rr;
+    sum += rr;
+    sumSquares += rr * rr;
+    count++;
+}
+
+double HrvAnalyzer::getMetric(int metric) const {
+    if (count < 2) return 0.0;
+    switch (metric) {
+        case kHrvMetric_RMSSD:
+            return sqrt((double) sumDiffSquares / (count - 1)) / 1000.0;
+        case kHrvMetric_SDNN: {
+            // integer numerator: n * sum(x^2) - sum(x)^2 is exact
+            double numerator = (double) (sumSquares * count - sum * sum);
+            return sqrt(numerator / ((double) count * (count - 1))) / 1000.0;
+        }
+        case kHrvMetric_PNN50:
+            return 100.0 * nn50 / (count - 1);
+        default:
+            return 0.0;
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/HrvAnalyzer.h
+ * @brief Header of HrvAnalyzer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_HRVANALYZER_H
+#define ANDROID_MIDI_SYNTH_HRVANALYZER_H
+
+#include <cstdint>
+
+/** @brief Number of RR intervals in the analysis window. */
+static const int kHrvWindow = 64;
+
+/** @brief Heart-rate variability metrics. */
+enum HrvMetric {
+    /** @brief Root mean square of successive differences, in ms. */
+    kHrvMetric_RMSSD = 0,
+    /** @brief Standard deviation of the intervals, in ms. */
+    kHrvMetric_SDNN  = 1,
+    /** @brief Percentage of successive differences above 50 ms. */
+    kHrvMetric_PNN50 = 2,
+    /** @brief Number of metrics. */
+    kHrvMetricCount  = 3,
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief HrvAnalyzer class.
+ * @details Sliding-window heart-rate variability (RMSSD, SDNN, pNN50) over the last RR
+ *          intervals. Intervals are stored in microseconds and the running sums are integers,
+ *          so each interval costs O(1) and the metrics never drift, however long the session.
+ *          The intervals come from detected beats (addBeat()): unsure detections, implausible
+ *          intervals, intervals more than 20% off the previous one (ectopic beats, missed
+ *          or extra detections) and the interval after a premature beat are left out, as
+ *          HRV analysis requires. Fixed memory, does
+ *          not allocate. Not thread safe.
+ */
+class HrvAnalyzer {
+public:
+    /** @brief Constructor. */
+    HrvAnalyzer();
+    /**
+     * @brief Add a detected beat.
+     * @param timeNs Time of the beat, in nanoseconds.
+     * @param confidence Confidence of the detection (0 to 1).
+     * @return True if the interval to the previous beat was added. False otherwise.
+     */
+    bool addBeat(int64_t timeNs, float confidence);
+    /**
+     * @brief Add an RR interval, as is.
+     * @param rrMs Interval between two beats, in milliseconds.
+     */
+    void addInterval(double rrMs);
+    /**
+     * @brief Get a metric.
+     * @param metric The metric (HrvMetric).
+     * @return Value of the metric, or 0 if there are not enough intervals.
+     */
+    double getMetric(int metric) const;
+    /**
+     * @brief Get the number of intervals in the window.
+     * @return The number of intervals.
+     */
+    int getCount() const { return count; }
+    /**
+     * @brief Get the number of beats left out so far.
+     * @return The number of beats.
+     */
+    uint64_t getRejectedBeats() const { return rejectedBeats; }
+    /** @brief Forget all the intervals. */
+    void reset();
+private:
+    /* @brief Intervals (ring buffer), in microseconds. */
+    int64_t intervals[kHrvWindow];
+    /* @brief Index of the oldest interval. */
+    int head;
+    /* @brief Number of intervals in the window. */
+    int count;
+    /* @brief Sum of the intervals. */
+    int64_t sum;
+    /* @brief Sum of the squared intervals. */
+    int64_t sumSquares;
+    /* @brief Sum of the squared successive differences. */
+    int64_t sumDiffSquares;
+    /* @brief Number of successive differences above 50 ms. */
+    int nn50;
+    /* @brief Time of the last sure beat, in nanoseconds (-1 if none). */
+    int64_t lastBeatNs;
+    /* @brief Last interval taken from the beats, in microseconds (0 if none). */
+    int64_t lastBeatInterval;
+    /* @brief Number of successive intervals left out for being off the last one. */
+    int offIntervals;
+    /* @brief True if the last beat came too early (the next interval is left out). */
+    bool prematureBeat;
+    /* @brief Number of beats left out. */
+    uint64_t rejectedBeats;
+};
+
+#endif //ANDROID_MIDI_SYNTH_HRVANALYZER_H
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/LevelMeter.cpp
+ * @brief Output level meter: peak, RMS and loudness (ITU-R BS.1770).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#include "LevelMeter.h"
+
+/* @brief Length of a loudness bin, in seconds. */
+static const double kLevelMeterBinSeconds = 0.1;
+/* @brief Absolute gate of the integrated loudness, in LUFS. */
+static const double kLevelMeterAbsoluteGate = -70.0;
+/* @brief Relative gate of the integrated loudness, in LU below the ungated loudness. */
+static const double kLevelMeterRelativeGate = -10.0;
+/* @brief Histogram bins per LU. */
+static const double kLevelMeterHistogramScale = 10.0;
+/* @brief Filter state below which it is flushed to zero (avoids denormals). */
+static const double kLevelMeterDenormal = 1e-30;
+
+/* @brief Convert a mean square to dB (or LUFS, with the BS.1770 offset). */
+static float powerToDb(double power, double offset = 0.0) {
+    if (power <= 0.0) return kLevelMeterSilence;
+    return (float) (offset + 10.0 * log10(power));
+}
+
+/* @brief Convert an energy per frame to loudness (LUFS). */
+static double energyToLoudness(double energy) {
+    return -0.691 + 10.0 * log10(energy);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+void LevelSnapshot::toArray(float *values) const {
+    values[0] = peak;
+    values[1] = rms;
+    values[2] = momentary;
+    values[3] = shortTerm;
+    values[4] = integrated;
+    values[5] = maxPeak;
+    values[6] = seconds;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+LevelMeter::LevelMeter(int sampleRate):
+    sampleRate(sampleRate), resetRequested(false), seq(0), sharedPeak(0.0f),
+    sharedPower(0.0f), sharedMomentary(0.0), sharedShortTerm(0.0), sharedIntegrated(0.0),
+    sharedMaxPeak(0.0f), sharedFrames(0) {
+    binFrames = (int) (kLevelMeterBinSeconds * sampleRate);
+    // K-weighting of BS.1770 for any sample rate (the standard gives 48 kHz coefficients)
+    double k = tan(M_PI * 1681.974450955533 / sampleRate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0,
+              (vh - vb * k / q + k * k) / a0, 2.0 * (k * k - 1.0) / a0,
+              (1.0 - k / q + k * k) / a0 };
+    k = tan(M_PI * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+    memset(state, 0, sizeof(state));
+    reset();
+}
+
+void LevelMeter::reset() {
+    binEnergy = 0.0;
+    binFill = 0;
+    memset(bins, 0, sizeof(bins));
+    binCount = 0;
+    memset(histogramCount, 0, sizeof(histogramCount));
+    memset(histogramEnergy, 0, sizeof(histogramEnergy));
+    blockPeak = 0.0f;
+    blockPower = 0.0f;
+    momentaryEnergy = 0.0;
+    shortTermEnergy = 0.0;
+    gatedEnergy = 0.0;
+    maxPeak = 0.0f;
+    frames = 0;
+}
+
+void LevelMeter::process(const float *left, const float *right, int frames) {
+    if (frames <= 0) return;
+    if (resetRequested.exchange(false, std::memory_order_relaxed)) reset();
+    // peak and sum of squares, in lanes (a float reduction is not vectorized otherwise)
+    float peakLanes[kLanes] = {};
+    float powerLanes[kLanes] = {};
+    int i = 0;
+    // (plain comparisons: fmaxf() handles NaNs and is not turned into vector max)
+    for (; i + kLanes <= frames; i += kLanes) {
+        for (int lane = 0; lane < kLanes; lane++) {
+            float l = left[i + lane];
+            float r = right[i + lane];
+            float level = fabsf(l) > fabsf(r) ? fabsf(l) : fabsf(r);
+            peakLanes[lane] = level > peakLanes[lane] ? level : peakLanes[lane];
+            powerLanes[lane] += l * l + r * r;
+        }
+    }
+    for (; i < frames; i++) {
+        float level = fabsf(left[i]) > fabsf(right[i]) ? fabsf(left[i]) : fabsf(right[i]);
+        if (level > peakLanes[0]) peakLanes[0] = level;
+        powerLanes[0] += left[i] * left[i] + right[i] * right[i];
+    }
+    float peak = 0.0f;
+    float power = 0.0f;
+    for (int lane = 0; lane < kLanes; lane++) {
+        if (peakLanes[lane] > peak) peak = peakLanes[lane];
+        power += powerLanes[lane];
+    }
+    blockPeak = peak;
+    blockPower = power / (2 * frames);
+    if (peak > maxPeak) maxPeak = peak;
+    this->frames += frames;
+    // loudness: the block is split at the bin boundaries
+    for (int done = 0; done < frames;) {
+        int count = binFrames - binFill;
+        if (count > frames - done) count = frames - done;
+        if (count > kChunkFrames) count = kChunkFrames;
+        binEnergy += weightedEnergy(left + done, right + done, count);
+        binFill += count;
+        done += count;
+        if (binFill == binFrames) closeBin();
+    }
+    publish();
+}
+
+double LevelMeter::weightedEnergy(const float *left, const float *right, int frames) {
+    float weighted[2 * kChunkFrames];
+    // transposed direct form II, the shelf then the high pass; both channels in the same
+    // loop, so the two recursions run in parallel (two lanes)
+    double l0 = state[0][0], l1 = state[0][1], l2 = state[0][2], l3 = state[0][3];
+    double r0 = state[1][0], r1 = state[1][1], r2 = state[1][2], r3 = state[1][3];
+    const Biquad a = shelf;
+    const Biquad b = highPass;
+    for (int i = 0; i < frames; i++) {
+        double xl = left[i];
+        double xr = right[i];
+        double yl = a.b0 * xl + l0;
+        double yr = a.b0 * xr + r0;
+        l0 = a.b1 * xl - a.a1 * yl + l1;
+        r0 = a.b1 * xr - a.a1 * yr + r1;
+        l1 = a.b2 * xl - a.a2 * yl;
+        r1 = a.b2 * xr - a.a2 * yr;
+        double zl = b.b0 * yl + l2;
+        double zr = b.b0 * yr + r2;
+        l2 = b.b1 * yl - b.a1 * zl + l3;
+        r2 = b.b1 * yr - b.a1 * zr + r3;
+        l3 = b.b2 * yl - b.a2 * zl;
+        r3 = b.b2 * yr - b.a2 * zr;
+        weighted[2 * i] = (float) zl;
+        weighted[2 * i + 1] = (float) zr;
+    }
+    double values[2][4] = { { l0, l1, l2, l3 }, { r0, r1, r2, r3 } };
+    for (int c = 0; c < 2; c++) {
+        for (int k = 0; k < 4; k++) {
+            state[c][k] = fabs(values[c][k]) < kLevelMeterDenormal ? 0.0 : values[c][k];
+        }
+    }
+    float lanes[kLanes] = {};
+    int i = 0;
+    for (; i + kLanes <= 2 * frames; i += kLanes) {
+        for (int lane = 0; lane < kLanes; lane++) {
+            lanes[lane] += weighted[i + lane] * weighted[i + lane];
+        }
+    }
+    for (; i < 2 * frames; i++) lanes[0] += weighted[i] * weighted[i];
+    double energy = 0.0;
+    for (int lane = 0; lane < kLanes; lane++) energy += lanes[lane];
+    return energy;
+}
+
+void LevelMeter::closeBin() {
+    bins[binCount % kBins] = binEnergy / binFrames;
+    binCount++;
+    binEnergy = 0.0;
+    binFill = 0;
+    // the means of the last bins (fewer at the start)
+    double sum = 0.0;
+    int count = binCount < kBins ? (int) binCount : kBins;
+    for (int i = 1; i <= count; i++) {
+        sum += bins[(binCount - i) % kBins];
+        if (i == kMomentaryBins || (i == count && count < kMomentaryBins)) {
+            momentaryEnergy = sum / i;
+        }
+    }
+    shortTermEnergy = sum / count;
+    // a momentary block every 100 ms: 75% overlap, as the integrated loudness requires
+    if (binCount < kMomentaryBins || momentaryEnergy <= 0.0) return;
+    double loudness = energyToLoudness(momentaryEnergy);
+    if (loudness < kLevelMeterAbsoluteGate) return;
+    int bin = (int) ((loudness - kLevelMeterAbsoluteGate) * kLevelMeterHistogramScale);
+    if (bin >= kHistogramBins) bin = kHistogramBins - 1;
+    histogramCount[bin]++;
+    histogramEnergy[bin] += momentaryEnergy;
+    gatedEnergy = integratedEnergy();
+}
+
+double LevelMeter::integratedEnergy() const {
+    double sum = 0.0;
+    uint64_t count = 0;
+    for (int i = 0; i < kHistogramBins; i++) {
+        sum += histogramEnergy[i];
+        count += histogramCount[i];
+    }
+    if (count == 0) return 0.0;
+    double threshold = energyToLoudness(sum / count) + kLevelMeterRelativeGate;
+    int first = (int) ceil((threshold - kLevelMeterAbsoluteGate) * kLevelMeterHistogramScale);
+    if (first < 0) first = 0;
+    sum = 0.0;
+    count = 0;
+    for (int i = first; i < kHistogramBins; i++) {
+        sum += histogramEnergy[i];
+        count += histogramCount[i];
+    }
+    return count > 0 ? sum / count : 0.0;
+}
+
+void LevelMeter::publish() {
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    sharedPeak.store(blockPeak, std::memory_order_relaxed);
+    sharedPower.store(blockPower, std::memory_order_relaxed);
+    sharedMomentary.store(momentaryEnergy, std::memory_order_relaxed);
+    sharedShortTerm.store(shortTermEnergy, std::memory_order_relaxed);
+    sharedIntegrated.store(gatedEnergy, std::memory_order_relaxed);
+    sharedMaxPeak.store(maxPeak, std::memory_order_relaxed);
+    sharedFrames.store(frames, std::memory_order_relaxed);
+    seq.fetch_add(1, std::memory_order_release);
+}
+
+void LevelMeter::getSnapshot(LevelSnapshot &snapshot) const {
+    float peak, power, maxPeak;
+    double momentary, shortTerm, integrated;
+    int64_t frames;
+    uint32_t start;
+    do {
+        start = seq.load(std::memory_order_acquire);
+        peak = sharedPeak.load(std::memory_order_relaxed);
+        power = sharedPower.load(std::memory_order_relaxed);
+        momentary = sharedMomentary.load(std::memory_order_relaxed);
+        shortTerm = sharedShortTerm.load(std::memory_order_relaxed);
+        integrated = sharedIntegrated.load(std::memory_order_relaxed);
+        maxPeak = sharedMaxPeak.load(std::memory_order_relaxed);
+        frames = sharedFrames.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((start & 1) || start != seq.load(std::memory_order_relaxed));
+    // the logarithms are taken by the reader, not by the render thread
+    snapshot.peak = powerToDb((double) peak * peak);
+    snapshot.rms = powerToDb(power);
+    snapshot.momentary = powerToDb(momentary, -0.691);
+    snapshot.shortTerm = powerToDb(shortTerm, -0.691);
+    snapshot.integrated = powerToDb(integrated, -0.691);
+    snapshot.maxPeak = powerToDb((double) maxPeak * maxPeak);
+    snapshot.seconds = (float) frames / sampleRate;
+}
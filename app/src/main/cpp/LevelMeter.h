@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/LevelMeter.h
+ * @brief Output level meter: peak, RMS and loudness (ITU-R BS.1770).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_LEVELMETER_H
+#define ANDROID_MIDI_SYNTH_LEVELMETER_H
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief Level reported for silence, in dB. */
+static const float kLevelMeterSilence = -144.0f;
+/** @brief Number of values of a level snapshot, as copied by LevelSnapshot::toArray(). */
+static const int kLevelMeterValues = 7;
+
+/** @brief Levels of the output, as published by LevelMeter. */
+struct LevelSnapshot {
+    /** @brief Sample peak of the last block, in dBFS. */
+    float peak;
+    /** @brief RMS of the last block, in dBFS. */
+    float rms;
+    /** @brief Momentary loudness (400 ms), in LUFS. */
+    float momentary;
+    /** @brief Short-term loudness (3 s), in LUFS. */
+    float shortTerm;
+    /** @brief Integrated (gated) loudness since the reset, in LUFS. */
+    float integrated;
+    /** @brief Sample peak since the reset, in dBFS. */
+    float maxPeak;
+    /** @brief Time metered since the reset, in seconds. */
+    float seconds;
+    /**
+     * @brief Copy the values in declaration order.
+     * @param values Receives kLevelMeterValues values.
+     */
+    void toArray(float *values) const;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief LevelMeter class.
+ * @details Meters the stereo render output: sample peak and RMS of each block, and the
+ *          loudness of ITU-R BS.1770 / EBU R 128 (K-weighting, momentary, short-term and
+ *          gated integrated loudness). The energy is summed in 100 ms bins; the momentary
+ *          and short-term loudness are the means of the last 4 and 30 bins, and each
+ *          momentary value goes to a 0.1 LU histogram for the integrated loudness, so the
+ *          memory does not grow with the session.
+ *          The peak and the sums of squares are computed in independent lanes, which the
+ *          compiler vectorizes; the K-weighting filters are recursive, so they run along
+ *          the frames, both channels in parallel. process() is called by the render thread
+ *          and publishes a snapshot under a sequence counter (seqlock): the writer never
+ *          waits, and readers on any thread retry while a publication is in progress.
+ */
+class LevelMeter {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit LevelMeter(int sampleRate);
+    /**
+     * @brief Meter a stereo block (render thread).
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    void process(const float *left, const float *right, int frames);
+    /** @brief Restart the integrated values on the next block (any thread). */
+    void requestReset() { resetRequested.store(true, std::memory_order_relaxed); }
+    /**
+     * @brief Read the last published levels (any thread).
+     * @param snapshot Receives the levels.
+     */
+    void getSnapshot(LevelSnapshot &snapshot) const;
+private:
+    /* @brief Bins of the short-term loudness (3 s). */
+    static const int kBins = 30;
+    /* @brief Bins of the momentary loudness (400 ms). */
+    static const int kMomentaryBins = 4;
+    /* @brief Bins of the loudness histogram (0.1 LU, -70 to +5 LUFS). */
+    static const int kHistogramBins = 750;
+    /* @brief Lanes of the vectorized sums. */
+    static const int kLanes = 8;
+    /* @brief Largest block filtered at once, in frames. */
+    static const int kChunkFrames = 256;
+    /* @brief A biquad filter (transposed direct form II). */
+    struct Biquad {
+        /* @brief Numerator coefficients. */
+        double b0, b1, b2;
+        /* @brief Denominator coefficients (a0 = 1). */
+        double a1, a2;
+    };
+    /* @brief Clear the integrated values. */
+    void reset();
+    /* @brief K-weight both channels and sum the squares.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames (up to kChunkFrames).
+     * @return The sum of the squares of the weighted samples. */
+    double weightedEnergy(const float *left, const float *right, int frames);
+    /* @brief Close the current bin: update the loudness values and the histogram. */
+    void closeBin();
+    /* @brief Compute the gated integrated loudness from the histogram.
+     * @return Mean energy of the gated blocks, or 0 if none. */
+    double integratedEnergy() const;
+    /* @brief Publish the values under the sequence counter. */
+    void publish();
+private:
+    /* @brief Frames of a 100 ms bin. */
+    int binFrames;
+    /* @brief Pre-filter (high shelf) of the K-weighting. */
+    Biquad shelf;
+    /* @brief RLB filter (high pass) of the K-weighting. */
+    Biquad highPass;
+    /* @brief Filter state per channel: two per biquad. */
+    double state[2][4];
+    /* @brief Weighted energy of the current bin. */
+    double binEnergy;
+    /* @brief Frames of the current bin. */
+    int binFill;
+    /* @brief Weighted energy of the last bins (ring), per frame. */
+    double bins[kBins];
+    /* @brief Number of bins closed since the reset. */
+    int64_t binCount;
+    /* @brief Number of momentary blocks per histogram bin. */
+    uint32_t histogramCount[kHistogramBins];
+    /* @brief Sum of the energy of the momentary blocks per histogram bin. */
+    double histogramEnergy[kHistogramBins];
+    /* @brief Peak of the last block (linear). */
+    float blockPeak;
+    /* @brief Mean square of the last block. */
+    float blockPower;
+    /* @brief Momentary energy per frame. */
+    double momentaryEnergy;
+    /* @brief Short-term energy per frame. */
+    double shortTermEnergy;
+    /* @brief Integrated (gated) energy per frame. */
+    double gatedEnergy;
+    /* @brief Peak since the reset (linear). */
+    float maxPeak;
+    /* @brief Frames metered since the reset. */
+    int64_t frames;
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief True to reset on the next block (written by any thread). */
+    std::atomic<bool> resetRequested;
+    /* @brief Sequence counter of the snapshot (odd while publishing). */
+    std::atomic<uint32_t> seq;
+    /* @brief Published peak of the last block. */
+    std::atomic<float> sharedPeak;
+    /* @brief Published mean square of the last block. */
+    std::atomic<float> sharedPower;
+    /* @brief Published momentary energy. */
+    std::atomic<double> sharedMomentary;
+    /* @brief Published short-term energy. */
+    std::atomic<double> sharedShortTerm;
+    /* @brief Published integrated energy. */
+    std::atomic<double> sharedIntegrated;
+    /* @brief Published peak since the reset. */
+    std::atomic<float> sharedMaxPeak;
+    /* @brief Published frames metered since the reset. */
+    std::atomic<int64_t> sharedFrames;
+};
+
+#endif //ANDROID_MIDI_SYNTH_LEVELMETER_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiClock.cpp
+ * @brief Implementation of MidiClock class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "MidiSpec.h"
+#include "MidiClock.h"
+
+/* @brief No pending transport request. */
+static const int kMidiClockRequestNone = -1;
+/* @brief Pending stop request. */
+static const int kMidiClockRequestStop = -2;
+/* @brief Highest Song Position Pointer value (14 bits). */
+static const int kMidiClockMaxPosition = 0x3FFF;
+
+// -----------------------------------------------------------------------------------------------
+
+MidiClock::MidiClock(MidiClockListener *listener, int sampleRate):
+    listener(listener), sampleRate(sampleRate), targetTempo(120.0f), maxSlew(0.0f),
+    currentTempo(120.0f), request(kMidiClockRequestNone), running(false), phase(0.0) {
+}
+
+void MidiClock::setTempo(float bpm) {
+    if (bpm <= 0.0f) return;
+    targetTempo.store(bpm, std::memory_order_relaxed);
+}
+
+void MidiClock::setMaxSlew(float bpmPerSecond) {
+    maxSlew.store(bpmPerSecond < 0.0f ? 0.0f : bpmPerSecond, std::memory_order_relaxed);
+}
+
+void MidiClock::start(int songPosition) {
+    if (songPosition < 0) songPosition = 0;
+    if (songPosition > kMidiClockMaxPosition) songPosition = kMidiClockMaxPosition;
+    request.store(songPosition, std::memory_order_release);
+}
+
+void MidiClock::stop() {
+    request.store(kMidiClockRequestStop, std::memory_order_release);
+}
+
+void MidiClock::process(int64_t frame, int frames) {
+    int command = request.exchange(kMidiClockRequestNone, std::memory_order_acquire);
+    if (command == kMidiClockRequestStop) {
+        if (running) listener->onMidiClock(frame, kMIDISysCmd_Stop, 0, 0);
+        running = false;
+    } else if (command >= 0) {
+        if (command == 0) {
+            listener->onMidiClock(frame, kMIDISysCmd_Start, 0, 0);
+        } else {
+            listener->onMidiClock(frame, kMIDISysCmd_SongPosition, command & 0x7F, command >> 7);
+            listener->onMidiClock(frame, kMIDISysCmd_Continue, 0, 0);
+        }
+        running = true;
+        // the first pulse after Start is the downbeat
+        phase = 1.0;
+    }
+    // follow the tempo with a bounded slew
+    float tempo = currentTempo.load(std::memory_order_relaxed);
+    float target = targetTempo.load(std::memory_order_relaxed);
+    float slew = maxSlew.load(std::memory_order_relaxed);
+    if (slew > 0.0f) {
+        float maxDelta = slew * frames / sampleRate;
+        if (target > tempo + maxDelta) target = tempo + maxDelta;
+        if (target < tempo - maxDelta) target = tempo - maxDelta;
+    }
+    currentTempo.store(target, std::memory_order_relaxed);
+    if (!running) return;
+    // average of the tempo over the block
+    double pulsesPerFrame = (tempo + target) * 0.5 * kMidiClockPPQN / 60.0 / sampleRate;
+    double start = phase;
+    phase += pulsesPerFrame * frames;
+    for (int pulse = 0; phase >= 1.0; pulse++) {
+        // the frame where the phase reaches the pulse
+        auto offset = (int64_t) ((1.0 + pulse - start) / pulsesPerFrame + 0.5);
+        if (offset > frames) offset = frames;
+        listener->onMidiClock(frame + offset, kMIDISysCmd_TimingClock, 0, 0);
+        phase -= 1.0;
+    }
+}
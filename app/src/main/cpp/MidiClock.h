@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiClock.h
+ * @brief Header of MidiClock class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDICLOCK_H
+#define ANDROID_MIDI_SYNTH_MIDICLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief MIDI clock pulses per quarter note. */
+static const int kMidiClockPPQN = 24;
+/** @brief MIDI clock pulses per MIDI beat (sixteenth note, unit of the Song Position Pointer). */
+static const int kMidiClockPulsesPerBeat = 6;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiClockListener interface.
+ * @details Receives the messages of a MidiClock, stamped with the audio frame they fall on.
+ */
+class MidiClockListener {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiClockListener() = default;
+    /**
+     * @brief A clock message is due (called from the render thread).
+     * @param frame Audio frame of the message.
+     * @param status Status byte.
+     * @param data1 First data byte (0 if not used by the message).
+     * @param data2 Second data byte (0 if not used by the message).
+     */
+    virtual void onMidiClock(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) = 0;
+};
+
+/**
+ * @brief MidiClock class.
+ * @details Generates 24 PPQN MIDI clock from the audio frame clock (render thread), following
+ *          tempo changes with a bounded slew so synced gear never sees a tempo jump. Also emits
+ *          Start, Continue with Song Position Pointer, and Stop. Tempo and transport may be set
+ *          from any thread; the messages are emitted by process(), each with the frame it falls on
+ *          inside the block (not quantized to the block).
+ */
+class MidiClock {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the clock messages (called from the render thread).
+     * @param sampleRate Audio sample rate, in Hz.
+     */
+    MidiClock(MidiClockListener *listener, int sampleRate);
+    /**
+     * @brief Set the tempo to follow.
+     * @param bpm Tempo, in quarter notes per minute.
+     */
+    void setTempo(float bpm);
+    /**
+     * @brief Set the maximum tempo change rate.
+     * @param bpmPerSecond Maximum tempo change, in BPM per second (0 follows at once).
+     */
+    void setMaxSlew(float bpmPerSecond);
+    /**
+     * @brief Start the clock.
+     * @param songPosition Position to start from, in MIDI beats (sixteenth notes). 0 sends
+     *                     Start, other positions send Song Position Pointer and Continue.
+     */
+    void start(int songPosition);
+    /** @brief Stop the clock. */
+    void stop();
+    /**
+     * @brief Advance the clock and emit the due messages (render thread).
+     * @param frame First audio frame of the block.
+     * @param frames Number of audio frames in the block.
+     */
+    void process(int64_t frame, int frames);
+    /**
+     * @brief Get the current (slewed) tempo.
+     * @return Tempo, in BPM.
+     */
+    float getTempo() const { return currentTempo.load(std::memory_order_relaxed); }
+private:
+    /* @brief Receives the clock messages. */
+    MidiClockListener *listener;
+    /* @brief Audio sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Tempo to follow, in BPM. */
+    std::atomic<float> targetTempo;
+    /* @brief Maximum tempo change, in BPM per second. */
+    std::atomic<float> maxSlew;
+    /* @brief Current tempo, in BPM. */
+    std::atomic<float> currentTempo;
+    /* @brief Pending transport request: -1 none, -2 stop, otherwise start position. */
+    std::atomic<int> request;
+    /* @brief True while the clock is running (render thread). */
+    bool running;
+    /* @brief Fraction of pulse elapsed since the last pulse (render thread). */
+    double phase;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDICLOCK_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiEventQueue.cpp
+ * @brief Implementation of MidiEventQueue class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "MidiEventQueue.h"
+
+/* @brief Index in the ring buffer. */
+#define RING_INDEX(x) ((x) % kMidiEventQueueSize)
+
+// -----------------------------------------------------------------------------------------------
+
+bool MidiEventQueue::push(const MidiEvent &event) {
+    if (count == kMidiEventQueueSize) return false;
+    // shift later events up, starting from the tail
+    int i = count;
+    while (i > 0 && events[RING_INDEX(head + i - 1)].frame > event.frame) {
+        events[RING_INDEX(head + i)] = events[RING_INDEX(head + i - 1)];
+        i--;
+    }
+    events[RING_INDEX(head + i)] = event;
+    count++;
+    return true;
+}
+
+bool MidiEventQueue::pop(int64_t frame, MidiEvent &event) {
+    if (count == 0 || events[head].frame >= frame) return false;
+    event = events[head];
+    head = RING_INDEX(head + 1);
+    count--;
+    return true;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiEventQueue.h
+ * @brief Header of MidiEventQueue class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDIEVENTQUEUE_H
+#define ANDROID_MIDI_SYNTH_MIDIEVENTQUEUE_H
+
+#include <cstdint>
+
+/** @brief Capacity of the MIDI event queue. */
+static const int kMidiEventQueueSize = 256;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief A MIDI message scheduled at an audio frame.
+ */
+struct MidiEvent {
+    /** @brief Audio frame the message is due at. */
+    int64_t frame;
+    /** @brief Status byte. */
+    uint8_t status;
+    /** @brief First data byte. */
+    uint8_t data1;
+    /** @brief Second data byte. */
+    uint8_t data2;
+    /** @brief True to also send the message to the MIDI outputs when played. */
+    bool output;
+};
+
+/**
+ * @brief MidiEventQueue class.
+ * @details Fixed capacity queue of MIDI events ordered by frame (events of the same frame keep
+ *          their insertion order). Insertion is cheap when events arrive mostly in order.
+ *          Not thread safe. Does not allocate memory.
+ */
+class MidiEventQueue {
+public:
+    /** @brief Constructor. */
+    MidiEventQueue(): head(0), count(0) {}
+    /**
+     * @brief Insert an event.
+     * @param event The event.
+     * @return True if successful. False if the queue is full.
+     */
+    bool push(const MidiEvent &event);
+    /**
+     * @brief Remove the earliest event if it is due before a frame.
+     * @param frame End frame (exclusive).
+     * @param event Receives the event.
+     * @return True if an event was removed. False otherwise.
+     */
+    bool pop(int64_t frame, MidiEvent &event);
+    /** @brief Remove all the events. */
+    void clear() { head = 0; count = 0; }
+    /**
+     * @brief Get the number of queued events.
+     * @return The number of events.
+     */
+    int size() const { return count; }
+private:
+    /* @brief Events (ring buffer). */
+    MidiEvent events[kMidiEventQueueSize];
+    /* @brief Index of the earliest event. */
+    int head;
+    /* @brief Number of events. */
+    int count;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDIEVENTQUEUE_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiLoopbackPort.cpp
+ * @brief Implementation of MidiLoopbackPort class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <chrono>
+
+#include "MidiLoopbackPort.h"
+
+// -----------------------------------------------------------------------------------------------
+
+MidiLoopbackPort::MidiLoopbackPort(): head(0), count(0), packetHead(0), packetCount(0) {
+}
+
+bool MidiLoopbackPort::send(const uint8_t *data, int length, int64_t timestampNs) {
+    if (length <= 0) return length == 0;
+    if (timestampNs <= 0) {
+        timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (length > kMidiLoopbackSize - count || packetCount == kMidiLoopbackPackets) return false;
+    for (int i = 0; i < length; i++) {
+        buffer[(head + count + i) % kMidiLoopbackSize] = data[i];
+    }
+    count += length;
+    packets[(packetHead + packetCount) % kMidiLoopbackPackets] = { length, timestampNs };
+    packetCount++;
+    return true;
+}
+
+int MidiLoopbackPort::receive(uint8_t *data, int maxLength, int64_t *timestampNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (packetCount == 0) return 0;
+    Packet &packet = packets[packetHead];
+    int length = packet.length < maxLength ? packet.length : maxLength;
+    for (int i = 0; i < length; i++) {
+        data[i] = buffer[(head + i) % kMidiLoopbackSize];
+    }
+    head = (head + length) % kMidiLoopbackSize;
+    count -= length;
+    if (timestampNs) *timestampNs = packet.timestampNs;
+    // the rest of a packet larger than the buffer is received next, with the same time
+    packet.length -= length;
+    if (packet.length == 0) {
+        packetHead = (packetHead + 1) % kMidiLoopbackPackets;
+        packetCount--;
+    }
+    return length;
+}
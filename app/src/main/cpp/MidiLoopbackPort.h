@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiLoopbackPort.h
+ * @brief Header of MidiLoopbackPort class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDILOOPBACKPORT_H
+#define ANDROID_MIDI_SYNTH_MIDILOOPBACKPORT_H
+
+#include <mutex>
+
+#include "MidiPort.h"
+
+/** @brief Capacity of the loopback buffer, in bytes. */
+static const int kMidiLoopbackSize = 4096;
+/** @brief Capacity of the loopback buffer, in packets (send() calls). */
+static const int kMidiLoopbackPackets = 256;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiLoopbackPort class.
+ * @details In-memory port: bytes sent are received back in the same order. Stands in for a
+ *          device port where AMidi is not available (e.g. host builds). As a device port,
+ *          each receive() returns the bytes of one packet (one send() call) stamped with its
+ *          timestamp, or the time it was sent. Does not allocate.
+ */
+class MidiLoopbackPort: public MidiOutputPort, public MidiInputPort {
+public:
+    /** @brief Constructor. */
+    MidiLoopbackPort();
+    /**
+     * @brief Queue MIDI bytes.
+     * @param data MIDI bytes.
+     * @param length Number of bytes.
+     * @param timestampNs Timestamp of the bytes (steady clock, in ns), or 0 for now.
+     * @return True if successful. False if the buffer is full (nothing is queued).
+     */
+    bool send(const uint8_t *data, int length, int64_t timestampNs) override;
+    /**
+     * @brief Dequeue the bytes of the oldest packet (or the first maxLength of them).
+     * @param buffer Receives the bytes.
+     * @param maxLength Size of the buffer.
+     * @param timestampNs Receives the timestamp of the packet (steady clock, in ns).
+     * @return The number of bytes received, 0 if none is available.
+     */
+    int receive(uint8_t *buffer, int maxLength, int64_t *timestampNs) override;
+private:
+    /* @brief A queued packet. */
+    struct Packet {
+        /* @brief Bytes left to receive. */
+        int length;
+        /* @brief Time the packet was sent (steady clock), in nanoseconds. */
+        int64_t timestampNs;
+    };
+    /* @brief Guards the buffer. */
+    std::mutex mutex;
+    /* @brief Ring buffer. */
+    uint8_t buffer[kMidiLoopbackSize];
+    /* @brief Read position. */
+    int head;
+    /* @brief Number of bytes queued. */
+    int count;
+    /* @brief Ring of the queued packets. */
+    Packet packets[kMidiLoopbackPackets];
+    /* @brief Oldest packet. */
+    int packetHead;
+    /* @brief Number of packets queued. */
+    int packetCount;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDILOOPBACKPORT_H
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiMessageQueue.h
+ * @brief Header of MidiMessageQueue class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDIMESSAGEQUEUE_H
+#define ANDROID_MIDI_SYNTH_MIDIMESSAGEQUEUE_H
+
+#include <cstdint>
+
+#include "BoundedQueue.h"
+
+/** @brief Capacity of the MIDI message queue, in messages (power of 2). */
+static const int kMidiMessageQueueSize = 1024;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiMessageQueue class.
+ * @details Takes short MIDI messages from any thread and hands them to a single consumer,
+ *          the render thread, in the order they were queued. Lock-free (see BoundedQueue).
+ */
+class MidiMessageQueue {
+public:
+    /**
+     * @brief Queue a message (any thread). Lock-free.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full (the message is dropped).
+     */
+    bool push(uint8_t status, uint8_t data1, uint8_t data2) {
+        return queue.push(status | (data1 << 8) | (data2 << 16));
+    }
+    /**
+     * @brief Remove the oldest message (single consumer). Wait-free.
+     * @param status Receives the status byte.
+     * @param data1 Receives the first data byte.
+     * @param data2 Receives the second data byte.
+     * @return True if a message was removed. False if none is ready.
+     */
+    bool pop(uint8_t &status, uint8_t &data1, uint8_t &data2) {
+        uint32_t message;
+        if (!queue.pop(message)) return false;
+        status = (uint8_t) message;
+        data1 = (uint8_t) (message >> 8);
+        data2 = (uint8_t) (message >> 16);
+        return true;
+    }
+    /**
+     * @brief Get the number of messages dropped because the queue was full.
+     * @return The number of messages.
+     */
+    uint64_t getDropped() const { return queue.getDropped(); }
+private:
+    /* @brief Status and data bytes (bits 0-7, 8-15 and 16-23) of the messages. */
+    BoundedQueue<uint32_t, kMidiMessageQueueSize> queue;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDIMESSAGEQUEUE_H
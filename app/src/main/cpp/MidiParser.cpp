@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiParser.cpp
+ * @brief Implementation of MidiParser class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "MidiSpec.h"
+#include "MidiParser.h"
+
+/* @brief True if the byte is a status byte. */
+#define IS_STATUS(x) (((x) & 0x80) != 0)
+/* @brief True if the byte is a realtime message. */
+#define IS_REALTIME(x) ((x) >= kMIDISysCmd_TimingClock)
+
+// -----------------------------------------------------------------------------------------------
+
+int MidiParser::dataLength(uint8_t status) {
+    if (status < kMIDISysCmdChan) {
+        uint8_t cmd = status >> 4;
+        return (cmd == kMIDIChanCmd_ProgramChange || cmd == kMIDIChanCmd_ChannelPress) ? 1 : 2;
+    }
+    switch (status) {
+        case kMIDISysCmd_QuarterFrame:
+        case kMIDISysCmd_SongSelect:
+            return 1;
+        case kMIDISysCmd_SongPosition:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+MidiParser::MidiParser(MidiListener *listener): listener(listener), droppedBytes(0) {
+    reset();
+}
+
+void MidiParser::reset() {
+    status = 0;
+    dataCount = 0;
+    dataExpected = 0;
+    inSysEx = false;
+    sysExOverflow = false;
+    sysExLength = 0;
+}
+
+void MidiParser::parse(const uint8_t *bytes, int length) {
+    for (int i = 0; i < length; i++) {
+        uint8_t b = bytes[i];
+        if (!IS_STATUS(b)) {
+            parseData(b);
+        } else if (IS_REALTIME(b)) {
+            // realtime bytes do not affect the message being received
+            listener->onMidiMessage(b, 0, 0);
+        } else {
+            parseStatus(b);
+        }
+    }
+}
+
+void MidiParser::parseStatus(uint8_t b) {
+    // any status byte terminates a SysEx
+    if (inSysEx) endSysEx();
+    dataCount = 0;
+    if (b == kMIDISysCmd_SysEx) {
+        status = 0;
+        inSysEx = true;
+        sysExOverflow = false;
+        sysExLength = 0;
+        return;
+    }
+    if (b == kMIDISysCmd_EndOfSysEx) {
+        status = 0;
+        return;
+    }
+    dataExpected = dataLength(b);
+    if (b >= kMIDISysCmdChan) {
+        // system common messages cancel the running status
+        if (dataExpected == 0) {
+            listener->onMidiMessage(b, 0, 0);
+            status = 0;
+        } else {
+            status = b;
+        }
+        return;
+    }
+    status = b;
+}
+
+void MidiParser::parseData(uint8_t b) {
+    if (inSysEx) {
+        if (sysExLength < kMidiParserMaxSysEx) {
+            sysEx[sysExLength++] = b;
+        } else {
+            if (!sysExOverflow) droppedBytes += sysExLength;
+            sysExOverflow = true;
+            droppedBytes++;
+        }
+        return;
+    }
+    if (status == 0) {
+        droppedBytes++;
+        return;
+    }
+    data[dataCount++] = b;
+    if (dataCount < dataExpected) return;
+    listener->onMidiMessage(status, data[0], dataExpected > 1 ? data[1] : 0);
+    dataCount = 0;
+    // system common messages have no running status
+    if (status >= kMIDISysCmdChan) status = 0;
+}
+
+void MidiParser::endSysEx() {
+    inSysEx = false;
+    if (!sysExOverflow) listener->onMidiSysEx(sysEx, sysExLength);
+    sysExLength = 0;
+}
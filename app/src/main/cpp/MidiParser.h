@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiParser.h
+ * @brief Header of MidiParser class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDIPARSER_H
+#define ANDROID_MIDI_SYNTH_MIDIPARSER_H
+
+#include <cstdint>
+
+/** @brief Maximum SysEx payload kept by the parser, in bytes. Longer messages are dropped. */
+static const int kMidiParserMaxSysEx = 512;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiListener interface.
+ * @details Receives the messages decoded by a MidiParser.
+ */
+class MidiListener {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiListener() = default;
+    /**
+     * @brief A channel, system common or realtime message was received.
+     * @param status Status byte.
+     * @param data1 First data byte (0 if not used by the message).
+     * @param data2 Second data byte (0 if not used by the message).
+     */
+    virtual void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) = 0;
+    /**
+     * @brief A SysEx message was received.
+     * @param data Payload, without the SysEx and End Of SysEx bytes.
+     *             Only valid during the call.
+     * @param length Payload length, in bytes.
+     */
+    virtual void onMidiSysEx(const uint8_t *data, int length) = 0;
+};
+
+/**
+ * @brief MidiParser class.
+ * @details Streaming parser of a raw MIDI byte stream. Accepts chunks split at any byte,
+ *          handles running status, realtime bytes interleaved anywhere (also inside other
+ *          messages and SysEx) and SysEx. Does not allocate memory.
+ */
+class MidiParser {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the decoded messages.
+     */
+    explicit MidiParser(MidiListener *listener);
+    /**
+     * @brief Parse a chunk of the stream.
+     * @param data Bytes to parse.
+     * @param length Number of bytes.
+     */
+    void parse(const uint8_t *data, int length);
+    /** @brief Forget any partial message and the running status. */
+    void reset();
+    /**
+     * @brief Get the number of bytes discarded so far (orphan data bytes, overflowed SysEx).
+     * @return The number of bytes.
+     */
+    uint64_t getDroppedBytes() const { return droppedBytes; }
+    /**
+     * @brief Get the number of data bytes of a message.
+     * @param status Status byte (SysEx excluded).
+     * @return The number of data bytes (0 to 2).
+     */
+    static int dataLength(uint8_t status);
+private:
+    /* @brief Handle a status byte other than realtime. */
+    void parseStatus(uint8_t status);
+    /* @brief Handle a data byte. */
+    void parseData(uint8_t data);
+    /* @brief Deliver the SysEx received so far, if any. */
+    void endSysEx();
+private:
+    /* @brief Receives the decoded messages. */
+    MidiListener *listener;
+    /* @brief Current (running) status, or 0 if none. */
+    uint8_t status;
+    /* @brief Data bytes of the message being received. */
+    uint8_t data[2];
+    /* @brief Number of data bytes received for the current message. */
+    int dataCount;
+    /* @brief Number of data bytes expected for the current status. */
+    int dataExpected;
+    /* @brief True while receiving a SysEx. */
+    bool inSysEx;
+    /* @brief True if the SysEx being received did not fit in the buffer. */
+    bool sysExOverflow;
+    /* @brief Length of the SysEx payload received so far. */
+    int sysExLength;
+    /* @brief SysEx payload. */
+    uint8_t sysEx[kMidiParserMaxSysEx];
+    /* @brief Number of bytes discarded. */
+    uint64_t droppedBytes;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDIPARSER_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiPort.h
+ * @brief Header of MIDI port interfaces.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDIPORT_H
+#define ANDROID_MIDI_SYNTH_MIDIPORT_H
+
+#include <cstdint>
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiOutputPort interface.
+ * @details A port the synth library writes MIDI bytes to (e.g. the input port of a USB device).
+ */
+class MidiOutputPort {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiOutputPort() = default;
+    /**
+     * @brief Send MIDI bytes.
+     * @param data MIDI bytes.
+     * @param length Number of bytes.
+     * @param timestampNs Time the bytes are due (CLOCK_MONOTONIC, in ns), or 0 for now.
+     * @return True if successful. False otherwise.
+     */
+    virtual bool send(const uint8_t *data, int length, int64_t timestampNs) = 0;
+};
+
+/**
+ * @brief MidiInputPort interface.
+ * @details A port the synth library reads MIDI bytes from (e.g. the output port of a USB device).
+ */
+class MidiInputPort {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiInputPort() = default;
+    /**
+     * @brief Receive MIDI bytes, without blocking.
+     * @param buffer Receives the bytes.
+     * @param maxLength Size of the buffer.
+     * @param timestampNs Receives the timestamp of the bytes (CLOCK_MONOTONIC, in ns).
+     * @return The number of bytes received, 0 if none is available, or -1 on error.
+     */
+    virtual int receive(uint8_t *buffer, int maxLength, int64_t *timestampNs) = 0;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDIPORT_H
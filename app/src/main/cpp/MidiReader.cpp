@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiReader.cpp
+ * @brief Implementation of MidiReader class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <chrono>
+
+#include "MidiReader.h"
+
+/* @brief Size of the receive buffer, in bytes. */
+static const int kMidiReaderBufferSize = 1024;
+
+// -----------------------------------------------------------------------------------------------
+
+MidiReader::MidiReader(MidiReaderListener *listener):
+    listener(listener), parser(this), timestampNs(0), port(nullptr), running(false) {
+}
+
+MidiReader::~MidiReader() {
+    stop();
+}
+
+bool MidiReader::start(MidiInputPort *inputPort) {
+    if (running.load()) return false;
+    // the previous thread may have ended on a port error
+    if (thread.joinable()) thread.join();
+    port = inputPort;
+    parser.reset();
+    running.store(true);
+    thread = std::thread(&MidiReader::run, this);
+    return true;
+}
+
+void MidiReader::stop() {
+    running.store(false);
+    if (thread.joinable()) thread.join();
+    port = nullptr;
+}
+
+void MidiReader::run() {
+    uint8_t buffer[kMidiReaderBufferSize];
+    while (running.load(std::memory_order_relaxed)) {
+        int64_t timestamp = 0;
+        int length = port->receive(buffer, sizeof(buffer), &timestamp);
+        if (length < 0) break;
+        if (length == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(kMidiReaderPollUs));
+            continue;
+        }
+        if (timestamp <= 0) {
+            // the port has no timestamps: the bytes were received at most a poll ago
+            timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        timestampNs = timestamp;
+        parser.parse(buffer, length);
+    }
+    running.store(false);
+}
+
+void MidiReader::onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) {
+    listener->onMidiPortMessage(timestampNs, status, data1, data2);
+}
+
+void MidiReader::onMidiSysEx(const uint8_t *data, int length) {
+    listener->onMidiPortSysEx(timestampNs, data, length);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiReader.h
+ * @brief Header of MidiReader class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDIREADER_H
+#define ANDROID_MIDI_SYNTH_MIDIREADER_H
+
+#include <atomic>
+#include <thread>
+
+#include "MidiParser.h"
+#include "MidiPort.h"
+
+/** @brief Polling period of the MIDI reader thread, in microseconds. */
+static const int kMidiReaderPollUs = 1000;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiReaderListener interface.
+ * @details Receives the messages read from a port, with the time the port received them.
+ */
+class MidiReaderListener {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiReaderListener() = default;
+    /**
+     * @brief A channel, system common or realtime message was received.
+     * @param timestampNs Time the port received the message (CLOCK_MONOTONIC, in ns).
+     * @param status Status byte.
+     * @param data1 First data byte (0 if not used by the message).
+     * @param data2 Second data byte (0 if not used by the message).
+     */
+    virtual void onMidiPortMessage(int64_t timestampNs, uint8_t status, uint8_t data1,
+                                   uint8_t data2) = 0;
+    /**
+     * @brief A SysEx message was received.
+     * @param timestampNs Time the port received the end of the message (CLOCK_MONOTONIC, in ns).
+     * @param data Payload, without the SysEx and End Of SysEx bytes. Only valid during the call.
+     * @param length Payload length, in bytes.
+     */
+    virtual void onMidiPortSysEx(int64_t timestampNs, const uint8_t *data, int length) = 0;
+};
+
+/**
+ * @brief MidiReader class.
+ * @details Native thread that polls a MidiInputPort and feeds the bytes through its own
+ *          MidiParser into a MidiReaderListener, stamped with the time the port received
+ *          them (not the time they are read, which adds the polling delay).
+ */
+class MidiReader: private MidiListener {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the decoded messages (called from the reader thread).
+     */
+    explicit MidiReader(MidiReaderListener *listener);
+    /** @brief Destructor. Stops the thread. */
+    ~MidiReader();
+    /**
+     * @brief Start reading a port.
+     * @param port The port to read. Must outlive the reader (or the next stop()).
+     * @return True if successful. False if already running.
+     */
+    bool start(MidiInputPort *port);
+    /** @brief Stop reading and join the thread. */
+    void stop();
+private:
+    /* @brief Thread body. */
+    void run();
+    /* @brief Forward a parsed message with the timestamp of its bytes. */
+    void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) override;
+    /* @brief Forward a parsed SysEx with the timestamp of its last bytes. */
+    void onMidiSysEx(const uint8_t *data, int length) override;
+private:
+    /* @brief Receives the decoded messages. */
+    MidiReaderListener *listener;
+    /* @brief Parser of the received bytes. */
+    MidiParser parser;
+    /* @brief Timestamp of the bytes being parsed (CLOCK_MONOTONIC, in ns). */
+    int64_t timestampNs;
+    /* @brief Port being read. */
+    MidiInputPort *port;
+    /* @brief Reader thread. */
+    std::thread thread;
+    /* @brief True while the thread should keep running. */
+    std::atomic<bool> running;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDIREADER_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiSender.cpp
+ * @brief Timed sending of the MIDI output off the render thread.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <chrono>
+
+#include "MidiSender.h"
+
+// -----------------------------------------------------------------------------------------------
+
+MidiSender::MidiSender(MidiSenderListener *listener):
+    listener(listener), queue(), head(0), tail(0), dropped(0), running(false) {
+}
+
+MidiSender::~MidiSender() {
+    stop();
+}
+
+void MidiSender::start() {
+    if (running.load()) return;
+    running.store(true);
+    thread = std::thread(&MidiSender::run, this);
+}
+
+void MidiSender::stop() {
+    running.store(false);
+    if (thread.joinable()) thread.join();
+    head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+bool MidiSender::push(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2) {
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    if (pos - head.load(std::memory_order_acquire) == kMidiSenderQueueSize) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Message &message = queue[pos & (kMidiSenderQueueSize - 1)];
+    message.timeNs = timeNs;
+    message.status = status;
+    message.data1 = data1;
+    message.data2 = data2;
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void MidiSender::run() {
+    using namespace std::chrono;
+    while (running.load(std::memory_order_relaxed)) {
+        uint32_t pos = head.load(std::memory_order_relaxed);
+        if (pos == tail.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(microseconds(kMidiSenderPollUs));
+            continue;
+        }
+        const Message &message = queue[pos & (kMidiSenderQueueSize - 1)];
+        int64_t waitNs = message.timeNs -
+                duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        if (waitNs > 0) {
+            // wake up in time for the message, but keep an eye on stop()
+            std::this_thread::sleep_for(nanoseconds(waitNs < kMidiSenderPollUs * 1000LL
+                                                    ? waitNs : kMidiSenderPollUs * 1000LL));
+            continue;
+        }
+        listener->onMidiSend(message.timeNs, message.status, message.data1, message.data2);
+        head.store(pos + 1, std::memory_order_release);
+    }
+}
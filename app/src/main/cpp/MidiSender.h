@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/MidiSender.h
+ * @brief Timed sending of the MIDI output off the render thread.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_MIDISENDER_H
+#define ANDROID_MIDI_SYNTH_MIDISENDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/** @brief Capacity of the MIDI sender queue, in messages (power of 2). */
+static const int kMidiSenderQueueSize = 1024;
+/** @brief Longest sleep of the MIDI sender thread, in microseconds. */
+static const int kMidiSenderPollUs = 1000;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief MidiSenderListener interface.
+ * @details Sends the messages released by a MidiSender (called from its thread).
+ */
+class MidiSenderListener {
+public:
+    /** @brief Destructor. */
+    virtual ~MidiSenderListener() = default;
+    /**
+     * @brief A message is due.
+     * @param timeNs Time of the message (steady clock), in nanoseconds.
+     * @param status Status byte.
+     * @param data1 First data byte (0 if not used by the message).
+     * @param data2 Second data byte (0 if not used by the message).
+     */
+    virtual void onMidiSend(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2) = 0;
+};
+
+/**
+ * @brief MidiSender class.
+ * @details Takes timed MIDI messages from the render thread through a wait-free single
+ *          producer queue, and hands each one to the listener from its own thread when its
+ *          time comes. The render thread never locks or does I/O for the MIDI outputs, and the
+ *          messages of a block leave spread over time instead of in one burst.
+ */
+class MidiSender {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Sends the messages.
+     */
+    explicit MidiSender(MidiSenderListener *listener);
+    /** @brief Destructor. Stops the thread. */
+    ~MidiSender();
+    /** @brief Start the sender thread. */
+    void start();
+    /** @brief Stop the sender thread. The queued messages are dropped. */
+    void stop();
+    /**
+     * @brief Queue a message (single producer, the render thread). Wait-free.
+     * @param timeNs Time the message is due (steady clock), in nanoseconds.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full (the message is dropped).
+     */
+    bool push(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2);
+    /**
+     * @brief Get the number of messages dropped because the queue was full.
+     * @return The number of messages.
+     */
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+private:
+    /* @brief Sender thread body. */
+    void run();
+private:
+    /* @brief A queued message. */
+    struct Message {
+        /* @brief Time the message is due, in nanoseconds. */
+        int64_t timeNs;
+        /* @brief Status byte. */
+        uint8_t status;
+        /* @brief First data byte. */
+        uint8_t data1;
+        /* @brief Second data byte. */
+        uint8_t data2;
+    };
+    /* @brief Sends the messages. */
+    MidiSenderListener *listener;
+    /* @brief Message queue (ring buffer). */
+    Message queue[kMidiSenderQueueSize];
+    /* @brief Next position to read (sender thread). */
+    std::atomic<uint32_t> head;
+    /* @brief Next position to write (render thread). */
+    std::atomic<uint32_t> tail;
+    /* @brief Number of dropped messages. */
+    std::atomic<uint64_t> dropped;
+    /* @brief True while the thread runs. */
+    std::atomic<bool> running;
+    /* @brief Sender thread. */
+    std::thread thread;
+};
+
+#endif //ANDROID_MIDI_SYNTH_MIDISENDER_H
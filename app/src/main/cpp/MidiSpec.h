@@ -64,8 +64,24 @@ static const uint8_t kMIDIControl_Reverb        = 0x5B;
 static const uint8_t kMIDISysCmdChan            = 0xF0;
 /** @brief MIDI System: SysEx (240). */
 static const uint8_t kMIDISysCmd_SysEx          = 0xF0;
+/** @brief MIDI System: MTC Quarter Frame (241). */
+static const uint8_t kMIDISysCmd_QuarterFrame   = 0xF1;
+/** @brief MIDI System: Song Position Pointer (242). */
+static const uint8_t kMIDISysCmd_SongPosition   = 0xF2;
+/** @brief MIDI System: Song Select (243). */
+static const uint8_t kMIDISysCmd_SongSelect     = 0xF3;
+/** @brief MIDI System: Tune Request (246). */
+static const uint8_t kMIDISysCmd_TuneRequest    = 0xF6;
 /** @brief MIDI System: End Of SysEx (247). */
 static const uint8_t kMIDISysCmd_EndOfSysEx     = 0xF7;
+/** @brief MIDI System: Timing Clock (248). */
+static const uint8_t kMIDISysCmd_TimingClock    = 0xF8;
+/** @brief MIDI System: Start (250). */
+static const uint8_t kMIDISysCmd_Start          = 0xFA;
+/** @brief MIDI System: Continue (251). */
+static const uint8_t kMIDISysCmd_Continue       = 0xFB;
+/** @brief MIDI System: Stop (252). */
+static const uint8_t kMIDISysCmd_Stop           = 0xFC;
 /** @brief MIDI System: Active Sensing (254). */
 static const uint8_t kMIDISysCmd_ActiveSensing  = 0xFE;
 /** @brief MIDI System: Reset (255). */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/OutputChain.cpp
+ * @brief Implementation of OutputChain class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "OutputChain.h"
+
+// -----------------------------------------------------------------------------------------------
+
+OutputChain::OutputChain(int sampleRate):
+    heartbeat(sampleRate), outputStage(sampleRate), glitchDetector(sampleRate),
+    levelMeter(sampleRate) {
+}
+
+void OutputChain::callback(int64_t frame, int64_t timeNs, int frames) {
+    glitchDetector.callback(frame, timeNs, frames);
+}
+
+void OutputChain::process(int64_t frame, float *left, float *right, int frames) {
+    heartbeat.process(left, right, frames);
+    outputStage.process(left, right, frames);
+    // the output as heard, after the limiter: the stage delay is already in the samples
+    glitchDetector.process(frame, left, right, frames);
+    levelMeter.process(left, right, frames);
+}
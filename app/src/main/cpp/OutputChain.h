@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/OutputChain.h
+ * @brief Header of OutputChain class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_OUTPUTCHAIN_H
+#define ANDROID_MIDI_SYNTH_OUTPUTCHAIN_H
+
+#include <cstdint>
+
+#include "GlitchDetector.h"
+#include "HeartbeatEngine.h"
+#include "LevelMeter.h"
+#include "OutputStage.h"
+
+/** @brief Frames of a control block: the render loop splits each period in such blocks. */
+static const int kControlBlockFrames = 64;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief OutputChain class.
+ * @details The stages run on each control block after the synth, in this order: the
+ *          procedural heartbeat voices are mixed in, the output stage applies the gain and
+ *          the limiter, and the glitch detector and the level meter analyse the output as
+ *          heard. process() and callback() must be called by the render thread; the stages
+ *          may be configured from any thread, as documented by each of them.
+ */
+class OutputChain {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit OutputChain(int sampleRate);
+    /**
+     * @brief Start a render period (render thread, at the start of the callback).
+     * @param frame Audio frame of the period.
+     * @param timeNs Steady clock time of the callback, in nanoseconds.
+     * @param frames Frames of the period.
+     */
+    void callback(int64_t frame, int64_t timeNs, int frames);
+    /**
+     * @brief Run the stages on a block of the synth output, in place (render thread).
+     * @param frame Audio frame of the first sample.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames (up to kControlBlockFrames for the control rate).
+     */
+    void process(int64_t frame, float *left, float *right, int frames);
+    /**
+     * @brief Get the procedural heartbeat voices.
+     * @return The heartbeat engine.
+     */
+    HeartbeatEngine* getHeartbeat() { return &heartbeat; }
+    /**
+     * @brief Get the output stage (gain, limiter, dither).
+     * @return The output stage.
+     */
+    OutputStage* getOutputStage() { return &outputStage; }
+    /**
+     * @brief Get the glitch detector.
+     * @return The glitch detector.
+     */
+    GlitchDetector* getGlitchDetector() { return &glitchDetector; }
+    /**
+     * @brief Get the glitch detector.
+     * @return The glitch detector.
+     */
+    const GlitchDetector* getGlitchDetector() const { return &glitchDetector; }
+    /**
+     * @brief Get the level meter.
+     * @return The level meter.
+     */
+    LevelMeter* getLevelMeter() { return &levelMeter; }
+    /**
+     * @brief Get the level meter.
+     * @return The level meter.
+     */
+    const LevelMeter* getLevelMeter() const { return &levelMeter; }
+private:
+    /* @brief Procedural heartbeat voices. */
+    HeartbeatEngine heartbeat;
+    /* @brief Gain, limiter and 16-bit conversion of the output. */
+    OutputStage outputStage;
+    /* @brief Glitch detector of the output, after the output stage. */
+    GlitchDetector glitchDetector;
+    /* @brief Meter of the output levels. */
+    LevelMeter levelMeter;
+};
+
+#endif //ANDROID_MIDI_SYNTH_OUTPUTCHAIN_H
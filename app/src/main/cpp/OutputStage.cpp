@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/OutputStage.cpp
+ * @brief Output stage: smooth gain, look-ahead soft limiter and dithered 16-bit conversion.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define OUTPUT_STAGE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define OUTPUT_STAGE_X86
+#endif
+
+#include "OutputStage.h"
+
+/* @brief Peak level below which the limiter does not act. */
+static const float kOutputKnee = 0.5f;
+/* @brief Highest output level (leaves room for the dither below full scale). */
+static const float kOutputCeiling = 0.98f;
+/* @brief Time for the limiter gain to recover 63% of its reduction, in seconds. */
+static const float kOutputRelease = 0.1f;
+/* @brief Scale of a float sample to 16 bits. */
+static const float kS16Scale = 32768.0f;
+/* @brief Lowest 16-bit sample, as float. */
+static const float kS16Min = -32768.0f;
+/* @brief Highest 16-bit sample, as float. */
+static const float kS16Max = 32767.0f;
+
+/* @brief Kernels of an instruction set. */
+struct OutputKernels {
+    /* @brief dst[i] = src[i] * (gain + step * i); src may be dst. */
+    void (*ramp)(const float *src, float *dst, int frames, float gain, float step);
+    /* @brief Largest absolute value of two channels. */
+    float (*peak)(const float *left, const float *right, int frames);
+    /* @brief Add the noise, round and saturate to 16 bits, and scale back to float. */
+    void (*quantize)(float *samples, const float *noise, int frames);
+    /* @brief Add the noise, round and saturate to interleaved 16-bit samples. */
+    void (*toS16)(const float *left, const float *right, const float *noiseLeft,
+                  const float *noiseRight, int16_t *out, int frames);
+};
+
+// -----------------------------------------------------------------------------------------------
+// Portable C kernels (also the tails of the vector kernels)
+
+static void rampScalar(const float *src, float *dst, int frames, float gain, float step) {
+    for (int i = 0; i < frames; i++) dst[i] = src[i] * (gain + step * (float) i);
+}
+
+static float peakScalar(const float *left, const float *right, int frames) {
+    float peak = 0.0f;
+    for (int i = 0; i < frames; i++) {
+        peak = fmaxf(peak, fabsf(left[i]));
+        peak = fmaxf(peak, fabsf(right[i]));
+    }
+    return peak;
+}
+
+/* @brief Round and saturate a sample to 16 bits, with the noise added (in LSB). */
+static inline float roundS16(float sample, float noise) {
+    float value = sample * kS16Scale + noise;
+    value = fminf(fmaxf(value, kS16Min), kS16Max);
+    return nearbyintf(value);
+}
+
+static void quantizeScalar(float *samples, const float *noise, int frames) {
+    for (int i = 0; i < frames; i++) samples[i] = roundS16(samples[i], noise[i]) / kS16Scale;
+}
+
+static void toS16Scalar(const float *left, const float *right, const float *noiseLeft,
+                        const float *noiseRight, int16_t *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        out[2 * i] = (int16_t) roundS16(left[i], noiseLeft[i]);
+        out[2 * i + 1] = (int16_t) roundS16(right[i], noiseRight[i]);
+    }
+}
+
+static const OutputKernels kScalarKernels = {
+    rampScalar, peakScalar, quantizeScalar, toS16Scalar
+};
+
+// -----------------------------------------------------------------------------------------------
+// NEON kernels
+
+#ifdef OUTPUT_STAGE_NEON
+
+static void rampNeon(const float *src, float *dst, int frames, float gain, float step) {
+    static const float kIndex[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t index = vld1q_f32(kIndex);
+    float32x4_t vstep = vdupq_n_f32(step);
+    float32x4_t vgain = vdupq_n_f32(gain);
+    float32x4_t four = vdupq_n_f32(4.0f);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t g = vaddq_f32(vgain, vmulq_f32(vstep, index));
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), g));
+        index = vaddq_f32(index, four);
+    }
+    for (; i < frames; i++) dst[i] = src[i] * (gain + step * (float) i);
+}
+
+static float peakNeon(const float *left, const float *right, int frames) {
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(left + i)));
+        peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(right + i)));
+    }
+    float result = vmaxvq_f32(peak);
+    return fmaxf(result, peakScalar(left + i, right + i, frames - i));
+}
+
+/* @brief Round and saturate 4 samples to 16 bits, with the noise added (in LSB). */
+static inline int32x4_t roundS16Neon(float32x4_t samples, float32x4_t noise) {
+    float32x4_t value = vaddq_f32(vmulq_n_f32(samples, kS16Scale), noise);
+    value = vminq_f32(vmaxq_f32(value, vdupq_n_f32(kS16Min)), vdupq_n_f32(kS16Max));
+    return vcvtnq_s32_f32(value);
+}
+
+static void quantizeNeon(float *samples, const float *noise, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int32x4_t value = roundS16Neon(vld1q_f32(samples + i), vld1q_f32(noise + i));
+        vst1q_f32(samples + i, vmulq_n_f32(vcvtq_f32_s32(value), 1.0f / kS16Scale));
+    }
+    quantizeScalar(samples + i, noise + i, frames - i);
+}
+
+static void toS16Neon(const float *left, const float *right, const float *noiseLeft,
+                      const float *noiseRight, int16_t *out, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int16x4x2_t value;
+        value.val[0] = vmovn_s32(roundS16Neon(vld1q_f32(left + i), vld1q_f32(noiseLeft + i)));
+        value.val[1] = vmovn_s32(roundS16Neon(vld1q_f32(right + i), vld1q_f32(noiseRight + i)));
+        vst2_s16(out + 2 * i, value);
+    }
+    toS16Scalar(left + i, right + i, noiseLeft + i, noiseRight + i, out + 2 * i, frames - i);
+}
+
+static const OutputKernels kNeonKernels = {
+    rampNeon, peakNeon, quantizeNeon, toS16Neon
+};
+
+#endif // OUTPUT_STAGE_NEON
+
+// -----------------------------------------------------------------------------------------------
+// SSE2 kernels
+
+#ifdef OUTPUT_STAGE_X86
+
+static void rampSse2(const float *src, float *dst, int frames, float gain, float step) {
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 vstep = _mm_set1_ps(step);
+    __m128 vgain = _mm_set1_ps(gain);
+    __m128 four = _mm_set1_ps(4.0f);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 g = _mm_add_ps(vgain, _mm_mul_ps(vstep, index));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        index = _mm_add_ps(index, four);
+    }
+    for (; i < frames; i++) dst[i] = src[i] * (gain + step * (float) i);
+}
+
+static float peakSse2(const float *left, const float *right, int frames) {
+    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(left + i), mask));
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(right + i), mask));
+    }
+    peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+    peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 1));
+    return fmaxf(_mm_cvtss_f32(peak), peakScalar(left + i, right + i, frames - i));
+}
+
+/* @brief Round and saturate 4 samples to 16 bits, with the noise added (in LSB). */
+static inline __m128i roundS16Sse2(__m128 samples, __m128 noise) {
+    __m128 value = _mm_add_ps(_mm_mul_ps(samples, _mm_set1_ps(kS16Scale)), noise);
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(kS16Min)), _mm_set1_ps(kS16Max));
+    // rounds to nearest even (default MXCSR mode), as nearbyintf()
+    return _mm_cvtps_epi32(value);
+}
+
+static void quantizeSse2(float *samples, const float *noise, int frames) {
+    __m128 scale = _mm_set1_ps(1.0f / kS16Scale);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i value = roundS16Sse2(_mm_loadu_ps(samples + i), _mm_loadu_ps(noise + i));
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+    }
+    quantizeScalar(samples + i, noise + i, frames - i);
+}
+
+/* @brief Interleave 4 left and 4 right samples (32 bits) to 8 samples of 16 bits. */
+static inline __m128i interleaveS16Sse2(__m128i left, __m128i right) {
+    __m128i packed = _mm_packs_epi32(left, right);
+    return _mm_unpacklo_epi16(packed, _mm_unpackhi_epi64(packed, packed));
+}
+
+static void toS16Sse2(const float *left, const float *right, const float *noiseLeft,
+                      const float *noiseRight, int16_t *out, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i l = roundS16Sse2(_mm_loadu_ps(left + i), _mm_loadu_ps(noiseLeft + i));
+        __m128i r = roundS16Sse2(_mm_loadu_ps(right + i), _mm_loadu_ps(noiseRight + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), interleaveS16Sse2(l, r));
+    }
+    toS16Scalar(left + i, right + i, noiseLeft + i, noiseRight + i, out + 2 * i, frames - i);
+}
+
+static const OutputKernels kSse2Kernels = {
+    rampSse2, peakSse2, quantizeSse2, toS16Sse2
+};
+
+// -----------------------------------------------------------------------------------------------
+// AVX2 kernels (compiled for AVX2 whatever the target, selected only if the CPU has it)
+
+#define OUTPUT_STAGE_AVX2 __attribute__((target("avx2")))
+
+OUTPUT_STAGE_AVX2
+static void rampAvx2(const float *src, float *dst, int frames, float gain, float step) {
+    __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 vstep = _mm256_set1_ps(step);
+    __m256 vgain = _mm256_set1_ps(gain);
+    __m256 eight = _mm256_set1_ps(8.0f);
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 g = _mm256_add_ps(vgain, _mm256_mul_ps(vstep, index));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+        index = _mm256_add_ps(index, eight);
+    }
+    for (; i < frames; i++) dst[i] = src[i] * (gain + step * (float) i);
+}
+
+OUTPUT_STAGE_AVX2
+static float peakAvx2(const float *left, const float *right, int frames) {
+    __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peak = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(left + i), mask));
+        peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(right + i), mask));
+    }
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    return fmaxf(_mm_cvtss_f32(half), peakScalar(left + i, right + i, frames - i));
+}
+
+/* @brief Round and saturate 8 samples to 16 bits, with the noise added (in LSB). */
+OUTPUT_STAGE_AVX2
+static inline __m256i roundS16Avx2(__m256 samples, __m256 noise) {
+    __m256 value = _mm256_add_ps(_mm256_mul_ps(samples, _mm256_set1_ps(kS16Scale)), noise);
+    value = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(kS16Min)),
+                          _mm256_set1_ps(kS16Max));
+    return _mm256_cvtps_epi32(value);
+}
+
+OUTPUT_STAGE_AVX2
+static void quantizeAvx2(float *samples, const float *noise, int frames) {
+    __m256 scale = _mm256_set1_ps(1.0f / kS16Scale);
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i value = roundS16Avx2(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(noise + i));
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_cvtepi32_ps(value), scale));
+    }
+    quantizeScalar(samples + i, noise + i, frames - i);
+}
+
+OUTPUT_STAGE_AVX2
+static void toS16Avx2(const float *left, const float *right, const float *noiseLeft,
+                      const float *noiseRight, int16_t *out, int frames) {
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i l = roundS16Avx2(_mm256_loadu_ps(left + i), _mm256_loadu_ps(noiseLeft + i));
+        __m256i r = roundS16Avx2(_mm256_loadu_ps(right + i), _mm256_loadu_ps(noiseRight + i));
+        // packing works on 128-bit lanes: interleave each half as SSE2 does
+        __m128i low = interleaveS16Sse2(_mm256_castsi256_si128(l), _mm256_castsi256_si128(r));
+        __m128i high = interleaveS16Sse2(_mm256_extracti128_si256(l, 1),
+                                         _mm256_extracti128_si256(r, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 8), high);
+    }
+    toS16Scalar(left + i, right + i, noiseLeft + i, noiseRight + i, out + 2 * i, frames - i);
+}
+
+static const OutputKernels kAvx2Kernels = {
+    rampAvx2, peakAvx2, quantizeAvx2, toS16Avx2
+};
+
+#endif // OUTPUT_STAGE_X86
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief Get the kernels of an instruction set, or nullptr if not available. */
+static const OutputKernels* getKernels(int isa) {
+    switch (isa) {
+        case kOutputIsa_Scalar:
+            return &kScalarKernels;
+#ifdef OUTPUT_STAGE_NEON
+        case kOutputIsa_Neon:
+            return &kNeonKernels;
+#endif
+#ifdef OUTPUT_STAGE_X86
+        case kOutputIsa_Sse2:
+            return &kSse2Kernels;
+        case kOutputIsa_Avx2:
+            return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+OutputStage::OutputStage(int sampleRate):
+    kernels(&kScalarKernels), isa(kOutputIsa_Scalar), dither(true), minLimiterGain(1.0f) {
+    for (int i = kOutputIsaCount - 1; i > kOutputIsa_Scalar; i--) {
+        if (setIsa(i)) break;
+    }
+    releaseCoef = 1.0f - expf(-kOutputSubBlockFrames / (kOutputRelease * sampleRate));
+    gain.reset(1.0f);
+    for (int i = 0; i < kNoiseLanes; i++) noiseState[i] = 0x9E3779B9u * (i + 1);
+    reset();
+}
+
+bool OutputStage::isSupported(int isa) {
+    return getKernels(isa) != nullptr;
+}
+
+bool OutputStage::setIsa(int isa) {
+    const OutputKernels *selected = getKernels(isa);
+    if (selected == nullptr) return false;
+    kernels = selected;
+    this->isa = isa;
+    return true;
+}
+
+void OutputStage::setGain(float gain, int rampFrames) {
+    this->gain.setRampFrames(rampFrames);
+    this->gain.setTarget(gain);
+}
+
+void OutputStage::reset() {
+    memset(ringLeft, 0, sizeof(ringLeft));
+    memset(ringRight, 0, sizeof(ringRight));
+    for (int i = 0; i < kRingBlocks; i++) {
+        peak[i] = 0.0f;
+        required[i] = 1.0f;
+    }
+    // the output starts a look-ahead behind the input, on the (silent) ring
+    writePos = kOutputLookAheadFrames;
+    limiterGain = 1.0f;
+    limiterTarget = 1.0f;
+}
+
+void OutputStage::process(float *left, float *right, int frames) {
+    for (int offset = 0; offset < frames; offset += kChunkFrames) {
+        int count = frames - offset;
+        if (count > kChunkFrames) count = kChunkFrames;
+        processChunk(left + offset, right + offset, count);
+    }
+}
+
+void OutputStage::processChunk(float *left, float *right, int frames) {
+    float gainStart = gain.getValue();
+    float gainStep = (gain.process(frames) - gainStart) / frames;
+    kernels->ramp(left, left, frames, gainStart, gainStep);
+    kernels->ramp(right, right, frames, gainStart, gainStep);
+    // input: into the ring, measuring the peak of each sub-block
+    for (int done = 0; done < frames;) {
+        int pos = (int) (writePos & (kRingFrames - 1));
+        int block = pos / kOutputSubBlockFrames;
+        int run = kOutputSubBlockFrames - pos % kOutputSubBlockFrames;
+        if (run > frames - done) run = frames - done;
+        memcpy(ringLeft + pos, left + done, run * sizeof(float));
+        memcpy(ringRight + pos, right + done, run * sizeof(float));
+        peak[block] = fmaxf(peak[block], kernels->peak(left + done, right + done, run));
+        writePos += run;
+        done += run;
+        if (writePos % kOutputSubBlockFrames != 0) continue;
+        // sub-block complete: a tanh knee maps the peak to at most the ceiling
+        float level = peak[block];
+        float range = kOutputCeiling - kOutputKnee;
+        required[block] = level <= kOutputKnee ? 1.0f :
+                (kOutputKnee + range * tanhf((level - kOutputKnee) / range)) / level;
+        peak[(block + 1) & (kRingBlocks - 1)] = 0.0f;
+    }
+    // output: from the ring, a look-ahead behind, with the limiter gain ramp
+    int64_t readPos = writePos - frames - kOutputLookAheadFrames;
+    float lowest = 1.0f;
+    for (int done = 0; done < frames;) {
+        int offset = (int) (readPos % kOutputSubBlockFrames);
+        if (offset == 0) {
+            limiterGain = limiterTarget;
+            limiterTarget = nextLimiterGain(readPos / kOutputSubBlockFrames);
+            lowest = fminf(lowest, fminf(limiterGain, limiterTarget));
+        }
+        int pos = (int) (readPos & (kRingFrames - 1));
+        int run = kOutputSubBlockFrames - offset;
+        if (run > frames - done) run = frames - done;
+        float step = (limiterTarget - limiterGain) / kOutputSubBlockFrames;
+        float start = limiterGain + step * offset;
+        kernels->ramp(ringLeft + pos, left + done, run, start, step);
+        kernels->ramp(ringRight + pos, right + done, run, start, step);
+        readPos += run;
+        done += run;
+    }
+    if (lowest < 1.0f && lowest < minLimiterGain.load(std::memory_order_relaxed)) {
+        minLimiterGain.store(lowest, std::memory_order_relaxed);
+    }
+    if (!dither.load(std::memory_order_relaxed)) return;
+    alignas(32) float noise[kChunkFrames];
+    fillNoise(noise, frames);
+    kernels->quantize(left, noise, frames);
+    fillNoise(noise, frames);
+    kernels->quantize(right, noise, frames);
+}
+
+float OutputStage::nextLimiterGain(int64_t block) {
+    // the gain at the boundary of two sub-blocks must not exceed what both require; the
+    // gain is ramped linearly towards each requirement of the look-ahead, so it reaches it
+    // at its boundary, and recovers exponentially once the requirements go up
+    float result = limiterGain + (1.0f - limiterGain) * releaseCoef;
+    for (int k = 0; k < kOutputLookAheadBlocks - 1; k++) {
+        int64_t boundary = block + 1 + k;
+        float req = fminf(required[(boundary - 1) & (kRingBlocks - 1)],
+                          required[boundary & (kRingBlocks - 1)]);
+        result = fminf(result, limiterGain + (req - limiterGain) / (k + 1));
+    }
+    return result;
+}
+
+void OutputStage::fillNoise(float *noise, int frames) {
+    // lanes of xorshift32; the difference of the two 16-bit halves is triangular (TPDF),
+    // within +-1 LSB
+    for (int i = 0; i < frames; i += kNoiseLanes) {
+        for (int lane = 0; lane < kNoiseLanes; lane++) {
+            uint32_t x = noiseState[lane];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            noiseState[lane] = x;
+            noise[i + lane] = ((int32_t) (x & 0xFFFF) - (int32_t) (x >> 16)) / 65536.0f;
+        }
+    }
+}
+
+void OutputStage::convert(const float *left, const float *right, int16_t *out, int frames) {
+    alignas(32) float noiseLeft[kChunkFrames];
+    alignas(32) float noiseRight[kChunkFrames];
+    for (int offset = 0; offset < frames; offset += kChunkFrames) {
+        int count = frames - offset;
+        if (count > kChunkFrames) count = kChunkFrames;
+        fillNoise(noiseLeft, count);
+        fillNoise(noiseRight, count);
+        kernels->toS16(left + offset, right + offset, noiseLeft, noiseRight,
+                       out + 2 * offset, count);
+    }
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/OutputStage.h
+ * @brief Output stage: smooth gain, look-ahead soft limiter and dithered 16-bit conversion.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_OUTPUTSTAGE_H
+#define ANDROID_MIDI_SYNTH_OUTPUTSTAGE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "ParamSmoother.h"
+
+/** @brief Instruction sets of the output stage kernels. */
+enum OutputIsa {
+    /** @brief Portable C. */
+    kOutputIsa_Scalar = 0,
+    /** @brief ARM NEON (AArch64). */
+    kOutputIsa_Neon   = 1,
+    /** @brief x86 SSE2. */
+    kOutputIsa_Sse2   = 2,
+    /** @brief x86 AVX2 (detected at run time). */
+    kOutputIsa_Avx2   = 3,
+    /** @brief Number of instruction sets. */
+    kOutputIsaCount   = 4,
+};
+
+/** @brief Frames of a limiter sub-block (the limiter gain is ramped across each one). */
+static const int kOutputSubBlockFrames = 16;
+/** @brief Look-ahead of the limiter, in sub-blocks. */
+static const int kOutputLookAheadBlocks = 4;
+/** @brief Look-ahead of the limiter (the latency added to the output), in frames. */
+static const int kOutputLookAheadFrames = kOutputSubBlockFrames * kOutputLookAheadBlocks;
+
+/* @brief Kernels of an instruction set (OutputStage.cpp). */
+struct OutputKernels;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief OutputStage class.
+ * @details Post-processing of the stereo render output, so the synth can run at full gain:
+ *          - a gain ramped per frame (ParamSmoother), so gain changes do not click;
+ *          - a look-ahead soft limiter: the peak of each sub-block maps to a gain through
+ *            a tanh knee, and the gain is ramped linearly between sub-blocks, starting
+ *            early enough (look-ahead) to be below the gain of every sub-block it crosses.
+ *            The output is delayed by kOutputLookAheadFrames;
+ *          - TPDF dither and conversion to 16 bits, converted back to float so the device
+ *            conversion (Oboe/AAudio) of a 16-bit stream is exact.
+ *          The kernels are written for NEON, SSE2 and AVX2, with a portable C fallback;
+ *          the best one available is selected by the constructor. The dither noise is
+ *          generated by common code, so every kernel gives the same output (up to the
+ *          rounding of fused multiply-adds). process() must be called by the render thread;
+ *          the gain and the dither switch may be set from any thread.
+ */
+class OutputStage {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit OutputStage(int sampleRate);
+    /**
+     * @brief Check if an instruction set is available on this device.
+     * @param isa The instruction set (OutputIsa).
+     * @return True if available.
+     */
+    static bool isSupported(int isa);
+    /**
+     * @brief Select the kernels of an instruction set.
+     * @details Not thread safe: call it before the stage is published to the render thread.
+     * @param isa The instruction set (OutputIsa).
+     * @return True if successful. False if the instruction set is not available.
+     */
+    bool setIsa(int isa);
+    /**
+     * @brief Get the instruction set of the selected kernels.
+     * @return The instruction set (OutputIsa).
+     */
+    int getIsa() const { return isa; }
+    /**
+     * @brief Set the gain applied before the limiter.
+     * @param gain Linear gain.
+     * @param rampFrames Ramp duration, in frames.
+     */
+    void setGain(float gain, int rampFrames);
+    /**
+     * @brief Enable the dither and 16-bit conversion of the output.
+     * @param enabled True to convert the output to 16 bits (default), false to keep floats.
+     */
+    void setDither(bool enabled) { dither.store(enabled, std::memory_order_relaxed); }
+    /**
+     * @brief Get the lowest limiter gain since the last call.
+     * @return Linear gain (1 if the limiter did not act).
+     */
+    float takeLimiterGain() { return minLimiterGain.exchange(1.0f); }
+    /**
+     * @brief Process a stereo block in place (render thread).
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    void process(float *left, float *right, int frames);
+    /**
+     * @brief Dither and convert a stereo block to interleaved 16-bit samples.
+     * @details Does not apply the gain nor the limiter. Same thread as process().
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param out Receives 2 * frames interleaved samples.
+     * @param frames Number of frames.
+     */
+    void convert(const float *left, const float *right, int16_t *out, int frames);
+    /** @brief Clear the look-ahead delay and the limiter state (render thread). */
+    void reset();
+private:
+    /* @brief Frames processed at once (the ring must hold them beyond the look-ahead). */
+    static const int kChunkFrames = 64;
+    /* @brief Frames of the delay ring (power of two, multiple of the sub-block). */
+    static const int kRingFrames = 256;
+    /* @brief Sub-blocks of the delay ring. */
+    static const int kRingBlocks = kRingFrames / kOutputSubBlockFrames;
+    /* @brief Independent lanes of the noise generator. */
+    static const int kNoiseLanes = 4;
+    /* @brief Process up to kChunkFrames frames in place. */
+    void processChunk(float *left, float *right, int frames);
+    /* @brief Compute the limiter gain at the end of the next output sub-block. */
+    float nextLimiterGain(int64_t block);
+    /* @brief Fill a buffer with TPDF noise, in LSB.
+     * @param frames Number of values (rounded up to a multiple of kNoiseLanes). */
+    void fillNoise(float *noise, int frames);
+private:
+    /* @brief Kernels of the selected instruction set. */
+    const OutputKernels *kernels;
+    /* @brief Selected instruction set (OutputIsa). */
+    int isa;
+    /* @brief Gain ramp. */
+    ParamSmoother gain;
+    /* @brief True to dither and convert the output to 16 bits (written by any thread). */
+    std::atomic<bool> dither;
+    /* @brief Lowest limiter gain since the last read. */
+    std::atomic<float> minLimiterGain;
+    /* @brief Gain added back per sub-block once the peaks go down (release). */
+    float releaseCoef;
+    /* @brief Look-ahead delay, left channel. */
+    alignas(32) float ringLeft[kRingFrames];
+    /* @brief Look-ahead delay, right channel. */
+    alignas(32) float ringRight[kRingFrames];
+    /* @brief Peak of each sub-block of the ring. */
+    float peak[kRingBlocks];
+    /* @brief Limiter gain required by each complete sub-block of the ring. */
+    float required[kRingBlocks];
+    /* @brief Frames written to the ring so far. */
+    int64_t writePos;
+    /* @brief Limiter gain at the start of the current output sub-block. */
+    float limiterGain;
+    /* @brief Limiter gain at the end of the current output sub-block. */
+    float limiterTarget;
+    /* @brief State of the noise generator (xorshift32 lanes). */
+    uint32_t noiseState[kNoiseLanes];
+};
+
+#endif //ANDROID_MIDI_SYNTH_OUTPUTSTAGE_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ParamSmoother.cpp
+ * @brief Implementation of ParamSmoother class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include "ParamSmoother.h"
+
+// -----------------------------------------------------------------------------------------------
+
+ParamSmoother::ParamSmoother():
+    target(0.0f), rampFrames(0), current(0.0f), rampTarget(0.0f), step(0.0f), remaining(0) {
+}
+
+void ParamSmoother::setRampFrames(int frames) {
+    rampFrames.store(frames < 0 ? 0 : frames, std::memory_order_relaxed);
+}
+
+void ParamSmoother::setTarget(float value) {
+    target.store(value, std::memory_order_relaxed);
+}
+
+void ParamSmoother::reset(float value) {
+    target.store(value, std::memory_order_relaxed);
+    current = value;
+    rampTarget = value;
+    step = 0.0f;
+    remaining = 0;
+}
+
+float ParamSmoother::process(int frames) {
+    float newTarget = target.load(std::memory_order_relaxed);
+    if (newTarget != rampTarget) {
+        // start a new ramp from where we are now
+        rampTarget = newTarget;
+        remaining = rampFrames.load(std::memory_order_relaxed);
+        if (remaining > 0) {
+            step = (rampTarget - current) / remaining;
+        } else {
+            current = rampTarget;
+        }
+    }
+    if (remaining > 0) {
+        if (frames >= remaining) {
+            current = rampTarget;
+            remaining = 0;
+        } else {
+            current += step * frames;
+            remaining -= frames;
+        }
+    }
+    return current;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/ParamSmoother.h
+ * @brief Header of ParamSmoother class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_PARAMSMOOTHER_H
+#define ANDROID_MIDI_SYNTH_PARAMSMOOTHER_H
+
+#include <atomic>
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief ParamSmoother class.
+ * @details Linear ramp from the current value to a target value, advanced at control rate
+ *          by the render thread. Retargeting starts a new ramp from the current value, so
+ *          the output never jumps. Target and ramp time may be set from any thread.
+ */
+class ParamSmoother {
+public:
+    /** @brief Constructor. */
+    ParamSmoother();
+    /**
+     * @brief Set the ramp duration used for the next target changes.
+     * @param frames Ramp duration, in audio frames (0 jumps immediately).
+     */
+    void setRampFrames(int frames);
+    /**
+     * @brief Set the value to ramp to.
+     * @param value Target value.
+     */
+    void setTarget(float value);
+    /**
+     * @brief Jump to a value, cancelling any ramp in progress.
+     * @details Not thread safe: call it before the smoother is published to the render thread.
+     * @param value New value.
+     */
+    void reset(float value);
+    /**
+     * @brief Advance the ramp (render thread).
+     * @param frames Number of audio frames elapsed.
+     * @return The current value.
+     */
+    float process(int frames);
+    /**
+     * @brief Get the current value (render thread).
+     * @return The current value.
+     */
+    float getValue() const { return current; }
+private:
+    /* @brief Value to ramp to (written by any thread). */
+    std::atomic<float> target;
+    /* @brief Ramp duration, in frames (written by any thread). */
+    std::atomic<int> rampFrames;
+    /* @brief Current value. */
+    float current;
+    /* @brief End value of the ramp in progress. */
+    float rampTarget;
+    /* @brief Increment per frame of the ramp in progress. */
+    float step;
+    /* @brief Frames left in the ramp in progress. */
+    int remaining;
+};
+
+#endif //ANDROID_MIDI_SYNTH_PARAMSMOOTHER_H
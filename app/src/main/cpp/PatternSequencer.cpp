@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/PatternSequencer.cpp
+ * @brief Implementation of PatternSequencer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "MidiSpec.h"
+#include "PatternSequencer.h"
+
+/* @brief Maximum length of a line of the text format. */
+static const int kSequencerLineSize = 128;
+
+/* @brief Read a 16-bit little endian value. */
+static int readU16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+PatternSequencer::PatternSequencer(): velocityScale(1.0f) {
+    clear();
+}
+
+void PatternSequencer::clear() {
+    noteCount = 0;
+    trackCount = 0;
+}
+
+void PatternSequencer::rewind() {
+    for (int i = 0; i < trackCount; i++) {
+        trackPosition[i] = 0;
+        trackCursor[i] = 0;
+    }
+}
+
+int PatternSequencer::addTrack(int length) {
+    if (trackCount == kSequencerMaxTracks || length <= 0 || length > UINT16_MAX) return -1;
+    trackFirst[trackCount] = noteCount;
+    trackNotes[trackCount] = 0;
+    trackLength[trackCount] = length;
+    trackPosition[trackCount] = 0;
+    trackCursor[trackCount] = 0;
+    return trackCount++;
+}
+
+bool PatternSequencer::addNote(int step, int note, int velocity, int duration, int chan) {
+    if (trackCount == 0 || noteCount == kSequencerMaxNotes) return false;
+    int track = trackCount - 1;
+    if (step < 0 || step >= trackLength[track] || note < 0 || note > 127 ||
+            velocity < 1 || velocity > 127 || duration < 1 || duration > UINT16_MAX ||
+            chan < 0 || chan > 15) return false;
+    // keep the notes of a track in step order
+    if (trackNotes[track] > 0 && noteStep[noteCount - 1] > step) return false;
+    noteStep[noteCount] = (uint16_t) step;
+    noteNumber[noteCount] = (uint8_t) note;
+    noteVelocity[noteCount] = (uint8_t) velocity;
+    noteDuration[noteCount] = (uint16_t) duration;
+    noteChannel[noteCount] = (uint8_t) chan;
+    noteCount++;
+    trackNotes[track]++;
+    return true;
+}
+
+bool PatternSequencer::load(const uint8_t *data, int length) {
+    clear();
+    bool result = (length >= 4 && memcmp(data, kSequencerMagic, 4) == 0)
+            ? loadBinary(data, length)
+            : loadText((const char *) data, length);
+    if (!result) clear();
+    return result;
+}
+
+bool PatternSequencer::loadBinary(const uint8_t *data, int length) {
+    if (length < 6 || data[4] != kSequencerVersion) return false;
+    int tracks = data[5];
+    int pos = 6;
+    for (int t = 0; t < tracks; t++) {
+        if (pos + 4 > length) return false;
+        int notes = readU16(data + pos + 2);
+        if (addTrack(readU16(data + pos)) < 0) return false;
+        pos += 4;
+        if (pos + notes * 7 > length) return false;
+        for (int i = 0; i < notes; i++, pos += 7) {
+            const uint8_t *note = data + pos;
+            if (!addNote(readU16(note), note[2], note[3], readU16(note + 4), note[6])) {
+                return false;
+            }
+        }
+    }
+    return pos == length;
+}
+
+bool PatternSequencer::loadText(const char *text, int length) {
+    char line[kSequencerLineSize];
+    int pos = 0;
+    while (pos < length) {
+        // copy a line (without allocating)
+        int size = 0;
+        while (pos < length && text[pos] != '\n') {
+            if (size < kSequencerLineSize - 1) line[size++] = text[pos];
+            pos++;
+        }
+        pos++;
+        line[size] = '\0';
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        int values[5];
+        if (sscanf(line, " track %d", &values[0]) == 1) {
+            if (addTrack(values[0]) < 0) return false;
+        } else if (sscanf(line, "%d %d %d %d %d", &values[0], &values[1], &values[2],
+                          &values[3], &values[4]) == 5) {
+            if (!addNote(values[0], values[1], values[2], values[3], values[4])) return false;
+        } else {
+            // anything else must be a blank line
+            for (char *c = line; *c; c++) if (*c != ' ' && *c != '\t' && *c != '\r') return false;
+        }
+    }
+    return trackCount > 0;
+}
+
+int PatternSequencer::step(int64_t frame, double framesPerStep, MidiEventQueue &queue) {
+    int events = 0;
+    for (int t = 0; t < trackCount; t++) {
+        int position = trackPosition[t];
+        int first = trackFirst[t];
+        int cursor = trackCursor[t];
+        // notes of this step are contiguous from the cursor
+        while (cursor < trackNotes[t] && noteStep[first + cursor] == position) {
+            int i = first + cursor++;
+            // a note on is only queued with its note off
+            if (queue.size() + 2 > kMidiEventQueueSize) continue;
+            long velocity = lroundf(noteVelocity[i] * velocityScale);
+            if (velocity < 1) velocity = 1;
+            if (velocity > 127) velocity = 127;
+            int64_t end = frame + (int64_t) (noteDuration[i] * framesPerStep);
+            uint8_t chan = noteChannel[i];
+            queue.push({ frame, (uint8_t) ((kMIDIChanCmd_NoteOn << 4) | chan),
+                         noteNumber[i], (uint8_t) velocity, true });
+            queue.push({ end, (uint8_t) ((kMIDIChanCmd_NoteOff << 4) | chan),
+                         noteNumber[i], 0, true });
+            events += 2;
+        }
+        if (++position == trackLength[t]) {
+            position = 0;
+            cursor = 0;
+        }
+        trackPosition[t] = position;
+        trackCursor[t] = cursor;
+    }
+    return events;
+}
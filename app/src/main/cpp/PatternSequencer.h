@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/PatternSequencer.h
+ * @brief Header of PatternSequencer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_PATTERNSEQUENCER_H
+#define ANDROID_MIDI_SYNTH_PATTERNSEQUENCER_H
+
+#include <cstdint>
+
+#include "MidiEventQueue.h"
+
+/** @brief Maximum number of tracks of a pattern. */
+static const int kSequencerMaxTracks = 16;
+/** @brief Maximum number of notes of a pattern (all the tracks). */
+static const int kSequencerMaxNotes = 4096;
+/** @brief Magic number of the binary pattern format. */
+static const char kSequencerMagic[] = "HBSQ";
+/** @brief Version of the binary pattern format. */
+static const int kSequencerVersion = 1;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief PatternSequencer class.
+ * @details Plays patterns of looping tracks, one step at a time. The notes are stored as
+ *          packed arrays (structure of arrays), sorted by track and step, so a step only reads
+ *          the notes it plays. Each step emits note on/off events into a MidiEventQueue (flagged
+ *          for the MIDI outputs), without allocating memory. Not thread safe.
+ *
+ *          Text format (one directive per line, '#' starts a comment):
+ *          @code
+ *          track <length in steps>
+ *          <step> <note> <velocity> <duration in steps> <channel>
+ *          @endcode
+ *          Binary format (little endian): magic "HBSQ", u8 version, u8 number of tracks, then
+ *          for each track: u16 length, u16 number of notes, and 7 bytes per note: u16 step,
+ *          u8 note, u8 velocity, u16 duration, u8 channel.
+ */
+class PatternSequencer {
+public:
+    /** @brief Constructor. */
+    PatternSequencer();
+    /** @brief Remove all the tracks. */
+    void clear();
+    /**
+     * @brief Load a pattern (binary or text format, detected from the magic number).
+     * @details Replaces the current pattern. On error, the sequencer is left empty.
+     * @param data Pattern data.
+     * @param length Length of the data, in bytes.
+     * @return True if successful. False otherwise.
+     */
+    bool load(const uint8_t *data, int length);
+    /**
+     * @brief Add a track.
+     * @param length Length of the track, in steps.
+     * @return Index of the track, or -1 on error.
+     */
+    int addTrack(int length);
+    /**
+     * @brief Add a note to the last track.
+     * @details Notes must be added in step order.
+     * @param step Step of the note (0 to the track length - 1).
+     * @param note Note number.
+     * @param velocity Velocity (1-127).
+     * @param duration Duration, in steps.
+     * @param chan Channel number.
+     * @return True if successful. False otherwise.
+     */
+    bool addNote(int step, int note, int velocity, int duration, int chan);
+    /** @brief Go back to the first step of every track. */
+    void rewind();
+    /**
+     * @brief Set the velocity scale.
+     * @param scale Factor applied to the velocities of the pattern.
+     */
+    void setVelocityScale(float scale) { velocityScale = scale; }
+    /**
+     * @brief Play the current step of every track and advance.
+     * @param frame Audio frame of the step.
+     * @param framesPerStep Duration of a step, in audio frames.
+     * @param queue Receives the note on/off events.
+     * @return The number of events emitted.
+     */
+    int step(int64_t frame, double framesPerStep, MidiEventQueue &queue);
+    /**
+     * @brief Get the number of tracks.
+     * @return The number of tracks.
+     */
+    int getTrackCount() const { return trackCount; }
+private:
+    /* @brief Parse the text format. */
+    bool loadText(const char *text, int length);
+    /* @brief Parse the binary format. */
+    bool loadBinary(const uint8_t *data, int length);
+private:
+    /* @brief Step of each note. */
+    uint16_t noteStep[kSequencerMaxNotes];
+    /* @brief Note number of each note. */
+    uint8_t noteNumber[kSequencerMaxNotes];
+    /* @brief Velocity of each note. */
+    uint8_t noteVelocity[kSequencerMaxNotes];
+    /* @brief Duration of each note, in steps. */
+    uint16_t noteDuration[kSequencerMaxNotes];
+    /* @brief Channel of each note. */
+    uint8_t noteChannel[kSequencerMaxNotes];
+    /* @brief Number of notes. */
+    int noteCount;
+    /* @brief Index of the first note of each track. */
+    int trackFirst[kSequencerMaxTracks];
+    /* @brief Number of notes of each track. */
+    int trackNotes[kSequencerMaxTracks];
+    /* @brief Length of each track, in steps. */
+    int trackLength[kSequencerMaxTracks];
+    /* @brief Current step of each track. */
+    int trackPosition[kSequencerMaxTracks];
+    /* @brief Next note of each track (relative to the first note). */
+    int trackCursor[kSequencerMaxTracks];
+    /* @brief Number of tracks. */
+    int trackCount;
+    /* @brief Factor applied to the velocities. */
+    float velocityScale;
+};
+
+#endif //ANDROID_MIDI_SYNTH_PATTERNSEQUENCER_H
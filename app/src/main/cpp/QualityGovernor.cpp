@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/QualityGovernor.cpp
+ * @brief Quality tiers of the synth and their automatic selection from the CPU load.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <fluidsynth.h>
+
+#include "QualityGovernor.h"
+
+/* @brief Length of a load window, in seconds. */
+static const double kQualityWindowSeconds = 0.5;
+/* @brief Mean load of a window that steps down. */
+static const float kQualityStepDownLoad = 0.5f;
+/* @brief Load of a single period that steps down (close to an underrun). */
+static const float kQualityPeakLoad = 0.85f;
+/* @brief Mean load of a window under which the tier may step up. */
+static const float kQualityStepUpLoad = 0.2f;
+/* @brief Quiet time before stepping up, in seconds. */
+static const int kQualityHoldSeconds = 10;
+/* @brief Longest quiet time before stepping up, in seconds. */
+static const int kQualityMaxHoldSeconds = 160;
+
+/* @brief Settings of the tiers, indexed by QualityTier. */
+static const QualitySettings kQualitySettings[kQualityTierCount] = {
+    /* Eco */      { FLUID_INTERP_LINEAR,    16, false, false, 1 },
+    /* Balanced */ { FLUID_INTERP_4THORDER,  48, true,  false, 2 },
+    /* High */     { FLUID_INTERP_4THORDER, 256, true,  true,  4 },
+};
+
+/* @brief Number of windows in a time span. */
+static int windowsIn(int seconds) {
+    return (int) (seconds / kQualityWindowSeconds);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+QualityGovernor::QualityGovernor(int sampleRate, int tier):
+    sampleRate(sampleRate), tier(tier), ceiling(tier), quietWindows(0),
+    holdWindows(windowsIn(kQualityHoldSeconds)),
+    windowsSinceStepUp(windowsIn(kQualityMaxHoldSeconds)), requestedTier(-1),
+    automatic(false), sharedTier(tier), sharedLoad(0.0f) {
+    resetWindow();
+}
+
+const QualitySettings &QualityGovernor::getSettings(int tier) {
+    if (tier < 0) tier = 0;
+    if (tier >= kQualityTierCount) tier = kQualityTierCount - 1;
+    return kQualitySettings[tier];
+}
+
+bool QualityGovernor::setTier(int tier, bool automatic) {
+    if (tier < 0 || tier >= kQualityTierCount) return false;
+    this->automatic.store(automatic, std::memory_order_relaxed);
+    requestedTier.store(tier, std::memory_order_release);
+    return true;
+}
+
+void QualityGovernor::resetWindow() {
+    windowRenderNs = 0;
+    windowPeriodNs = 0;
+    windowPeak = 0.0f;
+}
+
+int QualityGovernor::update(int64_t renderNs, int frames) {
+    int request = requestedTier.exchange(-1, std::memory_order_acquire);
+    if (request >= 0) {
+        tier = request;
+        ceiling = request;
+        quietWindows = 0;
+        holdWindows = windowsIn(kQualityHoldSeconds);
+        resetWindow();
+        sharedTier.store(tier, std::memory_order_relaxed);
+    }
+    if (frames <= 0) return tier;
+    int64_t periodNs = (int64_t) frames * 1000000000 / sampleRate;
+    float load = (float) renderNs / (float) periodNs;
+    if (load > windowPeak) windowPeak = load;
+    windowRenderNs += renderNs;
+    windowPeriodNs += periodNs;
+    if (windowPeriodNs < (int64_t) (kQualityWindowSeconds * 1e9)) return tier;
+    float mean = (float) windowRenderNs / (float) windowPeriodNs;
+    sharedLoad.store(mean, std::memory_order_relaxed);
+    if (windowsSinceStepUp < windowsIn(kQualityMaxHoldSeconds)) windowsSinceStepUp++;
+    if (automatic.load(std::memory_order_relaxed)) {
+        if ((mean > kQualityStepDownLoad || windowPeak > kQualityPeakLoad) &&
+            tier > kQualityTier_Eco) {
+            tier--;
+            quietWindows = 0;
+            // the tier above did not fit: wait longer before trying it again
+            if (windowsSinceStepUp <= holdWindows) {
+                holdWindows *= 2;
+                if (holdWindows > windowsIn(kQualityMaxHoldSeconds)) {
+                    holdWindows = windowsIn(kQualityMaxHoldSeconds);
+                }
+            }
+        } else if (mean < kQualityStepUpLoad && tier < ceiling) {
+            if (++quietWindows >= holdWindows) {
+                tier++;
+                quietWindows = 0;
+                windowsSinceStepUp = 0;
+            }
+        } else {
+            quietWindows = 0;
+        }
+        sharedTier.store(tier, std::memory_order_relaxed);
+    }
+    resetWindow();
+    return tier;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/QualityGovernor.h
+ * @brief Quality tiers of the synth and their automatic selection from the CPU load.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_QUALITYGOVERNOR_H
+#define ANDROID_MIDI_SYNTH_QUALITYGOVERNOR_H
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief Quality tiers, from the cheapest. */
+enum QualityTier {
+    /** @brief Linear interpolation, 16 voices, no effects. */
+    kQualityTier_Eco      = 0,
+    /** @brief Fourth-order interpolation, 48 voices, reverb. */
+    kQualityTier_Balanced = 1,
+    /** @brief Fourth-order interpolation, 256 voices, reverb and chorus (the default). */
+    kQualityTier_High     = 2,
+    /** @brief Number of tiers. */
+    kQualityTierCount     = 3
+};
+
+/** @brief Synth settings of a quality tier. */
+struct QualitySettings {
+    /** @brief Interpolation method (fluid_interp). */
+    int interpolation;
+    /** @brief Polyphony limit, in voices. */
+    int polyphony;
+    /** @brief True to enable the reverb (at the level set by the app). */
+    bool reverb;
+    /** @brief True to enable the chorus (at the level set by the app). */
+    bool chorus;
+    /** @brief Render threads (synth.cpu-cores, only read when the synth is created). */
+    int cpuCores;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief QualityGovernor class.
+ * @details Selects the quality tier of the synth. The app sets a tier; in automatic mode the
+ *          tier is the ceiling, and the governor steps down from it when the render of a
+ *          period takes too much of the period, and back up after a long quiet spell.
+ *          The load is the render time over the period time, in windows of half a second:
+ *          a window over 50% on average, or with a single period over 85%, steps down at
+ *          once; windows under 20% for the hold time (10 s) step up. A step down soon after
+ *          a step up doubles the hold time (up to 160 s), so a tier that does not fit is not
+ *          retried over and over. update() is called by the render thread; the tier is set
+ *          and read from any thread through atomics.
+ *          The sample rate is the same for every tier: the audio stream, the clocks and the
+ *          recorders are bound to it.
+ */
+class QualityGovernor {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     * @param tier Initial tier (QualityTier).
+     */
+    QualityGovernor(int sampleRate, int tier);
+    /**
+     * @brief Get the synth settings of a tier.
+     * @param tier Quality tier (QualityTier, clamped).
+     * @return The settings.
+     */
+    static const QualitySettings &getSettings(int tier);
+    /**
+     * @brief Set the tier (any thread, applied on the next period).
+     * @param tier Quality tier (QualityTier).
+     * @param automatic True to use the tier as a ceiling and follow the CPU load.
+     * @return True if successful. False if the tier is invalid.
+     */
+    bool setTier(int tier, bool automatic);
+    /**
+     * @brief Get the tier in use.
+     * @return The tier (QualityTier).
+     */
+    int getTier() const { return sharedTier.load(std::memory_order_relaxed); }
+    /**
+     * @brief Get the render load of the last window.
+     * @return Render time over period time (1 takes the whole period).
+     */
+    float getLoad() const { return sharedLoad.load(std::memory_order_relaxed); }
+    /**
+     * @brief Account a rendered period and select the tier (render thread).
+     * @param renderNs Render time of the period, in nanoseconds.
+     * @param frames Frames of the period.
+     * @return The tier for the next period (QualityTier).
+     */
+    int update(int64_t renderNs, int frames);
+private:
+    /* @brief Start a new measuring window. */
+    void resetWindow();
+private:
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Tier in use (render thread). */
+    int tier;
+    /* @brief Highest tier of the automatic mode. */
+    int ceiling;
+    /* @brief Render time of the current window, in nanoseconds. */
+    int64_t windowRenderNs;
+    /* @brief Period time of the current window, in nanoseconds. */
+    int64_t windowPeriodNs;
+    /* @brief Highest load of a period of the current window. */
+    float windowPeak;
+    /* @brief Consecutive windows under the step up load. */
+    int quietWindows;
+    /* @brief Quiet windows required to step up. */
+    int holdWindows;
+    /* @brief Windows since the last step up. */
+    int windowsSinceStepUp;
+    /* @brief Tier set by the app, or -1 (written by any thread). */
+    std::atomic<int> requestedTier;
+    /* @brief True to follow the CPU load (written by any thread). */
+    std::atomic<bool> automatic;
+    /* @brief Published tier in use. */
+    std::atomic<int> sharedTier;
+    /* @brief Published load of the last window. */
+    std::atomic<float> sharedLoad;
+};
+
+#endif //ANDROID_MIDI_SYNTH_QUALITYGOVERNOR_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SessionRecorder.cpp
+ * @brief Implementation of SessionRecorder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <chrono>
+
+#include "MidiParser.h"
+#include "SessionRecorder.h"
+
+/* @brief Tempo of the recorded file, in microseconds per quarter note. */
+static const int kRecorderTempo = 500000;
+/* @brief Offset of the track length in the file. */
+static const long kRecorderLengthOffset = 18;
+/* @brief Offset of the first track event in the file. */
+static const long kRecorderTrackOffset = 22;
+
+/* @brief Write a big endian 32-bit value. */
+static void writeU32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t) (value >> 24);
+    p[1] = (uint8_t) (value >> 16);
+    p[2] = (uint8_t) (value >> 8);
+    p[3] = (uint8_t) value;
+}
+
+/* @brief Write a variable-length quantity.
+ * @return The number of bytes written. */
+static int writeVarLen(uint8_t *p, uint32_t value) {
+    uint8_t bytes[5];
+    int count = 0;
+    do {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value);
+    for (int i = 0; i < count; i++) {
+        p[i] = bytes[count - 1 - i] | (i < count - 1 ? 0x80 : 0);
+    }
+    return count;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+SessionRecorder::SessionRecorder(int sampleRate):
+    sampleRate(sampleRate), file(nullptr), endOffset(0), startFrame(0), lastFrame(0),
+    recording(false) {
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const char *path, int64_t frame) {
+    if (recording.load() || sampleRate > 65534) return false;
+    file = fopen(path, "wb");
+    if (file == nullptr) return false;
+    // header: format 0, one track, one tick per frame
+    int division = sampleRate / 2;
+    uint8_t header[kRecorderTrackOffset + 7] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1,
+        (uint8_t) (division >> 8), (uint8_t) division,
+        'M', 'T', 'r', 'k', 0, 0, 0, 0,
+        0x00, 0xFF, 0x51, 0x03,
+        (uint8_t) (kRecorderTempo >> 16), (uint8_t) (kRecorderTempo >> 8),
+        (uint8_t) kRecorderTempo
+    };
+    fwrite(header, 1, sizeof(header), file);
+    endOffset = sizeof(header);
+    finishTrack();
+    startFrame = frame;
+    lastFrame = frame;
+    queue.resetDropped();
+    recording.store(true);
+    thread = std::thread(&SessionRecorder::run, this);
+    return true;
+}
+
+void SessionRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        if (!recording.load()) return;
+        recording.store(false);
+    }
+    stopCondition.notify_all();
+    if (thread.joinable()) thread.join();
+    // producers that saw the flag just before it changed may still have queued events
+    flush();
+    fclose(file);
+    file = nullptr;
+}
+
+bool SessionRecorder::record(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+    if (!recording.load(std::memory_order_relaxed)) return false;
+    Event event = { frame, { status, data1, data2 } };
+    return queue.push(event);
+}
+
+void SessionRecorder::run() {
+    while (recording.load()) {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            stopCondition.wait_for(lock, std::chrono::milliseconds(kRecorderFlushMs),
+                                   [this] { return !recording.load(); });
+        }
+        flush();
+    }
+}
+
+void SessionRecorder::flush() {
+    for (;;) {
+        int count = 0;
+        while (count < kBatchSize && queue.pop(batch[count])) count++;
+        if (count == 0) return;
+        // producers on several threads: restore the time order (the batch is almost sorted)
+        for (int i = 1; i < count; i++) {
+            Event event = batch[i];
+            int j = i - 1;
+            for (; j >= 0 && batch[j].frame > event.frame; j--) batch[j + 1] = batch[j];
+            batch[j + 1] = event;
+        }
+        int size = 0;
+        for (int i = 0; i < count; i++) {
+            const Event &event = batch[i];
+            // late events (queued after a later flush) are written at the current time
+            int64_t frame = event.frame > lastFrame ? event.frame : lastFrame;
+            size += writeVarLen(buffer + size, (uint32_t) (frame - lastFrame));
+            lastFrame = frame;
+            int length = 1 + MidiParser::dataLength(event.bytes[0]);
+            for (int k = 0; k < length; k++) buffer[size++] = event.bytes[k];
+        }
+        fseek(file, endOffset, SEEK_SET);
+        fwrite(buffer, 1, size, file);
+        endOffset += size;
+        finishTrack();
+        if (count < kBatchSize) return;
+    }
+}
+
+void SessionRecorder::finishTrack() {
+    static const uint8_t endOfTrack[] = { 0x00, 0xFF, 0x2F, 0x00 };
+    fseek(file, endOffset, SEEK_SET);
+    fwrite(endOfTrack, 1, sizeof(endOfTrack), file);
+    uint8_t length[4];
+    writeU32(length, (uint32_t) (endOffset + sizeof(endOfTrack) - kRecorderTrackOffset));
+    fseek(file, kRecorderLengthOffset, SEEK_SET);
+    fwrite(length, 1, sizeof(length), file);
+    fflush(file);
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SessionRecorder.h
+ * @brief Header of SessionRecorder class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_SESSIONRECORDER_H
+#define ANDROID_MIDI_SYNTH_SESSIONRECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "BoundedQueue.h"
+
+/** @brief Capacity of the event queue of the recorder (power of two). */
+static const int kRecorderQueueSize = 4096;
+/** @brief Period of the writer thread, in milliseconds. */
+static const int kRecorderFlushMs = 250;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief SessionRecorder class.
+ * @details Records MIDI channel messages with their audio frame into a Standard MIDI File
+ *          (format 0). record() is lock-free (bounded multi-producer queue, no allocation),
+ *          so it can be called from the render thread. A writer thread drains the queue
+ *          periodically and appends the events to the file, then rewrites End Of Track and
+ *          the track length: the file is valid after every flush, even if the app dies.
+ *          The time division maps one tick to one audio frame (tempo 500000 us, division
+ *          sampleRate / 2).
+ */
+class SessionRecorder {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Audio sample rate, in Hz (even, up to 65534).
+     */
+    explicit SessionRecorder(int sampleRate);
+    /** @brief Destructor. Stops recording. */
+    ~SessionRecorder();
+    /**
+     * @brief Start recording.
+     * @param path Path of the file (overwritten).
+     * @param startFrame Audio frame of the start of the file.
+     * @return True if successful. False otherwise.
+     */
+    bool start(const char *path, int64_t startFrame);
+    /** @brief Stop recording, write the remaining events and close the file. */
+    void stop();
+    /**
+     * @brief Check if recording.
+     * @return True if recording.
+     */
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+    /**
+     * @brief Record a channel message (any thread, lock-free).
+     * @param frame Audio frame of the message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if not recording or the queue is full.
+     */
+    bool record(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2);
+    /**
+     * @brief Get the number of events dropped because the queue was full.
+     * @return The number of events.
+     */
+    uint64_t getDropped() const { return queue.getDropped(); }
+private:
+    /* @brief A recorded event. */
+    struct Event {
+        /* @brief Audio frame. */
+        int64_t frame;
+        /* @brief Message bytes. */
+        uint8_t bytes[3];
+    };
+    /* @brief Number of events written per flush at most. */
+    static const int kBatchSize = 512;
+    /* @brief Writer thread body. */
+    void run();
+    /* @brief Drain the queue into the file. */
+    void flush();
+    /* @brief Write End Of Track and fix the track length up. */
+    void finishTrack();
+private:
+    /* @brief Event queue (producers to the writer thread). */
+    BoundedQueue<Event, kRecorderQueueSize> queue;
+    /* @brief Events of the current flush. */
+    Event batch[kBatchSize];
+    /* @brief Encoded bytes of the current flush. */
+    uint8_t buffer[kBatchSize * 7 + 4];
+    /* @brief Audio sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Output file. */
+    FILE *file;
+    /* @brief File offset of the End Of Track event. */
+    long endOffset;
+    /* @brief Audio frame of the start of the file. */
+    int64_t startFrame;
+    /* @brief Audio frame of the last written event. */
+    int64_t lastFrame;
+    /* @brief True while recording. */
+    std::atomic<bool> recording;
+    /* @brief Writer thread. */
+    std::thread thread;
+    /* @brief Guards the stop condition. */
+    std::mutex stopMutex;
+    /* @brief Wakes the writer thread up to stop. */
+    std::condition_variable stopCondition;
+};
+
+#endif //ANDROID_MIDI_SYNTH_SESSIONRECORDER_H
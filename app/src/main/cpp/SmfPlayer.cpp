@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SmfPlayer.cpp
+ * @brief Implementation of SmfPlayer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "MidiSpec.h"
+#include "SmfPlayer.h"
+
+/* @brief Meta event: End Of Track. */
+static const uint8_t kSmfMeta_EndOfTrack = 0x2F;
+/* @brief Meta event: Set Tempo. */
+static const uint8_t kSmfMeta_Tempo = 0x51;
+/* @brief Status byte of the meta events. */
+static const uint8_t kSmfMetaEvent = 0xFF;
+/* @brief MIDI Control: All Notes Off (123). */
+static const uint8_t kSmfControl_AllNotesOff = 0x7B;
+
+/* @brief Read a big endian 16-bit value. */
+static int readU16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+/* @brief Read a big endian 32-bit value. */
+static uint32_t readU32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// -----------------------------------------------------------------------------------------------
+
+SmfPlayer::SmfPlayer(MidiListener *listener, int sampleRate):
+    listener(listener), sampleRate(sampleRate), data(nullptr), size(0), division(0),
+    trackCount(0), length(0), indexInterval(0), tempo(kSmfDefaultTempo),
+    baseTempo(kSmfDefaultTempo), liveBpm(60.0), position(0.0), playing(false), loop(false) {
+}
+
+SmfPlayer::~SmfPlayer() {
+    unload();
+}
+
+bool SmfPlayer::load(const char *path) {
+    unload();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 14 || (uint64_t) st.st_size > UINT32_MAX) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    data = static_cast<const uint8_t*>(map);
+    size = st.st_size;
+    // header chunk; SMPTE time division is not supported
+    uint32_t headerLength = readU32(data + 4);
+    int tracksInHeader = readU16(data + 10);
+    division = readU16(data + 12);
+    if (memcmp(data, "MThd", 4) != 0 || headerLength < 6 || division == 0 ||
+            (division & 0x8000)) {
+        unload();
+        return false;
+    }
+    // track chunks (only their bounds, the events are parsed when needed)
+    uint64_t offset = 8 + (uint64_t) headerLength;
+    while (offset + 8 <= size && trackCount < tracksInHeader && trackCount < kSmfMaxTracks) {
+        uint32_t chunkLength = readU32(data + offset + 4);
+        if (memcmp(data + offset, "MTrk", 4) == 0) {
+            Track &track = tracks[trackCount++];
+            track.start = (uint32_t) (offset + 8);
+            track.end = (uint32_t) std::min<uint64_t>(offset + 8 + chunkLength, size);
+        }
+        offset += 8 + (uint64_t) chunkLength;
+    }
+    if (trackCount == 0) {
+        unload();
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    buildIndex();
+    baseTempo = tempoAt(0);
+    for (int t = 0; t < trackCount; t++) rewindTrack(tracks[t]);
+    tempo = baseTempo;
+    position = 0.0;
+    return true;
+}
+
+void SmfPlayer::unload() {
+    if (playing) stop();
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    size = 0;
+    trackCount = 0;
+    length = 0;
+    position = 0.0;
+    std::vector<TempoChange>().swap(tempoMap);
+    std::vector<Checkpoint>().swap(checkpoints);
+}
+
+void SmfPlayer::play() {
+    if (data) playing = true;
+}
+
+void SmfPlayer::stop() {
+    playing = false;
+    allNotesOff();
+}
+
+size_t SmfPlayer::getIndexBytes() const {
+    return tempoMap.capacity() * sizeof(TempoChange) +
+           checkpoints.capacity() * sizeof(Checkpoint);
+}
+
+bool SmfPlayer::readVarLen(uint32_t &pos, uint32_t end, uint32_t &value) const {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (pos >= end) return false;
+        uint8_t byte = data[pos++];
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void SmfPlayer::readDelta(Track &track) {
+    uint32_t delta;
+    if (track.pos >= track.end || !readVarLen(track.pos, track.end, delta)) {
+        track.pos = track.end;
+        track.nextTick = INT64_MAX;
+        return;
+    }
+    track.nextTick += delta;
+}
+
+void SmfPlayer::rewindTrack(Track &track) {
+    track.pos = track.start;
+    track.runningStatus = 0;
+    track.nextTick = 0;
+    readDelta(track);
+}
+
+void SmfPlayer::readEvent(Track &track, ReadMode mode) {
+    uint32_t pos = track.pos;
+    uint32_t end = track.end;
+    uint8_t status = pos < end ? data[pos] : 0;
+    if (status & 0x80) {
+        pos++;
+    } else {
+        status = track.runningStatus;
+    }
+    uint32_t eventLength;
+    bool valid = false;
+    if (status == kSmfMetaEvent) {
+        uint8_t type = pos < end ? data[pos++] : 0;
+        valid = readVarLen(pos, end, eventLength) && pos + eventLength <= end &&
+                type != kSmfMeta_EndOfTrack;
+        if (valid && type == kSmfMeta_Tempo && eventLength == 3) {
+            int value = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+            if (mode == kRead_Play) tempo = value;
+            if (mode == kRead_Scan) tempoMap.push_back({ track.nextTick, value });
+        }
+        pos += valid ? eventLength : 0;
+        track.runningStatus = 0;
+    } else if (status == kMIDISysCmd_SysEx || status == kMIDISysCmd_EndOfSysEx) {
+        valid = readVarLen(pos, end, eventLength) && pos + eventLength <= end;
+        if (valid && mode == kRead_Play && status == kMIDISysCmd_SysEx) {
+            // the payload ends with End Of SysEx (F7 escapes are not played)
+            int payload = (int) eventLength;
+            if (payload > 0 && data[pos + payload - 1] == kMIDISysCmd_EndOfSysEx) payload--;
+            listener->onMidiSysEx(data + pos, payload);
+        }
+        pos += valid ? eventLength : 0;
+        track.runningStatus = 0;
+    } else if (status >= 0x80 && status < kMIDISysCmdChan) {
+        int count = MidiParser::dataLength(status);
+        valid = pos + count <= end;
+        if (valid) {
+            uint8_t data1 = data[pos];
+            uint8_t data2 = count > 1 ? data[pos + 1] : 0;
+            pos += count;
+            track.runningStatus = status;
+            int command = status >> 4;
+            bool note = command == kMIDIChanCmd_NoteOn || command == kMIDIChanCmd_NoteOff ||
+                        command == kMIDIChanCmd_KeyPress;
+            if (mode == kRead_Play || (mode == kRead_Chase && !note)) {
+                listener->onMidiMessage(status, data1, data2);
+            }
+        }
+    }
+    if (!valid) {
+        // End Of Track or a broken track: nothing more to play
+        track.pos = end;
+        track.nextTick = INT64_MAX;
+        return;
+    }
+    track.pos = pos;
+    readDelta(track);
+}
+
+void SmfPlayer::buildIndex() {
+    tempoMap.clear();
+    checkpoints.clear();
+    // first pass: length and tempo map
+    length = 0;
+    for (int t = 0; t < trackCount; t++) {
+        Track track = tracks[t];
+        rewindTrack(track);
+        while (track.nextTick != INT64_MAX) {
+            length = std::max(length, track.nextTick);
+            readEvent(track, kRead_Scan);
+        }
+    }
+    std::stable_sort(tempoMap.begin(), tempoMap.end(),
+                     [](const TempoChange &a, const TempoChange &b) { return a.tick < b.tick; });
+    tempoMap.shrink_to_fit();
+    // second pass: state of every track at each index point; the delta times may add up to
+    // billions of ticks, so long files get a wider interval instead of more points
+    int64_t interval = std::max<int64_t>((int64_t) kSmfIndexQuarters * division,
+                                         (length + kSmfMaxIndexPoints - 2) /
+                                         (kSmfMaxIndexPoints - 1));
+    indexInterval = interval;
+    size_t points = (size_t) (length / interval) + 1;
+    checkpoints.resize(points * trackCount);
+    for (int t = 0; t < trackCount; t++) {
+        Track track = tracks[t];
+        rewindTrack(track);
+        for (size_t k = 0; k < points; k++) {
+            while (track.nextTick < (int64_t) k * interval) readEvent(track, kRead_Skip);
+            checkpoints[k * trackCount + t] = { track.pos, track.runningStatus, track.nextTick };
+        }
+    }
+}
+
+int SmfPlayer::tempoAt(int64_t tick) const {
+    auto it = std::upper_bound(tempoMap.begin(), tempoMap.end(), tick,
+                               [](int64_t value, const TempoChange &c) { return value < c.tick; });
+    return it == tempoMap.begin() ? kSmfDefaultTempo : (it - 1)->tempo;
+}
+
+bool SmfPlayer::seek(int64_t tick) {
+    if (data == nullptr) return false;
+    if (tick < 0) tick = 0;
+    if (tick > length) tick = length;
+    allNotesOff();
+    // restore the nearest index point before the position
+    size_t point = std::min<size_t>((size_t) (tick / indexInterval),
+                                    checkpoints.size() / trackCount - 1);
+    for (int t = 0; t < trackCount; t++) {
+        const Checkpoint &checkpoint = checkpoints[point * trackCount + t];
+        tracks[t].pos = checkpoint.pos;
+        tracks[t].runningStatus = checkpoint.runningStatus;
+        tracks[t].nextTick = checkpoint.nextTick;
+    }
+    // then chase the controllers up to the position, in time order
+    for (;;) {
+        Track *next = nullptr;
+        for (int t = 0; t < trackCount; t++) {
+            if (tracks[t].nextTick < tick && (!next || tracks[t].nextTick < next->nextTick)) {
+                next = &tracks[t];
+            }
+        }
+        if (next == nullptr) break;
+        readEvent(*next, kRead_Chase);
+    }
+    tempo = tempoAt(tick);
+    position = (double) tick;
+    return true;
+}
+
+void SmfPlayer::process(int frames) {
+    if (!playing) return;
+    // one quarter note per live beat at the base tempo of the file
+    double ticksPerSecond = division * liveBpm.load(std::memory_order_relaxed) * baseTempo /
+                            (60.0 * tempo);
+    position += frames * ticksPerSecond / sampleRate;
+    for (;;) {
+        Track *next = nullptr;
+        for (int t = 0; t < trackCount; t++) {
+            if (!next || tracks[t].nextTick < next->nextTick) next = &tracks[t];
+        }
+        if (next->nextTick == INT64_MAX) {
+            // end of the file
+            if (loop) {
+                seek(0);
+            } else {
+                stop();
+            }
+            return;
+        }
+        if (next->nextTick > position) break;
+        readEvent(*next, kRead_Play);
+    }
+}
+
+void SmfPlayer::allNotesOff() {
+    for (int chan = 0; chan < 16; chan++) {
+        listener->onMidiMessage((kMIDIChanCmd_Control << 4) | chan, kSmfControl_AllNotesOff, 0);
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SmfPlayer.h
+ * @brief Header of SmfPlayer class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_SMFPLAYER_H
+#define ANDROID_MIDI_SYNTH_SMFPLAYER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MidiParser.h"
+
+/** @brief Maximum number of tracks of a Standard MIDI File. */
+static const int kSmfMaxTracks = 64;
+/** @brief Interval of the seek index, in quarter notes. */
+static const int kSmfIndexQuarters = 4;
+/** @brief Maximum number of seek index points (the interval grows for longer files). */
+static const int kSmfMaxIndexPoints = 1024;
+/** @brief Default tempo of a Standard MIDI File, in microseconds per quarter note. */
+static const int kSmfDefaultTempo = 500000;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief SmfPlayer class.
+ * @details Streaming Standard MIDI File (format 0 and 1) player. The file is memory-mapped and
+ *          the events are parsed lazily, when they are due. Playback runs in ticks at a rate
+ *          scaled to a live tempo: one quarter note per beat at the first tempo of the file,
+ *          later tempo changes of the file keep their ratio. Loading scans the file once to
+ *          build the tempo map and a seek index (state of every track each few quarter notes,
+ *          at most kSmfMaxIndexPoints points), so seeking only parses from the nearest index
+ *          point.
+ *
+ *          process() runs on the render thread and does not allocate memory. The other
+ *          methods must not run concurrently with it (the caller serializes them).
+ */
+class SmfPlayer {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the channel messages and SysEx of the file.
+     * @param sampleRate Audio sample rate, in Hz.
+     */
+    SmfPlayer(MidiListener *listener, int sampleRate);
+    /** @brief Destructor. Unloads the file. */
+    ~SmfPlayer();
+    /**
+     * @brief Load a Standard MIDI File.
+     * @details Stops and unloads the previous file.
+     * @param path Path of the file.
+     * @return True if successful. False otherwise.
+     */
+    bool load(const char *path);
+    /** @brief Stop and unload the file. */
+    void unload();
+    /** @brief Start (or resume) playing. */
+    void play();
+    /** @brief Stop playing and release the sounding notes. */
+    void stop();
+    /**
+     * @brief Move the playback position.
+     * @details Program changes, controllers and pitch bends before the position are sent, so
+     *          the channels sound as if the file was played from the start.
+     * @param tick Position, in ticks.
+     * @return True if successful. False otherwise.
+     */
+    bool seek(int64_t tick);
+    /**
+     * @brief Set if the playback restarts at the end of the file.
+     * @param enable True to loop.
+     */
+    void setLoop(bool enable) { loop = enable; }
+    /**
+     * @brief Set the live tempo.
+     * @details May be called from any thread.
+     * @param bpm Tempo, in beats (quarter notes) per minute.
+     */
+    void setBpm(double bpm) { if (bpm > 0.0) liveBpm.store(bpm); }
+    /**
+     * @brief Play the events due in the next frames (render thread).
+     * @param frames Number of audio frames.
+     */
+    void process(int frames);
+    /**
+     * @brief Check if the player is playing.
+     * @return True if playing.
+     */
+    bool isPlaying() const { return playing; }
+    /**
+     * @brief Get the playback position.
+     * @return Position, in ticks.
+     */
+    int64_t getPosition() const { return (int64_t) position; }
+    /**
+     * @brief Get the length of the file.
+     * @return Length, in ticks.
+     */
+    int64_t getLength() const { return length; }
+    /**
+     * @brief Get the number of tracks of the file.
+     * @return The number of tracks.
+     */
+    int getTrackCount() const { return trackCount; }
+    /**
+     * @brief Get the memory used by the tempo map and the seek index.
+     * @return Size, in bytes.
+     */
+    size_t getIndexBytes() const;
+private:
+    /* @brief Parsing state of a track. */
+    struct Track {
+        /* @brief Offset of the first byte of the track data. */
+        uint32_t start;
+        /* @brief Offset of the end of the track data. */
+        uint32_t end;
+        /* @brief Offset of the next event (after its delta time). */
+        uint32_t pos;
+        /* @brief Running status. */
+        uint8_t runningStatus;
+        /* @brief Tick of the next event (INT64_MAX at the end of the track). */
+        int64_t nextTick;
+    };
+    /* @brief State of a track at an index point. */
+    struct Checkpoint {
+        /* @brief Offset of the next event. */
+        uint32_t pos;
+        /* @brief Running status. */
+        uint8_t runningStatus;
+        /* @brief Tick of the next event. */
+        int64_t nextTick;
+    };
+    /* @brief A tempo change. */
+    struct TempoChange {
+        /* @brief Tick of the change. */
+        int64_t tick;
+        /* @brief Tempo, in microseconds per quarter note. */
+        int tempo;
+    };
+    /* @brief Modes of readEvent(): play, send only the controllers, collect the tempo map, skip. */
+    enum ReadMode { kRead_Play, kRead_Chase, kRead_Scan, kRead_Skip };
+    /* @brief Read a variable-length quantity. */
+    bool readVarLen(uint32_t &pos, uint32_t end, uint32_t &value) const;
+    /* @brief Read the delta time of the next event of a track. */
+    void readDelta(Track &track);
+    /* @brief Read (and play or scan) the next event of a track, then the next delta time. */
+    void readEvent(Track &track, ReadMode mode);
+    /* @brief Rewind a track to its first event. */
+    void rewindTrack(Track &track);
+    /* @brief Build the tempo map and the seek index. */
+    void buildIndex();
+    /* @brief Get the tempo at a tick. */
+    int tempoAt(int64_t tick) const;
+    /* @brief Release the sounding notes of every channel. */
+    void allNotesOff();
+private:
+    /* @brief Receives the messages. */
+    MidiListener *listener;
+    /* @brief Audio sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Mapped file (nullptr if none). */
+    const uint8_t *data;
+    /* @brief Size of the mapped file. */
+    size_t size;
+    /* @brief Ticks per quarter note. */
+    int division;
+    /* @brief Tracks. */
+    Track tracks[kSmfMaxTracks];
+    /* @brief Number of tracks. */
+    int trackCount;
+    /* @brief Length of the file, in ticks. */
+    int64_t length;
+    /* @brief Tempo map (sorted by tick). */
+    std::vector<TempoChange> tempoMap;
+    /* @brief Seek index: trackCount checkpoints per index point. */
+    std::vector<Checkpoint> checkpoints;
+    /* @brief Interval of the seek index, in ticks. */
+    int64_t indexInterval;
+    /* @brief Current tempo of the file, in microseconds per quarter note. */
+    int tempo;
+    /* @brief First tempo of the file (played at the live tempo). */
+    int baseTempo;
+    /* @brief Live tempo, in BPM. */
+    std::atomic<double> liveBpm;
+    /* @brief Playback position, in ticks. */
+    double position;
+    /* @brief True while playing. */
+    bool playing;
+    /* @brief True to restart at the end of the file. */
+    bool loop;
+};
+
+#endif //ANDROID_MIDI_SYNTH_SMFPLAYER_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SmootherBank.cpp
+ * @brief Implementation of SmootherBank class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+
+#include "SmootherBank.h"
+
+/* @brief First Channel Mode controller (All Sound Off): not kept in the state shadow. */
+static const int kChannelModeController = 0x78;
+
+// -----------------------------------------------------------------------------------------------
+
+SmootherBank::SmootherBank(SmootherListener *listener, int sampleRate):
+    listener(listener), sampleRate(sampleRate) {
+}
+
+bool SmootherBank::setTarget(int param, int chan, int controller, float value, int rampMs) {
+    if (param < kSmoothedParam_CC || param > kSmoothedParam_FilterCutoff) return false;
+    int rampFrames = (int) (sampleRate * (int64_t) rampMs / 1000);
+    std::lock_guard<std::mutex> lock(slotMutex);
+    Slot *freeSlot = nullptr;
+    for (Slot &slot : slots) {
+        if (!slot.active.load(std::memory_order_acquire)) {
+            if (freeSlot == nullptr) freeSlot = &slot;
+            continue;
+        }
+        if (slot.param == param && slot.chan == chan && slot.controller == controller) {
+            slot.smoother.setRampFrames(rampFrames);
+            slot.smoother.setTarget(value);
+            return true;
+        }
+    }
+    if (freeSlot == nullptr) return false;
+    // first value of a parameter: start from it, there is nothing to ramp from
+    freeSlot->param = param;
+    freeSlot->chan = chan;
+    freeSlot->controller = controller;
+    freeSlot->lastSent = NAN;
+    freeSlot->sentLevel.store(kSynthStateUnknown, std::memory_order_relaxed);
+    freeSlot->resend.store(false, std::memory_order_relaxed);
+    freeSlot->smoother.setRampFrames(rampFrames);
+    freeSlot->smoother.reset(value);
+    freeSlot->active.store(true, std::memory_order_release);
+    return true;
+}
+
+void SmootherBank::process(int frames) {
+    for (Slot &slot : slots) {
+        if (!slot.active.load(std::memory_order_acquire)) continue;
+        if (slot.resend.exchange(false, std::memory_order_acquire)) slot.lastSent = NAN;
+        float value = slot.smoother.process(frames);
+        if (slot.param == kSmoothedParam_FilterCutoff) {
+            if (fabsf(value - slot.lastSent) < kFilterCutoffResolution) continue;
+            slot.lastSent = value;
+            listener->onSmoothedParam(slot.param, slot.chan, slot.controller, value);
+            continue;
+        }
+        float level = roundf(value);
+        if (level < 0.0f) level = 0.0f;
+        if (level > 127.0f) level = 127.0f;
+        if (level == slot.lastSent) continue;
+        slot.lastSent = level;
+        // the state shadow is locked by the other threads: sync() updates it
+        slot.sentLevel.store((int) level, std::memory_order_relaxed);
+        listener->onSmoothedParam(slot.param, slot.chan, slot.controller, level);
+    }
+}
+
+void SmootherBank::sync(SynthState &state) const {
+    for (const Slot &slot : slots) {
+        if (!slot.active.load(std::memory_order_acquire)) continue;
+        int level = slot.sentLevel.load(std::memory_order_relaxed);
+        if (level == kSynthStateUnknown) continue;
+        if (slot.param == kSmoothedParam_Reverb) {
+            state.reverbLevel = (int16_t) level;
+        } else if (slot.param == kSmoothedParam_CC && slot.chan >= 0 &&
+                   slot.chan < kSynthStateChannels && slot.controller >= 0 &&
+                   slot.controller < kChannelModeController) {
+            state.channels[slot.chan].cc[slot.controller] = (int8_t) level;
+        }
+    }
+}
+
+void SmootherBank::resend() {
+    // the synth no longer holds the smoothed values: send them again on the next block
+    for (Slot &slot : slots) {
+        if (!slot.active.load(std::memory_order_acquire)) continue;
+        slot.sentLevel.store(kSynthStateUnknown, std::memory_order_relaxed);
+        slot.resend.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SmootherBank.h
+ * @brief Header of SmootherBank class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_SMOOTHERBANK_H
+#define ANDROID_MIDI_SYNTH_SMOOTHERBANK_H
+
+#include <atomic>
+#include <mutex>
+
+#include "ParamSmoother.h"
+#include "SynthState.h"
+
+/** @brief Synth parameters that can be smoothed in the render loop. */
+enum SmoothedParam {
+    /** @brief A controller of a channel (0-127). */
+    kSmoothedParam_CC           = 0,
+    /** @brief The reverb level (0-127). */
+    kSmoothedParam_Reverb       = 1,
+    /** @brief The filter cutoff offset of a channel, in cents. */
+    kSmoothedParam_FilterCutoff = 2,
+};
+
+/** @brief Maximum number of parameters smoothed at the same time. */
+static const int kMaxSmoothers = 16;
+
+/** @brief Smallest filter cutoff change sent to the synth, in cents. */
+static const float kFilterCutoffResolution = 1.0f;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief SmootherListener interface.
+ * @details Receives the values of a SmootherBank that have to be sent to the synth.
+ */
+class SmootherListener {
+public:
+    /** @brief Destructor. */
+    virtual ~SmootherListener() = default;
+    /**
+     * @brief A smoothed parameter changed (called from the render thread).
+     * @param param Parameter (SmoothedParam).
+     * @param chan Channel number.
+     * @param controller Controller number (kSmoothedParam_CC only).
+     * @param value New value: a level (0-127) for the controllers and the reverb, cents for
+     *              the filter cutoff.
+     */
+    virtual void onSmoothedParam(int param, int chan, int controller, float value) = 0;
+};
+
+/**
+ * @brief SmootherBank class.
+ * @details Ramps of the synth parameters, advanced at control rate by the render thread.
+ *          The levels are rounded to MIDI values and the cutoff to kFilterCutoffResolution,
+ *          so the listener only gets the values that change what the synth plays.
+ *          Targets may be set from any thread; the last level of each parameter is kept for
+ *          the state shadow, which the render thread cannot lock.
+ */
+class SmootherBank {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the changed values (called from the render thread).
+     * @param sampleRate Sample rate, in Hz.
+     */
+    SmootherBank(SmootherListener *listener, int sampleRate);
+    /**
+     * @brief Ramp a parameter to a new value.
+     * @details The first target of a parameter is sent at once, there is nothing to ramp from.
+     * @param param Parameter (SmoothedParam).
+     * @param chan Channel number (ignored for kSmoothedParam_Reverb).
+     * @param controller Controller number (only used for kSmoothedParam_CC).
+     * @param value Target value.
+     * @param rampMs Ramp duration, in milliseconds.
+     * @return True if successful. False if there is no free smoother.
+     */
+    bool setTarget(int param, int chan, int controller, float value, int rampMs);
+    /**
+     * @brief Advance the ramps and send the changed values (render thread).
+     * @param frames Number of audio frames elapsed.
+     */
+    void process(int frames);
+    /**
+     * @brief Copy the levels sent so far into a state shadow (caller holds its lock).
+     * @param state The state shadow.
+     */
+    void sync(SynthState &state) const;
+    /** @brief Send every value again on the next block (the synth state was reset). */
+    void resend();
+private:
+    /* @brief A smoothed parameter. */
+    struct Slot {
+        /* @brief True once the slot is published to the render thread. */
+        std::atomic<bool> active{false};
+        /* @brief Parameter (SmoothedParam). */
+        int param = 0;
+        /* @brief Channel number. */
+        int chan = 0;
+        /* @brief Controller number. */
+        int controller = 0;
+        /* @brief Last value sent to the synth (render thread). */
+        float lastSent = 0.0f;
+        /* @brief Last level sent to the synth, for the state shadow (-1 for none). */
+        std::atomic<int> sentLevel{kSynthStateUnknown};
+        /* @brief True if the synth state was reset: the value is sent again (render thread
+         *        clears lastSent). */
+        std::atomic<bool> resend{false};
+        /* @brief Ramp generator. */
+        ParamSmoother smoother;
+    };
+    /* @brief Receives the changed values. */
+    SmootherListener *listener;
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Smoothed parameters. */
+    Slot slots[kMaxSmoothers];
+    /* @brief Serializes the allocation of the slots. */
+    std::mutex slotMutex;
+};
+
+#endif //ANDROID_MIDI_SYNTH_SMOOTHERBANK_H
@@ -0,0 +1,725 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SynthEngine.cpp
+ * @brief Implementation of SynthEngine class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <sys/stat.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "MidiSpec.h"
+#include "SynthEngine.h"
+
+/* @brief Maximum number of audio buffers handled by the render callback. */
+static const int kMaxAudioBuffers = 8;
+/* @brief Ramp time of the output gain changes, in ms. */
+static const int kOutputGainRampMs = 50;
+/* @brief Default value of the channel volume controller. */
+static const int kDefaultChannelVolume = 100;
+
+/* @brief Get the monotonic time, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Bits of a float, as the trace holds the float arguments. */
+static int32_t floatBits(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* @brief Frame of the block being rendered, or -1 outside the render thread. */
+static thread_local int64_t renderBlockFrame = -1;
+
+/* @brief True if the channel is covered by the state shadow. */
+#define IS_SHADOWED_CHANNEL(x) ((x) >= 0 && (x) < kSynthStateChannels)
+
+/* @brief Stale shadow bit of the effects levels. */
+static const uint32_t kStaleEffects = 1u << kSynthStateChannels;
+/* @brief Stale shadow bits of the whole state. */
+static const uint32_t kStaleAll = (kStaleEffects << 1) - 1;
+
+/* @brief MIDI Control: Bank Select MSB. */
+static const int kMIDIControl_BankMSB       = 0x00;
+/* @brief MIDI Control: Channel Volume. */
+static const int kMIDIControl_Volume        = 0x07;
+/* @brief MIDI Control: Data Entry MSB. */
+static const int kMIDIControl_DataEntryMSB  = 0x06;
+/* @brief MIDI Control: Bank Select LSB. */
+static const int kMIDIControl_BankLSB       = 0x20;
+/* @brief MIDI Control: Data Entry LSB. */
+static const int kMIDIControl_DataEntryLSB  = 0x26;
+/* @brief MIDI Control: Data Increment. */
+static const int kMIDIControl_DataIncrement = 0x60;
+/* @brief MIDI Control: Data Decrement. */
+static const int kMIDIControl_DataDecrement = 0x61;
+/* @brief MIDI Control: first Channel Mode message (All Sound Off). */
+static const int kMIDIControl_ChannelMode   = 0x78;
+/* @brief MIDI Control: Reset All Controllers. */
+static const int kMIDIControl_ResetAll      = 0x79;
+/* @brief MIDI Control: All Notes Off. */
+static const int kMIDIControl_AllNotesOff   = 0x7B;
+
+// -----------------------------------------------------------------------------------------------
+
+SynthEngine::SynthEngine(SynthEngineListener *listener, int sampleRate, float gain, int tier):
+    listener(listener), sampleRate(sampleRate), gain(gain), settings(nullptr), synth(nullptr),
+    soundfontId(-1), staleShadow(0), forwardedCalls(0), elidedCalls(0),
+    smoothers(this, sampleRate), heartbeatChannel(-1), outputGain(1.0f), outputChain(sampleRate),
+    qualityGovernor(sampleRate, tier), qualityTier(tier), reverbEnabled(true),
+    chorusEnabled(true), reverbOn(false), chorusOn(false), voiceBudget(sampleRate),
+    voiceBudgetEnabled(true), recorder(sampleRate), apiTracePeriod(0), soundfontSize(0),
+    soundfontHash(0), renderFrame(0), frameClock(sampleRate), clockFrame(0), clockTimeNs(0),
+    clockSeq(0) {
+    resetState();
+    outputChain.getHeartbeat()->setVolume(gain * kDefaultChannelVolume / 127.0f);
+}
+
+SynthEngine::~SynthEngine() {
+    stopRecording();
+    stopApiTrace();
+    close();
+}
+
+bool SynthEngine::open(fluid_settings_t *synthSettings, int cores) {
+    close();
+    settings = synthSettings;
+    // the render threads are fixed with the synth, the rest of the tier may change live
+    int tier = qualityTier.load(std::memory_order_relaxed);
+    const QualitySettings &quality = QualityGovernor::getSettings(tier);
+    fluid_settings_setint(settings, "synth.cpu-cores", cores > 0 ? cores : quality.cpuCores);
+    fluid_settings_setint(settings, "synth.polyphony", quality.polyphony);
+    fluid_settings_setint(settings, "synth.reverb.active", quality.reverb);
+    fluid_settings_setint(settings, "synth.chorus.active", quality.chorus);
+    reverbOn = quality.reverb;
+    chorusOn = quality.chorus;
+    fluid_settings_setnum(settings, "synth.gain", gain);
+    fluid_settings_setnum(settings, "synth.sample-rate", sampleRate);
+    synth = new_fluid_synth(settings);
+    if (synth == nullptr) {
+        settings = nullptr;
+        return false;
+    }
+    fluid_synth_set_interp_method(synth, -1, quality.interpolation);
+    return true;
+}
+
+void SynthEngine::close() {
+    if (synth && soundfontId != -1) fluid_synth_sfunload(synth, soundfontId, 1);
+    if (synth) delete_fluid_synth(synth);
+    synth = nullptr;
+    soundfontId = -1;
+}
+
+int SynthEngine::hashFileName(const char *path) {
+    const char *name = strrchr(path, '/');
+    uint32_t hash = 2166136261u;
+    for (const char *c = name ? name + 1 : path; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619u;
+    return (int) hash;
+}
+
+bool SynthEngine::loadSF(const char *soundfontPath) {
+    if (synth == nullptr) return false;
+    // load soundfont
+    int id = fluid_synth_sfload(synth, soundfontPath, 0);
+    if (id == FLUID_FAILED) return false;
+    fluid_synth_sfont_select(synth, 0, id);
+    soundfontId = id;
+    // presets may differ in the new soundfont
+    std::unique_lock<std::mutex> lock = lockState();
+    resetState();
+    // the trace identifies the soundfont by size and name, not by path
+    struct stat st;
+    soundfontSize = stat(soundfontPath, &st) == 0 ? (int) st.st_size : 0;
+    soundfontHash = hashFileName(soundfontPath);
+    trace(kApiTraceOp_LoadSoundFont, 0, soundfontSize, soundfontHash);
+    return true;
+}
+
+void SynthEngine::programChange(int chan, int program) {
+    if (synth == nullptr) return;
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock() && IS_SHADOWED_CHANNEL(chan)) {
+        ChannelState &cs = state.channels[chan];
+        if (cs.program == program) { elided(); return; }
+        cs.program = (int16_t) program;
+    }
+    forwarded();
+    record((kMIDIChanCmd_ProgramChange << 4) | chan, program, 0);
+    trace(kApiTraceOp_ProgramChange, chan, program);
+    fluid_synth_program_change(synth, chan, program);
+    if (!lock.owns_lock()) markStale(chan);
+}
+
+void SynthEngine::bankSelect(int chan, int bank) {
+    if (synth == nullptr) return;
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock() && IS_SHADOWED_CHANNEL(chan)) {
+        ChannelState &cs = state.channels[chan];
+        if (cs.bank == bank) { elided(); return; }
+        cs.bank = (int16_t) bank;
+        // the new bank takes effect only on the next program change
+        cs.program = kSynthStateUnknown;
+    }
+    forwarded();
+    record((kMIDIChanCmd_Control << 4) | chan, kMIDIControl_BankMSB, (bank >> 7) & 0x7F);
+    record((kMIDIChanCmd_Control << 4) | chan, kMIDIControl_BankLSB, bank & 0x7F);
+    trace(kApiTraceOp_BankSelect, chan, bank);
+    fluid_synth_bank_select(synth, chan, bank);
+    if (!lock.owns_lock()) markStale(chan);
+}
+
+void SynthEngine::pitchBend(int chan, int value) {
+    if (synth == nullptr) return;
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock() && IS_SHADOWED_CHANNEL(chan)) {
+        ChannelState &cs = state.channels[chan];
+        if (cs.pitchBend == value) { elided(); return; }
+        cs.pitchBend = (int16_t) value;
+    }
+    forwarded();
+    record((kMIDIChanCmd_PitchWheel << 4) | chan, value & 0x7F, value >> 7);
+    trace(kApiTraceOp_PitchBend, chan, value);
+    fluid_synth_pitch_bend(synth, chan, value);
+    if (!lock.owns_lock()) markStale(chan);
+}
+
+void SynthEngine::noteOn(int chan, int note, int velocity) {
+    if (synth == nullptr) return;
+    if (chan == heartbeatChannel.load(std::memory_order_relaxed)) {
+        // the voices belong to the render thread: other threads play the note on the next block
+        if (renderBlockFrame < 0) {
+            scheduleMidi(frameAtTime(nowNs()), (kMIDIChanCmd_NoteOn << 4) | chan, note, velocity);
+            return;
+        }
+        record((kMIDIChanCmd_NoteOn << 4) | chan, note, velocity);
+        trace(kApiTraceOp_NoteOn, chan, note, velocity);
+        outputChain.getHeartbeat()->noteOn(note, velocity);
+        return;
+    }
+    record((kMIDIChanCmd_NoteOn << 4) | chan, note, velocity);
+    trace(kApiTraceOp_NoteOn, chan, note, velocity);
+    fluid_synth_noteon(synth, chan , note, velocity);
+}
+
+void SynthEngine::noteOff(int chan, int note) {
+    if (synth == nullptr) return;
+    if (chan == heartbeatChannel.load(std::memory_order_relaxed)) {
+        // the heartbeat voices decay by themselves
+        record((kMIDIChanCmd_NoteOff << 4) | chan, note, 0);
+        trace(kApiTraceOp_NoteOff, chan, note);
+        return;
+    }
+    record((kMIDIChanCmd_NoteOff << 4) | chan, note, 0);
+    trace(kApiTraceOp_NoteOff, chan, note);
+    fluid_synth_noteoff(synth, chan, note);
+}
+
+void SynthEngine::reverb(int level) {
+    if (synth == nullptr) return;
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock()) {
+        smoothers.sync(state);
+        if (state.reverbLevel == level) { elided(); return; }
+        state.reverbLevel = (int16_t) level;
+    }
+    forwarded();
+    trace(kApiTraceOp_Reverb, 0, level);
+    // the render thread switches the reverb, with the quality tier
+    reverbEnabled.store(level > 0, std::memory_order_relaxed);
+    fluid_synth_set_reverb_group_level(synth, -1, level / 127.0);
+    if (!lock.owns_lock()) markStale(-1);
+}
+
+void SynthEngine::chorus(int level) {
+    if (synth == nullptr) return;
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock()) {
+        if (state.chorusLevel == level) { elided(); return; }
+        state.chorusLevel = (int16_t) level;
+    }
+    forwarded();
+    trace(kApiTraceOp_Chorus, 0, level);
+    // the render thread switches the chorus, with the quality tier
+    chorusEnabled.store(level > 0, std::memory_order_relaxed);
+    fluid_synth_set_chorus_group_level(synth, -1, level / 127.0);
+    if (!lock.owns_lock()) markStale(-1);
+}
+
+void SynthEngine::sendCC(int chan, int controller, int value) {
+    if (synth == nullptr) return;
+    if (controller == kMIDIControl_Volume &&
+            chan == heartbeatChannel.load(std::memory_order_relaxed)) {
+        outputChain.getHeartbeat()->setVolume(gain * value / 127.0f);
+    }
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock()) smoothers.sync(state);
+    if (lock.owns_lock() && IS_SHADOWED_CHANNEL(chan) && controller >= 0 &&
+            controller < kSynthStateControllers) {
+        ChannelState &cs = state.channels[chan];
+        switch (controller) {
+            case kMIDIControl_DataEntryMSB:
+            case kMIDIControl_DataEntryLSB:
+            case kMIDIControl_DataIncrement:
+            case kMIDIControl_DataDecrement:
+                // act on the selected (N)RPN, so repeating them is not redundant
+                break;
+            case kMIDIControl_ResetAll:
+                memset(cs.cc, kSynthStateUnknown, sizeof(cs.cc));
+                cs.pitchBend = kSynthStateUnknown;
+                break;
+            default:
+                if (controller >= kMIDIControl_ChannelMode) break;
+                if (cs.cc[controller] == value) { elided(); return; }
+                cs.cc[controller] = (int8_t) value;
+                if (controller == kMIDIControl_BankMSB || controller == kMIDIControl_BankLSB) {
+                    cs.bank = kSynthStateUnknown;
+                    cs.program = kSynthStateUnknown;
+                }
+                break;
+        }
+    }
+    forwarded();
+    record((kMIDIChanCmd_Control << 4) | chan, controller, value);
+    trace(kApiTraceOp_Control, chan, controller, value);
+    fluid_synth_cc(synth, chan, controller, value);
+    if (!lock.owns_lock()) markStale(chan);
+}
+
+void SynthEngine::getState(SynthState &out) {
+    std::unique_lock<std::mutex> lock = lockState();
+    smoothers.sync(state);
+    out = state;
+}
+
+void SynthEngine::getStats(SynthStats &out) const {
+    out.forwardedCalls = forwardedCalls.load(std::memory_order_relaxed);
+    out.elidedCalls = elidedCalls.load(std::memory_order_relaxed);
+}
+
+std::unique_lock<std::mutex> SynthEngine::lockState() {
+    std::unique_lock<std::mutex> lock(stateMutex, std::defer_lock);
+    if (renderBlockFrame >= 0) {
+        // never block the render thread: a JNI thread may hold the lock for long
+        if (!lock.try_lock()) return lock;
+    } else {
+        lock.lock();
+    }
+    // the render thread sent to these channels without the shadow: it no longer holds
+    uint32_t stale = staleShadow.exchange(0, std::memory_order_acquire);
+    for (int chan = 0; stale != 0 && chan < kSynthStateChannels; chan++) {
+        if (!(stale & (1u << chan))) continue;
+        ChannelState &cs = state.channels[chan];
+        cs.program = kSynthStateUnknown;
+        cs.bank = kSynthStateUnknown;
+        cs.pitchBend = kSynthStateUnknown;
+        memset(cs.cc, kSynthStateUnknown, sizeof(cs.cc));
+    }
+    if (stale & kStaleEffects) {
+        state.reverbLevel = kSynthStateUnknown;
+        state.chorusLevel = kSynthStateUnknown;
+    }
+    return lock;
+}
+
+void SynthEngine::markStale(int chan) {
+    uint32_t bits = kStaleAll;
+    if (chan < 0) {
+        bits = kStaleEffects;
+    } else if (IS_SHADOWED_CHANNEL(chan)) {
+        bits = 1u << chan;
+    }
+    staleShadow.fetch_or(bits, std::memory_order_release);
+}
+
+void SynthEngine::resetState() {
+    for (ChannelState &cs : state.channels) {
+        cs.program = kSynthStateUnknown;
+        cs.bank = kSynthStateUnknown;
+        cs.pitchBend = kSynthStateUnknown;
+        memset(cs.cc, kSynthStateUnknown, sizeof(cs.cc));
+    }
+    state.reverbLevel = kSynthStateUnknown;
+    state.chorusLevel = kSynthStateUnknown;
+    smoothers.resend();
+}
+
+bool SynthEngine::smoothParam(int param, int chan, int controller, float value, int rampMs) {
+    if (synth == nullptr) return false;
+    return smoothers.setTarget(param, chan, controller, value, rampMs);
+}
+
+void SynthEngine::onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) {
+    if (synth == nullptr) return;
+    int chan = status & 0x0F;
+    switch (status >> 4) {
+        case kMIDIChanCmd_NoteOff:
+            noteOff(chan, data1);
+            break;
+        case kMIDIChanCmd_NoteOn:
+            noteOn(chan, data1, data2);
+            break;
+        case kMIDIChanCmd_KeyPress:
+            record(status, data1, data2);
+            trace(kApiTraceOp_KeyPressure, chan, data1, data2);
+            fluid_synth_key_pressure(synth, chan, data1, data2);
+            break;
+        case kMIDIChanCmd_Control:
+            sendCC(chan, data1, data2);
+            break;
+        case kMIDIChanCmd_ProgramChange:
+            programChange(chan, data1);
+            break;
+        case kMIDIChanCmd_ChannelPress:
+            record(status, data1, 0);
+            trace(kApiTraceOp_ChannelPressure, chan, data1);
+            fluid_synth_channel_pressure(synth, chan, data1);
+            break;
+        case kMIDIChanCmd_PitchWheel:
+            pitchBend(chan, (data2 << 7) | data1);
+            break;
+        default:
+            if (status == kMIDISysCmd_Reset) {
+                std::unique_lock<std::mutex> lock = lockState();
+                if (lock.owns_lock()) {
+                    resetState();
+                } else {
+                    markStale(kSynthStateChannels);
+                    smoothers.resend();
+                }
+                trace(kApiTraceOp_SystemReset, 0, 0);
+                fluid_synth_system_reset(synth);
+            }
+            // other system messages do not affect the synth
+            break;
+    }
+}
+
+void SynthEngine::onMidiSysEx(const uint8_t *data, int length) {
+    if (synth == nullptr) return;
+    fluid_synth_sysex(synth, reinterpret_cast<const char*>(data), length,
+                      nullptr, nullptr, nullptr, 0);
+    // a SysEx may reset or change anything (GM/GS/XG reset, tuning, ...)
+    std::unique_lock<std::mutex> lock = lockState();
+    if (lock.owns_lock()) {
+        resetState();
+    } else {
+        markStale(kSynthStateChannels);
+        smoothers.resend();
+    }
+}
+
+bool SynthEngine::scheduleMidi(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    return eventQueue.push({ frame, status, data1, data2, false });
+}
+
+bool SynthEngine::scheduleEvents(MidiEventQueue &events) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    MidiEvent event;
+    while (events.pop(INT64_MAX, event)) {
+        if (!eventQueue.push(event)) {
+            events.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t SynthEngine::frameAtTime(int64_t timeNs) {
+    int64_t frames, startNs;
+    uint32_t seq;
+    do {
+        seq = clockSeq.load(std::memory_order_acquire);
+        frames = clockFrame.load(std::memory_order_relaxed);
+        startNs = clockTimeNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != clockSeq.load(std::memory_order_relaxed));
+    return frames + (int64_t) ((timeNs - startNs) * 1e-9 * sampleRate);
+}
+
+int64_t SynthEngine::timeAtFrame(int64_t frame) {
+    int64_t frames, startNs;
+    uint32_t seq;
+    do {
+        seq = clockSeq.load(std::memory_order_acquire);
+        frames = clockFrame.load(std::memory_order_relaxed);
+        startNs = clockTimeNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != clockSeq.load(std::memory_order_relaxed));
+    return startNs + (int64_t) ((frame - frames) * 1e9 / sampleRate);
+}
+
+void SynthEngine::setHeartbeatChannel(int chan) {
+    if (chan < 0) chan = -1;
+    int previous = heartbeatChannel.exchange(chan);
+    trace(kApiTraceOp_HeartbeatChannel, 0, chan);
+    // release the soundfont notes left on the channel; the heartbeat voices decay by themselves
+    if (chan >= 0 && chan != previous) sendCC(chan, kMIDIControl_AllNotesOff, 0);
+}
+
+void SynthEngine::setHeart(float bpm, float rmssd) {
+    trace(kApiTraceOp_Heart, 0, floatBits(bpm), floatBits(rmssd));
+    outputChain.getHeartbeat()->setHeart(bpm, rmssd);
+}
+
+void SynthEngine::setOutputGain(float outputGain) {
+    this->outputGain.store(outputGain, std::memory_order_relaxed);
+    trace(kApiTraceOp_OutputGain, 0, floatBits(outputGain));
+    outputChain.getOutputStage()->setGain(outputGain, sampleRate * kOutputGainRampMs / 1000);
+}
+
+int SynthEngine::readGlitches(GlitchEvent *events, int count) {
+    std::lock_guard<std::mutex> lock(glitchMutex);
+    return outputChain.getGlitchDetector()->read(events, count);
+}
+
+bool SynthEngine::startRecording(const char *path, int64_t startFrame) {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    recorder.stop();
+    return recorder.start(path, startFrame);
+}
+
+void SynthEngine::stopRecording() {
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    recorder.stop();
+}
+
+bool SynthEngine::startApiTrace(const char *path) {
+    std::lock_guard<std::mutex> lock(apiTraceMutex);
+    apiTrace.stop();
+    if (!apiTrace.start(path, sampleRate, gain)) return false;
+    apiTracePeriod.store(0);
+    // a replay starts from a new synth: trace the state known so far
+    std::unique_lock<std::mutex> stateLock = lockState();
+    smoothers.sync(state);
+    if (soundfontId != -1) trace(kApiTraceOp_LoadSoundFont, 0, soundfontSize, soundfontHash);
+    // before the controllers: the volume of the heartbeat channel goes to its voices
+    int heartChan = heartbeatChannel.load(std::memory_order_relaxed);
+    if (heartChan >= 0) trace(kApiTraceOp_HeartbeatChannel, 0, heartChan);
+    const HeartbeatEngine *heartbeat = outputChain.getHeartbeat();
+    trace(kApiTraceOp_Heart, 0, floatBits(heartbeat->getBpm()), floatBits(heartbeat->getRmssd()));
+    trace(kApiTraceOp_OutputGain, 0, floatBits(outputGain.load(std::memory_order_relaxed)));
+    for (int chan = 0; chan < kSynthStateChannels; chan++) {
+        const ChannelState &cs = state.channels[chan];
+        for (int cc = 0; cc < kSynthStateControllers; cc++) {
+            if (cs.cc[cc] != kSynthStateUnknown) trace(kApiTraceOp_Control, chan, cc, cs.cc[cc]);
+        }
+        if (cs.bank != kSynthStateUnknown) trace(kApiTraceOp_BankSelect, chan, cs.bank);
+        if (cs.program != kSynthStateUnknown) trace(kApiTraceOp_ProgramChange, chan, cs.program);
+        if (cs.pitchBend != kSynthStateUnknown) trace(kApiTraceOp_PitchBend, chan, cs.pitchBend);
+    }
+    if (state.reverbLevel != kSynthStateUnknown) trace(kApiTraceOp_Reverb, 0, state.reverbLevel);
+    if (state.chorusLevel != kSynthStateUnknown) trace(kApiTraceOp_Chorus, 0, state.chorusLevel);
+    trace(kApiTraceOp_Quality, 0, qualityTier.load(std::memory_order_acquire));
+    for (int chan = 0; chan < kVoiceBudgetChannels; chan++) {
+        int priority = voiceBudget.getPriority(chan);
+        int budget = voiceBudget.getBudget(chan);
+        if (priority != kVoicePriority_Normal || budget != 0) {
+            trace(kApiTraceOp_VoicePriority, chan, priority, budget);
+        }
+    }
+    return true;
+}
+
+void SynthEngine::stopApiTrace() {
+    std::lock_guard<std::mutex> lock(apiTraceMutex);
+    apiTrace.stop();
+}
+
+int64_t SynthEngine::eventFrame() {
+    // calls of the render thread take effect at the start of the block
+    return renderBlockFrame >= 0 ? renderBlockFrame : frameAtTime(nowNs());
+}
+
+void SynthEngine::trace(int op, int chan, int arg1, int arg2) {
+    if (!apiTrace.isTracing()) return;
+    apiTrace.trace(eventFrame(), op, chan, arg1, arg2);
+}
+
+void SynthEngine::record(int status, int data1, int data2) {
+    if (!recorder.isRecording()) return;
+    recorder.record(eventFrame(), (uint8_t) status, (uint8_t) data1, (uint8_t) data2);
+}
+
+void SynthEngine::dispatchEvents(int64_t frame) {
+    uint8_t status, data1, data2;
+    while (postedMidi.pop(status, data1, data2)) {
+        onMidiMessage(status, data1, data2);
+        if (listener) listener->onEngineMidiOut(renderBlockFrame, status, data1, data2);
+    }
+    // never block the render thread, the events will be played on the next block
+    std::unique_lock<std::mutex> lock(eventMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    MidiEvent event;
+    while (eventQueue.pop(frame, event)) {
+        onMidiMessage(event.status, event.data1, event.data2);
+        // played at the start of the block, sent when that is heard
+        if (event.output && listener) {
+            listener->onEngineMidiOut(renderBlockFrame, event.status, event.data1, event.data2);
+        }
+    }
+}
+
+int SynthEngine::render(int len, int nfx, float *fx[], int nout, float *out[], int64_t timeNs) {
+    int64_t startNs = nowNs();
+    int64_t startFrame = renderFrame;
+    renderFrame += len;
+    // publish the (frame, time) pair used to map times to frames
+    clockSeq.fetch_add(1, std::memory_order_acq_rel);
+    clockFrame.store(startFrame, std::memory_order_relaxed);
+    clockTimeNs.store(frameClock.update(startFrame, timeNs), std::memory_order_relaxed);
+    clockSeq.fetch_add(1, std::memory_order_release);
+    outputChain.callback(startFrame, timeNs, len);
+    if (apiTrace.isTracing() && apiTracePeriod.load(std::memory_order_relaxed) != len) {
+        // a replay splits the periods into blocks as below
+        apiTracePeriod.store(len, std::memory_order_relaxed);
+        apiTrace.trace(startFrame, kApiTraceOp_Period, 0, len, 0);
+    }
+    // too many buffers to split: the whole period is a single block, as the driver gave it
+    bool unsplit = nout > kMaxAudioBuffers || nfx > kMaxAudioBuffers;
+    int blockFrames = unsplit ? len : kControlBlockFrames;
+    float *blockOut[kMaxAudioBuffers];
+    // without effects buffers, reverb and chorus both take the dry outputs
+    float *blockFx[2 * kMaxAudioBuffers];
+    for (int offset = 0; offset < len; offset += blockFrames) {
+        int frames = len - offset;
+        if (frames > blockFrames) frames = blockFrames;
+        int64_t blockFrame = startFrame + offset;
+        renderBlockFrame = blockFrame;
+        dispatchEvents(blockFrame + frames);
+        if (listener) listener->onEngineBlock(blockFrame, frames);
+        smoothers.process(frames);
+        applyEffects();
+        renderBlockFrame = -1;
+        if (voiceBudgetEnabled.load(std::memory_order_relaxed)) {
+            voiceBudget.process(synth, blockFrame);
+        }
+        int ret;
+        if (unsplit) {
+            ret = fluid_synth_process(synth, frames, nfx, fx, nout, out);
+            if (ret != FLUID_OK) return ret;
+            if (nout < 2) continue;
+            outputChain.process(blockFrame, out[0], out[1], frames);
+            if (listener) listener->onEngineOutput(blockFrame, out[0], out[1], frames);
+            continue;
+        }
+        for (int i = 0; i < nout; i++) blockOut[i] = out[i] + offset;
+        int blockNfx = nfx;
+        if (nfx == 0) {
+            // the driver has no effects buffers: mix reverb and chorus into the dry output
+            blockNfx = 2 * nout;
+            for (int i = 0; i < blockNfx; i++) blockFx[i] = blockOut[i % nout];
+        } else {
+            for (int i = 0; i < nfx; i++) blockFx[i] = fx[i] + offset;
+        }
+        ret = fluid_synth_process(synth, frames, blockNfx, blockFx, nout, blockOut);
+        if (ret != FLUID_OK) return ret;
+        if (nout < 2) continue;
+        outputChain.process(blockFrame, blockOut[0], blockOut[1], frames);
+        if (listener) listener->onEngineOutput(blockFrame, blockOut[0], blockOut[1], frames);
+    }
+    updateQuality(startNs, len);
+    return FLUID_OK;
+}
+
+void SynthEngine::updateQuality(int64_t startNs, int frames) {
+    int tier = qualityGovernor.update(nowNs() - startNs, frames);
+    if (tier != qualityTier.load(std::memory_order_relaxed)) applyQualityTier(tier);
+}
+
+void SynthEngine::applyQualityTier(int tier) {
+    const QualitySettings &quality = QualityGovernor::getSettings(tier);
+    // only the render thread writes the tier: the API calls read it, no lock on this thread
+    qualityTier.store(tier, std::memory_order_release);
+    trace(kApiTraceOp_Quality, 0, tier);
+    // the synth stops the voices over the new polyphony
+    fluid_synth_set_interp_method(synth, -1, quality.interpolation);
+    fluid_synth_set_polyphony(synth, quality.polyphony);
+    applyEffects();
+}
+
+void SynthEngine::applyEffects() {
+    const QualitySettings &quality =
+            QualityGovernor::getSettings(qualityTier.load(std::memory_order_relaxed));
+    bool reverb = quality.reverb && reverbEnabled.load(std::memory_order_relaxed);
+    bool chorus = quality.chorus && chorusEnabled.load(std::memory_order_relaxed);
+    if (reverb != reverbOn) {
+        reverbOn = reverb;
+        fluid_synth_reverb_on(synth, -1, reverb);
+    }
+    if (chorus != chorusOn) {
+        chorusOn = chorus;
+        fluid_synth_chorus_on(synth, -1, chorus);
+    }
+}
+
+bool SynthEngine::setVoicePriority(int chan, int priority, int budget) {
+    if (!voiceBudget.setChannel(chan, priority, budget)) return false;
+    std::lock_guard<std::mutex> lock(voicePriorityMutex);
+    trace(kApiTraceOp_VoicePriority, chan, priority, budget);
+    if (settings == nullptr) return true;
+    // the synth spares the protected channels if it still has to steal a voice
+    char channels[4 * kVoiceBudgetChannels] = "";
+    int length = 0;
+    for (int i = 0; i < kVoiceBudgetChannels; i++) {
+        if (voiceBudget.getPriority(i) != kVoicePriority_Protected) continue;
+        length += snprintf(channels + length, sizeof(channels) - length,
+                           length > 0 ? ",%d" : "%d", i + 1);
+    }
+    fluid_settings_setstr(settings, "synth.overflow.important-channels", channels);
+    return true;
+}
+
+void SynthEngine::onSmoothedParam(int param, int chan, int controller, float value) {
+    switch (param) {
+        case kSmoothedParam_CC:
+            if (controller == kMIDIControl_Volume &&
+                    chan == heartbeatChannel.load(std::memory_order_relaxed)) {
+                outputChain.getHeartbeat()->setVolume(gain * value / 127.0f);
+            }
+            record((kMIDIChanCmd_Control << 4) | chan, controller, (int) value);
+            trace(kApiTraceOp_Control, chan, controller, (int) value);
+            fluid_synth_cc(synth, chan, controller, (int) value);
+            break;
+        case kSmoothedParam_Reverb:
+            trace(kApiTraceOp_Reverb, 0, (int) value);
+            reverbEnabled.store(value > 0.0f, std::memory_order_relaxed);
+            fluid_synth_set_reverb_group_level(synth, -1, value / 127.0);
+            break;
+        case kSmoothedParam_FilterCutoff:
+            trace(kApiTraceOp_SetGen, chan, GEN_FILTERFC, floatBits(value));
+            fluid_synth_set_gen(synth, chan, GEN_FILTERFC, value);
+            break;
+        default:
+            break;
+    }
+}
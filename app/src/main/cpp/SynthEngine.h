@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SynthEngine.h
+ * @brief Header of SynthEngine class.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_SYNTHENGINE_H
+#define ANDROID_MIDI_SYNTH_SYNTHENGINE_H
+
+#include <fluidsynth.h>
+#include <atomic>
+#include <mutex>
+
+#include "ApiTrace.h"
+#include "FrameClock.h"
+#include "MidiEventQueue.h"
+#include "MidiMessageQueue.h"
+#include "MidiParser.h"
+#include "OutputChain.h"
+#include "QualityGovernor.h"
+#include "SessionRecorder.h"
+#include "SmootherBank.h"
+#include "SynthState.h"
+#include "VoiceBudget.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief SynthEngineListener interface.
+ * @details Receives the hooks of the render loop of a SynthEngine (render thread).
+ */
+class SynthEngineListener {
+public:
+    /** @brief Destructor. */
+    virtual ~SynthEngineListener() = default;
+    /**
+     * @brief A control block starts, after its scheduled events were played.
+     * @details Calls made to the engine from here take effect at the start of the block.
+     * @param frame Audio frame of the block.
+     * @param frames Number of frames of the block.
+     */
+    virtual void onEngineBlock(int64_t frame, int frames) = 0;
+    /**
+     * @brief A played message has to be sent to the MIDI outputs when its frame is heard.
+     * @param frame Audio frame of the message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    virtual void onEngineMidiOut(int64_t frame, uint8_t status, uint8_t data1,
+                                 uint8_t data2) = 0;
+    /**
+     * @brief A block of the output is rendered, after the output stages.
+     * @param frame Audio frame of the first sample.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    virtual void onEngineOutput(int64_t frame, const float *left, const float *right,
+                                int frames) = 0;
+};
+
+/**
+ * @brief SynthEngine class.
+ * @details The render core of the app, without the platform: a FluidSynth synthesizer fed
+ *          at control rate (kControlBlockFrames) with the scheduled and posted MIDI events
+ *          and the smoothed parameters, followed by the output chain. It also keeps the
+ *          shadow of the synth state (redundant calls are elided), the quality tiers, the
+ *          voice budget, the session recorder and the API trace. The audio driver, the MIDI
+ *          ports and the heart-rate pipeline are left to the owner, which calls render()
+ *          from its audio callback; the offline tools call it the same way.
+ */
+class SynthEngine: public MidiListener, public SmootherListener {
+public:
+    /**
+     * @brief Constructor.
+     * @param listener Receives the hooks of the render loop (may be nullptr).
+     * @param sampleRate Sample rate, in Hz.
+     * @param gain Gain of the synth.
+     * @param tier Quality tier at start (QualityTier).
+     */
+    SynthEngine(SynthEngineListener *listener, int sampleRate, float gain, int tier);
+    /** @brief Destructor. */
+    ~SynthEngine() override;
+    /**
+     * @brief Create the synth.
+     * @details Sets the sample rate, the gain and the settings of the quality tier, which
+     *          stay with the synth; the other settings are left to the caller.
+     * @param settings FluidSynth settings (not owned, must outlive the engine).
+     * @param cores Render threads of the synth, or 0 for those of the quality tier.
+     * @return True if successful. False otherwise.
+     */
+    bool open(fluid_settings_t *settings, int cores = 0);
+    /** @brief Delete the synth. The render must be stopped. */
+    void close();
+    /**
+     * @brief Get the synth.
+     * @return The synth, or nullptr if not open.
+     */
+    fluid_synth_t* getSynth() const { return synth; }
+    /**
+     * @brief Hash (FNV-1a) the name of a file, without the directory: the soundfont is
+     *        traced by size and name, not by path.
+     * @param path Path of the file.
+     * @return The hash.
+     */
+    static int hashFileName(const char *path);
+    /**
+     * @brief Load a soundfont file.
+     * @param soundfontPath Full soundfont filename path.
+     * @return True if successful. False otherwise.
+     */
+    bool loadSF(const char *soundfontPath);
+    /**
+     * @brief Program change.
+     * @param chan Channel number.
+     * @param program Program number.
+     */
+    void programChange(int chan, int program);
+    /**
+     * @brief Play a note.
+     * @param chan Channel number.
+     * @param note Note number.
+     * @param velocity The velocity of the note.
+     */
+    void noteOn(int chan, int note, int velocity);
+    /**
+     * @brief Stop of playing a note.
+     * @param chan Channel number.
+     * @param note Note number.
+     */
+    void noteOff(int chan, int note);
+    /**
+     * @brief Send a MIDI command.
+     * @param chan Channel number.
+     * @param controller Controller number.
+     * @param value Value to send.
+     */
+    void sendCC(int chan, int controller, int value);
+    /**
+     * @brief Adjust reverb effect.
+     * @param level Level of the reverb.
+     */
+    void reverb(int level);
+    /**
+     * @brief Adjust chorus effect.
+     * @param level Level of the chorus.
+     */
+    void chorus(int level);
+    /**
+     * @brief Select a bank.
+     * @param chan Channel number.
+     * @param bank Bank number (0-16383).
+     */
+    void bankSelect(int chan, int bank);
+    /**
+     * @brief Set the pitch bend.
+     * @param chan Channel number.
+     * @param value Pitch bend value (0-16383, 8192 is center).
+     */
+    void pitchBend(int chan, int value);
+    /**
+     * @brief Get a consistent copy of the synth state shadow.
+     * @param state Receives the state.
+     */
+    void getState(SynthState &state);
+    /**
+     * @brief Get the counters of the calls (forwarded and elided).
+     * @param stats Receives the counters (the others are left unchanged).
+     */
+    void getStats(SynthStats &stats) const;
+    /**
+     * @brief Ramp a parameter to a new value.
+     * @details The ramp is interpolated at control rate by the render loop, so callers only
+     *          need to push target values (e.g. at sensor rate).
+     * @param param Parameter (SmoothedParam).
+     * @param chan Channel number (ignored for kSmoothedParam_Reverb).
+     * @param controller Controller number (only used for kSmoothedParam_CC).
+     * @param value Target value.
+     * @param rampMs Ramp duration, in milliseconds.
+     * @return True if successful. False if there is no free smoother.
+     */
+    bool smoothParam(int param, int chan, int controller, float value, int rampMs);
+    /**
+     * @brief Play a decoded MIDI message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) override;
+    /**
+     * @brief Send a SysEx message to the synth.
+     * @param data Payload, without the SysEx and End Of SysEx bytes.
+     * @param length Payload length, in bytes.
+     */
+    void onMidiSysEx(const uint8_t *data, int length) override;
+    /**
+     * @brief Post a MIDI message to be played at the start of the next block and sent to the
+     *        MIDI outputs when that is heard (any thread).
+     * @details Lock-free and without I/O: the render thread plays the message, after the
+     *          calls made meanwhile through the other methods.
+     * @param status Status byte (SysEx excluded).
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full (the message is dropped).
+     */
+    bool postMidi(uint8_t status, uint8_t data1, uint8_t data2) {
+        return postedMidi.push(status, data1, data2);
+    }
+    /**
+     * @brief Schedule a MIDI message at an audio frame.
+     * @details The message is played by the render loop at the start of the control block
+     *          that contains the frame (or at once, if the frame is already rendered).
+     * @param frame Audio frame (see frameAtTime()).
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full.
+     */
+    bool scheduleMidi(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2);
+    /**
+     * @brief Move a batch of events to the scheduled events, at once.
+     * @param events The events (emptied).
+     * @return True if successful. False if the queue is full (the rest is dropped).
+     */
+    bool scheduleEvents(MidiEventQueue &events);
+    /**
+     * @brief Get the audio frame rendered at a given time.
+     * @param timeNs Time (steady clock), in nanoseconds.
+     * @return The audio frame.
+     */
+    int64_t frameAtTime(int64_t timeNs);
+    /**
+     * @brief Get the time at which an audio frame is rendered.
+     * @param frame Audio frame.
+     * @return Time (steady clock), in nanoseconds.
+     */
+    int64_t timeAtFrame(int64_t frame);
+    /**
+     * @brief Render a period (audio callback).
+     * @details The period is split in control blocks; before each one the due events are
+     *          played, the listener is called and the smoothed parameters are applied.
+     *          The dry output receives reverb and chorus if there are no effects buffers.
+     * @param len Frames of the period.
+     * @param nfx Number of effects buffers.
+     * @param fx Effects buffers.
+     * @param nout Number of output buffers.
+     * @param out Output buffers.
+     * @param timeNs Time of the callback (steady clock), in nanoseconds.
+     * @return FLUID_OK if successful. FLUID_FAILED otherwise.
+     */
+    int render(int len, int nfx, float *fx[], int nout, float *out[], int64_t timeNs);
+    /**
+     * @brief Play a channel with the procedural heartbeat voices instead of the soundfont.
+     * @details The notes of the channel trigger HeartbeatEngine voices, tuned by the heart
+     *          rate and its variability (setHeart()); its volume controller sets their level.
+     *          The other messages still reach the synth.
+     * @param chan Channel number, or -1 to play every channel with the soundfont.
+     */
+    void setHeartbeatChannel(int chan);
+    /**
+     * @brief Get the channel played with the procedural heartbeat voices.
+     * @return Channel number, or -1 if none.
+     */
+    int getHeartbeatChannel() const { return heartbeatChannel.load(); }
+    /**
+     * @brief Set the heart parameters of the procedural heartbeat voices.
+     * @param bpm Heart rate, in BPM.
+     * @param rmssd Heart-rate variability (RMSSD), in milliseconds.
+     */
+    void setHeart(float bpm, float rmssd);
+    /**
+     * @brief Set the gain of the output stage.
+     * @details The gain is ramped, and the output stage limits the peaks below full scale.
+     * @param gain Linear gain.
+     */
+    void setOutputGain(float gain);
+    /**
+     * @brief Get the stages of the output (heartbeat voices, output stage, glitch detector
+     *        and level meter).
+     * @return The output chain.
+     */
+    OutputChain* getOutputChain() { return &outputChain; }
+    /**
+     * @brief Get the stages of the output.
+     * @return The output chain.
+     */
+    const OutputChain* getOutputChain() const { return &outputChain; }
+    /**
+     * @brief Take the glitches logged since the last call, oldest first.
+     * @details The frames of the events are the frames of the output (after the latency of
+     *          the output stage); see timeAtFrame().
+     * @param events Receives the events.
+     * @param count Capacity of events.
+     * @return The number of events copied.
+     */
+    int readGlitches(GlitchEvent *events, int count);
+    /**
+     * @brief Set the quality tier of the synth: interpolation, polyphony, reverb and chorus.
+     * @details Applied live on the next period, the soundfont stays loaded.
+     * @param tier Quality tier (QualityTier).
+     * @param automatic True to use the tier as a ceiling and step down while the render
+     *                  load is too high.
+     * @return True if successful. False if the tier is invalid.
+     */
+    bool setQualityTier(int tier, bool automatic) {
+        return qualityGovernor.setTier(tier, automatic);
+    }
+    /**
+     * @brief Get the quality tier in use.
+     * @return The tier (QualityTier).
+     */
+    int getQualityTier() const { return qualityGovernor.getTier(); }
+    /**
+     * @brief Get the render load, measured over the last half second.
+     * @return Render time over period time (1 takes the whole period).
+     */
+    float getRenderLoad() const { return qualityGovernor.getLoad(); }
+    /**
+     * @brief Set the voice priority and budget of a channel.
+     * @details The voices of a protected channel are never taken, and voices are kept free
+     *          for it; the voices of a channel over its budget are faded out, released and
+     *          quietest first.
+     * @param chan Channel number.
+     * @param priority Voice priority (VoicePriority).
+     * @param budget Maximum number of voices of the channel (0 for no limit).
+     * @return True if successful. False if an argument is invalid.
+     */
+    bool setVoicePriority(int chan, int priority, int budget);
+    /**
+     * @brief Enable the voice budget (default).
+     * @details Without it the synth steals voices by its own rules, and the released voices
+     *          play to the end.
+     * @param enabled True to manage the voices before each block.
+     */
+    void setVoiceBudget(bool enabled) { voiceBudgetEnabled.store(enabled); }
+    /**
+     * @brief Get the voice counters: voices playing, faded out early and taken.
+     * @param stats Receives the counters.
+     */
+    void getVoiceStats(VoiceStats &stats) const { voiceBudget.getStats(stats); }
+    /**
+     * @brief Start recording the channel messages played by the synth to a MIDI file.
+     * @details Every note, controller, program, pressure and pitch bend message that
+     *          reaches the synth is stamped with its audio frame.
+     * @param path Path of the Standard MIDI File (overwritten).
+     * @param startFrame Audio frame of the start of the file.
+     * @return True if successful. False otherwise.
+     */
+    bool startRecording(const char *path, int64_t startFrame);
+    /** @brief Stop recording and close the MIDI file. */
+    void stopRecording();
+    /**
+     * @brief Get the number of messages lost by the recorder (queue full).
+     * @return The number of messages.
+     */
+    uint64_t getRecordingDropped() const { return recorder.getDropped(); }
+    /**
+     * @brief Start tracing the calls made to the synth, for offline replay.
+     * @details The trace starts with the known synth state (soundfont and shadow state).
+     * @param path Path of the trace file (overwritten).
+     * @return True if successful. False otherwise.
+     */
+    bool startApiTrace(const char *path);
+    /** @brief Stop tracing and close the trace file. */
+    void stopApiTrace();
+    /**
+     * @brief Get the number of calls lost by the trace.
+     * @return The number of calls.
+     */
+    uint64_t getApiTraceDropped() const { return apiTrace.getDropped(); }
+    /**
+     * @brief Send a changed smoothed parameter to the synth (called by the smoothers, render
+     *        thread, without locking).
+     * @param param Parameter (SmoothedParam).
+     * @param chan Channel number.
+     * @param controller Controller number.
+     * @param value New value.
+     */
+    void onSmoothedParam(int param, int chan, int controller, float value) override;
+private:
+    /* @brief Play the scheduled events due before a frame (render thread).
+     * @param frame End frame (exclusive). */
+    void dispatchEvents(int64_t frame);
+    /* @brief Get the audio frame of a call made now (block start on the render thread). */
+    int64_t eventFrame();
+    /* @brief Trace a call made to the synth, if tracing.
+     * @param op The call (ApiTraceOp).
+     * @param chan Channel number.
+     * @param arg1 First argument.
+     * @param arg2 Second argument. */
+    void trace(int op, int chan, int arg1, int arg2 = 0);
+    /* @brief Record a message sent to the synth, if recording.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte. */
+    void record(int status, int data1, int data2);
+    /* @brief Mark every shadow entry as unknown. */
+    void resetState();
+    /* @brief Lock the state shadow. Blocks off the render thread; on the render thread it
+     *        only tries, and the caller goes without the shadow if the lock is busy.
+     * @return The lock (owned if the shadow can be used). */
+    std::unique_lock<std::mutex> lockState();
+    /* @brief Note a call sent to the synth without the shadow: the next lockState() marks
+     *        the entries of the channel as unknown.
+     * @param chan Channel number (-1 for the effects, kSynthStateChannels for the whole
+     *        state). */
+    void markStale(int chan);
+    /* @brief Measure the render load of a period and apply the tier it calls for.
+     * @param startNs Start of the render of the period (steady clock), in nanoseconds.
+     * @param frames Frames of the period. */
+    void updateQuality(int64_t startNs, int frames);
+    /* @brief Apply the settings of a quality tier to the synth (render thread).
+     * @param tier Quality tier (QualityTier). */
+    void applyQualityTier(int tier);
+    /* @brief Switch the reverb and the chorus of the synth on or off, from their levels and
+     *        the quality tier (render thread). */
+    void applyEffects();
+    /* @brief Count a call that is forwarded to the synth. */
+    void forwarded() { forwardedCalls.fetch_add(1, std::memory_order_relaxed); }
+    /* @brief Count a call that is dropped before the synth. */
+    void elided() { elidedCalls.fetch_add(1, std::memory_order_relaxed); }
+private:
+    /* @brief Receives the hooks of the render loop. */
+    SynthEngineListener *listener;
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Gain of the synth. */
+    float gain;
+    /* @brief FluidSynth settings (not owned). */
+    fluid_settings_t *settings;
+    /* @brief FluidSynth synth object. */
+    fluid_synth_t *synth;
+    /* @brief FluidSynth loaded soundfont ID. */
+    int soundfontId;
+    /* @brief Guards the state shadow. */
+    std::mutex stateMutex;
+    /* @brief Shadow of the values last sent to the synth. */
+    SynthState state;
+    /* @brief Channels sent to while the render thread could not lock the shadow (bit n for
+     *        channel n, kStaleEffects for the effects). */
+    std::atomic<uint32_t> staleShadow;
+    /* @brief Statistics counter: calls forwarded to the synth. */
+    std::atomic<uint64_t> forwardedCalls;
+    /* @brief Statistics counter: calls dropped before the synth. */
+    std::atomic<uint64_t> elidedCalls;
+    /* @brief Guards the protected channels of the synth settings. */
+    std::mutex voicePriorityMutex;
+    /* @brief Smoothed parameters. */
+    SmootherBank smoothers;
+    /* @brief MIDI messages posted by postMidi(). */
+    MidiMessageQueue postedMidi;
+    /* @brief Scheduled MIDI events. */
+    MidiEventQueue eventQueue;
+    /* @brief Guards the scheduled MIDI events. */
+    std::mutex eventMutex;
+    /* @brief Channel played with the procedural heartbeat voices, or -1. */
+    std::atomic<int> heartbeatChannel;
+    /* @brief Gain of the output stage (target of its ramp), for the API trace. */
+    std::atomic<float> outputGain;
+    /* @brief Heartbeat voices, output stage, glitch detector and level meter (render
+     *        thread). */
+    OutputChain outputChain;
+    /* @brief Guards reading the glitch log (single consumer). */
+    std::mutex glitchMutex;
+    /* @brief Selection of the quality tier from the render load. */
+    QualityGovernor qualityGovernor;
+    /* @brief Quality tier applied to the synth (written only by the render thread). */
+    std::atomic<int> qualityTier;
+    /* @brief Reverb level above 0, asked by the API calls or the smoothers. */
+    std::atomic<bool> reverbEnabled;
+    /* @brief Chorus level above 0, asked by the API calls. */
+    std::atomic<bool> chorusEnabled;
+    /* @brief Reverb switched on in the synth (render thread). */
+    bool reverbOn;
+    /* @brief Chorus switched on in the synth (render thread). */
+    bool chorusOn;
+    /* @brief Budgets and priorities of the voices (render thread). */
+    VoiceBudget voiceBudget;
+    /* @brief True if the voice budget manages the voices. */
+    std::atomic<bool> voiceBudgetEnabled;
+    /* @brief Recorder of the session to a MIDI file. */
+    SessionRecorder recorder;
+    /* @brief Guards starting and stopping the recorder. */
+    std::mutex recorderMutex;
+    /* @brief Trace of the calls made to the synth. */
+    ApiTrace apiTrace;
+    /* @brief Guards starting and stopping the trace. */
+    std::mutex apiTraceMutex;
+    /* @brief Last render period traced, in frames (0 to trace the next one). */
+    std::atomic<int> apiTracePeriod;
+    /* @brief Size of the loaded soundfont file, in bytes. */
+    int soundfontSize;
+    /* @brief Hash of the name of the loaded soundfont file. */
+    int soundfontHash;
+    /* @brief Audio frames rendered so far (render thread). */
+    int64_t renderFrame;
+    /* @brief Time of the rendered frames, smoothed over the callback jitter (render thread). */
+    FrameClock frameClock;
+    /* @brief First frame of the last rendered period. */
+    std::atomic<int64_t> clockFrame;
+    /* @brief Time of that frame (steady clock), in nanoseconds. */
+    std::atomic<int64_t> clockTimeNs;
+    /* @brief Sequence counter of the clock pair (odd while being written). */
+    std::atomic<uint32_t> clockSeq;
+};
+
+#endif //ANDROID_MIDI_SYNTH_SYNTHENGINE_H
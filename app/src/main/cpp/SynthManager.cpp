@@ -30,14 +30,45 @@
 
 #include <jni.h>
 #include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
+#include "AMidiPort.h"
+#include "ASensorHeartRateSource.h"
 #include "MidiSpec.h"
 #include "SynthManager.h"
 
 /* @brief Default sample rate of the FluidSynth, in kHz. */
 static const int kFluidSynthSampleRate = 44100;
+/* @brief Gain of the FluidSynth (full: the output stage limits the peaks). */
+static const float kFluidSynthGain = 1.0f;
 /* @brief Default latency of the FluidSynth, in ms. */
 static const int kFluidSynthLatency = 10;
+/* @brief Quality tier of the FluidSynth at start (QualityTier). */
+static const int kFluidSynthQualityTier = kQualityTier_High;
+
+/* @brief Delay added to the messages of the input port: a render period and a poll, in ms. */
+static const int kMidiPortDelayMs = kFluidSynthLatency + kMidiReaderPollUs / 1000 + 1;
+/* @brief Delay of the MIDI output after its audio frame is rendered, so it leaves when the
+ *        frame is heard: the look-ahead of the output stage and the driver latency, in ns. */
+static const int64_t kMidiOutDelayNs =
+        kFluidSynthLatency * 1000000LL + kOutputLookAheadFrames * 1000000000LL /
+                                         kFluidSynthSampleRate;
+
+/* @brief Get the monotonic time, in milliseconds. */
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Get the monotonic time, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 /* @brief Calculate the buffer size based in latency value (ms). */
 #define LATENCY_TO_BUFFER_SIZE(x) (kFluidSynthSampleRate * (x) / 1000.0)
@@ -46,34 +77,53 @@ static const int kFluidSynthLatency = 10;
 
 SynthManager* SynthManager::instance = nullptr;
 
-SynthManager::SynthManager(): soundfontId(-1) {
+SynthManager::SynthManager():
+    settings(nullptr), driver(nullptr),
+    engine(this, kFluidSynthSampleRate, kFluidSynthGain, kFluidSynthQualityTier),
+    audioOutput(this),
+    bleMidiPackets(0), bleMidiBytes(0), midiParser(this), midiReader(this),
+    midiInput(nullptr), midiOutput(nullptr), bleMidiEncoder(this), bleMidiEnabled(false),
+    bleMidiHead(0), bleMidiCount(0), bleMidiMessageHead(0), bleMidiMessageCount(0),
+    bleMidiListening(false), midiSender(this), sequencerStepsPerBeat(1), sequencerRunning(false),
+    smfPlayer(this, kFluidSynthSampleRate), smfLoadTimeNs(0),
+    bleMidiDecoder(this), bleMidiArrivalMs(0.0),
+    heartRate(0.0f), heartRateSource(nullptr), heartRateSourceStartNs(0),
+    midiClock(this, kFluidSynthSampleRate) {
     // setup synthesizer
     settings = new_fluid_settings();
     if (settings == nullptr) return;
-    fluid_settings_setint(settings, "synth.cpu-cores", 4);
-    fluid_settings_setnum(settings, "synth.gain", 0.6);
     fluid_settings_setstr(settings, "audio.oboe.performance-mode", "LowLatency");
     fluid_settings_setstr(settings, "audio.oboe.sharing-mode", "Exclusive");
-    fluid_settings_setnum(settings, "synth.sample-rate", kFluidSynthSampleRate);
     setLatency(kFluidSynthLatency);
-    synth = new_fluid_synth(settings);
-    if (synth == nullptr) {
+    if (!engine.open(settings)) {
         delete_fluid_settings(settings);
+        settings = nullptr;
         return;
     }
-    driver = new_fluid_audio_driver(settings, synth);
-    if (driver == nullptr) {
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return;
+    if (!audioOutput.start(kFluidSynthSampleRate, kFluidSynthLatency)) {
+        // no AAudio stream: the driver of the synth runs the render core instead
+        driver = new_fluid_audio_driver2(settings, renderCallback, this);
+        if (driver == nullptr) {
+            engine.close();
+            delete_fluid_settings(settings);
+            settings = nullptr;
+            return;
+        }
     }
+    midiSender.start();
 }
 
 SynthManager::~SynthManager() {
     // clean up
-    if (synth && soundfontId != -1) fluid_synth_sfunload(synth, soundfontId, 1);
+    midiSender.stop();
+    stopHeartRateSource();
+    stopRecording();
+    stopAudioCapture();
+    stopApiTrace();
+    closeMidiPorts();
+    audioOutput.stop();
     if (driver) delete_fluid_audio_driver(driver);
-    if (synth) delete_fluid_synth(synth);
+    engine.close();
     if (settings) delete_fluid_settings(settings);
 }
 
@@ -89,40 +139,404 @@ void SynthManager::freeInstance() {
     }
 }
 
-bool SynthManager::loadSF(const char *soundfontPath) {
-    if (synth == nullptr) return false;
-    // load soundfont
-    int id = fluid_synth_sfload(synth, soundfontPath, 0);
-    if (id == FLUID_FAILED) return false;
-    fluid_synth_sfont_select(synth, 0, id);
-    soundfontId = id;
+void SynthManager::getStats(SynthStats &out) {
+    engine.getStats(out);
+    out.bleMidiPackets = bleMidiPackets.load(std::memory_order_relaxed);
+    out.bleMidiBytes = bleMidiBytes.load(std::memory_order_relaxed);
+}
+
+void SynthManager::sendMidi(const uint8_t *data, int length) {
+    if (engine.getSynth() == nullptr) return;
+    std::lock_guard<std::mutex> lock(midiMutex);
+    midiParser.parse(data, length);
+}
+
+void SynthManager::onMidiPortMessage(int64_t timestampNs, uint8_t status, uint8_t data1,
+                                     uint8_t data2) {
+    // a fixed delay from the port timestamp absorbs the polling and the render period
+    int64_t frame = frameAtTime(timestampNs + kMidiPortDelayMs * 1000000LL);
+    if (!scheduleMidi(frame, status, data1, data2)) onMidiMessage(status, data1, data2);
+}
+
+void SynthManager::onMidiPortSysEx(int64_t timestampNs, const uint8_t *data, int length) {
+    onMidiSysEx(data, length);
+}
+
+bool SynthManager::openMidiPorts(MidiInputPort *input, MidiOutputPort *output) {
+    closeMidiPorts();
+    std::lock_guard<std::mutex> lock(midiPortMutex);
+    if (input && !midiReader.start(input)) {
+        delete input;
+        delete output;
+        return false;
+    }
+    midiInput = input;
+    midiOutput = output;
+    return true;
+}
+
+void SynthManager::closeMidiPorts() {
+    std::lock_guard<std::mutex> lock(midiPortMutex);
+    midiReader.stop();
+    delete midiInput;
+    delete midiOutput;
+    midiInput = nullptr;
+    midiOutput = nullptr;
+}
+
+void SynthManager::midiOut(uint8_t status, uint8_t data1, uint8_t data2) {
+    sendMidiOut(nowNs(), status, data1, data2);
+}
+
+void SynthManager::queueMidiOut(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+    midiSender.push(timeAtFrame(frame) + kMidiOutDelayNs, status, data1, data2);
+}
+
+void SynthManager::onMidiClock(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+    queueMidiOut(frame, status, data1, data2);
+}
+
+void SynthManager::onMidiSend(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2) {
+    sendMidiOut(timeNs, status, data1, data2);
+}
+
+void SynthManager::sendMidiOut(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2) {
+    uint8_t message[] = { status, data1, data2 };
+    int length = 1 + MidiParser::dataLength(status);
+    {
+        std::lock_guard<std::mutex> lock(midiPortMutex);
+        if (midiOutput) midiOutput->send(message, length, timeNs);
+    }
+    std::lock_guard<std::mutex> lock(bleMidiMutex);
+    // the BLE-MIDI timestamps carry the time of the message, not the time it was encoded
+    if (bleMidiEnabled) bleMidiEncoder.add(timeNs / 1000000, message, length);
+    if (bleMidiListening) {
+        if (bleMidiMessageCount == kBleMidiQueueMessages) {
+            // nobody waits: drop the oldest message
+            bleMidiMessageHead = (bleMidiMessageHead + 1) % kBleMidiQueueMessages;
+            bleMidiMessageCount--;
+        }
+        bleMidiMessages[(bleMidiMessageHead + bleMidiMessageCount) % kBleMidiQueueMessages] =
+                status | (data1 << 8) | (data2 << 16);
+        bleMidiMessageCount++;
+        bleMidiCondition.notify_one();
+    }
+}
+
+void SynthManager::listenBleMidi(bool enabled) {
+    std::lock_guard<std::mutex> lock(bleMidiMutex);
+    bleMidiListening = enabled;
+    bleMidiMessageCount = 0;
+    bleMidiCondition.notify_all();
+}
+
+int SynthManager::waitBleMidiMessages(uint32_t *messages, int maxCount, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(bleMidiMutex);
+    bleMidiCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+        return bleMidiMessageCount > 0 || !bleMidiListening;
+    });
+    int count = 0;
+    while (count < maxCount && bleMidiMessageCount > 0) {
+        messages[count++] = bleMidiMessages[bleMidiMessageHead];
+        bleMidiMessageHead = (bleMidiMessageHead + 1) % kBleMidiQueueMessages;
+        bleMidiMessageCount--;
+    }
+    return count;
+}
+
+void SynthManager::configureBleMidi(int packetSize, int maxDelayMs) {
+    std::lock_guard<std::mutex> lock(bleMidiMutex);
+    bleMidiEncoder.configure(packetSize, maxDelayMs);
+    bleMidiEnabled = packetSize > 0;
+    if (!bleMidiEnabled) bleMidiCount = 0;
+}
+
+void SynthManager::flushBleMidi() {
+    std::lock_guard<std::mutex> lock(bleMidiMutex);
+    bleMidiEncoder.flush();
+}
+
+int SynthManager::pollBleMidi(uint8_t *packet, int maxLength) {
+    std::lock_guard<std::mutex> lock(bleMidiMutex);
+    bleMidiEncoder.poll(nowMs());
+    if (bleMidiCount == 0) return 0;
+    const BleMidiPacket &queued = bleMidiQueue[bleMidiHead];
+    int length = queued.length < maxLength ? queued.length : maxLength;
+    memcpy(packet, queued.data, length);
+    bleMidiHead = (bleMidiHead + 1) % kBleMidiQueuePackets;
+    bleMidiCount--;
+    return length;
+}
+
+void SynthManager::onBleMidiPacket(const uint8_t *packet, int length) {
+    // called with bleMidiMutex held; drop the oldest packet if nobody polls
+    if (bleMidiCount == kBleMidiQueuePackets) {
+        bleMidiHead = (bleMidiHead + 1) % kBleMidiQueuePackets;
+        bleMidiCount--;
+    }
+    BleMidiPacket &queued = bleMidiQueue[(bleMidiHead + bleMidiCount) % kBleMidiQueuePackets];
+    memcpy(queued.data, packet, length);
+    queued.length = length;
+    bleMidiCount++;
+    bleMidiPackets.fetch_add(1, std::memory_order_relaxed);
+    bleMidiBytes.fetch_add(length, std::memory_order_relaxed);
+}
+
+bool SynthManager::receiveBleMidi(const uint8_t *packet, int length, int64_t arrivalNs) {
+    if (engine.getSynth() == nullptr) return false;
+    std::lock_guard<std::mutex> lock(bleMidiInMutex);
+    bleMidiArrivalMs = arrivalNs / 1000000.0;
+    return bleMidiDecoder.decode(packet, length);
+}
+
+void SynthManager::resetBleMidi() {
+    std::lock_guard<std::mutex> lock(bleMidiInMutex);
+    bleMidiDecoder.reset();
+    bleMidiSync.reset();
+}
+
+void SynthManager::onBleMidiMessage(int64_t timeMs, uint8_t status, uint8_t data1, uint8_t data2) {
+    // called with bleMidiInMutex held
+    double localMs = bleMidiSync.toLocal(bleMidiArrivalMs, timeMs);
+    int64_t frame = frameAtTime((int64_t) (localMs * 1000000.0));
+    if (!scheduleMidi(frame, status, data1, data2)) onMidiMessage(status, data1, data2);
+}
+
+void SynthManager::onBleMidiSysEx(int64_t timeMs, const uint8_t *data, int length) {
+    onMidiSysEx(data, length);
+}
+
+void SynthManager::updateHeartRate(int64_t timeNs, double bpm) {
+    std::lock_guard<std::mutex> lock(beatMutex);
+    beatTracker.update(timeNs * 1e-9, bpm);
+}
+
+float SynthManager::filterHeartRate(int64_t timeNs, float bpm, int accuracy) {
+    float value;
+    double rmssd;
+    {
+        std::lock_guard<std::mutex> lock(beatMutex);
+        double time = timeNs * 1e-9;
+        if (!heartRateFilter.process(time, bpm, accuracy)) return 0.0f;
+        value = heartRateFilter.getValue();
+        beatTracker.update(time, value);
+        rmssd = hrvAnalyzer.getMetric(kHrvMetric_RMSSD);
+    }
+    heartRate.store(value);
+    engine.setHeart(value, (float) rmssd);
+    return value;
+}
+
+void SynthManager::addHeartBeat(int64_t timeNs, float confidence) {
+    double metrics[kHrvMetricCount];
+    {
+        std::lock_guard<std::mutex> lock(beatMutex);
+        if (!hrvAnalyzer.addBeat(timeNs, confidence)) return;
+        for (int i = 0; i < kHrvMetricCount; i++) metrics[i] = hrvAnalyzer.getMetric(i);
+    }
+    float value = heartRate.load();
+    if (value > 0.0f) engine.setHeart(value, (float) metrics[kHrvMetric_RMSSD]);
+    applyHrvRoutes(metrics);
+}
+
+void SynthManager::getHrv(double *metrics) {
+    std::lock_guard<std::mutex> lock(beatMutex);
+    for (int i = 0; i < kHrvMetricCount; i++) metrics[i] = hrvAnalyzer.getMetric(i);
+}
+
+bool SynthManager::setHrvRoute(int slot, int metric, int chan, int controller,
+                               float minValue, float maxValue) {
+    if (slot < 0 || slot >= kMaxHrvRoutes) return false;
+    if (metric >= kHrvMetricCount || chan < 0 || chan >= kSynthStateChannels ||
+            controller < 0 || controller >= kSynthStateControllers) return false;
+    std::lock_guard<std::mutex> lock(hrvMutex);
+    HrvRoute &route = hrvRoutes[slot];
+    route.active = metric >= 0 && maxValue != minValue;
+    route.metric = metric;
+    route.chan = chan;
+    route.controller = controller;
+    route.minValue = minValue;
+    route.maxValue = maxValue;
+    return true;
+}
+
+void SynthManager::applyHrvRoutes(const double *metrics) {
+    std::lock_guard<std::mutex> lock(hrvMutex);
+    for (HrvRoute &route : hrvRoutes) {
+        if (!route.active) continue;
+        double position = (metrics[route.metric] - route.minValue) /
+                (route.maxValue - route.minValue);
+        if (position < 0.0) position = 0.0;
+        if (position > 1.0) position = 1.0;
+        // unchanged values are elided by sendCC
+        sendCC(route.chan, route.controller, (int) lround(position * 127.0));
+    }
+}
+
+void SynthManager::onHeartRateSample(int64_t timeNs, float bpm, int accuracy) {
+    filterHeartRate(timeNs, bpm, accuracy);
+}
+
+void SynthManager::onHeartBeat(int64_t timeNs, float confidence) {
+    addHeartBeat(timeNs, confidence);
+}
+
+bool SynthManager::startHeartRateSource(HeartRateSource *source) {
+    stopHeartRateSource();
+    std::lock_guard<std::mutex> lock(heartRateSourceMutex);
+    if (source == nullptr) return false;
+    if (!source->start(this)) {
+        delete source;
+        return false;
+    }
+    heartRateSource = source;
+    heartRateSourceStartNs = nowNs();
     return true;
 }
 
-void SynthManager::programChange(int chan, int program) {
-    if (synth == nullptr) return;
-    fluid_synth_program_change(synth, chan, program);
+void SynthManager::stopHeartRateSource() {
+    std::lock_guard<std::mutex> lock(heartRateSourceMutex);
+    delete heartRateSource;
+    heartRateSource = nullptr;
+}
+
+float SynthManager::getHeartRateWakeupsPerMinute() {
+    std::lock_guard<std::mutex> lock(heartRateSourceMutex);
+    if (heartRateSource == nullptr) return 0.0f;
+    double minutes = (nowNs() - heartRateSourceStartNs) / 60e9;
+    if (minutes <= 0.0) return 0.0f;
+    return (float) (heartRateSource->getWakeups() / minutes);
+}
+
+int SynthManager::advanceBeats(int64_t timeNs) {
+    int beats;
+    double beatTime, period;
+    {
+        std::lock_guard<std::mutex> lock(beatMutex);
+        beatTime = beatTracker.getNextBeatTime();
+        beats = beatTracker.advance(timeNs * 1e-9);
+        period = beatTracker.getPeriod();
+    }
+    smfPlayer.setBpm(60.0 / period);
+    if (beats > 0) {
+        // play the step at the beat itself, not when the caller woke up (unless beats were missed)
+        auto beatNs = (int64_t) (beatTime * 1e9);
+        playSequencerBeat(beats == 1 && beatNs <= timeNs ? beatNs : timeNs, period);
+    }
+    return beats;
+}
+
+bool SynthManager::loadPattern(const uint8_t *data, int length) {
+    std::lock_guard<std::mutex> lock(sequencerMutex);
+    return sequencer.load(data, length);
+}
+
+void SynthManager::startSequencer(int stepsPerBeat) {
+    std::lock_guard<std::mutex> lock(sequencerMutex);
+    sequencer.rewind();
+    sequencerStepsPerBeat = stepsPerBeat > 0 ? stepsPerBeat : 1;
+    sequencerRunning = true;
+}
+
+void SynthManager::stopSequencer() {
+    std::lock_guard<std::mutex> lock(sequencerMutex);
+    sequencerRunning = false;
+}
+
+void SynthManager::setSequencerVelocity(float scale) {
+    std::lock_guard<std::mutex> lock(sequencerMutex);
+    sequencer.setVelocityScale(scale);
+}
+
+bool SynthManager::loadMidiFile(const char *path) {
+    std::lock_guard<std::mutex> lock(smfMutex);
+    int64_t start = nowNs();
+    bool result = smfPlayer.load(path);
+    smfLoadTimeNs = nowNs() - start;
+    return result;
+}
+
+void SynthManager::playMidiFile(bool loop) {
+    std::lock_guard<std::mutex> lock(smfMutex);
+    smfPlayer.setLoop(loop);
+    smfPlayer.play();
+}
+
+void SynthManager::stopMidiFile() {
+    std::lock_guard<std::mutex> lock(smfMutex);
+    smfPlayer.stop();
 }
 
-void SynthManager::noteOn(int chan, int note, int velocity) {
-    if (synth == nullptr) return;
-    fluid_synth_noteon(synth, chan , note, velocity);
+bool SynthManager::seekMidiFile(int64_t tick) {
+    std::lock_guard<std::mutex> lock(smfMutex);
+    return smfPlayer.seek(tick);
 }
 
-void SynthManager::noteOff(int chan, int note) {
-    if (synth == nullptr) return;
-    fluid_synth_noteoff(synth, chan, note);
+void SynthManager::getMidiFileInfo(int64_t &loadTimeNs, int64_t &indexBytes, int &tracks,
+                                   int64_t &length, int64_t &position) {
+    std::lock_guard<std::mutex> lock(smfMutex);
+    loadTimeNs = smfLoadTimeNs;
+    indexBytes = (int64_t) smfPlayer.getIndexBytes();
+    tracks = smfPlayer.getTrackCount();
+    length = smfPlayer.getLength();
+    position = smfPlayer.getPosition();
 }
 
-void SynthManager::reverb(int level) {
-    if (synth == nullptr) return;
-    fluid_synth_reverb_on(synth, -1, level > 0);
-    fluid_synth_set_reverb_group_level(synth, -1, level / 127.0);
+bool SynthManager::startRecording(const char *path) {
+    return engine.startRecording(path, frameAtTime(nowNs()));
 }
 
-void SynthManager::sendCC(int chan, int controller, int value) {
-    if (synth == nullptr) return;
-    fluid_synth_cc(synth, chan, controller, value);
+bool SynthManager::startAudioCapture(const char *path, int bitrate) {
+    std::lock_guard<std::mutex> lock(audioCaptureMutex);
+    audioCapture.stop();
+    return audioCapture.start(path, kFluidSynthSampleRate, bitrate);
+}
+
+void SynthManager::stopAudioCapture() {
+    std::lock_guard<std::mutex> lock(audioCaptureMutex);
+    audioCapture.stop();
+}
+
+void SynthManager::getAudioCaptureStats(int64_t &cpuNs, int64_t &frames, int64_t &bytes,
+                                        int64_t &overruns) {
+    cpuNs = audioCapture.getEncoderCpuNs();
+    frames = audioCapture.getEncodedFrames();
+    bytes = audioCapture.getBytesWritten();
+    overruns = (int64_t) audioCapture.getOverruns();
+}
+
+void SynthManager::playSequencerBeat(int64_t beatNs, double period) {
+    std::lock_guard<std::mutex> lock(sequencerMutex);
+    if (!sequencerRunning) return;
+    int64_t frame = frameAtTime(beatNs);
+    double framesPerStep = period * kFluidSynthSampleRate / sequencerStepsPerBeat;
+    for (int i = 0; i < sequencerStepsPerBeat; i++) {
+        sequencer.step(frame + (int64_t) (i * framesPerStep), framesPerStep, sequencerEvents);
+    }
+    engine.scheduleEvents(sequencerEvents);
+}
+
+int64_t SynthManager::getNextBeatTime() {
+    std::lock_guard<std::mutex> lock(beatMutex);
+    return (int64_t) (beatTracker.getNextBeatTime() * 1e9);
+}
+
+int SynthManager::renderCallback(void *data, int len, int nfx, float *fx[], int nout, float *out[]) {
+    return static_cast<SynthManager*>(data)->engine.render(len, nfx, fx, nout, out, nowNs());
+}
+
+void SynthManager::onAudioOutput(float *left, float *right, int frames) {
+    float *out[2] = {left, right};
+    engine.render(frames, 0, nullptr, 2, out, nowNs());
+}
+
+void SynthManager::onEngineBlock(int64_t frame, int frames) {
+    {
+        // never block the render thread, the player catches up on the next block
+        std::unique_lock<std::mutex> lock(smfMutex, std::try_to_lock);
+        if (lock.owns_lock()) smfPlayer.process(frames);
+    }
+    midiClock.process(frame, frames);
 }
 
 void SynthManager::setLatency(int ms){
@@ -133,6 +547,9 @@ void SynthManager::setLatency(int ms){
 
 // -----------------------------------------------------------------------------------------------
 
+/* @brief AMidi device whose ports are connected to the synth. */
+static AMidiDevice *midiDevice = nullptr;
+
 extern "C" {
 
 /**
@@ -141,7 +558,7 @@ extern "C" {
  * @param   env            JNI Env pointer.
  * @param   (unnamed)      SynthManager (Java) object.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthInit(
         JNIEnv *env, jobject) {
     SynthManager::getInstance();
@@ -155,7 +572,7 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthInit(
  * @param   jSoundfontPath The soundfont filename full path.
  * @param   program        The number of the program
  */
-JNIEXPORT int JNICALL
+static int JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthLoadSF(
         JNIEnv *env, jobject, jstring jSoundfontPath) {
     // convert Java string to C string
@@ -169,10 +586,14 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthLoadSF(
  * @param   env            JNI Env pointer.
  * @param   (unnamed)      SynthManager (Java) object.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthFree(
         JNIEnv *env, jobject) {
     SynthManager::freeInstance();
+    if (midiDevice) {
+        AMidiDevice_release(midiDevice);
+        midiDevice = nullptr;
+    }
 }
 
 /**
@@ -183,10 +604,12 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthFree(
  * @param   note           The note to be played.
  * @param   velocity       The velocity of the note to be played.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthProgramChange(
         JNIEnv *env, jobject, int chan, int program) {
-    SynthManager::getInstance()->programChange(chan, program);
+    SynthManager *manager = SynthManager::getInstance();
+    manager->programChange(chan, program);
+    manager->midiOut((kMIDIChanCmd_ProgramChange << 4) | chan, program, 0);
 }
 
 /**
@@ -197,10 +620,12 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthProgramChange(
  * @param   note           The note to be played.
  * @param   velocity       The velocity of the note to be played.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthNoteOn(
         JNIEnv *env, jobject, int chan, int note, int velocity) {
-    SynthManager::getInstance()->noteOn(chan, note, velocity);
+    SynthManager *manager = SynthManager::getInstance();
+    manager->noteOn(chan, note, velocity);
+    manager->midiOut((kMIDIChanCmd_NoteOn << 4) | chan, note, velocity);
 }
 
 /**
@@ -210,10 +635,12 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthNoteOn(
  * @param   (unnamed)      SynthManager (Java) object.
  * @param   note           The note to be stopped.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthNoteOff(
         JNIEnv *env, jobject, int chan,  int note) {
-    SynthManager::getInstance()->noteOff(chan, note);
+    SynthManager *manager = SynthManager::getInstance();
+    manager->noteOff(chan, note);
+    manager->midiOut((kMIDIChanCmd_NoteOff << 4) | chan, note, 0);
 }
 
 /**
@@ -224,10 +651,12 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthNoteOff(
  * @param   controller     Number of the controller.
  * @param   value          Value to send.
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthCC(
         JNIEnv *env, jobject, int chan ,int controller, int value) {
-    SynthManager::getInstance()->sendCC(chan, controller, value);
+    SynthManager *manager = SynthManager::getInstance();
+    manager->sendCC(chan, controller, value);
+    manager->midiOut((kMIDIChanCmd_Control << 4) | chan, controller, value);
 }
 
 /**
@@ -237,10 +666,1233 @@ Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthCC(
  * @param   (unnamed)      SynthManager (Java) object.
  * @param   level          The reverb level (0 to 127).
  */
-JNIEXPORT void JNICALL
+static void JNICALL
 Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthReverb(
         JNIEnv *env, jobject, int level) {
     SynthManager::getInstance()->reverb(level);
 }
 
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthChorus() method.
+ * @details Sets the chorus level.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   level          The chorus level (0 to 127).
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthChorus(
+        JNIEnv *env, jobject, int level) {
+    SynthManager::getInstance()->chorus(level);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthPitchBend() method.
+ * @details Sets the pitch bend of a channel.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           The channel.
+ * @param   value          The pitch bend value (0 to 16383).
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthPitchBend(
+        JNIEnv *env, jobject, int chan, int value) {
+    SynthManager::getInstance()->pitchBend(chan, value);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmoothCC() method.
+ * @details Ramps a controller of a channel to a new value.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           The channel.
+ * @param   controller     Number of the controller.
+ * @param   value          Target value (0 to 127).
+ * @param   rampMs         Ramp duration, in milliseconds.
+ * @return  0 if successful, -1 if there is no free smoother.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmoothCC(
+        JNIEnv *env, jobject, int chan, int controller, float value, int rampMs) {
+    return SynthManager::getInstance()->smoothParam(
+            kSmoothedParam_CC, chan, controller, value, rampMs) ? 0 : -1;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmoothReverb() method.
+ * @details Ramps the reverb level to a new value.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   level          Target reverb level (0 to 127).
+ * @param   rampMs         Ramp duration, in milliseconds.
+ * @return  0 if successful, -1 if there is no free smoother.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmoothReverb(
+        JNIEnv *env, jobject, float level, int rampMs) {
+    return SynthManager::getInstance()->smoothParam(
+            kSmoothedParam_Reverb, 0, 0, level, rampMs) ? 0 : -1;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmoothFilterCutoff() method.
+ * @details Ramps the filter cutoff offset of a channel to a new value.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           The channel.
+ * @param   cents          Target cutoff offset, in cents.
+ * @param   rampMs         Ramp duration, in milliseconds.
+ * @return  0 if successful, -1 if there is no free smoother.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmoothFilterCutoff(
+        JNIEnv *env, jobject, int chan, float cents, int rampMs) {
+    return SynthManager::getInstance()->smoothParam(
+            kSmoothedParam_FilterCutoff, chan, 0, cents, rampMs) ? 0 : -1;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSendMidi() method.
+ * @details Plays a raw MIDI byte stream.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jData          MIDI bytes.
+ * @param   offset         Offset of the first byte.
+ * @param   length         Number of bytes.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSendMidi(
+        JNIEnv *env, jobject, jbyteArray jData, int offset, int length) {
+    SynthManager *manager = SynthManager::getInstance();
+    jbyte buffer[256];
+    while (length > 0) {
+        int count = length > (int) sizeof(buffer) ? (int) sizeof(buffer) : length;
+        env->GetByteArrayRegion(jData, offset, count, buffer);
+        if (env->ExceptionCheck()) return;
+        manager->sendMidi(reinterpret_cast<const uint8_t*>(buffer), count);
+        offset += count;
+        length -= count;
+    }
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthOpenMidiDevice() method.
+ * @details Connects the ports of a MIDI device (USB, virtual, ...) to the synth: MIDI received
+ *          from the device is played natively and the notes played by the app are sent to it.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jDevice        The opened android.media.midi.MidiDevice.
+ * @param   inputPort      Device input port to send MIDI to, or -1 for none.
+ * @param   outputPort     Device output port to receive MIDI from, or -1 for none.
+ * @return  0 if successful, -1 otherwise.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthOpenMidiDevice(
+        JNIEnv *env, jobject, jobject jDevice, int inputPort, int outputPort) {
+    SynthManager *manager = SynthManager::getInstance();
+    manager->closeMidiPorts();
+    if (midiDevice) {
+        AMidiDevice_release(midiDevice);
+        midiDevice = nullptr;
+    }
+    if (AMidiDevice_fromJava(env, jDevice, &midiDevice) != AMEDIA_OK) {
+        midiDevice = nullptr;
+        return -1;
+    }
+    AMidiOutput *output = inputPort >= 0 ? AMidiOutput::open(midiDevice, inputPort) : nullptr;
+    AMidiInput *input = outputPort >= 0 ? AMidiInput::open(midiDevice, outputPort) : nullptr;
+    bool opened = (inputPort < 0 || output != nullptr) && (outputPort < 0 || input != nullptr);
+    if (opened) {
+        // deletes the ports on failure
+        opened = manager->openMidiPorts(input, output);
+    } else {
+        delete output;
+        delete input;
+    }
+    if (!opened) {
+        AMidiDevice_release(midiDevice);
+        midiDevice = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthCloseMidiDevice() method.
+ * @details Disconnects the MIDI device ports from the synth.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthCloseMidiDevice(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->closeMidiPorts();
+    if (midiDevice) {
+        AMidiDevice_release(midiDevice);
+        midiDevice = nullptr;
+    }
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthMidiOut() method.
+ * @details Sends a MIDI message to the MIDI outputs only (not played by the synth).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   status         Status byte.
+ * @param   data1          First data byte.
+ * @param   data2          Second data byte.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthMidiOut(
+        JNIEnv *env, jobject, int status, int data1, int data2) {
+    SynthManager::getInstance()->midiOut(status, data1, data2);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiConfigure() method.
+ * @details Enables or disables the BLE-MIDI encoder of the MIDI output.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   packetSize     Maximum packet size, in bytes (ATT MTU - 3), or 0 to disable.
+ * @param   maxDelayMs     Maximum time a message waits for other messages, in milliseconds.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiConfigure(
+        JNIEnv *env, jobject, int packetSize, int maxDelayMs) {
+    SynthManager::getInstance()->configureBleMidi(packetSize, maxDelayMs);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiFlush() method.
+ * @details Completes the pending BLE-MIDI packet.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiFlush(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->flushBleMidi();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiPoll() method.
+ * @details Gets the next completed BLE-MIDI packet.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPacket        Receives the packet.
+ * @return  The packet length, or 0 if there is no packet.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiPoll(
+        JNIEnv *env, jobject, jbyteArray jPacket) {
+    uint8_t packet[kBleMidiMaxPacket];
+    int maxLength = env->GetArrayLength(jPacket);
+    if (maxLength > kBleMidiMaxPacket) maxLength = kBleMidiMaxPacket;
+    int length = SynthManager::getInstance()->pollBleMidi(packet, maxLength);
+    if (length > 0) {
+        env->SetByteArrayRegion(jPacket, 0, length, reinterpret_cast<const jbyte*>(packet));
+    }
+    return length;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiListen() method.
+ * @details Enables or disables the queue of MIDI output messages for a BLE library.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   enabled        True to queue the messages.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiListen(
+        JNIEnv *env, jobject, jboolean enabled) {
+    SynthManager::getInstance()->listenBleMidi(enabled);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiMessages() method.
+ * @details Waits for the MIDI output messages queued for a BLE library.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jMessages      Receives the messages (status | data1 << 8 | data2 << 16).
+ * @param   timeoutMs      Longest wait, in milliseconds.
+ * @return  The number of messages (0 on timeout).
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiMessages(
+        JNIEnv *env, jobject, jintArray jMessages, int timeoutMs) {
+    uint32_t messages[kBleMidiQueueMessages];
+    int maxCount = env->GetArrayLength(jMessages);
+    if (maxCount > kBleMidiQueueMessages) maxCount = kBleMidiQueueMessages;
+    int count = SynthManager::getInstance()->waitBleMidiMessages(messages, maxCount, timeoutMs);
+    if (count > 0) {
+        env->SetIntArrayRegion(jMessages, 0, count, reinterpret_cast<const jint*>(messages));
+    }
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiReceive() method.
+ * @details Plays a received BLE-MIDI packet with the sender timing.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPacket        Packet bytes.
+ * @param   length         Packet length, in bytes.
+ * @return  0 if successful, -1 if the packet is invalid.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiReceive(
+        JNIEnv *env, jobject, jbyteArray jPacket, int length) {
+    int64_t arrivalNs = nowNs();
+    uint8_t packet[kBleMidiMaxPacket];
+    if (length > kBleMidiMaxPacket) return -1;
+    env->GetByteArrayRegion(jPacket, 0, length, reinterpret_cast<jbyte*>(packet));
+    if (env->ExceptionCheck()) return -1;
+    return SynthManager::getInstance()->receiveBleMidi(packet, length, arrivalNs) ? 0 : -1;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBleMidiReset() method.
+ * @details Forgets the clock offset and the delivery delays of the BLE-MIDI input.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBleMidiReset(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->resetBleMidi();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthMidiClockTempo() method.
+ * @details Sets the tempo followed by the MIDI clock.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   bpm            Tempo, in BPM.
+ * @param   maxSlew        Maximum tempo change, in BPM per second (0 follows at once).
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthMidiClockTempo(
+        JNIEnv *env, jobject, float bpm, float maxSlew) {
+    MidiClock *clock = SynthManager::getInstance()->getMidiClock();
+    clock->setMaxSlew(maxSlew);
+    clock->setTempo(bpm);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthMidiClockStart() method.
+ * @details Starts the MIDI clock.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   songPosition   Position to start from, in MIDI beats (sixteenth notes).
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthMidiClockStart(
+        JNIEnv *env, jobject, int songPosition) {
+    SynthManager::getInstance()->getMidiClock()->start(songPosition);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthMidiClockStop() method.
+ * @details Stops the MIDI clock.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthMidiClockStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->getMidiClock()->stop();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBeatTrackerUpdate() method.
+ * @details Feeds a heart-rate sample to the beat tracker.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   bpm            Heart rate, in BPM.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBeatTrackerUpdate(
+        JNIEnv *env, jobject, float bpm) {
+    SynthManager::getInstance()->updateHeartRate(nowNs(), bpm);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartRateSample() method.
+ * @details Feeds a raw heart-rate sensor sample to the signal pipeline (and, when accepted,
+ *          to the beat tracker).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   bpm            Raw heart rate, in BPM.
+ * @param   accuracy       Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+ * @return  The filtered heart rate, in BPM, or 0 if the sample was gated out.
+ */
+static float JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartRateSample(
+        JNIEnv *env, jobject, float bpm, int accuracy) {
+    return SynthManager::getInstance()->filterHeartRate(nowNs(), bpm, accuracy);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartBeat() method.
+ * @details Feeds a beat of the heart-beat sensor to the heart-rate variability analysis.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   timeNs         Time of the beat (System.nanoTime()), in nanoseconds.
+ * @param   confidence     Confidence of the detection (0 to 1).
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartBeat(
+        JNIEnv *env, jobject, jlong timeNs, float confidence) {
+    SynthManager::getInstance()->addHeartBeat(timeNs, confidence);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartRateSensorStart() method.
+ * @details Starts reading the heart-rate sensor natively (ASensorManager on a looper thread),
+ *          feeding the signal pipeline without waking the JVM.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPackageName   Package name of the application.
+ * @param   batchLatencyMs Maximum report latency of the sensor FIFO, in milliseconds.
+ * @return  True if successful. False otherwise (e.g. no heart-rate sensor).
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartRateSensorStart(
+        JNIEnv *env, jobject, jstring jPackageName, int batchLatencyMs) {
+    const char *packageName = env->GetStringUTFChars(jPackageName, nullptr);
+    auto *source = new ASensorHeartRateSource(
+            packageName, kHeartRateSamplingUs, (int64_t) batchLatencyMs * 1000);
+    env->ReleaseStringUTFChars(jPackageName, packageName);
+    return SynthManager::getInstance()->startHeartRateSource(source) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartRateSensorStop() method.
+ * @details Stops reading the heart-rate sensor natively.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartRateSensorStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopHeartRateSource();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartRateSensorWakeups() method.
+ * @details Gets the wakeups of the native sensor reader.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  Wakeups per minute, or 0 if the native reader is not running.
+ */
+static float JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartRateSensorWakeups(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getHeartRateWakeupsPerMinute();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartRateValue() method.
+ * @details Gets the last filtered heart rate.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  Heart rate, in BPM, or 0 if no sample was accepted yet.
+ */
+static float JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartRateValue(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getHeartRate();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGetHrv() method.
+ * @details Copies the heart-rate variability metrics: RMSSD (ms), SDNN (ms), pNN50 (%).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jMetrics       Receives the metrics.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGetHrv(
+        JNIEnv *env, jobject, jfloatArray jMetrics) {
+    double metrics[kHrvMetricCount];
+    SynthManager::getInstance()->getHrv(metrics);
+    jfloat values[kHrvMetricCount];
+    for (int i = 0; i < kHrvMetricCount; i++) values[i] = (jfloat) metrics[i];
+    int count = env->GetArrayLength(jMetrics);
+    if (count > kHrvMetricCount) count = kHrvMetricCount;
+    env->SetFloatArrayRegion(jMetrics, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHrvRoute() method.
+ * @details Routes a heart-rate variability metric to a controller.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   slot           Route slot.
+ * @param   metric         The metric (0 RMSSD, 1 SDNN, 2 pNN50), or -1 to clear the slot.
+ * @param   chan           Channel number.
+ * @param   controller     Controller number.
+ * @param   minValue       Metric value mapped to 0.
+ * @param   maxValue       Metric value mapped to 127.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHrvRoute(
+        JNIEnv *env, jobject, int slot, int metric, int chan, int controller,
+        float minValue, float maxValue) {
+    return SynthManager::getInstance()->setHrvRoute(
+            slot, metric, chan, controller, minValue, maxValue) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBeatTrackerAdvance() method.
+ * @details Advances the beat tracker to now.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  The number of beats since the previous call.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBeatTrackerAdvance(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->advanceBeats(nowNs());
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthBeatTrackerNextBeat() method.
+ * @details Gets the time of the next beat.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  Time of the next beat (CLOCK_MONOTONIC, same base as SystemClock.uptimeMillis()),
+ *          in milliseconds.
+ */
+static jlong JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthBeatTrackerNextBeat(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getNextBeatTime() / 1000000;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSequencerLoad() method.
+ * @details Loads a pattern into the sequencer (binary or text format).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jData          Pattern data.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSequencerLoad(
+        JNIEnv *env, jobject, jbyteArray jData) {
+    std::vector<jbyte> data(env->GetArrayLength(jData));
+    env->GetByteArrayRegion(jData, 0, (jsize) data.size(), data.data());
+    return SynthManager::getInstance()->loadPattern(
+            reinterpret_cast<const uint8_t*>(data.data()), (int) data.size())
+            ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSequencerStart() method.
+ * @details Starts the pattern sequencer from the first step; it plays on the beats of the
+ *          beat tracker.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   stepsPerBeat   Number of steps played on each beat.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSequencerStart(
+        JNIEnv *env, jobject, int stepsPerBeat) {
+    SynthManager::getInstance()->startSequencer(stepsPerBeat);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSequencerStop() method.
+ * @details Stops the pattern sequencer.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSequencerStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopSequencer();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSequencerVelocity() method.
+ * @details Sets the velocity scale of the pattern sequencer.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   scale          Factor applied to the velocities of the pattern.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSequencerVelocity(
+        JNIEnv *env, jobject, float scale) {
+    SynthManager::getInstance()->setSequencerVelocity(scale);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmfLoad() method.
+ * @details Loads a Standard MIDI File into the tempo-following player.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPath          The MIDI file full path.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmfLoad(
+        JNIEnv *env, jobject, jstring jPath) {
+    const char *path = env->GetStringUTFChars(jPath, nullptr);
+    bool result = SynthManager::getInstance()->loadMidiFile(path);
+    env->ReleaseStringUTFChars(jPath, path);
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmfPlay() method.
+ * @details Starts (or resumes) playing the MIDI file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   loop           True to restart at the end of the file.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmfPlay(
+        JNIEnv *env, jobject, jboolean loop) {
+    SynthManager::getInstance()->playMidiFile(loop);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmfStop() method.
+ * @details Stops playing the MIDI file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmfStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopMidiFile();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmfSeek() method.
+ * @details Moves the playback position of the MIDI file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   tick           Position, in ticks.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmfSeek(
+        JNIEnv *env, jobject, jlong tick) {
+    return SynthManager::getInstance()->seekMidiFile(tick) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthSmfInfo() method.
+ * @details Copies information about the MIDI file: load time (us), memory of the seek index
+ *          (bytes), number of tracks, length (ticks) and playback position (ticks).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jInfo          Receives the values.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthSmfInfo(
+        JNIEnv *env, jobject, jlongArray jInfo) {
+    int64_t loadTimeNs, indexBytes, length, position;
+    int tracks;
+    SynthManager::getInstance()->getMidiFileInfo(loadTimeNs, indexBytes, tracks, length, position);
+    jlong info[] = { loadTimeNs / 1000, indexBytes, tracks, length, position };
+    int count = env->GetArrayLength(jInfo);
+    if (count > (int) (sizeof(info) / sizeof(info[0]))) count = sizeof(info) / sizeof(info[0]);
+    env->SetLongArrayRegion(jInfo, 0, count, info);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthRecordStart() method.
+ * @details Starts recording the messages played by the synth to a Standard MIDI File.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPath          The MIDI file full path.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthRecordStart(
+        JNIEnv *env, jobject, jstring jPath) {
+    const char *path = env->GetStringUTFChars(jPath, nullptr);
+    bool result = SynthManager::getInstance()->startRecording(path);
+    env->ReleaseStringUTFChars(jPath, path);
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthRecordStop() method.
+ * @details Stops recording and closes the MIDI file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  The number of messages lost by the recorder.
+ */
+static jlong JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthRecordStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopRecording();
+    return (jlong) SynthManager::getInstance()->getRecordingDropped();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthAudioCaptureStart() method.
+ * @details Starts capturing the rendered audio to an Ogg/Opus file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPath          The Ogg/Opus file full path.
+ * @param   bitrate        Bitrate, in bits per second.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthAudioCaptureStart(
+        JNIEnv *env, jobject, jstring jPath, jint bitrate) {
+    const char *path = env->GetStringUTFChars(jPath, nullptr);
+    bool result = SynthManager::getInstance()->startAudioCapture(path, bitrate);
+    env->ReleaseStringUTFChars(jPath, path);
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthAudioCaptureStop() method.
+ * @details Stops capturing the rendered audio and closes the file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthAudioCaptureStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopAudioCapture();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthAudioCaptureStats() method.
+ * @details Copies the statistics of the audio capture: encoder CPU time (us), encoded audio
+ *          (ms), bytes written and dropped blocks.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jStats         Receives the values.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthAudioCaptureStats(
+        JNIEnv *env, jobject, jlongArray jStats) {
+    int64_t cpuNs, frames, bytes, overruns;
+    SynthManager::getInstance()->getAudioCaptureStats(cpuNs, frames, bytes, overruns);
+    jlong stats[] = { cpuNs / 1000, frames * 1000 / kFluidSynthSampleRate, bytes, overruns };
+    int count = env->GetArrayLength(jStats);
+    if (count > (int) (sizeof(stats) / sizeof(stats[0]))) count = sizeof(stats) / sizeof(stats[0]);
+    env->SetLongArrayRegion(jStats, 0, count, stats);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthTraceStart() method.
+ * @details Starts tracing the calls made to the synth to a binary trace file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jPath          The trace file full path.
+ * @return  True if successful. False otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthTraceStart(
+        JNIEnv *env, jobject, jstring jPath) {
+    const char *path = env->GetStringUTFChars(jPath, nullptr);
+    bool result = SynthManager::getInstance()->startApiTrace(path);
+    env->ReleaseStringUTFChars(jPath, path);
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthTraceStop() method.
+ * @details Stops tracing and closes the trace file.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  The number of calls lost by the trace.
+ */
+static jlong JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthTraceStop(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->stopApiTrace();
+    return (jlong) SynthManager::getInstance()->getApiTraceDropped();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHeartbeatChannel() method.
+ * @details Plays a channel with the procedural heartbeat voices instead of the soundfont.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           Channel number, or -1 to play every channel with the soundfont.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHeartbeatChannel(
+        JNIEnv *env, jobject, jint chan) {
+    SynthManager::getInstance()->setHeartbeatChannel(chan);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthOutputGain() method.
+ * @details Sets the gain of the output stage (ramped, peaks limited below full scale).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   gain           Linear gain.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthOutputGain(
+        JNIEnv *env, jobject, jfloat gain) {
+    SynthManager::getInstance()->setOutputGain(gain);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthOutputDither() method.
+ * @details Enables the dither and 16-bit conversion of the output stage.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   enabled        True to convert the output to 16 bits, false to keep floats.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthOutputDither(
+        JNIEnv *env, jobject, jboolean enabled) {
+    SynthManager::getInstance()->setOutputDither(enabled == JNI_TRUE);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthLimiterGain() method.
+ * @details Gets the lowest gain of the output limiter since the last call.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  Linear gain (1 if the limiter did not act).
+ */
+static jfloat JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthLimiterGain(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getLimiterGain();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthLevels() method.
+ * @details Copies the levels of the output: block peak and RMS (dBFS), momentary, short-term
+ *          and integrated loudness (LUFS), peak since the reset (dBFS) and time metered
+ *          since the reset (seconds).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jLevels        Receives the values.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthLevels(
+        JNIEnv *env, jobject, jfloatArray jLevels) {
+    LevelSnapshot levels;
+    SynthManager::getInstance()->getLevels(levels);
+    float values[kLevelMeterValues];
+    levels.toArray(values);
+    int count = env->GetArrayLength(jLevels);
+    if (count > kLevelMeterValues) count = kLevelMeterValues;
+    env->SetFloatArrayRegion(jLevels, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthLevelsReset() method.
+ * @details Restarts the integrated levels (loudness and peak) of the output.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthLevelsReset(
+        JNIEnv *env, jobject) {
+    SynthManager::getInstance()->resetLevels();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGlitchDetection() method.
+ * @details Enables the glitch detector of the output (enabled by default).
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   enabled        True to analyse the rendered blocks.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGlitchDetection(
+        JNIEnv *env, jobject, jboolean enabled) {
+    SynthManager::getInstance()->setGlitchDetection(enabled == JNI_TRUE);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGlitchCounts() method.
+ * @details Copies the number of glitches per type since the start: discontinuities, clipping,
+ *          dropouts, late callbacks (underruns), then the events not logged.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jCounts        Receives the values.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGlitchCounts(
+        JNIEnv *env, jobject, jlongArray jCounts) {
+    SynthManager *manager = SynthManager::getInstance();
+    jlong values[kGlitchTypeCount + 1];
+    for (int type = 0; type < kGlitchTypeCount; type++) {
+        values[type] = manager->getGlitchCount(type);
+    }
+    values[kGlitchTypeCount] = manager->getGlitchesDropped();
+    int count = env->GetArrayLength(jCounts);
+    if (count > kGlitchTypeCount + 1) count = kGlitchTypeCount + 1;
+    env->SetLongArrayRegion(jCounts, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGlitchEvents() method.
+ * @details Takes the glitches logged since the last call, oldest first: time at which the
+ *          glitch is heard (steady clock, nanoseconds), type and magnitude.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jTimes         Receives the times.
+ * @param   jTypes         Receives the types.
+ * @param   jValues        Receives the magnitudes.
+ * @return  The number of events copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGlitchEvents(
+        JNIEnv *env, jobject, jlongArray jTimes, jintArray jTypes, jfloatArray jValues) {
+    SynthManager *manager = SynthManager::getInstance();
+    int capacity = env->GetArrayLength(jTimes);
+    if (env->GetArrayLength(jTypes) < capacity) capacity = env->GetArrayLength(jTypes);
+    if (env->GetArrayLength(jValues) < capacity) capacity = env->GetArrayLength(jValues);
+    if (capacity > kGlitchLogSize) capacity = kGlitchLogSize;
+    GlitchEvent events[kGlitchLogSize];
+    int count = manager->readGlitches(events, capacity);
+    jlong times[kGlitchLogSize];
+    jint types[kGlitchLogSize];
+    jfloat values[kGlitchLogSize];
+    for (int i = 0; i < count; i++) {
+        times[i] = manager->timeAtFrame(events[i].frame);
+        types[i] = events[i].type;
+        values[i] = events[i].value;
+    }
+    env->SetLongArrayRegion(jTimes, 0, count, times);
+    env->SetIntArrayRegion(jTypes, 0, count, types);
+    env->SetFloatArrayRegion(jValues, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthQualityTier() method.
+ * @details Sets the quality tier of the synth (interpolation, polyphony, reverb and chorus),
+ *          applied live on the next period.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   tier           Quality tier (0 eco, 1 balanced, 2 high).
+ * @param   automatic      True to use the tier as a ceiling and step down while the render
+ *                         load is too high.
+ * @return  True if successful, false otherwise.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthQualityTier(
+        JNIEnv *env, jobject, jint tier, jboolean automatic) {
+    return SynthManager::getInstance()->setQualityTier(tier, automatic == JNI_TRUE);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGetQualityTier() method.
+ * @details Gets the quality tier in use.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  The tier (0 eco, 1 balanced, 2 high).
+ */
+static jint JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGetQualityTier(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getQualityTier();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthRenderLoad() method.
+ * @details Gets the render load, measured over the last half second.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  Render time over period time (1 takes the whole period).
+ */
+static jfloat JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthRenderLoad(
+        JNIEnv *env, jobject) {
+    return SynthManager::getInstance()->getRenderLoad();
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthVoicePriority() method.
+ * @details Sets the voice priority and budget of a channel.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           Channel number.
+ * @param   priority       Voice priority (0 low, 1 normal, 2 protected).
+ * @param   budget         Maximum number of voices of the channel (0 for no limit).
+ * @return  True if successful. False if an argument is invalid.
+ */
+static jboolean JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthVoicePriority(
+        JNIEnv *env, jobject, jint chan, jint priority, jint budget) {
+    return SynthManager::getInstance()->setVoicePriority(chan, priority, budget);
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthVoiceStats() method.
+ * @details Copies the voice counters: voices playing, voices faded out early and voices
+ *          taken for the budgets since the start.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jStats         Receives the values.
+ * @return  The number of values copied.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthVoiceStats(
+        JNIEnv *env, jobject, jlongArray jStats) {
+    VoiceStats stats;
+    SynthManager::getInstance()->getVoiceStats(stats);
+    jlong values[3] = { stats.active, stats.faded, stats.taken };
+    int count = env->GetArrayLength(jStats);
+    if (count > 3) count = 3;
+    env->SetLongArrayRegion(jStats, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthHandle() method.
+ * @details Gets the engine handle passed to the critical native methods.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @return  The handle.
+ */
+static jlong JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthHandle(
+        JNIEnv *env, jobject) {
+    return reinterpret_cast<jlong>(SynthManager::getInstance());
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGetChannelState() method.
+ * @details Copies the shadow state of a channel: program, bank, pitch bend, followed by
+ *          the 128 controller values. Unknown values are reported as -1.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   chan           The channel.
+ * @param   jState         Receives the channel state.
+ * @return  The number of values copied, or -1 on error.
+ */
+static int JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGetChannelState(
+        JNIEnv *env, jobject, int chan, jintArray jState) {
+    if (chan < 0 || chan >= kSynthStateChannels) return -1;
+    SynthState state;
+    SynthManager::getInstance()->getState(state);
+    const ChannelState &cs = state.channels[chan];
+    jint values[3 + kSynthStateControllers];
+    values[0] = cs.program;
+    values[1] = cs.bank;
+    values[2] = cs.pitchBend;
+    for (int i = 0; i < kSynthStateControllers; i++) values[3 + i] = cs.cc[i];
+    jsize count = env->GetArrayLength(jState);
+    if (count > (jsize) (sizeof(values) / sizeof(values[0]))) {
+        count = sizeof(values) / sizeof(values[0]);
+    }
+    env->SetIntArrayRegion(jState, 0, count, values);
+    return count;
+}
+
+/**
+ * @brief   Native implementation of SynthManager.fluidsynthGetStats() method.
+ * @details Copies the statistics counters: forwarded calls, elided calls, BLE-MIDI packets,
+ *          BLE-MIDI bytes.
+ * @param   env            JNI Env pointer.
+ * @param   (unnamed)      SynthManager (Java) object.
+ * @param   jStats         Receives the counters.
+ */
+static void JNICALL
+Java_com_robsonmartins_androidmidisynth_SynthManager_fluidsynthGetStats(
+        JNIEnv *env, jobject, jlongArray jStats) {
+    SynthStats stats;
+    SynthManager::getInstance()->getStats(stats);
+    jlong values[] = {
+        (jlong) stats.forwardedCalls,
+        (jlong) stats.elidedCalls,
+        (jlong) stats.bleMidiPackets,
+        (jlong) stats.bleMidiBytes,
+    };
+    jsize count = env->GetArrayLength(jStats);
+    if (count > (jsize) (sizeof(values) / sizeof(values[0]))) {
+        count = sizeof(values) / sizeof(values[0]);
+    }
+    env->SetLongArrayRegion(jStats, 0, count, values);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief Check a channel and a data byte of a posted message (the status byte is made from
+ *        the channel, unmasked). */
+#define IS_POSTABLE(chan, data) ((chan) >= 0 && (chan) <= 0x0F && (data) >= 0 && (data) <= 0x7F)
+
+/**
+ * @brief   Critical native implementation of SynthManager.nativeNoteOn() method.
+ * @details Posts the note to the render thread, which plays it on the next block: a critical
+ *          native call must not lock nor do I/O. Called without JNIEnv nor class, on the
+ *          cached engine handle.
+ * @param   handle         Engine handle (fluidsynthHandle()).
+ * @param   chan           The channel.
+ * @param   note           The note to be played.
+ * @param   velocity       The velocity of the note to be played.
+ */
+static void JNICALL criticalNoteOn(jlong handle, jint chan, jint note, jint velocity) {
+    auto *manager = reinterpret_cast<SynthManager*>(handle);
+    if (manager == nullptr || !IS_POSTABLE(chan, note) || !IS_POSTABLE(chan, velocity)) return;
+    manager->postMidi((kMIDIChanCmd_NoteOn << 4) | chan, note, velocity);
+}
+
+/**
+ * @brief   Critical native implementation of SynthManager.nativeNoteOff() method.
+ * @details Posts the note off to the render thread. Called without JNIEnv nor class, on the
+ *          cached engine handle.
+ * @param   handle         Engine handle (fluidsynthHandle()).
+ * @param   chan           The channel.
+ * @param   note           The note to be stopped.
+ */
+static void JNICALL criticalNoteOff(jlong handle, jint chan, jint note) {
+    auto *manager = reinterpret_cast<SynthManager*>(handle);
+    if (manager == nullptr || !IS_POSTABLE(chan, note)) return;
+    manager->postMidi((kMIDIChanCmd_NoteOff << 4) | chan, note, 0);
+}
+
+/**
+ * @brief   Critical native implementation of SynthManager.nativeCC() method.
+ * @details Posts the control command to the render thread. Called without JNIEnv nor class,
+ *          on the cached engine handle.
+ * @param   handle         Engine handle (fluidsynthHandle()).
+ * @param   chan           The channel.
+ * @param   controller     Number of the controller.
+ * @param   value          Value to send.
+ */
+static void JNICALL criticalCC(jlong handle, jint chan, jint controller, jint value) {
+    auto *manager = reinterpret_cast<SynthManager*>(handle);
+    if (manager == nullptr || !IS_POSTABLE(chan, controller) || !IS_POSTABLE(chan, value)) return;
+    manager->postMidi((kMIDIChanCmd_Control << 4) | chan, controller, value);
+}
+
+/**
+ * @brief   Critical native implementation of SynthManager.nativeProgramChange() method.
+ * @details Posts the program change to the render thread, in order with the other posted
+ *          calls. Called without JNIEnv nor class, on the cached engine handle.
+ * @param   handle         Engine handle (fluidsynthHandle()).
+ * @param   chan           The channel.
+ * @param   program        The program.
+ */
+static void JNICALL criticalProgramChange(jlong handle, jint chan, jint program) {
+    auto *manager = reinterpret_cast<SynthManager*>(handle);
+    if (manager == nullptr || !IS_POSTABLE(chan, program)) return;
+    manager->postMidi((kMIDIChanCmd_ProgramChange << 4) | chan, program, 0);
+}
+
+/* @brief Entry of the native method table, bound to its JNI implementation. */
+#define NATIVE_METHOD(name, signature) { #name, signature, \
+    reinterpret_cast<void*>(Java_com_robsonmartins_androidmidisynth_SynthManager_##name) }
+
+/* @brief Native methods of the SynthManager (Java) class. */
+static const JNINativeMethod kNativeMethods[] = {
+    NATIVE_METHOD(fluidsynthInit, "()V"),
+    NATIVE_METHOD(fluidsynthLoadSF, "(Ljava/lang/String;)I"),
+    NATIVE_METHOD(fluidsynthFree, "()V"),
+    NATIVE_METHOD(fluidsynthProgramChange, "(II)V"),
+    NATIVE_METHOD(fluidsynthNoteOn, "(III)V"),
+    NATIVE_METHOD(fluidsynthNoteOff, "(II)V"),
+    NATIVE_METHOD(fluidsynthCC, "(III)V"),
+    NATIVE_METHOD(fluidsynthReverb, "(I)V"),
+    NATIVE_METHOD(fluidsynthChorus, "(I)V"),
+    NATIVE_METHOD(fluidsynthPitchBend, "(II)V"),
+    NATIVE_METHOD(fluidsynthSmoothCC, "(IIFI)I"),
+    NATIVE_METHOD(fluidsynthSmoothReverb, "(FI)I"),
+    NATIVE_METHOD(fluidsynthSmoothFilterCutoff, "(IFI)I"),
+    NATIVE_METHOD(fluidsynthSendMidi, "([BII)V"),
+    NATIVE_METHOD(fluidsynthOpenMidiDevice, "(Landroid/media/midi/MidiDevice;II)I"),
+    NATIVE_METHOD(fluidsynthCloseMidiDevice, "()V"),
+    NATIVE_METHOD(fluidsynthMidiOut, "(III)V"),
+    NATIVE_METHOD(fluidsynthBleMidiConfigure, "(II)V"),
+    NATIVE_METHOD(fluidsynthBleMidiFlush, "()V"),
+    NATIVE_METHOD(fluidsynthBleMidiPoll, "([B)I"),
+    NATIVE_METHOD(fluidsynthBleMidiListen, "(Z)V"),
+    NATIVE_METHOD(fluidsynthBleMidiMessages, "([II)I"),
+    NATIVE_METHOD(fluidsynthBleMidiReceive, "([BI)I"),
+    NATIVE_METHOD(fluidsynthBleMidiReset, "()V"),
+    NATIVE_METHOD(fluidsynthMidiClockTempo, "(FF)V"),
+    NATIVE_METHOD(fluidsynthMidiClockStart, "(I)V"),
+    NATIVE_METHOD(fluidsynthMidiClockStop, "()V"),
+    NATIVE_METHOD(fluidsynthBeatTrackerUpdate, "(F)V"),
+    NATIVE_METHOD(fluidsynthHeartRateSample, "(FI)F"),
+    NATIVE_METHOD(fluidsynthHeartBeat, "(JF)V"),
+    NATIVE_METHOD(fluidsynthHeartRateSensorStart, "(Ljava/lang/String;I)Z"),
+    NATIVE_METHOD(fluidsynthHeartRateSensorStop, "()V"),
+    NATIVE_METHOD(fluidsynthHeartRateSensorWakeups, "()F"),
+    NATIVE_METHOD(fluidsynthHeartRateValue, "()F"),
+    NATIVE_METHOD(fluidsynthGetHrv, "([F)I"),
+    NATIVE_METHOD(fluidsynthHrvRoute, "(IIIIFF)Z"),
+    NATIVE_METHOD(fluidsynthBeatTrackerAdvance, "()I"),
+    NATIVE_METHOD(fluidsynthBeatTrackerNextBeat, "()J"),
+    NATIVE_METHOD(fluidsynthSequencerLoad, "([B)Z"),
+    NATIVE_METHOD(fluidsynthSequencerStart, "(I)V"),
+    NATIVE_METHOD(fluidsynthSequencerStop, "()V"),
+    NATIVE_METHOD(fluidsynthSequencerVelocity, "(F)V"),
+    NATIVE_METHOD(fluidsynthSmfLoad, "(Ljava/lang/String;)Z"),
+    NATIVE_METHOD(fluidsynthSmfPlay, "(Z)V"),
+    NATIVE_METHOD(fluidsynthSmfStop, "()V"),
+    NATIVE_METHOD(fluidsynthSmfSeek, "(J)Z"),
+    NATIVE_METHOD(fluidsynthSmfInfo, "([J)I"),
+    NATIVE_METHOD(fluidsynthRecordStart, "(Ljava/lang/String;)Z"),
+    NATIVE_METHOD(fluidsynthRecordStop, "()J"),
+    NATIVE_METHOD(fluidsynthAudioCaptureStart, "(Ljava/lang/String;I)Z"),
+    NATIVE_METHOD(fluidsynthAudioCaptureStop, "()V"),
+    NATIVE_METHOD(fluidsynthAudioCaptureStats, "([J)I"),
+    NATIVE_METHOD(fluidsynthTraceStart, "(Ljava/lang/String;)Z"),
+    NATIVE_METHOD(fluidsynthTraceStop, "()J"),
+    NATIVE_METHOD(fluidsynthHeartbeatChannel, "(I)V"),
+    NATIVE_METHOD(fluidsynthOutputGain, "(F)V"),
+    NATIVE_METHOD(fluidsynthOutputDither, "(Z)V"),
+    NATIVE_METHOD(fluidsynthLimiterGain, "()F"),
+    NATIVE_METHOD(fluidsynthLevels, "([F)I"),
+    NATIVE_METHOD(fluidsynthLevelsReset, "()V"),
+    NATIVE_METHOD(fluidsynthGlitchDetection, "(Z)V"),
+    NATIVE_METHOD(fluidsynthGlitchCounts, "([J)I"),
+    NATIVE_METHOD(fluidsynthGlitchEvents, "([J[I[F)I"),
+    NATIVE_METHOD(fluidsynthQualityTier, "(IZ)Z"),
+    NATIVE_METHOD(fluidsynthGetQualityTier, "()I"),
+    NATIVE_METHOD(fluidsynthRenderLoad, "()F"),
+    NATIVE_METHOD(fluidsynthVoicePriority, "(III)Z"),
+    NATIVE_METHOD(fluidsynthVoiceStats, "([J)I"),
+    NATIVE_METHOD(fluidsynthHandle, "()J"),
+    NATIVE_METHOD(fluidsynthGetChannelState, "(I[I)I"),
+    NATIVE_METHOD(fluidsynthGetStats, "([J)V"),
+    { "nativeNoteOn", "(JIII)V", reinterpret_cast<void*>(criticalNoteOn) },
+    { "nativeNoteOff", "(JII)V", reinterpret_cast<void*>(criticalNoteOff) },
+    { "nativeCC", "(JIII)V", reinterpret_cast<void*>(criticalCC) },
+    { "nativeProgramChange", "(JII)V", reinterpret_cast<void*>(criticalProgramChange) },
+};
+
+/**
+ * @brief   Called when the library is loaded (System.loadLibrary()).
+ * @details Registers the native methods, so no method is looked up by its mangled name.
+ *          Registering is required for the critical native methods.
+ * @param   vm             Java VM.
+ * @param   (unnamed)      Reserved.
+ * @return  The JNI version, or JNI_ERR on error.
+ */
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *) {
+    JNIEnv *env;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) return JNI_ERR;
+    jclass clazz = env->FindClass("com/robsonmartins/androidmidisynth/SynthManager");
+    if (clazz == nullptr) return JNI_ERR;
+    jint result = env->RegisterNatives(clazz, kNativeMethods,
+                                       sizeof(kNativeMethods) / sizeof(kNativeMethods[0]));
+    env->DeleteLocalRef(clazz);
+    return result == JNI_OK ? JNI_VERSION_1_6 : JNI_ERR;
+}
+
 } // extern "C"
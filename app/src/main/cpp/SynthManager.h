@@ -32,14 +32,53 @@
 #define ANDROID_MIDI_SYNTH_SYNTHMANAGER_H
 
 #include <fluidsynth.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "AAudioOutput.h"
+#include "AudioCapture.h"
+#include "BeatTracker.h"
+#include "BleMidiDecoder.h"
+#include "BleMidiEncoder.h"
+#include "BleMidiSync.h"
+#include "HeartRateFilter.h"
+#include "HeartRateSource.h"
+#include "HrvAnalyzer.h"
+#include "MidiClock.h"
+#include "MidiEventQueue.h"
+#include "MidiParser.h"
+#include "MidiPort.h"
+#include "MidiReader.h"
+#include "MidiSender.h"
+#include "PatternSequencer.h"
+#include "SmfPlayer.h"
+#include "SynthEngine.h"
+
+// -----------------------------------------------------------------------------------------------
+
+/** @brief Number of completed BLE-MIDI packets waiting to be polled. */
+static const int kBleMidiQueuePackets = 8;
+/** @brief Number of MIDI output messages waiting for the BLE library. */
+static const int kBleMidiQueueMessages = 256;
+
+/** @brief Maximum number of HRV metrics routed to controllers. */
+static const int kMaxHrvRoutes = 4;
 
 // -----------------------------------------------------------------------------------------------
 
 /**
  * @brief SynthManager class.
- * @details The SynthManager encapsulates a native C/C++ FluidSynth synthesizer.
+ * @details The SynthManager encapsulates a native C/C++ FluidSynth synthesizer: it runs the
+ *          render core (SynthEngine) from an AAudio stream of its own and connects it to the
+ *          MIDI ports, BLE-MIDI, the sequencer, the MIDI file player and the heart-rate
+ *          pipeline. If the stream can not be opened, the FluidSynth audio driver runs the
+ *          same render core from its own callback; if neither starts, the synth is closed
+ *          and loading a soundfont fails.
  */
-class SynthManager {
+class SynthManager: public MidiListener, public MidiReaderListener, public MidiClockListener,
+        public MidiSenderListener, public BleMidiPacketListener, public BleMidiListener,
+        public HeartRateListener, public SynthEngineListener, public AAudioOutputListener {
 public:
     /**
      * @brief Get an unique SynthManager instance.
@@ -53,53 +92,755 @@ public:
      * @param soundfontPath Full soundfont filename path.
      * @return True if successful. False otherwise.
      */
-    bool loadSF(const char *soundfontPath);
+    bool loadSF(const char *soundfontPath) { return engine.loadSF(soundfontPath); }
     /**
      * @brief Play a note.
      * @param note Note number.
      * @param velocity The velocity of the note.
      */
-    void programChange(int chan, int program);
+    void programChange(int chan, int program) { engine.programChange(chan, program); }
     /**
      * @brief Program change.
      * @param program program.
      */
-    void noteOn(int chan, int note, int velocity);
+    void noteOn(int chan, int note, int velocity) { engine.noteOn(chan, note, velocity); }
     /**
      * @brief Stop of playing a note.
      * @param note Note number.
      */
-    void noteOff(int cham, int note);
+    void noteOff(int cham, int note) { engine.noteOff(cham, note); }
     /**
      * @brief Send a MIDI command.
      * @param controller Controller number.
      * @param value Value to send.
      */
-    void sendCC(int chan, int controller, int value);
+    void sendCC(int chan, int controller, int value) {
+        engine.sendCC(chan, controller, value);
+    }
     /**
      * @brief Adjust reverb effect.
      * @param level Level of the reverb.
      */
-    void reverb(int level);
+    void reverb(int level) { engine.reverb(level); }
+    /**
+     * @brief Adjust chorus effect.
+     * @param level Level of the chorus.
+     */
+    void chorus(int level) { engine.chorus(level); }
+    /**
+     * @brief Select a bank.
+     * @param chan Channel number.
+     * @param bank Bank number (0-16383).
+     */
+    void bankSelect(int chan, int bank) { engine.bankSelect(chan, bank); }
+    /**
+     * @brief Set the pitch bend.
+     * @param chan Channel number.
+     * @param value Pitch bend value (0-16383, 8192 is center).
+     */
+    void pitchBend(int chan, int value) { engine.pitchBend(chan, value); }
+    /**
+     * @brief Get a consistent copy of the synth state shadow.
+     * @param state Receives the state.
+     */
+    void getState(SynthState &state) { engine.getState(state); }
+    /**
+     * @brief Get a copy of the statistics counters.
+     * @param stats Receives the counters.
+     */
+    void getStats(SynthStats &stats);
+    /**
+     * @brief Ramp a parameter to a new value.
+     * @details The ramp is interpolated at control rate by the render loop, so callers only
+     *          need to push target values (e.g. at sensor rate).
+     * @param param Parameter (SmoothedParam).
+     * @param chan Channel number (ignored for kSmoothedParam_Reverb).
+     * @param controller Controller number (only used for kSmoothedParam_CC).
+     * @param value Target value.
+     * @param rampMs Ramp duration, in milliseconds.
+     * @return True if successful. False if there is no free smoother.
+     */
+    bool smoothParam(int param, int chan, int controller, float value, int rampMs) {
+        return engine.smoothParam(param, chan, controller, value, rampMs);
+    }
+    /**
+     * @brief Play a raw MIDI byte stream.
+     * @details The stream may be split at any byte between calls.
+     * @param data MIDI bytes.
+     * @param length Number of bytes.
+     */
+    void sendMidi(const uint8_t *data, int length);
+    /**
+     * @brief Play a decoded MIDI message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) override {
+        engine.onMidiMessage(status, data1, data2);
+    }
+    /**
+     * @brief Send a SysEx message to the synth.
+     * @param data Payload, without the SysEx and End Of SysEx bytes.
+     * @param length Payload length, in bytes.
+     */
+    void onMidiSysEx(const uint8_t *data, int length) override {
+        engine.onMidiSysEx(data, length);
+    }
+    /**
+     * @brief Schedule a message read from the input port (called by the reader thread).
+     * @details Played kMidiPortDelayMs after the port received it, at the matching frame.
+     * @param timestampNs Time the port received the message (steady clock), in nanoseconds.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onMidiPortMessage(int64_t timestampNs, uint8_t status, uint8_t data1,
+                           uint8_t data2) override;
+    /**
+     * @brief Play a SysEx read from the input port (called by the reader thread).
+     * @param timestampNs Time the port received the message (steady clock), in nanoseconds.
+     * @param data Payload.
+     * @param length Payload length, in bytes.
+     */
+    void onMidiPortSysEx(int64_t timestampNs, const uint8_t *data, int length) override;
+    /**
+     * @brief Connect external MIDI ports.
+     * @details Bytes received from the input port are played on a native reader thread.
+     *          Any previously connected ports are closed first.
+     * @param input Port to read MIDI from, or nullptr. Ownership is taken.
+     * @param output Port to send MIDI to, or nullptr. Ownership is taken.
+     * @return True if successful. False otherwise (the ports are deleted).
+     */
+    bool openMidiPorts(MidiInputPort *input, MidiOutputPort *output);
+    /** @brief Disconnect and delete the external MIDI ports. */
+    void closeMidiPorts();
+    /**
+     * @brief Send a MIDI message now to the MIDI outputs (output port, BLE-MIDI encoder and
+     *        BLE library queue, if enabled). Not for the render thread.
+     * @param status Status byte (SysEx excluded).
+     * @param data1 First data byte (ignored by messages without data).
+     * @param data2 Second data byte (ignored by messages with less than two data bytes).
+     */
+    void midiOut(uint8_t status, uint8_t data1, uint8_t data2);
+    /**
+     * @brief Queue a MIDI message for the MIDI outputs at an audio frame (render thread).
+     * @details The sender thread sends it when the frame is heard. Lock-free.
+     * @param frame Audio frame of the message.
+     * @param status Status byte (SysEx excluded).
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void queueMidiOut(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2);
+    /**
+     * @brief Post a MIDI message to be played at the start of the next block and sent to the
+     *        MIDI outputs when that is heard (any thread).
+     * @details Lock-free and without I/O, for the critical native methods: the render thread
+     *          plays the message, after the calls made meanwhile through the other methods.
+     * @param status Status byte (SysEx excluded).
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full (the message is dropped).
+     */
+    bool postMidi(uint8_t status, uint8_t data1, uint8_t data2) {
+        return engine.postMidi(status, data1, data2);
+    }
+    /**
+     * @brief Send a due message of the MIDI clock (called by the clock, render thread).
+     * @param frame Audio frame of the message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onMidiClock(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) override;
+    /**
+     * @brief Send a queued message to the MIDI outputs (called by the sender thread).
+     * @param timeNs Time of the message (steady clock), in nanoseconds.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onMidiSend(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2) override;
+    /**
+     * @brief Enable or disable the queue of MIDI output messages for a BLE library (which
+     *        encodes the messages itself).
+     * @param enabled True to queue the messages, false to stop and clear the queue.
+     */
+    void listenBleMidi(bool enabled);
+    /**
+     * @brief Wait for the MIDI output messages queued for a BLE library.
+     * @param messages Receives the messages (status | data1 << 8 | data2 << 16).
+     * @param maxCount Size of the buffer, in messages.
+     * @param timeoutMs Longest wait for a message, in milliseconds.
+     * @return The number of messages (0 on timeout).
+     */
+    int waitBleMidiMessages(uint32_t *messages, int maxCount, int timeoutMs);
+    /**
+     * @brief Enable or disable the BLE-MIDI encoder of the MIDI output.
+     * @param packetSize Maximum packet size, in bytes (ATT MTU - 3), or 0 to disable.
+     * @param maxDelayMs Maximum time a message waits for other messages, in milliseconds.
+     */
+    void configureBleMidi(int packetSize, int maxDelayMs);
+    /** @brief Complete the pending BLE-MIDI packet (e.g. at the end of a beat). */
+    void flushBleMidi();
+    /**
+     * @brief Get the next completed BLE-MIDI packet.
+     * @details Also completes the pending packet if its maximum delay has elapsed.
+     * @param packet Receives the packet.
+     * @param maxLength Size of the buffer.
+     * @return The packet length, or 0 if there is no packet.
+     */
+    int pollBleMidi(uint8_t *packet, int maxLength);
+    /**
+     * @brief Queue a completed BLE-MIDI packet (called by the encoder).
+     * @param packet Packet bytes.
+     * @param length Packet length, in bytes.
+     */
+    void onBleMidiPacket(const uint8_t *packet, int length) override;
+    /**
+     * @brief Schedule a MIDI message at an audio frame.
+     * @details The message is played by the render loop at the start of the control block
+     *          that contains the frame (or at once, if the frame is already rendered).
+     * @param frame Audio frame (see frameAtTime()).
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     * @return True if successful. False if the queue is full.
+     */
+    bool scheduleMidi(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) {
+        return engine.scheduleMidi(frame, status, data1, data2);
+    }
+    /**
+     * @brief Get the audio frame rendered at a given time.
+     * @param timeNs Time (steady clock), in nanoseconds.
+     * @return The audio frame.
+     */
+    int64_t frameAtTime(int64_t timeNs) { return engine.frameAtTime(timeNs); }
+    /**
+     * @brief Get the time at which an audio frame is rendered.
+     * @param frame Audio frame.
+     * @return Time (steady clock), in nanoseconds.
+     */
+    int64_t timeAtFrame(int64_t frame) { return engine.timeAtFrame(frame); }
+    /**
+     * @brief Play a received BLE-MIDI packet.
+     * @details The sender timestamps are mapped to local time behind an adaptive jitter
+     *          buffer, so the messages are played with the sender timing instead of the BLE
+     *          delivery timing.
+     * @param packet Packet bytes.
+     * @param length Packet length, in bytes.
+     * @param arrivalNs Arrival time of the packet (steady clock), in nanoseconds.
+     * @return True if the packet is valid. False otherwise.
+     */
+    bool receiveBleMidi(const uint8_t *packet, int length, int64_t arrivalNs);
+    /**
+     * @brief Forget the clock offset and the delivery delays of the BLE-MIDI input (e.g. when
+     *        another central connects).
+     */
+    void resetBleMidi();
+    /**
+     * @brief Schedule a decoded BLE-MIDI message (called by the decoder).
+     * @param timeMs Sender time, in milliseconds.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onBleMidiMessage(int64_t timeMs, uint8_t status, uint8_t data1, uint8_t data2) override;
+    /**
+     * @brief Play a decoded BLE-MIDI SysEx (called by the decoder).
+     * @param timeMs Sender time, in milliseconds.
+     * @param data Payload.
+     * @param length Payload length, in bytes.
+     */
+    void onBleMidiSysEx(int64_t timeMs, const uint8_t *data, int length) override;
+    /**
+     * @brief Get the MIDI clock generator.
+     * @details Its messages are sent to the MIDI outputs (AMidi and BLE-MIDI encoder) from the
+     *          render loop.
+     * @return The MIDI clock.
+     */
+    MidiClock* getMidiClock() { return &midiClock; }
+    /**
+     * @brief Feed a heart-rate sample to the beat tracker.
+     * @param timeNs Time of the sample (steady clock), in nanoseconds.
+     * @param bpm Heart rate, in BPM.
+     */
+    void updateHeartRate(int64_t timeNs, double bpm);
+    /**
+     * @brief Feed a raw heart-rate sensor sample to the signal pipeline.
+     * @details The sample is gated by accuracy, checked for outliers and smoothed. When
+     *          accepted, the filtered value also updates the beat tracker.
+     * @param timeNs Time of the sample (steady clock), in nanoseconds.
+     * @param bpm Raw heart rate, in BPM.
+     * @param accuracy Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+     * @return The filtered heart rate, in BPM, or 0 if the sample was gated out.
+     */
+    float filterHeartRate(int64_t timeNs, float bpm, int accuracy);
+    /**
+     * @brief Advance the beat tracker.
+     * @details When a beat passed, the pattern sequencer plays the steps of the beat.
+     * @param timeNs Current time (steady clock), in nanoseconds.
+     * @return The number of beats since the previous call.
+     */
+    int advanceBeats(int64_t timeNs);
+    /**
+     * @brief Load a pattern into the sequencer (see PatternSequencer for the formats).
+     * @param data Pattern data.
+     * @param length Length of the data, in bytes.
+     * @return True if successful. False otherwise.
+     */
+    bool loadPattern(const uint8_t *data, int length);
+    /**
+     * @brief Start the pattern sequencer from the first step.
+     * @param stepsPerBeat Number of steps played on each beat.
+     */
+    void startSequencer(int stepsPerBeat);
+    /** @brief Stop the pattern sequencer. */
+    void stopSequencer();
+    /**
+     * @brief Set the velocity scale of the pattern sequencer.
+     * @param scale Factor applied to the velocities of the pattern.
+     */
+    void setSequencerVelocity(float scale);
+    /**
+     * @brief Load a Standard MIDI File into the player.
+     * @details The player follows the beat tracker: one quarter note per beat at the base
+     *          tempo of the file.
+     * @param path Path of the file.
+     * @return True if successful. False otherwise.
+     */
+    bool loadMidiFile(const char *path);
+    /**
+     * @brief Start (or resume) playing the MIDI file.
+     * @param loop True to restart at the end of the file.
+     */
+    void playMidiFile(bool loop);
+    /** @brief Stop playing the MIDI file. */
+    void stopMidiFile();
+    /**
+     * @brief Move the playback position of the MIDI file.
+     * @param tick Position, in ticks.
+     * @return True if successful. False otherwise.
+     */
+    bool seekMidiFile(int64_t tick);
+    /**
+     * @brief Get information about the MIDI file.
+     * @param loadTimeNs Receives the load time (mapping, tempo map and seek index), in ns.
+     * @param indexBytes Receives the memory used by the tempo map and the seek index.
+     * @param tracks Receives the number of tracks.
+     * @param length Receives the length, in ticks.
+     * @param position Receives the playback position, in ticks.
+     */
+    void getMidiFileInfo(int64_t &loadTimeNs, int64_t &indexBytes, int &tracks,
+                         int64_t &length, int64_t &position);
+    /**
+     * @brief Play a channel with the procedural heartbeat voices instead of the soundfont.
+     * @details The notes of the channel trigger HeartbeatEngine voices, tuned by the filtered
+     *          heart rate and its variability; its volume controller sets their level.
+     *          The other messages still reach the synth.
+     * @param chan Channel number, or -1 to play every channel with the soundfont.
+     */
+    void setHeartbeatChannel(int chan) { engine.setHeartbeatChannel(chan); }
+    /**
+     * @brief Get the channel played with the procedural heartbeat voices.
+     * @return Channel number, or -1 if none.
+     */
+    int getHeartbeatChannel() const { return engine.getHeartbeatChannel(); }
+    /**
+     * @brief Set the gain of the output stage.
+     * @details The gain is ramped, and the output stage limits the peaks below full scale.
+     * @param gain Linear gain.
+     */
+    void setOutputGain(float gain) { engine.setOutputGain(gain); }
+    /**
+     * @brief Enable the dither and 16-bit conversion of the output stage.
+     * @param enabled True to convert the output to 16 bits, false to keep floats.
+     */
+    void setOutputDither(bool enabled) {
+        engine.getOutputChain()->getOutputStage()->setDither(enabled);
+    }
+    /**
+     * @brief Get the lowest gain of the output limiter since the last call.
+     * @return Linear gain (1 if the limiter did not act).
+     */
+    float getLimiterGain() {
+        return engine.getOutputChain()->getOutputStage()->takeLimiterGain();
+    }
+    /**
+     * @brief Get the levels of the output (wait-free for the render thread).
+     * @param levels Receives the levels.
+     */
+    void getLevels(LevelSnapshot &levels) const {
+        engine.getOutputChain()->getLevelMeter()->getSnapshot(levels);
+    }
+    /** @brief Restart the integrated levels (loudness and peak) of the output. */
+    void resetLevels() { engine.getOutputChain()->getLevelMeter()->requestReset(); }
+    /**
+     * @brief Enable the glitch detector of the output.
+     * @param enabled True to analyse the rendered blocks (default).
+     */
+    void setGlitchDetection(bool enabled) {
+        engine.getOutputChain()->getGlitchDetector()->setEnabled(enabled);
+    }
+    /**
+     * @brief Get the number of glitches of a type since the start.
+     * @param type Glitch type (GlitchType).
+     * @return The number of glitches.
+     */
+    int64_t getGlitchCount(int type) const {
+        return engine.getOutputChain()->getGlitchDetector()->getCount(type);
+    }
+    /**
+     * @brief Get the number of glitches not logged because the log was full.
+     * @return The number of glitches.
+     */
+    int64_t getGlitchesDropped() const {
+        return engine.getOutputChain()->getGlitchDetector()->getDropped();
+    }
+    /**
+     * @brief Take the glitches logged since the last call, oldest first.
+     * @details The frames of the events are the frames of the output (after the latency of
+     *          the output stage); see timeAtFrame().
+     * @param events Receives the events.
+     * @param count Capacity of events.
+     * @return The number of events copied.
+     */
+    int readGlitches(GlitchEvent *events, int count) {
+        return engine.readGlitches(events, count);
+    }
+    /**
+     * @brief Set the quality tier of the synth: interpolation, polyphony, reverb and chorus.
+     * @details Applied live on the next period, the soundfont stays loaded.
+     * @param tier Quality tier (QualityTier).
+     * @param automatic True to use the tier as a ceiling and step down while the render
+     *                  load is too high.
+     * @return True if successful. False if the tier is invalid.
+     */
+    bool setQualityTier(int tier, bool automatic) {
+        return engine.setQualityTier(tier, automatic);
+    }
+    /**
+     * @brief Get the quality tier in use.
+     * @return The tier (QualityTier).
+     */
+    int getQualityTier() const { return engine.getQualityTier(); }
+    /**
+     * @brief Get the render load, measured over the last half second.
+     * @return Render time over period time (1 takes the whole period).
+     */
+    float getRenderLoad() const { return engine.getRenderLoad(); }
+    /**
+     * @brief Set the voice priority and budget of a channel.
+     * @details The voices of a protected channel are never taken, and voices are kept free
+     *          for it; the voices of a channel over its budget are faded out, released and
+     *          quietest first.
+     * @param chan Channel number.
+     * @param priority Voice priority (VoicePriority).
+     * @param budget Maximum number of voices of the channel (0 for no limit).
+     * @return True if successful. False if an argument is invalid.
+     */
+    bool setVoicePriority(int chan, int priority, int budget) {
+        return engine.setVoicePriority(chan, priority, budget);
+    }
+    /**
+     * @brief Get the voice counters: voices playing, faded out early and taken.
+     * @param stats Receives the counters.
+     */
+    void getVoiceStats(VoiceStats &stats) const { engine.getVoiceStats(stats); }
+    /**
+     * @brief Start recording the channel messages played by the synth to a MIDI file.
+     * @details Every note, controller, program, pressure and pitch bend message that
+     *          reaches the synth is stamped with its audio frame.
+     * @param path Path of the Standard MIDI File (overwritten).
+     * @return True if successful. False otherwise.
+     */
+    bool startRecording(const char *path);
+    /** @brief Stop recording and close the MIDI file. */
+    void stopRecording() { engine.stopRecording(); }
+    /**
+     * @brief Get the number of messages lost by the recorder (queue full).
+     * @return The number of messages.
+     */
+    uint64_t getRecordingDropped() const { return engine.getRecordingDropped(); }
+    /**
+     * @brief Start capturing the rendered audio to an Ogg/Opus file.
+     * @details The render thread only copies the audio; it is encoded by a background thread.
+     * @param path Path of the Ogg/Opus file (overwritten).
+     * @param bitrate Bitrate, in bits per second.
+     * @return True if successful. False otherwise.
+     */
+    bool startAudioCapture(const char *path, int bitrate);
+    /** @brief Stop capturing the rendered audio and close the file. */
+    void stopAudioCapture();
+    /**
+     * @brief Get statistics of the audio capture.
+     * @param cpuNs Receives the CPU time of the encoder, in nanoseconds.
+     * @param frames Receives the number of encoded audio frames.
+     * @param bytes Receives the number of bytes written to the file.
+     * @param overruns Receives the number of blocks dropped (encoder behind).
+     */
+    void getAudioCaptureStats(int64_t &cpuNs, int64_t &frames, int64_t &bytes,
+                              int64_t &overruns);
+    /**
+     * @brief Start tracing the calls made to the synth, for offline replay.
+     * @details The trace starts with the known synth state (soundfont and shadow state).
+     * @param path Path of the trace file (overwritten).
+     * @return True if successful. False otherwise.
+     */
+    bool startApiTrace(const char *path) { return engine.startApiTrace(path); }
+    /** @brief Stop tracing and close the trace file. */
+    void stopApiTrace() { engine.stopApiTrace(); }
+    /**
+     * @brief Get the number of calls lost by the trace.
+     * @return The number of calls.
+     */
+    uint64_t getApiTraceDropped() const { return engine.getApiTraceDropped(); }
+    /**
+     * @brief Get the time of the next beat.
+     * @return Time of the next beat (steady clock), in nanoseconds.
+     */
+    int64_t getNextBeatTime();
+    /**
+     * @brief Start a native heart-rate source feeding the signal pipeline.
+     * @details Stops the previous source. Takes ownership of the source (also on failure).
+     * @param source The heart-rate source.
+     * @return True if successful. False otherwise.
+     */
+    bool startHeartRateSource(HeartRateSource *source);
+    /** @brief Stop and release the native heart-rate source. */
+    void stopHeartRateSource();
+    /**
+     * @brief Get the wakeups of the native heart-rate source per minute.
+     * @return Wakeups per minute since the source started, or 0 if none is running.
+     */
+    float getHeartRateWakeupsPerMinute();
+    /**
+     * @brief Get the last filtered heart rate.
+     * @return Heart rate, in BPM, or 0 if no sample was accepted yet.
+     */
+    float getHeartRate() const { return heartRate.load(); }
+    /**
+     * @brief Receive a sample of the native heart-rate source.
+     * @param timeNs Time of the sample (steady clock), in nanoseconds.
+     * @param bpm Raw heart rate, in BPM.
+     * @param accuracy Sensor accuracy.
+     */
+    void onHeartRateSample(int64_t timeNs, float bpm, int accuracy) override;
+    /**
+     * @brief Receive a beat of the native heart-rate source.
+     * @param timeNs Time of the beat (steady clock), in nanoseconds.
+     * @param confidence Confidence of the detection (0 to 1).
+     */
+    void onHeartBeat(int64_t timeNs, float confidence) override;
+    /**
+     * @brief Feed a detected heart beat to the heart-rate variability analysis.
+     * @details The intervals between the beats update the metrics, which are then sent
+     *          to their routes.
+     * @param timeNs Time of the beat (steady clock), in nanoseconds.
+     * @param confidence Confidence of the detection (0 to 1).
+     */
+    void addHeartBeat(int64_t timeNs, float confidence);
+    /**
+     * @brief Get the heart-rate variability metrics.
+     * @param metrics Receives kHrvMetricCount values, indexed by HrvMetric.
+     */
+    void getHrv(double *metrics);
+    /**
+     * @brief Route a heart-rate variability metric to a controller.
+     * @details Each time the metrics are updated, the metric is mapped linearly from
+     *          [minValue, maxValue] to 0-127 (clamped) and sent with sendCC().
+     * @param slot Route slot (0 to kMaxHrvRoutes - 1).
+     * @param metric The metric (HrvMetric), or -1 to clear the slot.
+     * @param chan Channel number.
+     * @param controller Controller number.
+     * @param minValue Metric value mapped to 0.
+     * @param maxValue Metric value mapped to 127.
+     * @return True if successful. False otherwise.
+     */
+    bool setHrvRoute(int slot, int metric, int chan, int controller,
+                     float minValue, float maxValue);
+    /**
+     * @brief Play the MIDI file events of a control block (called by the engine, render
+     *        thread).
+     * @param frame Audio frame of the block.
+     * @param frames Number of frames of the block.
+     */
+    void onEngineBlock(int64_t frame, int frames) override;
+    /**
+     * @brief Queue a played message for the MIDI outputs (called by the engine, render
+     *        thread).
+     * @param frame Audio frame of the message.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte.
+     */
+    void onEngineMidiOut(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) override {
+        queueMidiOut(frame, status, data1, data2);
+    }
+    /**
+     * @brief Capture a rendered block (called by the engine, render thread).
+     * @param (unnamed) Audio frame of the first sample.
+     * @param left Left channel samples.
+     * @param right Right channel samples.
+     * @param frames Number of frames.
+     */
+    void onEngineOutput(int64_t, const float *left, const float *right, int frames) override {
+        audioCapture.write(left, right, frames);
+    }
+    /**
+     * @brief Render the synth into the AAudio stream (audio thread).
+     * @param left Left channel, zeroed.
+     * @param right Right channel, zeroed.
+     * @param frames Number of frames.
+     */
+    void onAudioOutput(float *left, float *right, int frames) override;
 private:
     /* @brief Constructor. */
     SynthManager();
     /* @brief Destructor. */
-    ~SynthManager();
+    ~SynthManager() override;
     /* @brief Set the FluidSynth latency.
      * @param ms Latency value, in milliseconds. */
     void setLatency(int ms);
+    /* @brief FluidSynth audio driver callback (fallback of the AAudio stream). */
+    static int renderCallback(void *data, int len, int nfx, float *fx[], int nout, float *out[]);
+    /* @brief Send a MIDI message to the MIDI outputs (not the render thread).
+     * @param timeNs Time of the message (steady clock), in nanoseconds.
+     * @param status Status byte.
+     * @param data1 First data byte.
+     * @param data2 Second data byte. */
+    void sendMidiOut(int64_t timeNs, uint8_t status, uint8_t data1, uint8_t data2);
+    /* @brief Send the routed heart-rate variability metrics to the controllers.
+     * @param metrics kHrvMetricCount values, indexed by HrvMetric. */
+    void applyHrvRoutes(const double *metrics);
+    /* @brief Play the sequencer steps of a beat.
+     * @param beatNs Time of the beat (steady clock), in nanoseconds.
+     * @param period Beat period, in seconds. */
+    void playSequencerBeat(int64_t beatNs, double period);
 private:
     /* @brief SynthManager unique instance. */
     static SynthManager *instance;
     /* @brief FluidSynth settings. */
     fluid_settings_t *settings;
-    /* @brief FluidSynth synth object. */
-    fluid_synth_t *synth;
-    /* @brief FluidSynth audio driver object. */
+    /* @brief FluidSynth audio driver object (only if the AAudio stream fails). */
     fluid_audio_driver_t *driver;
-    /* @brief FluidSynth loaded soundfont ID. */
-    int soundfontId;
+    /* @brief Render core: synth, state shadow, smoothers, scheduled events and output
+     *        stages. */
+    SynthEngine engine;
+    /* @brief Audio output stream, rendered by the engine. */
+    AAudioOutput audioOutput;
+    /* @brief Statistics counter: BLE-MIDI packets produced. */
+    std::atomic<uint64_t> bleMidiPackets;
+    /* @brief Statistics counter: BLE-MIDI bytes produced. */
+    std::atomic<uint64_t> bleMidiBytes;
+    /* @brief Parser of the MIDI stream sent with sendMidi(). */
+    MidiParser midiParser;
+    /* @brief Guards the MIDI stream parser. */
+    std::mutex midiMutex;
+    /* @brief Reader thread of the external MIDI input port. */
+    MidiReader midiReader;
+    /* @brief External MIDI input port. */
+    MidiInputPort *midiInput;
+    /* @brief External MIDI output port. */
+    MidiOutputPort *midiOutput;
+    /* @brief Guards the external MIDI ports. */
+    std::mutex midiPortMutex;
+    /* @brief Encoder of the BLE-MIDI output. */
+    BleMidiEncoder bleMidiEncoder;
+    /* @brief True if the BLE-MIDI output is enabled. */
+    bool bleMidiEnabled;
+    /* @brief A completed BLE-MIDI packet. */
+    struct BleMidiPacket {
+        /* @brief Packet length, in bytes. */
+        int length;
+        /* @brief Packet bytes. */
+        uint8_t data[kBleMidiMaxPacket];
+    };
+    /* @brief Completed BLE-MIDI packets (ring buffer). */
+    BleMidiPacket bleMidiQueue[kBleMidiQueuePackets];
+    /* @brief Index of the oldest queued BLE-MIDI packet. */
+    int bleMidiHead;
+    /* @brief Number of queued BLE-MIDI packets. */
+    int bleMidiCount;
+    /* @brief MIDI output messages queued for a BLE library (ring buffer). */
+    uint32_t bleMidiMessages[kBleMidiQueueMessages];
+    /* @brief Index of the oldest queued message for the BLE library. */
+    int bleMidiMessageHead;
+    /* @brief Number of queued messages for the BLE library. */
+    int bleMidiMessageCount;
+    /* @brief True if the messages are queued for the BLE library. */
+    bool bleMidiListening;
+    /* @brief Wakes up the waiter of the messages for the BLE library. */
+    std::condition_variable bleMidiCondition;
+    /* @brief Guards the BLE-MIDI encoder and queues. */
+    std::mutex bleMidiMutex;
+    /* @brief Sends the MIDI output of the render thread at the time it is heard. */
+    MidiSender midiSender;
+    /* @brief Pattern sequencer, played on the beats. */
+    PatternSequencer sequencer;
+    /* @brief Steps of the sequencer waiting to be scheduled in the engine. */
+    MidiEventQueue sequencerEvents;
+    /* @brief Number of sequencer steps per beat. */
+    int sequencerStepsPerBeat;
+    /* @brief True while the sequencer plays. */
+    bool sequencerRunning;
+    /* @brief Guards the sequencer. */
+    std::mutex sequencerMutex;
+    /* @brief Standard MIDI File player, following the beat tracker. */
+    SmfPlayer smfPlayer;
+    /* @brief Load time of the MIDI file, in nanoseconds. */
+    int64_t smfLoadTimeNs;
+    /* @brief Guards the MIDI file player. */
+    std::mutex smfMutex;
+    /* @brief Capture of the rendered audio to an Ogg/Opus file. */
+    AudioCapture audioCapture;
+    /* @brief Guards starting and stopping the audio capture. */
+    std::mutex audioCaptureMutex;
+    /* @brief Decoder of the BLE-MIDI input. */
+    BleMidiDecoder bleMidiDecoder;
+    /* @brief Arrival time of the BLE-MIDI packet being decoded, in milliseconds. */
+    double bleMidiArrivalMs;
+    /* @brief Maps the BLE-MIDI sender time to local time. */
+    BleMidiSync bleMidiSync;
+    /* @brief Guards the BLE-MIDI decoder and clock estimate. */
+    std::mutex bleMidiInMutex;
+    /* @brief Heart-rate signal pipeline (guarded by beatMutex). */
+    HeartRateFilter heartRateFilter;
+    /* @brief Heart-rate variability of the clean samples (guarded by beatMutex). */
+    HrvAnalyzer hrvAnalyzer;
+    /* @brief Route of a heart-rate variability metric to a controller. */
+    struct HrvRoute {
+        /* @brief True if the route is in use. */
+        bool active = false;
+        /* @brief Metric (HrvMetric). */
+        int metric = 0;
+        /* @brief Channel number. */
+        int chan = 0;
+        /* @brief Controller number. */
+        int controller = 0;
+        /* @brief Metric value mapped to 0. */
+        float minValue = 0.0f;
+        /* @brief Metric value mapped to 127. */
+        float maxValue = 0.0f;
+    };
+    /* @brief Routes of the heart-rate variability metrics. */
+    HrvRoute hrvRoutes[kMaxHrvRoutes];
+    /* @brief Guards the routes. */
+    std::mutex hrvMutex;
+    /* @brief Last filtered heart rate, in BPM. */
+    std::atomic<float> heartRate;
+    /* @brief Native heart-rate source (owned). */
+    HeartRateSource *heartRateSource;
+    /* @brief Start time of the heart-rate source (steady clock), in nanoseconds. */
+    int64_t heartRateSourceStartNs;
+    /* @brief Guards the heart-rate source. */
+    std::mutex heartRateSourceMutex;
+    /* @brief Beat tracker following the heart rate. */
+    BeatTracker beatTracker;
+    /* @brief Guards the beat tracker. */
+    std::mutex beatMutex;
+    /* @brief MIDI clock generator. */
+    MidiClock midiClock;
 };
 
 #endif //ANDROID_MIDI_SYNTH_SYNTHMANAGER_H
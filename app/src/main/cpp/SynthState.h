@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/SynthState.h
+ * @brief Header of the synth state shadow and statistics structures.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_SYNTHSTATE_H
+#define ANDROID_MIDI_SYNTH_SYNTHSTATE_H
+
+#include <cstdint>
+
+/** @brief Number of MIDI channels kept in the shadow cache. */
+static const int kSynthStateChannels   = 16;
+/** @brief Number of MIDI controllers per channel. */
+static const int kSynthStateControllers = 128;
+/** @brief Value of a shadow entry that was never sent to the synth. */
+static const int kSynthStateUnknown    = -1;
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief Shadow of the state of a single MIDI channel.
+ * @details Every field holds kSynthStateUnknown until a value is sent to the synth.
+ */
+struct ChannelState {
+    /** @brief Current program number (0-127). */
+    int16_t program;
+    /** @brief Current bank number (0-16383). */
+    int16_t bank;
+    /** @brief Current pitch bend value (0-16383). */
+    int16_t pitchBend;
+    /** @brief Current value of each controller (0-127). */
+    int8_t cc[kSynthStateControllers];
+};
+
+/**
+ * @brief Shadow of the whole synth state.
+ */
+struct SynthState {
+    /** @brief Per-channel state. */
+    ChannelState channels[kSynthStateChannels];
+    /** @brief Reverb group level (0-127). */
+    int16_t reverbLevel;
+    /** @brief Chorus group level (0-127). */
+    int16_t chorusLevel;
+};
+
+/**
+ * @brief SynthManager statistics counters.
+ */
+struct SynthStats {
+    /** @brief Calls forwarded to the FluidSynth synth. */
+    uint64_t forwardedCalls;
+    /** @brief Calls dropped because they would not change the synth state. */
+    uint64_t elidedCalls;
+    /** @brief BLE-MIDI packets produced. */
+    uint64_t bleMidiPackets;
+    /** @brief BLE-MIDI bytes produced. */
+    uint64_t bleMidiBytes;
+};
+
+#endif //ANDROID_MIDI_SYNTH_SYNTHSTATE_H
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/VoiceBudget.cpp
+ * @brief Voice budget of the synth: per-channel limits, priorities and early fade.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstring>
+
+#include "VoiceBudget.h"
+
+/* @brief Release time of a fade, in timecents (16 ms, the shortest the synth allows). */
+static const float kVoiceFadeTimecents = -7200.0f;
+/* @brief Range of the volume envelope, in dB (reached at the end of the release time). */
+static const float kVoiceEnvelopeDb = 96.0f;
+/* @brief Fraction of the polyphony kept free for the protected channels. */
+static const int kVoiceHeadroomDivisor = 16;
+/* @brief Fewest voices kept free for the protected channels. */
+static const int kVoiceMinHeadroom = 2;
+
+// -----------------------------------------------------------------------------------------------
+
+VoiceBudget::VoiceBudget(int sampleRate):
+    sampleRate(sampleRate), voiceCount(0), activeVoices(0), fadedVoices(0), takenVoices(0) {
+    for (int chan = 0; chan < kVoiceBudgetChannels; chan++) {
+        priorities[chan].store(kVoicePriority_Normal, std::memory_order_relaxed);
+        budgets[chan].store(0, std::memory_order_relaxed);
+    }
+    memset(table, 0, sizeof(table));
+    memset(list, 0, sizeof(list));
+}
+
+bool VoiceBudget::setChannel(int chan, int priority, int budget) {
+    if (chan < 0 || chan >= kVoiceBudgetChannels || budget < 0 ||
+        priority < kVoicePriority_Low || priority > kVoicePriority_Protected) return false;
+    priorities[chan].store(priority, std::memory_order_relaxed);
+    budgets[chan].store(budget, std::memory_order_relaxed);
+    return true;
+}
+
+int VoiceBudget::getPriority(int chan) const {
+    if (chan < 0 || chan >= kVoiceBudgetChannels) return -1;
+    return priorities[chan].load(std::memory_order_relaxed);
+}
+
+int VoiceBudget::getBudget(int chan) const {
+    if (chan < 0 || chan >= kVoiceBudgetChannels) return -1;
+    return budgets[chan].load(std::memory_order_relaxed);
+}
+
+void VoiceBudget::getStats(VoiceStats &stats) const {
+    stats.active = activeVoices.load(std::memory_order_relaxed);
+    stats.faded = fadedVoices.load(std::memory_order_relaxed);
+    stats.taken = takenVoices.load(std::memory_order_relaxed);
+}
+
+VoiceBudget::VoiceEntry *VoiceBudget::lookup(fluid_voice_t *voice, int64_t frame) {
+    uint32_t hash = (uint32_t) ((uintptr_t) voice >> 4) * 2654435761u;
+    int index = (int) (hash >> 16) & (kTableSize - 1);
+    for (int probe = 0; probe < kTableSize; probe++) {
+        VoiceEntry &entry = table[index];
+        if (entry.voice == voice || entry.voice == nullptr) {
+            unsigned int id = fluid_voice_get_id(voice);
+            if (entry.voice == nullptr || entry.id != id) {
+                // a new voice in this slot
+                int velocity = fluid_voice_get_actual_velocity(voice);
+                entry.voice = voice;
+                entry.id = id;
+                entry.startFrame = frame;
+                entry.releaseFrame = -1;
+                entry.releaseDb = velocity > 0 ? 40.0f * log10f(velocity / 127.0f)
+                                               : -kVoiceEnvelopeDb;
+                entry.releaseDbPerFrame = 0.0f;
+                entry.faded = false;
+            }
+            return &entry;
+        }
+        index = (index + 1) & (kTableSize - 1);
+    }
+    return nullptr;
+}
+
+void VoiceBudget::process(fluid_synth_t *synth, int64_t frame) {
+    int priority[kVoiceBudgetChannels];
+    bool anyProtected = false;
+    for (int chan = 0; chan < kVoiceBudgetChannels; chan++) {
+        priority[chan] = priorities[chan].load(std::memory_order_relaxed);
+        if (priority[chan] == kVoicePriority_Protected) anyProtected = true;
+    }
+    fluid_synth_get_voicelist(synth, list, kMaxVoices, -1);
+    int playing = 0;
+    int counts[kVoiceBudgetChannels] = {};
+    voiceCount = 0;
+    for (; playing < kMaxVoices && list[playing] != nullptr; playing++) {
+        fluid_voice_t *voice = list[playing];
+        VoiceEntry *entry = lookup(voice, frame);
+        int chan = fluid_voice_get_channel(voice);
+        if (entry == nullptr || entry->faded || chan < 0 || chan >= kVoiceBudgetChannels) {
+            continue;
+        }
+        bool held = fluid_voice_is_on(voice) || fluid_voice_is_sustained(voice) ||
+                    fluid_voice_is_sostenuto(voice);
+        if (!held && entry->releaseFrame < 0) {
+            // the envelope goes down by kVoiceEnvelopeDb per release time
+            float timecents = fluid_voice_gen_get(voice, GEN_VOLENVRELEASE);
+            if (timecents < kVoiceFadeTimecents) timecents = kVoiceFadeTimecents;
+            float seconds = exp2f(timecents / 1200.0f);
+            entry->releaseFrame = frame;
+            entry->releaseDbPerFrame = kVoiceEnvelopeDb / (seconds * sampleRate);
+        }
+        float levelDb = entry->releaseDb;
+        if (entry->releaseFrame >= 0) {
+            levelDb -= (float) (frame - entry->releaseFrame) * entry->releaseDbPerFrame;
+        }
+        VoiceInfo &info = voices[voiceCount];
+        info = { voice, entry, chan, levelDb };
+        if (!held && levelDb < kVoiceAudibleDb) {
+            fade(synth, info);
+            fadedVoices.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        counts[chan]++;
+        voiceCount++;
+    }
+    activeVoices.store(playing, std::memory_order_relaxed);
+    // channels over their budget (the protected channels keep their voices)
+    for (int chan = 0; chan < kVoiceBudgetChannels; chan++) {
+        int budget = budgets[chan].load(std::memory_order_relaxed);
+        if (budget == 0 || priority[chan] == kVoicePriority_Protected) continue;
+        for (; counts[chan] > budget; counts[chan]--) {
+            int victim = chooseVictim(chan, priority);
+            if (victim < 0) break;
+            fade(synth, voices[victim]);
+            takenVoices.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!anyProtected) return;
+    // free voices for the protected channels, so the synth does not steal them
+    int polyphony = fluid_synth_get_polyphony(synth);
+    int headroom = polyphony / kVoiceHeadroomDivisor;
+    if (headroom < kVoiceMinHeadroom) headroom = kVoiceMinHeadroom;
+    int used = 0;
+    for (int chan = 0; chan < kVoiceBudgetChannels; chan++) used += counts[chan];
+    for (; polyphony - used < headroom; used--) {
+        int victim = chooseVictim(-1, priority);
+        if (victim < 0) break;
+        fade(synth, voices[victim]);
+        takenVoices.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void VoiceBudget::fade(fluid_synth_t *synth, const VoiceInfo &info) {
+    info.entry->faded = true;
+    fluid_voice_gen_set(info.voice, GEN_VOLENVRELEASE, kVoiceFadeTimecents);
+    fluid_voice_update_param(info.voice, GEN_VOLENVRELEASE);
+    if (fluid_voice_is_on(info.voice)) fluid_synth_stop(synth, fluid_voice_get_id(info.voice));
+}
+
+int VoiceBudget::chooseVictim(int chan, const int *priority) const {
+    // lowest priority, then released before held, then quietest, then oldest
+    int best = -1;
+    for (int i = 0; i < voiceCount; i++) {
+        const VoiceInfo &info = voices[i];
+        if (info.entry->faded) continue;
+        if (chan >= 0 ? info.chan != chan : priority[info.chan] == kVoicePriority_Protected) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        const VoiceInfo &other = voices[best];
+        bool released = info.entry->releaseFrame >= 0;
+        bool otherReleased = other.entry->releaseFrame >= 0;
+        if (priority[info.chan] != priority[other.chan]) {
+            if (priority[info.chan] < priority[other.chan]) best = i;
+        } else if (released != otherReleased) {
+            if (released) best = i;
+        } else if (info.levelDb != other.levelDb) {
+            if (info.levelDb < other.levelDb) best = i;
+        } else if (info.entry->startFrame < other.entry->startFrame) {
+            best = i;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/VoiceBudget.h
+ * @brief Voice budget of the synth: per-channel limits, priorities and early fade.
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#ifndef ANDROID_MIDI_SYNTH_VOICEBUDGET_H
+#define ANDROID_MIDI_SYNTH_VOICEBUDGET_H
+
+#include <fluidsynth.h>
+#include <atomic>
+#include <cstdint>
+
+/** @brief Number of MIDI channels with a voice priority. */
+static const int kVoiceBudgetChannels = 16;
+/** @brief Estimated level under which a released voice is faded out, in dBFS. */
+static const float kVoiceAudibleDb = -60.0f;
+
+/** @brief Voice priorities of a channel. */
+enum VoicePriority {
+    /** @brief Taken first when voices are needed. */
+    kVoicePriority_Low       = 0,
+    /** @brief Default priority. */
+    kVoicePriority_Normal    = 1,
+    /** @brief Never taken (the heartbeat); voices are kept free for it. */
+    kVoicePriority_Protected = 2
+};
+
+/** @brief Voice counters, as published by VoiceBudget. */
+struct VoiceStats {
+    /** @brief Voices playing at the last block. */
+    int64_t active;
+    /** @brief Released voices faded out early, since the start. */
+    int64_t faded;
+    /** @brief Voices taken for the budgets or the free voices, since the start. */
+    int64_t taken;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief VoiceBudget class.
+ * @details Manages the voices of the synth before each rendered block, so the synth never
+ *          has to steal voices by its own rules (which may cut the current heartbeat in
+ *          favour of an older note in its release):
+ *          - released voices are faded out in 16 ms once their estimated level falls under
+ *            kVoiceAudibleDb. The estimate is an upper bound: full scale scaled by the
+ *            velocity (40 log10(velocity / 127) dB) at the note off, then 96 dB per release
+ *            time, as the volume envelope of the synth decays;
+ *          - a channel over its budget gives up voices (released ones first, then the
+ *            quietest and oldest);
+ *          - while a channel is protected, a few voices (1/16 of the polyphony, at least 2)
+ *            are kept free, taken from the other channels: low priority first, released
+ *            before held, quietest and oldest first.
+ *          A voice is taken by a 16 ms fade (and a note off, if still held), so no voice is
+ *          cut. The voices are tracked by their slot in the synth and their ID; the voice
+ *          list is only valid on the thread calling fluid_synth_process(), so process() is
+ *          called by the render thread. Priorities and budgets may be set from any thread.
+ */
+class VoiceBudget {
+public:
+    /**
+     * @brief Constructor.
+     * @param sampleRate Sample rate, in Hz.
+     */
+    explicit VoiceBudget(int sampleRate);
+    /**
+     * @brief Set the priority and voice budget of a channel (any thread).
+     * @param chan Channel number.
+     * @param priority Voice priority (VoicePriority).
+     * @param budget Maximum number of voices of the channel (0 for no limit).
+     * @return True if successful. False if an argument is invalid.
+     */
+    bool setChannel(int chan, int priority, int budget);
+    /**
+     * @brief Get the priority of a channel.
+     * @param chan Channel number.
+     * @return The priority (VoicePriority), or -1 if the channel is invalid.
+     */
+    int getPriority(int chan) const;
+    /**
+     * @brief Get the voice budget of a channel.
+     * @param chan Channel number.
+     * @return The budget (0 for no limit), or -1 if the channel is invalid.
+     */
+    int getBudget(int chan) const;
+    /**
+     * @brief Manage the voices before a block is rendered (render thread).
+     * @param synth The synth.
+     * @param frame Audio frame of the block.
+     */
+    void process(fluid_synth_t *synth, int64_t frame);
+    /**
+     * @brief Get the voice counters (any thread).
+     * @param stats Receives the counters.
+     */
+    void getStats(VoiceStats &stats) const;
+private:
+    /* @brief Most voices managed (polyphony of the high tier). */
+    static const int kMaxVoices = 256;
+    /* @brief Slots of the voice table (power of two, twice the voices). */
+    static const int kTableSize = 2 * kMaxVoices;
+    /* @brief State of a voice, by slot of the synth. */
+    struct VoiceEntry {
+        /* @brief Voice slot of the synth (nullptr for a free entry). */
+        const fluid_voice_t *voice;
+        /* @brief Voice ID (a new ID is a new voice in the slot). */
+        unsigned int id;
+        /* @brief Frame at which the voice was first seen. */
+        int64_t startFrame;
+        /* @brief Frame of the note off, or -1 while held. */
+        int64_t releaseFrame;
+        /* @brief Level at the note off, in dB. */
+        float releaseDb;
+        /* @brief Decay of the release, in dB per frame. */
+        float releaseDbPerFrame;
+        /* @brief True once faded out. */
+        bool faded;
+    };
+    /* @brief A voice playing in the current block. */
+    struct VoiceInfo {
+        /* @brief The voice. */
+        fluid_voice_t *voice;
+        /* @brief Its entry in the table. */
+        VoiceEntry *entry;
+        /* @brief Channel number. */
+        int chan;
+        /* @brief Estimated level, in dB. */
+        float levelDb;
+    };
+    /* @brief Find or create the entry of a voice. */
+    VoiceEntry *lookup(fluid_voice_t *voice, int64_t frame);
+    /* @brief Fade out a voice in 16 ms (with a note off, if held). */
+    void fade(fluid_synth_t *synth, const VoiceInfo &info);
+    /* @brief Choose the next voice to take.
+     * @param chan Channel to take from, or -1 for any channel that is not protected.
+     * @param priority Priority per channel.
+     * @return Index in voices, or -1 if none. */
+    int chooseVictim(int chan, const int *priority) const;
+private:
+    /* @brief Sample rate, in Hz. */
+    int sampleRate;
+    /* @brief Priority per channel (written by any thread). */
+    std::atomic<int> priorities[kVoiceBudgetChannels];
+    /* @brief Budget per channel, 0 for no limit (written by any thread). */
+    std::atomic<int> budgets[kVoiceBudgetChannels];
+    /* @brief Voice table (open addressing by slot). */
+    VoiceEntry table[kTableSize];
+    /* @brief Voice list of the synth. */
+    fluid_voice_t *list[kMaxVoices + 1];
+    /* @brief Voices playing in the current block, not faded out. */
+    VoiceInfo voices[kMaxVoices];
+    /* @brief Number of voices (not faded out). */
+    int voiceCount;
+    /* @brief Published voices playing. */
+    std::atomic<int64_t> activeVoices;
+    /* @brief Published voices faded out early. */
+    std::atomic<int64_t> fadedVoices;
+    /* @brief Published voices taken. */
+    std::atomic<int64_t> takenVoices;
+};
+
+#endif //ANDROID_MIDI_SYNTH_VOICEBUDGET_H
@@ -0,0 +1,1078 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/ApiReplay.cpp
+ * @brief Synth API trace replay tool (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <fluidsynth.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../ApiTrace.h"
+#include "../LevelMeter.h"
+#include "../MidiSpec.h"
+#include "../QualityGovernor.h"
+#include "../SynthEngine.h"
+
+/*
+ * Replays a trace of the synth calls (SynthManager::startApiTrace()) against an offline
+ * SynthEngine, the render core of the app: the periods are rendered by SynthEngine::render()
+ * and each call is made at the start of the control block of its frame. Prints per-block
+ * render times, voices playing and a hash of the output of each run; the runs must match
+ * bit for bit.
+ *
+ * usage: api-replay [-s soundfont.sf2] [-n runs] [-c cores] [-k hash] [-r ratio]
+ *                   [-w scenario] [-g dir] [-G dir] [-o out.raw] [-m] [-q tier] [-v]
+ *                   trace.bin
+ *        runs (2 by default) replays the trace several times to check determinism.
+ *        cores sets synth.cpu-cores (1 by default, the cores of the tier with -q).
+ *        hash (hex) is the expected hash of the output, to gate changes on a known trace
+ *        (of the first tier, with -q all).
+ *        ratio is the limit of the block render time (mean of the best run) over its
+ *        baseline: the same trace rendered by a stock synth (FluidSynth defaults, no voice
+ *        budget, no output stages), measured in the same process, so the gate holds on any
+ *        host.
+ *        scenario writes a built-in scenario to trace.bin before replaying it, and checks
+ *        its output against the expected spectrum and levels (checks that hold for any
+ *        FluidSynth build and soundfont, unlike the hash): heartbeat60, heartbeat120,
+ *        heartbeat180 (the app pattern: the beat period and the note of each beat), chord
+ *        (each note over the notes between them), reverb (level sweep on a held note: wet
+ *        minus dry rises with the level), reverb64 (the same in periods of one control
+ *        block, with the effects mixed into the dry output), program (program change in
+ *        the middle of a note: the note goes on, the next one changes timbre) or
+ *        heartvoices (the pattern played by the procedural voices of the heartbeat channel,
+ *        the output gain halved in the middle: the beat period and the gain; the synth
+ *        plays nothing, so its golden spectrum holds without a soundfont).
+ *        dir (-g) holds the golden spectra of the scenarios (dir/scenario.txt): the output
+ *        must match the level and the third-octave band levels of the file within its
+ *        tolerance. -G writes the file instead, from the first run (to update it after an
+ *        intended change). The goldens hold for the traced tiers, not with -q.
+ *        out.raw receives the audio of the first run (interleaved stereo float).
+ *        -m meters each block as the app does (LevelMeter), printing the meter time per
+ *        block next to the render time, and the loudness of the output.
+ *        tier replays with a fixed quality tier instead of the traced ones: eco, balanced,
+ *        high, or all to replay with each tier and print the render cost per tier.
+ *        -v replays also without the voice budget (the synth steals voices by its own
+ *        rules, released voices play to the end), and prints the voices saved by it.
+ *        Exits with 1 if the runs differ, the hash, the scenario output or its golden
+ *        spectrum does not match, or the render time is over the limit.
+ */
+
+/* @brief Period assumed before the first traced period, in frames. */
+static const int kReplayDefaultPeriod = 64;
+/* @brief Time rendered after the last call, in seconds (release tails). */
+static const double kReplayTailSeconds = 2.0;
+
+/* @brief Sample rate of the built-in scenarios, in Hz (as the app). */
+static const int kScenarioSampleRate = 44100;
+/* @brief Render period of the built-in scenarios, in frames (10 ms, as the app). */
+static const int kScenarioPeriod = 441;
+/* @brief Gain of the built-in scenarios (as the app). */
+static const float kScenarioGain = 1.0f;
+
+/* @brief Smallest power ratio of the notes played over the notes not played (6 dB). */
+static const double kGoldenMinToneRatio = 4.0;
+/* @brief Largest error of the beat period found in the output, in seconds. */
+static const double kGoldenBeatTolerance = 0.02;
+/* @brief Largest error of the output gain found in the output, relative. */
+static const double kGoldenGainTolerance = 0.05;
+/* @brief Smallest ratio of the reverb (wet minus dry) at the top of the sweep over its
+ * bottom, each relative to the dry output. */
+static const double kGoldenMinWetRatio = 2.0;
+/* @brief Largest level change of a note across a program change (no gap, no jump). */
+static const double kGoldenMaxLevelChange = 2.0;
+/* @brief Smallest timbre change of a note after a program change (mean of the harmonics
+ * relative to the fundamental), in dB. */
+static const double kGoldenMinTimbreDb = 3.0;
+/* @brief Harmonics compared by the timbre change. */
+static const int kGoldenHarmonics = 8;
+
+/* @brief Frames of the FFT of the golden spectra (power of 2). */
+static const int kSpectrumFrames = 4096;
+/* @brief First third-octave band of the golden spectra (50 Hz), in thirds from 1 kHz. */
+static const int kSpectrumFirstBand = -13;
+/* @brief Last third-octave band of the golden spectra (16 kHz), in thirds from 1 kHz. */
+static const int kSpectrumLastBand = 12;
+/* @brief Band level below which two spectra are not compared (dither and noise), in dBFS. */
+static const double kSpectrumFloorDb = -90.0;
+/* @brief Lowest level written to a golden spectrum (silence), in dBFS. */
+static const double kSpectrumSilenceDb = -120.0;
+/* @brief Tolerance written to a new golden spectrum, in dB. */
+static const double kSpectrumToleranceDb = 3.0;
+
+/* @brief Names of the quality tiers, indexed by QualityTier. */
+static const char *kTierNames[kQualityTierCount] = { "eco", "balanced", "high" };
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Bits of a float argument of the trace. */
+static int32_t floatBits(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* @brief Float argument of the trace, from its bits. */
+static float bitsFloat(int32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* @brief Load a trace file, ordered by frame (ties by sequence number). */
+static bool loadTrace(const char *path, ApiTraceHeader &header,
+                      std::vector<ApiTraceRecord> &records) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, kApiTraceMagic, sizeof(header.magic)) == 0 &&
+                 header.version == kApiTraceVersion;
+    ApiTraceRecord record;
+    while (valid && fread(&record, sizeof(record), 1, file) == 1) records.push_back(record);
+    fclose(file);
+    if (!valid) return false;
+    std::stable_sort(records.begin(), records.end(),
+                     [](const ApiTraceRecord &a, const ApiTraceRecord &b) {
+                         return (int32_t) (a.sequence - b.sequence) < 0;
+                     });
+    std::stable_sort(records.begin(), records.end(),
+                     [](const ApiTraceRecord &a, const ApiTraceRecord &b) {
+                         return a.frame < b.frame;
+                     });
+    return true;
+}
+
+/* @brief Append a call to a scenario. */
+static void addCall(std::vector<ApiTraceRecord> &records, double seconds, int op, int chan,
+                    int arg1, int arg2 = 0) {
+    ApiTraceRecord record = {};
+    record.frame = (int64_t) (seconds * kScenarioSampleRate);
+    record.sequence = (uint32_t) records.size();
+    record.op = (uint8_t) op;
+    record.chan = (uint8_t) chan;
+    record.arg1 = arg1;
+    record.arg2 = arg2;
+    records.push_back(record);
+}
+
+/* @brief Write a built-in scenario as a trace file. */
+static bool writeScenario(const char *name, const char *soundfont, const char *path) {
+    std::vector<ApiTraceRecord> records;
+    // reverb64 renders in the periods of a single control block, as a low latency driver does
+    int period = strcmp(name, "reverb64") == 0 ? kControlBlockFrames : kScenarioPeriod;
+    addCall(records, 0.0, kApiTraceOp_Period, 0, period);
+    struct stat st;
+    if (soundfont) {
+        int size = stat(soundfont, &st) == 0 ? (int) st.st_size : 0;
+        addCall(records, 0.0, kApiTraceOp_LoadSoundFont, 0, size,
+                SynthEngine::hashFileName(soundfont));
+    }
+    int bpm = 0;
+    if (sscanf(name, "heartbeat%d", &bpm) == 1 && bpm > 0) {
+        // the app pattern: C and G on channel 1 (the guitar of the app), half a beat long
+        double period = 60.0 / bpm;
+        addCall(records, 0.0, kApiTraceOp_ProgramChange, 1, 24);
+        for (int i = 0; i < 16; i++) {
+            int note = i % 2 ? 67 : 60;
+            addCall(records, i * period, kApiTraceOp_NoteOn, 1, note, 100);
+            addCall(records, (i + 0.5) * period, kApiTraceOp_NoteOff, 1, note);
+        }
+    } else if (strcmp(name, "chord") == 0) {
+        static const int notes[] = { 48, 60, 64, 67, 72 };
+        addCall(records, 0.0, kApiTraceOp_ProgramChange, 0, 0);
+        for (int note : notes) addCall(records, 0.0, kApiTraceOp_NoteOn, 0, note, 90);
+        for (int note : notes) addCall(records, 3.0, kApiTraceOp_NoteOff, 0, note);
+    } else if (strcmp(name, "reverb") == 0 || strcmp(name, "reverb64") == 0) {
+        // the sweep of the reverb level, on a note sent to the reverb in full
+        addCall(records, 0.0, kApiTraceOp_ProgramChange, 0, 0);
+        addCall(records, 0.0, kApiTraceOp_Control, 0, kMIDIControl_Reverb, 127);
+        addCall(records, 0.0, kApiTraceOp_NoteOn, 0, 60, 100);
+        for (int i = 0; i <= 64; i++) {
+            int level = i <= 32 ? i * 127 / 32 : (64 - i) * 127 / 32;
+            addCall(records, i * 0.05, kApiTraceOp_Reverb, 0, level);
+        }
+        addCall(records, 3.2, kApiTraceOp_NoteOff, 0, 60);
+    } else if (strcmp(name, "program") == 0) {
+        addCall(records, 0.0, kApiTraceOp_ProgramChange, 0, 0);
+        addCall(records, 0.1, kApiTraceOp_NoteOn, 0, 60, 100);
+        addCall(records, 1.0, kApiTraceOp_ProgramChange, 0, 40);
+        addCall(records, 2.0, kApiTraceOp_NoteOff, 0, 60);
+        addCall(records, 2.2, kApiTraceOp_NoteOn, 0, 60, 100);
+        addCall(records, 3.2, kApiTraceOp_NoteOff, 0, 60);
+    } else if (strcmp(name, "heartvoices") == 0) {
+        // the pattern of heartbeat120 on the procedural voices, the output gain halved at 4 s
+        addCall(records, 0.0, kApiTraceOp_HeartbeatChannel, 0, 1);
+        addCall(records, 0.0, kApiTraceOp_Heart, 0, floatBits(120.0f), floatBits(40.0f));
+        for (int i = 0; i < 16; i++) {
+            int note = i % 2 ? 67 : 60;
+            addCall(records, i * 0.5, kApiTraceOp_NoteOn, 1, note, 100);
+            addCall(records, (i + 0.5) * 0.5, kApiTraceOp_NoteOff, 1, note);
+        }
+        addCall(records, 4.0, kApiTraceOp_OutputGain, 0, floatBits(0.5f));
+    } else {
+        return false;
+    }
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) return false;
+    ApiTraceHeader header;
+    memcpy(header.magic, kApiTraceMagic, sizeof(header.magic));
+    header.version = kApiTraceVersion;
+    header.sampleRate = kScenarioSampleRate;
+    header.gain = kScenarioGain;
+    header.dropped = 0;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(records.data(), sizeof(ApiTraceRecord), records.size(), file);
+    fclose(file);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief One replay of a trace, rendered by the engine of the app. */
+class Replay: public SynthEngineListener {
+public:
+    Replay(const ApiTraceHeader &header, const std::vector<ApiTraceRecord> &records,
+           const char *soundfont, int cores, bool metering, int tier, bool budgeting):
+        records(records), soundfont(soundfont), sampleRate((int) header.sampleRate),
+        // as SynthManager: the high tier until the trace sets another
+        engine(this, (int) header.sampleRate, header.gain, tier >= 0 ? tier : kQualityTier_High),
+        next(0), blockStart(0), hash(14695981039346656037ull), meanUs(0.0), p99Us(0.0),
+        metering(metering), levelMeter((int) header.sampleRate), fixedTier(tier >= 0),
+        audio(nullptr), output(nullptr), voiceTotal(0), voicePeak(0) {
+        if (cores == 0) cores = tier >= 0 ? QualityGovernor::getSettings(tier).cpuCores : 1;
+        settings = new_fluid_settings();
+        if (!engine.open(settings, cores)) return;
+        engine.setVoiceBudget(budgeting);
+    }
+
+    ~Replay() {
+        engine.close();
+        delete_fluid_settings(settings);
+    }
+
+    bool isValid() const { return engine.getSynth() != nullptr; }
+
+    /* @brief Replay the whole trace, keeping the output (mono) in audio if given. */
+    void run(FILE *outputFile, std::vector<float> *outputAudio = nullptr) {
+        output = outputFile;
+        audio = outputAudio;
+        int period = kReplayDefaultPeriod;
+        int64_t frame = records.empty() ? 0 : records.front().frame;
+        int64_t end = records.empty() ? 0 : records.back().frame;
+        end += (int64_t) (kReplayTailSeconds * sampleRate);
+        std::vector<float> left, right;
+        while (frame < end) {
+            // a period traced at this frame applies to it
+            for (size_t i = next; i < records.size() && records[i].frame <= frame; i++) {
+                if (records[i].op == kApiTraceOp_Period) period = records[i].arg1;
+            }
+            // the synth mixes into the buffers, as the driver clears them
+            left.assign(period, 0.0f);
+            right.assign(period, 0.0f);
+            float *out[] = { left.data(), right.data() };
+            // the time of the period as if the callbacks came on time
+            engine.render(period, 0, nullptr, 2, out, frame * 1000000000 / sampleRate);
+            frame += period;
+        }
+        if (blockTimes.empty()) return;
+        std::vector<int64_t> sorted(blockTimes);
+        std::sort(sorted.begin(), sorted.end());
+        int64_t total = 0;
+        for (int64_t t : sorted) total += t;
+        meanUs = total / 1e3 / sorted.size();
+        p99Us = sorted[sorted.size() * 99 / 100] / 1e3;
+    }
+
+    uint64_t getHash() const { return hash; }
+
+    double getMeanUs() const { return meanUs; }
+
+    double getP99Us() const { return p99Us; }
+
+    /* @brief Mean of the voices playing per block. */
+    double getMeanVoices() const {
+        return blockTimes.empty() ? 0.0 : (double) voiceTotal / blockTimes.size();
+    }
+
+    int getPeakVoices() const { return voicePeak; }
+
+    /* @brief Print the render time statistics. */
+    void print() {
+        if (blockTimes.empty()) return;
+        std::vector<int64_t> sorted(blockTimes);
+        std::sort(sorted.begin(), sorted.end());
+        int64_t total = 0;
+        for (int64_t t : sorted) total += t;
+        size_t count = sorted.size();
+        printf("blocks %zu, render %.3f ms, block mean %.2f us, p50 %.2f us, p99 %.2f us, "
+               "max %.2f us\n", count, total / 1e6, meanUs,
+               sorted[count / 2] / 1e3, p99Us, sorted.back() / 1e3);
+        printf("  voices: mean %.1f, peak %d", getMeanVoices(), voicePeak);
+        VoiceStats stats;
+        engine.getVoiceStats(stats);
+        if (stats.faded > 0 || stats.taken > 0) {
+            printf(", faded out early %lld, taken %lld", (long long) stats.faded,
+                   (long long) stats.taken);
+        }
+        printf("\n");
+        if (!metering || meterTimes.empty()) return;
+        std::vector<int64_t> meterSorted(meterTimes);
+        std::sort(meterSorted.begin(), meterSorted.end());
+        int64_t meterTotal = 0;
+        for (int64_t t : meterSorted) meterTotal += t;
+        printf("  meter: block mean %.3f us, p99 %.3f us (%.2f%% of the render)\n",
+               meterTotal / 1e3 / count, meterSorted[count * 99 / 100] / 1e3,
+               100.0 * meterTotal / total);
+        LevelSnapshot levels;
+        engine.getOutputChain()->getLevelMeter()->getSnapshot(levels);
+        printf("  loudness: integrated %.1f LUFS, short-term %.1f LUFS, peak %.1f dBFS\n",
+               levels.integrated, levels.shortTerm, levels.maxPeak);
+    }
+
+    void onEngineBlock(int64_t frame, int frames) override {
+        // the calls of the block, made as the app threads make them
+        for (; next < records.size() && records[next].frame < frame + frames; next++) {
+            apply(records[next]);
+        }
+        blockStart = nowNs();
+    }
+
+    void onEngineMidiOut(int64_t, uint8_t, uint8_t, uint8_t) override {
+    }
+
+    void onEngineOutput(int64_t, const float *left, const float *right, int frames) override {
+        // smoothers, effects, voice budget, synth and output stages of the block
+        blockTimes.push_back(nowNs() - blockStart);
+        int voices = fluid_synth_get_active_voice_count(engine.getSynth());
+        voiceTotal += voices;
+        if (voices > voicePeak) voicePeak = voices;
+        if (metering) {
+            // the meter of the engine runs within the block: time a second one alone
+            int64_t start = nowNs();
+            levelMeter.process(left, right, frames);
+            meterTimes.push_back(nowNs() - start);
+        }
+        float interleaved[kControlBlockFrames * 2];
+        for (int offset = 0; offset < frames; offset += kControlBlockFrames) {
+            int count = std::min(frames - offset, kControlBlockFrames);
+            for (int i = 0; i < count; i++) {
+                interleaved[2 * i] = left[offset + i];
+                interleaved[2 * i + 1] = right[offset + i];
+            }
+            const auto *bytes = reinterpret_cast<const uint8_t*>(interleaved);
+            for (size_t i = 0; i < count * 2 * sizeof(float); i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            if (output) fwrite(interleaved, sizeof(float), count * 2, output);
+        }
+        for (int i = 0; i < frames && audio; i++) {
+            audio->push_back(0.5f * (left[i] + right[i]));
+        }
+    }
+
+private:
+    /* @brief Make a traced call through the engine API, as the app does. */
+    void apply(const ApiTraceRecord &r) {
+        switch (r.op) {
+            case kApiTraceOp_NoteOn:
+                engine.noteOn(r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_NoteOff:
+                engine.noteOff(r.chan, r.arg1);
+                break;
+            case kApiTraceOp_Control:
+                engine.sendCC(r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_ProgramChange:
+                engine.programChange(r.chan, r.arg1);
+                break;
+            case kApiTraceOp_BankSelect:
+                engine.bankSelect(r.chan, r.arg1);
+                break;
+            case kApiTraceOp_PitchBend:
+                engine.pitchBend(r.chan, r.arg1);
+                break;
+            case kApiTraceOp_KeyPressure:
+                engine.onMidiMessage((kMIDIChanCmd_KeyPress << 4) | r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_ChannelPressure:
+                engine.onMidiMessage((kMIDIChanCmd_ChannelPress << 4) | r.chan, r.arg1, 0);
+                break;
+            case kApiTraceOp_Reverb:
+                engine.reverb(r.arg1);
+                break;
+            case kApiTraceOp_Chorus:
+                engine.chorus(r.arg1);
+                break;
+            case kApiTraceOp_SetGen:
+                // the smoothed filter cutoff of the engine, traced as it reaches the synth
+                fluid_synth_set_gen(engine.getSynth(), r.chan, r.arg1, bitsFloat(r.arg2));
+                break;
+            case kApiTraceOp_LoadSoundFont:
+                loadSoundFont(r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_SystemReset:
+                engine.onMidiMessage(kMIDISysCmd_Reset, 0, 0);
+                break;
+            case kApiTraceOp_Quality:
+                if (!fixedTier) engine.setQualityTier(r.arg1, false);
+                break;
+            case kApiTraceOp_VoicePriority:
+                engine.setVoicePriority(r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_HeartbeatChannel:
+                engine.setHeartbeatChannel(r.arg1);
+                break;
+            case kApiTraceOp_Heart:
+                engine.setHeart(bitsFloat(r.arg1), bitsFloat(r.arg2));
+                break;
+            case kApiTraceOp_OutputGain:
+                engine.setOutputGain(bitsFloat(r.arg1));
+                break;
+            default:
+                break;
+        }
+    }
+
+    void loadSoundFont(int size, int nameHash) {
+        if (soundfont == nullptr) {
+            fprintf(stderr, "the trace loads a soundfont, use -s\n");
+            return;
+        }
+        struct stat st;
+        if (stat(soundfont, &st) != 0 || st.st_size != size ||
+                SynthEngine::hashFileName(soundfont) != nameHash) {
+            fprintf(stderr, "warning: %s differs from the traced soundfont\n", soundfont);
+        }
+        if (!engine.loadSF(soundfont)) fprintf(stderr, "cannot load %s\n", soundfont);
+    }
+
+private:
+    const std::vector<ApiTraceRecord> &records;
+    const char *soundfont;
+    int sampleRate;
+    fluid_settings_t *settings;
+    SynthEngine engine;
+    size_t next;
+    int64_t blockStart;
+    uint64_t hash;
+    double meanUs;
+    double p99Us;
+    std::vector<int64_t> blockTimes;
+    bool metering;
+    LevelMeter levelMeter;
+    std::vector<int64_t> meterTimes;
+    bool fixedTier;
+    std::vector<float> *audio;
+    FILE *output;
+    int64_t voiceTotal;
+    int voicePeak;
+};
+
+/* @brief Replay of a trace by a stock synth: the FluidSynth defaults, no quality tiers, no
+ * voice budget and no output stages. The baseline of the render time, not of the output. */
+class StockReplay {
+public:
+    StockReplay(const ApiTraceHeader &header, const std::vector<ApiTraceRecord> &records,
+                const char *soundfont):
+        records(records), soundfont(soundfont), sampleRate((int) header.sampleRate),
+        meanUs(0.0) {
+        settings = new_fluid_settings();
+        fluid_settings_setnum(settings, "synth.sample-rate", header.sampleRate);
+        fluid_settings_setnum(settings, "synth.gain", header.gain);
+        synth = new_fluid_synth(settings);
+    }
+
+    ~StockReplay() {
+        if (synth) delete_fluid_synth(synth);
+        delete_fluid_settings(settings);
+    }
+
+    /* @brief Replay the whole trace in control blocks, timing each. */
+    void run() {
+        if (synth == nullptr) return;
+        size_t next = 0;
+        int64_t frame = records.empty() ? 0 : records.front().frame;
+        int64_t end = records.empty() ? 0 : records.back().frame;
+        end += (int64_t) (kReplayTailSeconds * sampleRate);
+        float left[kControlBlockFrames];
+        float right[kControlBlockFrames];
+        float *out[] = { left, right };
+        float *fx[] = { left, right, left, right };
+        int64_t total = 0, blocks = 0;
+        for (; frame < end; frame += kControlBlockFrames) {
+            for (; next < records.size() &&
+                   records[next].frame < frame + kControlBlockFrames; next++) {
+                apply(records[next]);
+            }
+            memset(left, 0, sizeof(left));
+            memset(right, 0, sizeof(right));
+            int64_t start = nowNs();
+            fluid_synth_process(synth, kControlBlockFrames, 4, fx, 2, out);
+            total += nowNs() - start;
+            blocks++;
+        }
+        meanUs = blocks > 0 ? total / 1e3 / blocks : 0.0;
+    }
+
+    double getMeanUs() const { return meanUs; }
+
+private:
+    /* @brief Make the calls that set the voices playing. */
+    void apply(const ApiTraceRecord &r) {
+        switch (r.op) {
+            case kApiTraceOp_NoteOn:
+                fluid_synth_noteon(synth, r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_NoteOff:
+                fluid_synth_noteoff(synth, r.chan, r.arg1);
+                break;
+            case kApiTraceOp_Control:
+                fluid_synth_cc(synth, r.chan, r.arg1, r.arg2);
+                break;
+            case kApiTraceOp_ProgramChange:
+                fluid_synth_program_change(synth, r.chan, r.arg1);
+                break;
+            case kApiTraceOp_BankSelect:
+                fluid_synth_bank_select(synth, r.chan, r.arg1);
+                break;
+            case kApiTraceOp_Reverb:
+                fluid_synth_set_reverb_group_level(synth, -1, r.arg1 / 127.0);
+                break;
+            case kApiTraceOp_Chorus:
+                fluid_synth_set_chorus_group_level(synth, -1, r.arg1 / 127.0);
+                break;
+            case kApiTraceOp_LoadSoundFont:
+                if (soundfont == nullptr) break;
+                fluid_synth_sfont_select(synth, 0, fluid_synth_sfload(synth, soundfont, 0));
+                break;
+            case kApiTraceOp_SystemReset:
+                fluid_synth_system_reset(synth);
+                break;
+            default:
+                break;
+        }
+    }
+
+private:
+    const std::vector<ApiTraceRecord> &records;
+    const char *soundfont;
+    int sampleRate;
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    double meanUs;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief Frequency of a MIDI note, in Hz. */
+static double noteHz(int note) {
+    return 440.0 * pow(2.0, (note - 69) / 12.0);
+}
+
+/* @brief Power around a frequency (within a quarter tone) in a window of the audio
+ * (Goertzel, Hann window), from and to in seconds. */
+static double tonePower(const std::vector<float> &audio, int sampleRate, double from, double to,
+                        double hz) {
+    size_t first = std::min(audio.size(), (size_t) (from * sampleRate));
+    size_t count = std::min(audio.size(), (size_t) (to * sampleRate)) - first;
+    double power = 0.0;
+    for (int step = -2; step <= 2; step++) {
+        double w = 2.0 * M_PI * hz * pow(2.0, step / 96.0) / sampleRate;
+        double coeff = 2.0 * cos(w);
+        double s1 = 0.0, s2 = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            double window = 0.5 - 0.5 * cos(2.0 * M_PI * i / count);
+            double s0 = audio[first + i] * window + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        power = std::max(power, s1 * s1 + s2 * s2 - coeff * s1 * s2);
+    }
+    return power;
+}
+
+/* @brief RMS of a window of the audio, from and to in seconds. */
+static double rms(const std::vector<float> &audio, int sampleRate, double from, double to) {
+    size_t first = std::min(audio.size(), (size_t) (from * sampleRate));
+    size_t last = std::min(audio.size(), (size_t) (to * sampleRate));
+    double sum = 0.0;
+    for (size_t i = first; i < last; i++) sum += (double) audio[i] * audio[i];
+    return last > first ? sqrt(sum / (last - first)) : 0.0;
+}
+
+/* @brief Beat period of the level of the audio, in seconds (autocorrelation of 16 beats
+ * around the expected period). */
+static double beatPeriod(const std::vector<float> &audio, int sampleRate, double period) {
+    // level in 10 ms frames, its autocorrelation around the beat period
+    const double frame = 0.01;
+    std::vector<double> level;
+    for (double t = 0.0; t < 16 * period; t += frame) {
+        level.push_back(rms(audio, sampleRate, t, t + frame));
+    }
+    double mean = 0.0;
+    for (double l : level) mean += l / level.size();
+    int bestLag = 0;
+    double best = -1e300;
+    for (int lag = (int) (0.5 * period / frame); lag <= (int) (1.5 * period / frame); lag++) {
+        double sum = 0.0;
+        for (size_t i = lag; i < level.size(); i++) {
+            sum += (level[i] - mean) * (level[i - lag] - mean);
+        }
+        if (sum > best) {
+            best = sum;
+            bestLag = lag;
+        }
+    }
+    return bestLag * frame;
+}
+
+/* @brief Check the beat pattern: the beat period of the level and the note of each beat
+ * (over the other note of the pattern and the notes a semitone away). */
+static bool checkHeartbeat(const std::vector<float> &audio, int sampleRate, int bpm) {
+    double period = 60.0 / bpm;
+    double found = beatPeriod(audio, sampleRate, period);
+    double beatError = fabs(found - period);
+    int wrongBeats = 0;
+    for (int i = 0; i < 16; i++) {
+        double from = i * period + 0.02, to = (i + 0.45) * period;
+        int note = i % 2 ? 67 : 60;
+        int patternNote = i % 2 ? 60 : 67;
+        double other = 0.0;
+        for (int near : { patternNote, note - 1, note + 1 }) {
+            other = std::max(other, tonePower(audio, sampleRate, from, to, noteHz(near)));
+        }
+        double power = tonePower(audio, sampleRate, from, to, noteHz(note));
+        if (!(power >= kGoldenMinToneRatio * other)) wrongBeats++;
+    }
+    printf("golden: beat period %.3f s (%.3f s), %d of 16 beats off their note\n",
+           found, period, wrongBeats);
+    return beatError <= kGoldenBeatTolerance && wrongBeats == 0;
+}
+
+/* @brief Check the chord: each note of the chord over the notes between them. */
+static bool checkChord(const std::vector<float> &audio, int sampleRate) {
+    static const int played[] = { 48, 60, 64, 67, 72 };
+    static const int between[] = { 61, 63, 66, 68, 70 };
+    double weakest = 1e300, strongest = 0.0;
+    for (int note : played) {
+        weakest = std::min(weakest, tonePower(audio, sampleRate, 0.5, 2.5, noteHz(note)));
+    }
+    for (int note : between) {
+        strongest = std::max(strongest, tonePower(audio, sampleRate, 0.5, 2.5, noteHz(note)));
+    }
+    double ratio = strongest > 0.0 ? weakest / strongest : 1e300;
+    printf("golden: weakest chord note %.1f dB over the strongest other note\n",
+           10.0 * log10(ratio));
+    return ratio >= kGoldenMinToneRatio;
+}
+
+/* @brief Check the reverb sweep: none before it, more at its top than near its bottom. */
+static bool checkReverb(const std::vector<float> &audio, const std::vector<float> &dry,
+                        int sampleRate) {
+    std::vector<float> wet(audio.size());
+    for (size_t i = 0; i < audio.size() && i < dry.size(); i++) wet[i] = audio[i] - dry[i];
+    // the sweep starts at level 0 (reverb off), rises to 127 at 1.6 s and falls to 0 at 3.2 s
+    double before = rms(wet, sampleRate, 0.0, 0.045);
+    double low = rms(wet, sampleRate, 0.2, 0.4) / rms(dry, sampleRate, 0.2, 0.4);
+    double top = rms(wet, sampleRate, 1.5, 1.7) / rms(dry, sampleRate, 1.5, 1.7);
+    printf("golden: reverb before the sweep %.2e, wet/dry %.3f near the bottom, %.3f at the "
+           "top\n", before, low, top);
+    return before == 0.0 && top > 0.0 && top >= kGoldenMinWetRatio * low;
+}
+
+/* @brief Check the program change: the held note goes on, the next note changes timbre. */
+static bool checkProgram(const std::vector<float> &audio, int sampleRate) {
+    double change = rms(audio, sampleRate, 1.0, 1.2) / rms(audio, sampleRate, 0.8, 1.0);
+    double fundamental[2], timbreDb = 0.0;
+    const double windows[2] = { 0.2, 2.4 };
+    for (int k = 1; k <= kGoldenHarmonics; k++) {
+        double db[2];
+        for (int w = 0; w < 2; w++) {
+            double power = tonePower(audio, sampleRate, windows[w], windows[w] + 0.4,
+                                     k * noteHz(60));
+            if (k == 1) fundamental[w] = power;
+            db[w] = 10.0 * log10(power / fundamental[w] + 1e-30);
+        }
+        timbreDb += fabs(db[1] - db[0]) / (kGoldenHarmonics - 1);
+    }
+    printf("golden: held note level x%.2f across the change, timbre changed %.1f dB\n",
+           change, timbreDb);
+    return change <= kGoldenMaxLevelChange && change >= 1.0 / kGoldenMaxLevelChange &&
+           timbreDb >= kGoldenMinTimbreDb;
+}
+
+/* @brief Check the heartbeat voices: the beat period, and the output gain halved at 4 s. */
+static bool checkHeartVoices(const std::vector<float> &audio, int sampleRate) {
+    double found = beatPeriod(audio, sampleRate, 0.5);
+    // whole beats, past the gain ramp
+    double before = rms(audio, sampleRate, 0.5, 4.0);
+    double after = rms(audio, sampleRate, 4.5, 8.0);
+    double gain = before > 0.0 ? after / before : 0.0;
+    printf("golden: beat period %.3f s (0.500 s), output gain x%.3f (x0.500)\n", found, gain);
+    return fabs(found - 0.5) <= kGoldenBeatTolerance && fabs(gain - 0.5) <= kGoldenGainTolerance;
+}
+
+/* @brief Check the output of a built-in scenario against its expected spectrum and levels. */
+static bool checkScenario(const char *name, const ApiTraceHeader &header,
+                          const std::vector<ApiTraceRecord> &records, const char *soundfont,
+                          const std::vector<float> &audio) {
+    int sampleRate = (int) header.sampleRate;
+    int bpm = 0;
+    if (sscanf(name, "heartbeat%d", &bpm) == 1) return checkHeartbeat(audio, sampleRate, bpm);
+    if (strcmp(name, "chord") == 0) return checkChord(audio, sampleRate);
+    if (strcmp(name, "program") == 0) return checkProgram(audio, sampleRate);
+    if (strcmp(name, "heartvoices") == 0) return checkHeartVoices(audio, sampleRate);
+    // the reverb against the same trace without it
+    std::vector<ApiTraceRecord> dryRecords;
+    for (const ApiTraceRecord &record : records) {
+        if (record.op != kApiTraceOp_Reverb) dryRecords.push_back(record);
+    }
+    ApiTraceRecord off = {};
+    off.op = kApiTraceOp_Reverb;
+    off.frame = records.empty() ? 0 : records.front().frame;
+    dryRecords.insert(dryRecords.begin(), off);
+    Replay replay(header, dryRecords, soundfont, 0, false, -1, true);
+    std::vector<float> dry;
+    replay.run(nullptr, &dry);
+    return checkReverb(audio, dry, sampleRate);
+}
+
+/* @brief Third-octave band levels of the audio (averaged Hann FFT frames, half overlap) and
+ * its RMS level, all in dBFS. */
+static void bandLevels(const std::vector<float> &audio, int sampleRate,
+                       std::vector<double> &centres, std::vector<double> &levels,
+                       double &levelDb) {
+    centres.clear();
+    levels.assign(kSpectrumLastBand - kSpectrumFirstBand + 1, 0.0);
+    for (int band = kSpectrumFirstBand; band <= kSpectrumLastBand; band++) {
+        centres.push_back(1000.0 * pow(2.0, band / 3.0));
+    }
+    std::vector<std::complex<double>> bins(kSpectrumFrames);
+    int count = 0;
+    for (size_t start = 0; start + kSpectrumFrames <= audio.size();
+         start += kSpectrumFrames / 2) {
+        for (int i = 0; i < kSpectrumFrames; i++) {
+            double window = 0.5 - 0.5 * cos(2.0 * M_PI * i / kSpectrumFrames);
+            bins[i] = audio[start + i] * window;
+        }
+        // iterative radix-2 FFT
+        for (int i = 1, j = 0; i < kSpectrumFrames; i++) {
+            int bit = kSpectrumFrames >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(bins[i], bins[j]);
+        }
+        for (int length = 2; length <= kSpectrumFrames; length <<= 1) {
+            std::complex<double> step = std::polar(1.0, -2.0 * M_PI / length);
+            for (int i = 0; i < kSpectrumFrames; i += length) {
+                std::complex<double> w(1.0);
+                for (int k = 0; k < length / 2; k++) {
+                    std::complex<double> u = bins[i + k], v = bins[i + k + length / 2] * w;
+                    bins[i + k] = u + v;
+                    bins[i + k + length / 2] = u - v;
+                    w *= step;
+                }
+            }
+        }
+        for (int k = 1; k < kSpectrumFrames / 2; k++) {
+            double hz = (double) k * sampleRate / kSpectrumFrames;
+            for (size_t b = 0; b < centres.size(); b++) {
+                if (hz >= centres[b] * pow(2.0, -1.0 / 6) && hz < centres[b] * pow(2.0, 1.0 / 6)) {
+                    levels[b] += std::norm(bins[k]);
+                }
+            }
+        }
+        count++;
+    }
+    // mean square of the signal in the band: the Hann window keeps 3/8 of the power
+    for (double &level : levels) {
+        double power = count > 0 ? 2.0 * level / (count * kSpectrumFrames * 0.375 *
+                                                  kSpectrumFrames) : 0.0;
+        level = std::max(kSpectrumSilenceDb, 10.0 * log10(power + 1e-30));
+    }
+    double sum = 0.0;
+    for (float sample : audio) sum += (double) sample * sample;
+    levelDb = audio.empty() ? kSpectrumSilenceDb :
+              std::max(kSpectrumSilenceDb, 10.0 * log10(sum / audio.size() + 1e-30));
+}
+
+/* @brief Write the golden spectrum of a scenario (dir/scenario.txt). */
+static bool writeGolden(const char *dir, const char *name, const std::vector<float> &audio,
+                        int sampleRate) {
+    std::vector<double> centres, levels;
+    double levelDb;
+    bandLevels(audio, sampleRate, centres, levels, levelDb);
+    std::string path = std::string(dir) + "/" + name + ".txt";
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+    fprintf(file, "# api-replay -w %s: golden spectrum of the output (api-replay -G)\n", name);
+    fprintf(file, "# level: RMS of the output, dBFS\n");
+    fprintf(file, "# band: centre (Hz), third-octave level (dBFS)\n");
+    fprintf(file, "tolerance %.1f\n", kSpectrumToleranceDb);
+    fprintf(file, "level %.2f\n", levelDb);
+    for (size_t b = 0; b < centres.size(); b++) {
+        fprintf(file, "band %.0f %.2f\n", centres[b], levels[b]);
+    }
+    fclose(file);
+    printf("golden spectrum written to %s\n", path.c_str());
+    return true;
+}
+
+/* @brief Check the output of a scenario against its golden spectrum (dir/scenario.txt). */
+static bool checkGolden(const char *dir, const char *name, const std::vector<float> &audio,
+                        int sampleRate) {
+    std::string path = std::string(dir) + "/" + name + ".txt";
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        printf("golden spectrum: cannot read %s\n", path.c_str());
+        return false;
+    }
+    double tolerance = kSpectrumToleranceDb, goldenLevel = 0.0;
+    std::vector<double> goldenCentres, goldenLevels;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        double a, b;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "tolerance %lf", &a) == 1) tolerance = a;
+        if (sscanf(line, "level %lf", &a) == 1) goldenLevel = a;
+        if (sscanf(line, "band %lf %lf", &a, &b) == 2) {
+            goldenCentres.push_back(a);
+            goldenLevels.push_back(b);
+        }
+    }
+    fclose(file);
+    std::vector<double> centres, levels;
+    double levelDb;
+    bandLevels(audio, sampleRate, centres, levels, levelDb);
+    if (goldenCentres.size() != centres.size()) {
+        printf("golden spectrum: %s has %zu bands, expected %zu\n", path.c_str(),
+               goldenCentres.size(), centres.size());
+        return false;
+    }
+    int off = 0;
+    bool silent = levelDb < kSpectrumFloorDb && goldenLevel < kSpectrumFloorDb;
+    double worst = silent ? 0.0 : fabs(levelDb - goldenLevel);
+    for (size_t b = 0; b < centres.size(); b++) {
+        // the bands under the floor in both hold no signal to compare (only dither)
+        if (levels[b] < kSpectrumFloorDb && goldenLevels[b] < kSpectrumFloorDb) continue;
+        double error = fabs(levels[b] - goldenLevels[b]);
+        worst = std::max(worst, error);
+        if (error > tolerance) {
+            printf("golden spectrum: band %.0f Hz at %.1f dB, golden %.1f dB\n", centres[b],
+                   levels[b], goldenLevels[b]);
+            off++;
+        }
+    }
+    printf("golden spectrum: level %.1f dBFS (golden %.1f), %d bands off, worst error "
+           "%.1f dB (tolerance %.1f dB)\n", levelDb, goldenLevel, off, worst, tolerance);
+    return off == 0 && (silent || fabs(levelDb - goldenLevel) <= tolerance);
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s soundfont.sf2] [-n runs] [-c cores] [-k hash] [-r ratio] "
+                    "[-w scenario] [-g dir] [-G dir] [-o out.raw] [-m] [-q tier] [-v] "
+                    "trace.bin\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *soundfont = nullptr;
+    const char *outputPath = nullptr;
+    const char *expected = nullptr;
+    const char *scenario = nullptr;
+    const char *tierName = nullptr;
+    const char *goldenDir = nullptr;
+    bool writeGoldens = false;
+    double maxRatio = 0.0;
+    int runs = 2;
+    int cores = 0;
+    bool metering = false;
+    bool compareVoices = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:c:k:r:w:g:G:o:mq:v")) != -1) {
+        switch (opt) {
+            case 's': soundfont = optarg; break;
+            case 'n': runs = atoi(optarg); break;
+            case 'c': cores = atoi(optarg); break;
+            case 'k': expected = optarg; break;
+            case 'r': maxRatio = atof(optarg); break;
+            case 'w': scenario = optarg; break;
+            case 'g': goldenDir = optarg; break;
+            case 'G': goldenDir = optarg; writeGoldens = true; break;
+            case 'o': outputPath = optarg; break;
+            case 'm': metering = true; break;
+            case 'q': tierName = optarg; break;
+            case 'v': compareVoices = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    // the tiers to replay with (-1: the tiers of the trace)
+    std::vector<int> tiers;
+    for (int tier = 0; tier < kQualityTierCount && tierName; tier++) {
+        if (strcmp(tierName, "all") == 0 || strcmp(tierName, kTierNames[tier]) == 0) {
+            tiers.push_back(tier);
+        }
+    }
+    if (tierName == nullptr) tiers.push_back(-1);
+    if (optind >= argc || runs < 1 || cores < 0 || tiers.empty() ||
+            (goldenDir && (scenario == nullptr || tierName))) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (scenario && !writeScenario(scenario, soundfont, argv[optind])) {
+        fprintf(stderr, "cannot write scenario %s to %s\n", scenario, argv[optind]);
+        return 1;
+    }
+    ApiTraceHeader header;
+    std::vector<ApiTraceRecord> records;
+    if (!loadTrace(argv[optind], header, records)) {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    // a replay without the dropped calls would not match the capture
+    if (header.dropped > 0) {
+        fprintf(stderr, "%s is incomplete: %llu calls dropped while tracing\n", argv[optind],
+                (unsigned long long) header.dropped);
+        return 1;
+    }
+    printf("trace: %zu calls, %u Hz, gain %.2f\n", records.size(), header.sampleRate,
+           header.gain);
+    uint64_t firstHash = 0;
+    std::vector<float> firstAudio;
+    double worstRatio = 0.0;
+    bool exact = true;
+    std::vector<double> tierMeanUs, tierP99Us;
+    for (size_t t = 0; t < tiers.size(); t++) {
+        if (tiers[t] >= 0) printf("tier %s\n", kTierNames[tiers[t]]);
+        // with -v, a pass without the voice budget first
+        double unbudgetedVoices = 0.0;
+        int unbudgetedPeak = 0;
+        for (int pass = compareVoices ? 0 : 1; pass < 2; pass++) {
+            bool budgeting = pass == 1;
+            if (compareVoices) printf("voice budget %s\n", budgeting ? "on" : "off");
+            uint64_t passHash = 0;
+            double meanUs = 0.0, p99Us = 0.0, meanVoices = 0.0, stockMeanUs = 0.0;
+            int peakVoices = 0;
+            for (int i = 0; i < runs; i++) {
+                Replay replay(header, records, soundfont, cores, metering, tiers[t], budgeting);
+                if (!replay.isValid()) {
+                    fprintf(stderr, "cannot create the synth\n");
+                    return 1;
+                }
+                bool first = t == 0 && budgeting && i == 0;
+                FILE *output = (first && outputPath) ? fopen(outputPath, "wb") : nullptr;
+                replay.run(output, first && scenario ? &firstAudio : nullptr);
+                if (output) fclose(output);
+                printf("run %d: hash %016llx, ", i + 1, (unsigned long long) replay.getHash());
+                replay.print();
+                if (first) firstHash = replay.getHash();
+                if (i == 0) {
+                    passHash = replay.getHash();
+                    meanVoices = replay.getMeanVoices();
+                    peakVoices = replay.getPeakVoices();
+                }
+                if (replay.getHash() != passHash) exact = false;
+                if (i == 0 || replay.getP99Us() < p99Us) p99Us = replay.getP99Us();
+                if (i == 0 || replay.getMeanUs() < meanUs) meanUs = replay.getMeanUs();
+                if (maxRatio > 0.0 && budgeting) {
+                    // the baseline, interleaved with the runs so both see the same host load
+                    StockReplay stock(header, records, soundfont);
+                    stock.run();
+                    if (i == 0 || stock.getMeanUs() < stockMeanUs) stockMeanUs = stock.getMeanUs();
+                }
+            }
+            if (!budgeting) {
+                unbudgetedVoices = meanVoices;
+                unbudgetedPeak = peakVoices;
+                continue;
+            }
+            if (compareVoices) {
+                double saved = unbudgetedVoices > 0.0 ? 1.0 - meanVoices / unbudgetedVoices : 0.0;
+                printf("voices without/with the budget: mean %.1f -> %.1f (%.0f%% fewer), "
+                       "peak %d -> %d\n", unbudgetedVoices, meanVoices, 100.0 * saved,
+                       unbudgetedPeak, peakVoices);
+            }
+            if (maxRatio > 0.0) {
+                double ratio = stockMeanUs > 0.0 ? meanUs / stockMeanUs : 0.0;
+                printf("block mean %.2f us, stock synth %.2f us (x%.2f)\n", meanUs, stockMeanUs,
+                       ratio);
+                worstRatio = std::max(worstRatio, ratio);
+            }
+            tierMeanUs.push_back(meanUs);
+            tierP99Us.push_back(p99Us);
+        }
+    }
+    if (tiers.size() > 1) {
+        // the cost of each tier against the last (the highest)
+        for (size_t t = 0; t < tiers.size(); t++) {
+            printf("cost of %-8s block mean %.2f us (%.0f%%), p99 %.2f us\n",
+                   kTierNames[tiers[t]], tierMeanUs[t], 100.0 * tierMeanUs[t] / tierMeanUs.back(),
+                   tierP99Us[t]);
+        }
+    }
+    printf("bit-exact across runs: %s\n", exact ? "yes" : "NO");
+    if (expected && strtoull(expected, nullptr, 16) != firstHash) {
+        printf("hash differs from %s\n", expected);
+        exact = false;
+    }
+    // the goldens of the scenarios hold for the traced tiers (a fixed tier may drop reverb)
+    bool golden = true;
+    if (scenario && tiers[0] < 0) {
+        golden = checkScenario(scenario, header, records, soundfont, firstAudio);
+        printf("scenario output as expected: %s\n", golden ? "yes" : "NO");
+        int sampleRate = (int) header.sampleRate;
+        if (goldenDir && writeGoldens) {
+            golden = writeGolden(goldenDir, scenario, firstAudio, sampleRate) && golden;
+        } else if (goldenDir) {
+            bool spectrum = checkGolden(goldenDir, scenario, firstAudio, sampleRate);
+            printf("scenario spectrum as its golden: %s\n", spectrum ? "yes" : "NO");
+            golden = golden && spectrum;
+        }
+    }
+    // the best run of each tier is the least disturbed by the host; the slowest tier gates
+    bool fast = true;
+    if (maxRatio > 0.0) {
+        printf("render time over the stock synth x%.2f, limit x%.2f\n", worstRatio, maxRatio);
+        fast = worstRatio <= maxRatio;
+    }
+    return exact && golden && fast ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/ApiTraceThreads.cpp
+ * @brief Check of the ring of each thread of the API trace (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../ApiTrace.h"
+
+/*
+ * Checks that the API trace gives the ring of a thread back once the thread exits: waves
+ * of short-lived threads (more threads in total than kApiTraceThreads) trace calls, with a
+ * pause between the waves for the writer thread to drain and release their rings. No call
+ * may be dropped, and the header must report none. Then more threads than rings trace at
+ * once: the calls of the threads without ring must be reported in the header. Last, threads
+ * outlive their trace, which must not be touched when they exit.
+ *
+ * usage: api-trace-threads [-w waves] [-n calls] file
+ *        waves is the number of waves of kApiTraceThreads / 2 threads (8 by default).
+ *        calls is the number of calls per thread (100 by default).
+ *        file is the trace file (overwritten).
+ *        Exits with 1 if a call is dropped or the header does not match the file.
+ */
+
+/* @brief Sample rate of the trace, in Hz. */
+static const int kTraceSampleRate = 48000;
+
+/* @brief Read the header of a trace and count its records. */
+static bool readTrace(const char *path, ApiTraceHeader &header, uint64_t &records) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 header.version == kApiTraceVersion;
+    ApiTraceRecord record;
+    records = 0;
+    while (valid && fread(&record, sizeof(record), 1, file) == 1) records++;
+    fclose(file);
+    return valid;
+}
+
+/* @brief Trace calls from a number of threads, all alive at once. */
+static void traceFrom(ApiTrace &trace, int threads, int calls) {
+    std::vector<std::thread> workers;
+    std::atomic<int> ready(0);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            // all threads alive before the first call
+            ready.fetch_add(1);
+            while (ready.load() < threads) std::this_thread::yield();
+            for (int i = 0; i < calls; i++) {
+                trace.trace(i, kApiTraceOp_NoteOn, t & 0x0F, i & 0x7F, 100);
+                // within the capacity of the ring between two flushes
+                if ((i + 1) % (kApiTraceRingSize / 2) == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2 * kApiTraceFlushMs));
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) worker.join();
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-w waves] [-n calls] file\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int waves = 8;
+    int calls = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:n:")) != -1) {
+        switch (opt) {
+            case 'w': waves = atoi(optarg); break;
+            case 'n': calls = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || waves < 1 || calls < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *path = argv[optind];
+    static ApiTrace trace;
+    bool failed = false;
+    ApiTraceHeader header;
+    uint64_t records;
+
+    // waves of threads that exit: every thread finds a ring
+    int threads = kApiTraceThreads / 2;
+    if (!trace.start(path, kTraceSampleRate, 1.0f)) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    for (int w = 0; w < waves; w++) {
+        traceFrom(trace, threads, calls);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * kApiTraceFlushMs));
+    }
+    trace.stop();
+    uint64_t expected = (uint64_t) waves * threads * calls;
+    if (!readTrace(path, header, records)) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    printf("%d threads: %llu calls written, %llu dropped\n", waves * threads,
+           (unsigned long long) records, (unsigned long long) header.dropped);
+    if (records != expected || header.dropped != 0 || trace.getDropped() != 0) {
+        fprintf(stderr, "FAIL: %llu calls expected, none dropped\n",
+                (unsigned long long) expected);
+        failed = true;
+    }
+
+    // more threads than rings at once: the calls without ring are reported
+    threads = kApiTraceThreads + 4;
+    trace.start(path, kTraceSampleRate, 1.0f);
+    traceFrom(trace, threads, calls);
+    trace.stop();
+    if (!readTrace(path, header, records)) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    printf("%d threads at once: %llu calls written, %llu dropped\n", threads,
+           (unsigned long long) records, (unsigned long long) header.dropped);
+    if (header.dropped == 0 || header.dropped != trace.getDropped() ||
+            records + header.dropped != (uint64_t) threads * calls) {
+        fprintf(stderr, "FAIL: %llu calls expected, some dropped\n",
+                (unsigned long long) threads * calls);
+        failed = true;
+    }
+
+    // threads that outlive their trace
+    ApiTrace *shortTrace = new ApiTrace();
+    shortTrace->start(path, kTraceSampleRate, 1.0f);
+    std::atomic<bool> traced(false), deleted(false);
+    std::thread survivor([&] {
+        shortTrace->trace(0, kApiTraceOp_NoteOn, 0, 60, 100);
+        traced.store(true);
+        while (!deleted.load()) std::this_thread::yield();
+    });
+    while (!traced.load()) std::this_thread::yield();
+    delete shortTrace;
+    deleted.store(true);
+    survivor.join();
+    return failed ? 1 : 0;
+}
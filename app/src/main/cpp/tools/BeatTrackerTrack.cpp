@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/BeatTrackerTrack.cpp
+ * @brief Tracking check of the beat tracker (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "../BeatTracker.h"
+
+/*
+ * Drives the beat tracker as the app does (a heart-rate sample per second, the clock
+ * advanced every millisecond) and checks the beats it fires:
+ * - step: 60 to 120 BPM; no beat is fired twice or skipped (every interval lies between
+ *   the two periods) and the period settles within 1% in five time constants;
+ * - ramp: 60 to 150 BPM over 30 s; the period follows with the lag of the loop (the time
+ *   constant plus half the sample period) within 2%;
+ * - noise: 80 BPM with 4 BPM of Gaussian noise per sample; the beat intervals keep the
+ *   mean of the sampled periods within 1% and less than half their deviation.
+ * Each scenario also runs a reference integrator (0.1 ms steps), whose beats must match
+ * those of the tracker within 1 ms. A last case advances over a 10-minute gap (checked
+ * against the reference) and a one-day gap, which must take less than a millisecond.
+ *
+ * usage: beat-tracker-track
+ *        Exits with 1 if a check fails.
+ */
+
+/* @brief Time constant of the period loop, in seconds (the default of the tracker). */
+static const double kTrackTimeConstant = 2.0;
+/* @brief Period of the clock advances, in seconds. */
+static const double kTrackTick = 0.001;
+/* @brief Period of the heart-rate samples, in seconds. */
+static const double kTrackSamplePeriod = 1.0;
+/* @brief Step of the reference integrator, in seconds. */
+static const double kTrackReferenceStep = 0.0001;
+/* @brief Largest difference between the beats of the tracker and the reference, in s. */
+static const double kTrackMaxBeatError = 0.001;
+/* @brief Longest advance over a one-day gap, in seconds. */
+static const double kTrackMaxGapTime = 0.001;
+
+/* @brief The beat clock integrated in small steps, with the exact period of each step. */
+class ReferenceTracker {
+public:
+    explicit ReferenceTracker(double timeConstant): timeConstant(timeConstant) {}
+    void update(double bpm) { targetPeriod = 60.0 / bpm; }
+    /* @brief Advance to a time, adding the times of the beats to a list. */
+    void advance(double time, std::vector<double> &beats) {
+        while (lastTime + kTrackReferenceStep <= time + 1e-12) {
+            double start = period;
+            period = targetPeriod + (start - targetPeriod) * exp(-kTrackReferenceStep /
+                                                                 timeConstant);
+            double step = kTrackReferenceStep / (0.5 * (start + period));
+            if (phase + step >= 1.0) {
+                beats.push_back(lastTime + (1.0 - phase) / step * kTrackReferenceStep);
+                phase -= 1.0;
+            }
+            phase += step;
+            lastTime += kTrackReferenceStep;
+        }
+    }
+    double getPhase() const { return phase; }
+private:
+    double timeConstant;
+    double targetPeriod = 1.0;
+    double period = 1.0;
+    double phase = 0.0;
+    double lastTime = 0.0;
+};
+
+/* @brief Beats of a scenario, from the tracker and from the reference. */
+struct TrackBeats {
+    std::vector<double> tracker;
+    std::vector<double> reference;
+};
+
+/* @brief Run a scenario: the heart rate at each sample time, for a duration in seconds. */
+static TrackBeats run(const std::function<double(double)> &bpm, double seconds) {
+    BeatTracker tracker;
+    tracker.setTimeConstant(kTrackTimeConstant);
+    ReferenceTracker reference(kTrackTimeConstant);
+    TrackBeats beats;
+    tracker.advance(0.0);
+    int ticksPerSample = (int) lround(kTrackSamplePeriod / kTrackTick);
+    long ticks = lround(seconds / kTrackTick);
+    for (long tick = 0; tick <= ticks; tick++) {
+        double time = tick * kTrackTick;
+        if (tick % ticksPerSample == 0) {
+            double rate = bpm(time);
+            tracker.update(time, rate);
+            reference.advance(time, beats.reference);
+            reference.update(rate);
+        }
+        int count = tracker.advance(time);
+        reference.advance(time, beats.reference);
+        // the beats fell behind the clock by their phase
+        for (int i = count - 1; i >= 0; i--) {
+            beats.tracker.push_back(time - (tracker.getPhase() + i) * tracker.getPeriod());
+        }
+    }
+    return beats;
+}
+
+/* @brief Compare the beats of the tracker with the reference. */
+static bool matchReference(const char *name, const TrackBeats &beats) {
+    if (beats.tracker.size() != beats.reference.size()) {
+        printf("  %s: %zu beats, reference %zu\n", name, beats.tracker.size(),
+               beats.reference.size());
+        return false;
+    }
+    double maxError = 0.0;
+    for (size_t i = 0; i < beats.tracker.size(); i++) {
+        maxError = std::max(maxError, fabs(beats.tracker[i] - beats.reference[i]));
+    }
+    printf("  %s: %zu beats, largest difference from the reference %.3f ms\n", name,
+           beats.tracker.size(), maxError * 1000.0);
+    return maxError <= kTrackMaxBeatError;
+}
+
+/* @brief Step from 60 to 120 BPM at 20 s. */
+static bool checkStep() {
+    const double stepTime = 20.0;
+    TrackBeats beats = run([=](double time) { return time < stepTime ? 60.0 : 120.0; }, 40.0);
+    bool ok = matchReference("step", beats);
+    double settled = stepTime + 5.0 * kTrackTimeConstant;
+    double minInterval = 1e9, maxInterval = 0.0, maxSettledError = 0.0;
+    for (size_t i = 1; i < beats.tracker.size(); i++) {
+        double interval = beats.tracker[i] - beats.tracker[i - 1];
+        minInterval = std::min(minInterval, interval);
+        maxInterval = std::max(maxInterval, interval);
+        if (beats.tracker[i - 1] >= settled) {
+            maxSettledError = std::max(maxSettledError, fabs(interval / 0.5 - 1.0));
+        }
+    }
+    printf("  step: intervals %.3f to %.3f s, %.2f%% from the period after %.0f s\n",
+           minInterval, maxInterval, maxSettledError * 100.0, settled);
+    return ok && minInterval > 0.5 - kTrackTick && maxInterval < 1.0 + kTrackTick &&
+           maxSettledError < 0.01;
+}
+
+/* @brief Ramp from 60 to 150 BPM between 10 and 40 s. */
+static bool checkRamp() {
+    auto bpm = [](double time) {
+        return 60.0 + 90.0 * std::min(1.0, std::max(0.0, (time - 10.0) / 30.0));
+    };
+    TrackBeats beats = run(bpm, 50.0);
+    bool ok = matchReference("ramp", beats);
+    double lag = kTrackTimeConstant + kTrackSamplePeriod / 2.0;
+    double maxError = 0.0;
+    for (size_t i = 1; i < beats.tracker.size(); i++) {
+        double middle = (beats.tracker[i] + beats.tracker[i - 1]) / 2.0;
+        if (middle < 10.0 + 3.0 * lag) continue;
+        double expected = 60.0 / bpm(middle - lag);
+        maxError = std::max(maxError, fabs((beats.tracker[i] - beats.tracker[i - 1]) /
+                                           expected - 1.0));
+    }
+    printf("  ramp: %.2f%% from the heart rate %.1f s before\n", maxError * 100.0, lag);
+    return ok && maxError < 0.02;
+}
+
+/* @brief 80 BPM with Gaussian noise. */
+static bool checkNoise() {
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, 4.0);
+    std::vector<double> samples;
+    TrackBeats beats = run([&](double) {
+        samples.push_back(80.0 + noise(random));
+        return samples.back();
+    }, 120.0);
+    bool ok = matchReference("noise", beats);
+    double sampleSum = 0.0, sampleSquares = 0.0;
+    int sampleCount = 0;
+    for (double sample : samples) {
+        double period = 60.0 / sample;
+        sampleSum += period;
+        sampleSquares += period * period;
+        sampleCount++;
+    }
+    double sampleMean = sampleSum / sampleCount;
+    double sampleDeviation = sqrt(sampleSquares / sampleCount - sampleMean * sampleMean);
+    double sum = 0.0, squares = 0.0;
+    int count = 0;
+    for (size_t i = 1; i < beats.tracker.size(); i++) {
+        if (beats.tracker[i - 1] < 5.0 * kTrackTimeConstant) continue;
+        double interval = beats.tracker[i] - beats.tracker[i - 1];
+        sum += interval;
+        squares += interval * interval;
+        count++;
+    }
+    double mean = sum / count;
+    double deviation = sqrt(squares / count - mean * mean);
+    printf("  noise: intervals %.4f s (deviation %.4f s), samples %.4f s (deviation %.4f s)\n",
+           mean, deviation, sampleMean, sampleDeviation);
+    return ok && fabs(mean / sampleMean - 1.0) < 0.01 && deviation < sampleDeviation * 0.5;
+}
+
+/* @brief Long pauses of the clock. */
+static bool checkGap() {
+    BeatTracker tracker;
+    tracker.setTimeConstant(kTrackTimeConstant);
+    ReferenceTracker reference(kTrackTimeConstant);
+    std::vector<double> referenceBeats;
+    tracker.advance(0.0);
+    tracker.update(0.0, 120.0);
+    reference.update(120.0);
+    int beats = tracker.advance(600.0);
+    reference.advance(600.0, referenceBeats);
+    bool ok = beats == (int) referenceBeats.size() &&
+              fabs(tracker.getPhase() - reference.getPhase()) < 1e-3;
+    printf("  10-minute gap: %d beats, reference %zu\n", beats, referenceBeats.size());
+
+    const double day = 86400.0;
+    auto start = std::chrono::steady_clock::now();
+    beats = tracker.advance(600.0 + day);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                   start).count();
+    printf("  one-day gap: %d beats in %.3f ms\n", beats, seconds * 1000.0);
+    return ok && beats >= (int) (day / 0.5) - 1 && beats <= (int) (day / 0.5) + 1 &&
+           seconds < kTrackMaxGapTime;
+}
+
+int main() {
+    printf("beat tracker, time constant %.1f s:\n", kTrackTimeConstant);
+    bool ok = true;
+    ok = checkStep() && ok;
+    ok = checkRamp() && ok;
+    ok = checkNoise() && ok;
+    ok = checkGap() && ok;
+    if (!ok) fprintf(stderr, "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/BleMidiBench.cpp
+ * @brief BLE-MIDI packets per minute of a heart-rate session (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../BleMidiDecoder.h"
+#include "../BleMidiEncoder.h"
+#include "../MidiParser.h"
+#include "../MidiSpec.h"
+
+/*
+ * Encodes the MIDI output of a generated heart-rate session and reports the BLE-MIDI
+ * packets and bytes per minute, coalesced by the encoder and with one packet per message
+ * (one write per message, as the BLE library sends them). The session follows a heart rate
+ * wandering between 55 and 160 BPM: 24 timing clocks per beat, the note offs and two note
+ * ons of the song on each beat, and a modulation controller on two channels.
+ *
+ * Every packet is decoded again: the test fails (exit 1) if a packet is larger than the
+ * packet size, if a message or its time is not decoded back exactly (the timestamp wraps
+ * inside the packets are checked this way), or if the encoder does not save packets.
+ *
+ * usage: ble-midi-bench [-m minutes] [-p packet_size] [-d max_delay_ms]
+ *        minutes is the session length (60 by default).
+ *        packet_size is the BLE-MIDI packet size, ATT MTU - 3 (20 by default).
+ *        max_delay_ms is the time a message waits for others (10 by default).
+ */
+
+/* @brief Modulation wheel controller. */
+static const uint8_t kBenchModulation = 1;
+
+/* @brief A MIDI message of the session. */
+struct BenchMessage {
+    int64_t timeMs;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+/* @brief Counts the packets and checks their size. */
+class BenchPackets : public BleMidiPacketListener {
+public:
+    explicit BenchPackets(BleMidiDecoder *decoder): decoder(decoder) {}
+    void onBleMidiPacket(const uint8_t *packet, int length) override {
+        if (length > maxLength) maxLength = length;
+        if (decoder && !decoder->decode(packet, length)) invalid++;
+    }
+    BleMidiDecoder *decoder;
+    int maxLength = 0;
+    int invalid = 0;
+};
+
+/* @brief Compares the decoded messages with the session. */
+class BenchChecker : public BleMidiListener {
+public:
+    explicit BenchChecker(const std::vector<BenchMessage> &messages): messages(messages) {}
+    void onBleMidiMessage(int64_t timeMs, uint8_t status, uint8_t data1, uint8_t data2) override {
+        if (count >= messages.size()) {
+            errors++;
+            return;
+        }
+        const BenchMessage &sent = messages[count];
+        if (count == 0) offsetMs = timeMs - sent.timeMs;
+        if (timeMs - offsetMs != sent.timeMs || status != sent.status ||
+            data1 != sent.data1 || data2 != sent.data2) {
+            if (errors == 0) {
+                fprintf(stderr, "message %zu: sent %02X %d %d at %lld ms, decoded %02X %d %d "
+                        "at %lld ms\n", count, sent.status, sent.data1, sent.data2,
+                        (long long) sent.timeMs, status, data1, data2,
+                        (long long) (timeMs - offsetMs));
+            }
+            errors++;
+        }
+        count++;
+    }
+    void onBleMidiSysEx(int64_t, const uint8_t *, int) override { errors++; }
+    const std::vector<BenchMessage> &messages;
+    size_t count = 0;
+    int64_t offsetMs = 0;
+    int errors = 0;
+};
+
+/* @brief Generate the MIDI output of the session. */
+static std::vector<BenchMessage> generate(int minutes) {
+    std::mt19937 random(1);
+    std::vector<BenchMessage> messages;
+    double bpm = 70.0;
+    double timeMs = 0.0;
+    int note = 0;
+    static const uint8_t kNotes[] = { 60, 67, 69, 67, 65, 64, 62, 60 };
+    while (timeMs < minutes * 60000.0) {
+        double periodMs = 60000.0 / bpm;
+        int64_t beatMs = (int64_t) timeMs;
+        if (note > 0) {
+            for (int chan = 1; chan <= 2; chan++) {
+                messages.push_back({ beatMs, (uint8_t) ((kMIDIChanCmd_NoteOff << 4) | chan),
+                                     kNotes[(note - 1) % 8], 0 });
+            }
+        }
+        for (int chan = 1; chan <= 2; chan++) {
+            messages.push_back({ beatMs, (uint8_t) ((kMIDIChanCmd_NoteOn << 4) | chan),
+                                 kNotes[note % 8], (uint8_t) (periodMs / 10 > 127 ? 127
+                                                                    : periodMs / 10) });
+            messages.push_back({ beatMs, (uint8_t) ((kMIDIChanCmd_Control << 4) | chan),
+                                 kBenchModulation, (uint8_t) (random() % 128) });
+        }
+        note++;
+        for (int pulse = 0; pulse < 24; pulse++) {
+            messages.push_back({ (int64_t) (timeMs + pulse * periodMs / 24),
+                                 kMIDISysCmd_TimingClock, 0, 0 });
+        }
+        timeMs += periodMs;
+        bpm += (double) ((int) (random() % 7) - 3);
+        if (bpm < 55.0) bpm = 55.0;
+        if (bpm > 160.0) bpm = 160.0;
+    }
+    // the clocks of a beat were generated after its notes
+    std::stable_sort(messages.begin(), messages.end(),
+                     [](const BenchMessage &a, const BenchMessage &b) {
+                         return a.timeMs < b.timeMs;
+                     });
+    return messages;
+}
+
+/* @brief Encode the session, polling the encoder every millisecond. */
+static void encode(const std::vector<BenchMessage> &messages, BleMidiEncoder &encoder,
+                   bool perMessage) {
+    int64_t pollMs = messages.empty() ? 0 : messages[0].timeMs;
+    for (const BenchMessage &message : messages) {
+        for (; pollMs < message.timeMs; pollMs++) encoder.poll(pollMs);
+        uint8_t bytes[] = { message.status, message.data1, message.data2 };
+        encoder.add(message.timeMs, bytes, 1 + MidiParser::dataLength(message.status));
+        if (perMessage) encoder.flush();
+    }
+    encoder.flush();
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m minutes] [-p packet_size] [-d max_delay_ms]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int minutes = 60;
+    int packetSize = kBleMidiDefaultPacket;
+    int maxDelayMs = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:p:d:")) != -1) {
+        switch (opt) {
+            case 'm': minutes = atoi(optarg); break;
+            case 'p': packetSize = atoi(optarg); break;
+            case 'd': maxDelayMs = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (minutes < 1 || packetSize < 5 || packetSize > kBleMidiMaxPacket || maxDelayMs < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::vector<BenchMessage> messages = generate(minutes);
+
+    BenchPackets single(nullptr);
+    BleMidiEncoder singleEncoder(&single);
+    singleEncoder.configure(packetSize, 0);
+    encode(messages, singleEncoder, true);
+
+    BenchChecker checker(messages);
+    BleMidiDecoder decoder(&checker);
+    BenchPackets coalesced(&decoder);
+    BleMidiEncoder encoder(&coalesced);
+    encoder.configure(packetSize, maxDelayMs);
+    auto start = std::chrono::steady_clock::now();
+    encode(messages, encoder, false);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%d min, %zu messages, %d-byte packets:\n", minutes, messages.size(), packetSize);
+    printf("  one per message: %.0f packets/min, %.0f bytes/min\n",
+           singleEncoder.getPacketCount() / (double) minutes,
+           singleEncoder.getByteCount() / (double) minutes);
+    printf("  coalesced (%d ms): %.0f packets/min, %.0f bytes/min, %.0f%% of the packets, "
+           "largest %d bytes, %.1f ns per message (with decoding)\n", maxDelayMs,
+           encoder.getPacketCount() / (double) minutes,
+           encoder.getByteCount() / (double) minutes,
+           100.0 * encoder.getPacketCount() / singleEncoder.getPacketCount(),
+           coalesced.maxLength, elapsed.count() * 1e9 / messages.size());
+    bool ok = true;
+    if (coalesced.maxLength > packetSize || coalesced.invalid > 0) {
+        fprintf(stderr, "FAIL: %d invalid packets, largest %d bytes\n", coalesced.invalid,
+                coalesced.maxLength);
+        ok = false;
+    }
+    if (checker.errors > 0 || checker.count != messages.size()) {
+        fprintf(stderr, "FAIL: %d messages decoded wrong, %zu of %zu decoded\n", checker.errors,
+                checker.count, messages.size());
+        ok = false;
+    }
+    if (encoder.getPacketCount() >= singleEncoder.getPacketCount()) {
+        fprintf(stderr, "FAIL: no packets saved\n");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/BleMidiReceive.cpp
+ * @brief Throughput and timing jitter of the BLE-MIDI input (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../BleMidiDecoder.h"
+#include "../BleMidiEncoder.h"
+#include "../BleMidiSync.h"
+#include "../MidiSpec.h"
+
+/*
+ * Checks the timing of the BLE-MIDI input and measures the decoder throughput.
+ *
+ * A sender plays 24 timing clocks and a note per beat at 120 BPM, with a clock that runs
+ * 50 ppm fast and from another origin. Its messages are packed by the encoder (20-byte
+ * packets, 10 ms maximum delay) and delivered at the BLE connection events, some of them
+ * one or more intervals late (lost and retried). The receiver decodes the packets and maps
+ * them to local time like the app does, behind the adaptive jitter delay. The jitter is the
+ * spread (1st to 99th percentile) of the local play time minus the true send time; it is
+ * compared with playing on arrival. The test fails (exit 1) if the jitter exceeds the
+ * maximum or more than 1% of the messages are scheduled before their packet arrived (too
+ * late to keep the sender timing).
+ *
+ * Then the packets are decoded again and again to report MB/s and messages/s.
+ *
+ * usage: ble-midi-receive [-m minutes] [-i interval_ms] [-r retry_rate] [-j max_jitter_ms]
+ *        minutes is the session length (10 by default).
+ *        interval_ms is the BLE connection interval (7.5 by default, as advised for MIDI).
+ *        retry_rate is the probability of a packet waiting one more interval (0.02 by default).
+ *        max_jitter_ms is the largest jitter accepted (2 by default); with a slow interval the
+ *        delay settles in the first seconds, which widens the spread.
+ */
+
+/* @brief Drift of the sender clock. */
+static const double kSenderDrift = 50e-6;
+/* @brief Origin of the sender clock, in local milliseconds. */
+static const double kSenderOriginMs = -123456.7;
+/* @brief Largest jitter accepted by default, in milliseconds. */
+static const double kMaxJitterMs = 2.0;
+/* @brief Largest fraction of messages scheduled before their arrival. */
+static const double kMaxLateRate = 0.01;
+/* @brief Amount of packets decoded for the throughput, in bytes. */
+static const int64_t kThroughputBytes = 64 << 20;
+
+/* @brief A packet on the air. */
+struct ReceivePacket {
+    std::vector<uint8_t> data;
+    double completedMs;
+    double arrivalMs;
+};
+
+/* @brief Collects the completed packets. */
+class ReceivePackets : public BleMidiPacketListener {
+public:
+    void onBleMidiPacket(const uint8_t *packet, int length) override {
+        packets.push_back({ std::vector<uint8_t>(packet, packet + length), completedMs, 0.0 });
+    }
+    std::vector<ReceivePacket> packets;
+    double completedMs = 0.0;
+};
+
+/* @brief Maps the decoded messages to local time. */
+class ReceiveTiming : public BleMidiListener {
+public:
+    void onBleMidiMessage(int64_t timeMs, uint8_t, uint8_t, uint8_t) override {
+        playMs.push_back(sync.toLocal(arrivalMs, timeMs));
+        arrival.push_back(arrivalMs);
+        checksum += timeMs;
+    }
+    void onBleMidiSysEx(int64_t, const uint8_t *, int) override {}
+    BleMidiSync sync;
+    double arrivalMs = 0.0;
+    std::vector<double> playMs;
+    std::vector<double> arrival;
+    uint64_t checksum = 0;
+};
+
+/* @brief Spread (1st to 99th percentile) of a set of values. */
+static double spread(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() * 99 / 100] - values[values.size() / 100];
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m minutes] [-i interval_ms] [-r retry_rate] [-j max_jitter_ms]\n",
+            name);
+}
+
+int main(int argc, char *argv[]) {
+    int minutes = 10;
+    double intervalMs = 7.5;
+    double retryRate = 0.02;
+    double maxJitterMs = kMaxJitterMs;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:i:r:j:")) != -1) {
+        switch (opt) {
+            case 'm': minutes = atoi(optarg); break;
+            case 'i': intervalMs = atof(optarg); break;
+            case 'r': retryRate = atof(optarg); break;
+            case 'j': maxJitterMs = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (minutes < 1 || intervalMs < 7.5 || retryRate < 0.0 || retryRate >= 1.0 ||
+        maxJitterMs <= 0.0) {
+        usage(argv[0]);
+        return 2;
+    }
+    // sender: the true (local) time of each message, encoded with the sender clock
+    std::vector<double> sentMs;
+    ReceivePackets air;
+    BleMidiEncoder encoder(&air);
+    encoder.configure(kBleMidiDefaultPacket, 10);
+    double periodMs = 500.0;
+    int64_t pollMs = 0;
+    for (double beatMs = 0.0; beatMs < minutes * 60000.0; beatMs += periodMs) {
+        for (int pulse = 0; pulse < 24; pulse++) {
+            double trueMs = beatMs + pulse * periodMs / 24;
+            int64_t senderMs = (int64_t) ((trueMs - kSenderOriginMs) * (1.0 + kSenderDrift));
+            for (; pollMs <= (int64_t) trueMs; pollMs++) {
+                air.completedMs = (double) pollMs;
+                encoder.poll((int64_t) ((pollMs - kSenderOriginMs) * (1.0 + kSenderDrift)));
+            }
+            air.completedMs = trueMs;
+            uint8_t clock[] = { kMIDISysCmd_TimingClock };
+            encoder.add(senderMs, clock, 1);
+            sentMs.push_back(trueMs);
+            if (pulse == 0) {
+                uint8_t note[] = { (uint8_t) (kMIDIChanCmd_NoteOn << 4), 60, 100 };
+                encoder.add(senderMs, note, 3);
+                sentMs.push_back(trueMs);
+            }
+        }
+    }
+    encoder.flush();
+    // the air: a packet leaves at the next connection event, or later if retried
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double lastMs = 0.0;
+    for (ReceivePacket &packet : air.packets) {
+        double eventMs = std::ceil(packet.completedMs / intervalMs) * intervalMs;
+        while (uniform(random) < retryRate) eventMs += intervalMs;
+        // the link keeps the packet order
+        packet.arrivalMs = std::max(eventMs, lastMs);
+        lastMs = packet.arrivalMs;
+    }
+
+    ReceiveTiming timing;
+    BleMidiDecoder decoder(&timing);
+    for (const ReceivePacket &packet : air.packets) {
+        timing.arrivalMs = packet.arrivalMs;
+        decoder.decode(packet.data.data(), (int) packet.data.size());
+    }
+    if (timing.playMs.size() != sentMs.size()) {
+        fprintf(stderr, "FAIL: %zu of %zu messages decoded\n", timing.playMs.size(),
+                sentMs.size());
+        return 1;
+    }
+    std::vector<double> timedMs;
+    std::vector<double> arrivalMs;
+    size_t late = 0;
+    for (size_t i = 0; i < sentMs.size(); i++) {
+        timedMs.push_back(timing.playMs[i] - sentMs[i]);
+        arrivalMs.push_back(timing.arrival[i] - sentMs[i]);
+        if (timing.playMs[i] < timing.arrival[i]) late++;
+    }
+    double jitterMs = spread(timedMs);
+    double lateRate = (double) late / sentMs.size();
+    printf("%d min, %zu messages in %zu packets, %.2f ms connection interval, %.0f%% retries:\n",
+           minutes, sentMs.size(), air.packets.size(), intervalMs, retryRate * 100);
+    printf("  played on arrival: jitter %.2f ms\n", spread(arrivalMs));
+    printf("  sender timing: jitter %.2f ms, %.2f%% scheduled too late, delay %.1f ms\n",
+           jitterMs, lateRate * 100, timing.sync.getJitter());
+
+    // throughput of the decoder alone
+    int64_t bytes = 0;
+    int64_t messages = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (bytes < kThroughputBytes) {
+        size_t before = timing.playMs.size();
+        for (const ReceivePacket &packet : air.packets) {
+            decoder.decode(packet.data.data(), (int) packet.data.size());
+            bytes += (int64_t) packet.data.size();
+        }
+        messages += (int64_t) (timing.playMs.size() - before);
+        timing.playMs.clear();
+        timing.arrival.clear();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("  decoder: %.1f MB/s, %.1f M messages/s (checksum %llu)\n",
+           bytes / 1048576.0 / elapsed.count(), messages / elapsed.count() / 1e6,
+           (unsigned long long) timing.checksum);
+
+    bool ok = true;
+    if (jitterMs > maxJitterMs) {
+        fprintf(stderr, "FAIL: jitter %.2f ms (max. %.2f ms)\n", jitterMs, maxJitterMs);
+        ok = false;
+    }
+    if (lateRate > kMaxLateRate) {
+        fprintf(stderr, "FAIL: %.2f%% scheduled too late (max. %.2f%%)\n", lateRate * 100,
+                kMaxLateRate * 100);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/GlitchInject.cpp
+ * @brief Glitch detector check with synthetic glitch injection (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../GlitchDetector.h"
+#include "../OutputChain.h"
+
+/*
+ * Renders a test signal (two voices with attack and release envelopes, notes with rests
+ * that fade out naturally), injects glitches at known frames and runs the glitch detector
+ * as SynthEngine::render() does: 441-frame periods split in 64-frame blocks, the callback
+ * time checked at each period. Every two seconds it injects:
+ *   - a discontinuity: a voice cut at the peak of its waveform (voice stealing);
+ *   - clipping: a smooth gain bump that takes the peaks over full scale;
+ *   - a dropout: 300 frames zeroed in the middle of a note;
+ *   - a late callback: a period that starts 25 ms late.
+ * Each injected glitch must be reported with its type within two blocks of its span; any
+ * other event is a false positive (a dropout also shows as discontinuities at its edges).
+ * Prints the detections and the cost of the detector per block.
+ *
+ * usage: glitch-inject [-d seconds] [-c] [-o]
+ *        seconds is the length of the test signal (60 by default).
+ *        -c renders the clean signal only, which must report no glitch.
+ *        -o runs the signal through the output chain of SynthEngine::render() (OutputChain:
+ *        the output stage with its gain, limiter and dither, before the detector): the
+ *        glitches of the audio are reported kOutputLookAheadFrames later, and the clipping
+ *        must not be reported at all (the limiter keeps the output under full scale).
+ *        Exits with 1 if a glitch is missed or a false one is reported.
+ */
+
+/* @brief Sample rate, in Hz (as the app). */
+static const int kInjectSampleRate = 44100;
+/* @brief Render period, in frames (10 ms, as the app). */
+static const int kInjectPeriod = 441;
+/* @brief Frames rendered per block (a control block, as SynthEngine). */
+static const int kInjectBlockFrames = kControlBlockFrames;
+/* @brief Length of a cycle of the test signal (notes and injections), in seconds. */
+static const double kInjectCycleSeconds = 2.0;
+/* @brief Distance between an injected glitch and its report, in frames. */
+static const int kInjectTolerance = 2 * kInjectBlockFrames;
+/* @brief Frames zeroed by an injected dropout. */
+static const int kInjectDropoutFrames = 300;
+/* @brief Delay of an injected late callback, in nanoseconds. */
+static const int64_t kInjectLateNs = 25000000;
+
+/* @brief Names of the glitch types, indexed by GlitchType. */
+static const char *kGlitchNames[kGlitchTypeCount] = {
+    "discontinuity", "clipping", "dropout", "late callback"
+};
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief An injected glitch. */
+struct Injection {
+    /* @brief Audio frame of the glitch. */
+    int64_t frame;
+    /* @brief Glitch type (GlitchType). */
+    int type;
+    /* @brief Length of the glitch, in frames. */
+    int frames;
+    /* @brief True once reported. */
+    bool found;
+};
+
+/* @brief Envelope of a note: 10 ms linear attack, exponential release (20 ms). */
+static double envelope(double t, double length) {
+    if (t < 0.0) return 0.0;
+    if (t < 0.01) return t / 0.01;
+    if (t < length) return 1.0;
+    return exp(-(t - length) / 0.02);
+}
+
+/* @brief Render the test signal, with the glitches of the audio if inject is set. */
+static void renderSignal(std::vector<float> &left, std::vector<float> &right, bool inject,
+                         std::vector<Injection> &injections) {
+    int frames = (int) left.size();
+    int cycleFrames = (int) (kInjectCycleSeconds * kInjectSampleRate);
+    std::vector<float> voice(frames);
+    for (int i = 0; i < frames; i++) {
+        double t = (double) i / kInjectSampleRate;
+        double cycle = fmod(t, kInjectCycleSeconds);
+        // a note held 1.4 s, then a rest; a second voice on a shorter note, and a high one
+        double low = 0.3 * envelope(cycle, 1.4) *
+                     (sin(2 * M_PI * 220.0 * t) + 0.3 * sin(2 * M_PI * 440.0 * t));
+        double high = 0.05 * envelope(cycle - 0.5, 0.5) * sin(2 * M_PI * 1760.0 * t);
+        voice[i] = (float) (0.25 * envelope(cycle - 0.1, 1.2) * sin(2 * M_PI * 330.0 * t));
+        left[i] = (float) (low + high) + voice[i];
+        right[i] = (float) (low - high) + voice[i];
+    }
+    if (!inject) return;
+    for (int start = 0; start + cycleFrames <= frames; start += cycleFrames) {
+        // voice stealing: the second voice stops at a peak of its waveform
+        int cut = start + (int) (0.3 * kInjectSampleRate);
+        while (fabsf(voice[cut]) < 0.2f) cut++;
+        int end = start + (int) (1.4 * kInjectSampleRate);
+        for (int i = cut; i < end; i++) {
+            left[i] -= voice[i];
+            right[i] -= voice[i];
+        }
+        injections.push_back({ cut, kGlitch_Discontinuity, 0, false });
+        // clipping: a smooth 10 ms gain bump up to 4
+        int bump = start + (int) (0.7 * kInjectSampleRate);
+        int bumpFrames = kInjectSampleRate / 100;
+        for (int i = 0; i < bumpFrames; i++) {
+            float gain = (float) (1.0 + 1.5 * (1.0 - cos(2 * M_PI * i / bumpFrames)));
+            left[bump + i] *= gain;
+            right[bump + i] *= gain;
+        }
+        injections.push_back({ bump, kGlitch_Clipping, bumpFrames, false });
+        // dropout: the output goes silent in the middle of the note
+        int drop = start + (int) (1.01 * kInjectSampleRate);
+        for (int i = drop; i < drop + kInjectDropoutFrames; i++) {
+            left[i] = 0.0f;
+            right[i] = 0.0f;
+        }
+        injections.push_back({ drop, kGlitch_Dropout, kInjectDropoutFrames, false });
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-d seconds] [-c] [-o]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 60.0;
+    bool inject = true;
+    bool throughStage = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:co")) != -1) {
+        switch (opt) {
+            case 'd': seconds = atof(optarg); break;
+            case 'c': inject = false; break;
+            case 'o': throughStage = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (seconds < kInjectCycleSeconds) {
+        usage(argv[0]);
+        return 2;
+    }
+    int frames = (int) (seconds * kInjectSampleRate);
+    std::vector<float> left(frames), right(frames);
+    std::vector<Injection> injections;
+    renderSignal(left, right, inject, injections);
+    if (throughStage) {
+        // heard later, and never clipped: a clipping report is then a false one
+        std::vector<Injection> delayed;
+        for (Injection injection : injections) {
+            if (injection.type == kGlitch_Clipping) continue;
+            injection.frame += kOutputLookAheadFrames;
+            delayed.push_back(injection);
+        }
+        injections = delayed;
+    }
+    // late callbacks: one period per cycle, 0.2 s after the dropout
+    int cycleFrames = (int) (kInjectCycleSeconds * kInjectSampleRate);
+    std::vector<int64_t> lateFrames;
+    if (inject) {
+        for (int start = 0; start + cycleFrames <= frames; start += cycleFrames) {
+            int64_t frame = start + (int) (1.2 * kInjectSampleRate);
+            frame -= frame % kInjectPeriod;
+            lateFrames.push_back(frame);
+            injections.push_back({ frame, kGlitch_LateCallback, 0, false });
+        }
+    }
+    // the chain of the engine, or the detector alone
+    static OutputChain chain(kInjectSampleRate);
+    static GlitchDetector bareDetector(kInjectSampleRate);
+    GlitchDetector &detector = throughStage ? *chain.getGlitchDetector() : bareDetector;
+    std::vector<GlitchEvent> events;
+    GlitchEvent buffer[kGlitchLogSize];
+    int64_t processNs = 0;
+    int64_t blocks = 0;
+    int64_t timeNs = 1000000000;
+    size_t late = 0;
+    for (int period = 0; period < frames; period += kInjectPeriod) {
+        int periodFrames = frames - period < kInjectPeriod ? frames - period : kInjectPeriod;
+        timeNs += (int64_t) kInjectPeriod * 1000000000 / kInjectSampleRate;
+        if (late < lateFrames.size() && lateFrames[late] == period) {
+            timeNs += kInjectLateNs;
+            late++;
+        }
+        if (throughStage) {
+            chain.callback(period, timeNs, periodFrames);
+        } else {
+            detector.callback(period, timeNs, periodFrames);
+        }
+        for (int offset = period; offset < period + periodFrames;
+             offset += kInjectBlockFrames) {
+            int count = period + periodFrames - offset;
+            if (count > kInjectBlockFrames) count = kInjectBlockFrames;
+            int64_t start = nowNs();
+            if (throughStage) {
+                chain.process(offset, &left[offset], &right[offset], count);
+            } else {
+                detector.process(offset, &left[offset], &right[offset], count);
+            }
+            processNs += nowNs() - start;
+            blocks++;
+        }
+        int count = detector.read(buffer, kGlitchLogSize);
+        events.insert(events.end(), buffer, buffer + count);
+    }
+    // match the events with the injected glitches
+    int falsePositives = 0;
+    for (const GlitchEvent &event : events) {
+        bool explained = false;
+        for (Injection &injection : injections) {
+            int64_t distance = event.frame - injection.frame;
+            if (distance < -kInjectTolerance || distance > injection.frames + kInjectTolerance) {
+                continue;
+            }
+            if (event.type == injection.type) injection.found = true;
+            explained = true;
+        }
+        if (!explained) {
+            falsePositives++;
+            printf("false %s at frame %lld (%.3f s), magnitude %.3f\n",
+                   kGlitchNames[event.type], (long long) event.frame,
+                   (double) event.frame / kInjectSampleRate, event.value);
+        }
+    }
+    int missed = 0;
+    for (const Injection &injection : injections) {
+        if (injection.found) continue;
+        missed++;
+        printf("missed %s at frame %lld (%.3f s)\n", kGlitchNames[injection.type],
+               (long long) injection.frame, (double) injection.frame / kInjectSampleRate);
+    }
+    for (int type = 0; type < kGlitchTypeCount; type++) {
+        printf("%-14s %lld reported\n", kGlitchNames[type],
+               (long long) detector.getCount(type));
+    }
+    printf("%d frames, %zu injected, %d missed, %d false, %lld dropped from the log\n",
+           frames, injections.size(), missed, falsePositives,
+           (long long) detector.getDropped());
+    printf("%s %.0f ns per %d-frame block\n", throughStage ? "output chain" : "detector",
+           (double) processNs / blocks, kInjectBlockFrames);
+    return missed == 0 && falsePositives == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/HeartRateArtifacts.cpp
+ * @brief Artifact rejection check and benchmark of the heart-rate filter (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../HeartRateFilter.h"
+
+/*
+ * Runs the heart-rate filter on a synthetic 1 Hz sensor trace (70 BPM, a ramp to 110 BPM,
+ * a fast fall to 80 BPM, 1 BPM of noise) with injected artifacts:
+ * - out-of-range readings (0 and 220 BPM), as the sensor reports when it loses the beat;
+ * - plausible spikes (40 BPM off), single and in pairs;
+ * - a 10 s loss of contact (accuracy NO_CONTACT, reading 0);
+ * - 5 s of unreliable readings (accuracy UNRELIABLE, 1.5 times the rate).
+ * The filter output with the artifacts must stay within kArtifactMaxError of its output
+ * on the clean trace, while the raw readings (what the app played before) do not, and
+ * every injected artifact must be counted as rejected. On the clean trace the output must
+ * follow the slow ramp within kArtifactMaxLag and settle within kArtifactMaxLag of the
+ * new rate kArtifactMaxSettle seconds after the fall (the smoother has a time constant of
+ * about 3 s at rest, so a fall of 3 BPM/s lags by about 10 BPM while it lasts). Then the
+ * filter is timed on the trace with artifacts: prints samples/s and the cost per sample.
+ *
+ * usage: heart-rate-artifacts [-n samples]
+ *        samples is the number of samples timed (10 million by default).
+ *        Exits with 1 if a check fails.
+ */
+
+/* @brief Length of the trace, in seconds (one sample per second). */
+static const int kArtifactTraceSeconds = 300;
+/* @brief Largest difference between the output with and without artifacts, in BPM. */
+static const double kArtifactMaxError = 2.0;
+/* @brief Largest difference between the output on the clean trace and the rate, in BPM. */
+static const double kArtifactMaxLag = 3.0;
+/* @brief Longest time to settle after the fall, in seconds. */
+static const int kArtifactMaxSettle = 15;
+/* @brief Samples ignored at the start (the smoother starts from the first sample). */
+static const int kArtifactWarmUp = 10;
+
+/* @brief A sensor sample. */
+struct ArtifactSample {
+    /* @brief Heart rate, in BPM. */
+    float bpm;
+    /* @brief Sensor accuracy. */
+    int accuracy;
+    /* @brief True if the sample is an injected artifact. */
+    bool artifact;
+};
+
+/* @brief Heart rate of the trace at a time, in BPM. */
+static double truth(int second) {
+    if (second < 60) return 70.0;
+    if (second < 120) return 70.0 + 40.0 * (second - 60) / 60.0;
+    if (second < 180) return 110.0;
+    if (second < 190) return 110.0 - 30.0 * (second - 180) / 10.0;
+    return 80.0;
+}
+
+/* @brief Generate the trace, clean or with the artifacts. */
+static std::vector<ArtifactSample> generate(bool artifacts) {
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<ArtifactSample> samples;
+    for (int second = 0; second < kArtifactTraceSeconds; second++) {
+        samples.push_back({ (float) (truth(second) + noise(random)),
+                            kSensorStatusAccuracyLow, false });
+    }
+    if (!artifacts) return samples;
+    auto inject = [&](int second, float bpm, int accuracy) {
+        samples[second] = { bpm, accuracy, true };
+    };
+    // out of range
+    for (int second : { 20, 75, 140, 230, 270 }) inject(second, 0.0f, kSensorStatusAccuracyLow);
+    for (int second : { 35, 100, 160, 250 }) inject(second, 220.0f, kSensorStatusAccuracyLow);
+    // plausible spikes, some in pairs
+    for (int second : { 45, 90, 150, 260 }) {
+        inject(second, (float) truth(second) + 40.0f, kSensorStatusAccuracyLow);
+    }
+    for (int second : { 55, 130, 280 }) {
+        inject(second, (float) truth(second) - 40.0f, kSensorStatusAccuracyLow);
+        inject(second + 1, (float) truth(second + 1) - 40.0f, kSensorStatusAccuracyLow);
+    }
+    // loss of contact and unreliable readings
+    for (int second = 200; second < 210; second++) {
+        inject(second, 0.0f, kSensorStatusNoContact);
+    }
+    for (int second = 240; second < 245; second++) {
+        inject(second, (float) truth(second) * 1.5f, kSensorStatusUnreliable);
+    }
+    return samples;
+}
+
+/* @brief Filter a trace, return the output after each sample (the last one if gated). */
+static std::vector<double> filter(const std::vector<ArtifactSample> &samples,
+                                  uint64_t *rejected) {
+    HeartRateFilter heartRateFilter;
+    std::vector<double> output;
+    for (size_t i = 0; i < samples.size(); i++) {
+        heartRateFilter.process((double) i, samples[i].bpm, samples[i].accuracy);
+        output.push_back(heartRateFilter.getValue());
+    }
+    *rejected = heartRateFilter.getRejectedCount();
+    return output;
+}
+
+/* @brief Check the filter on the traces. */
+static bool check() {
+    std::vector<ArtifactSample> clean = generate(false);
+    std::vector<ArtifactSample> dirty = generate(true);
+    uint64_t cleanRejected, dirtyRejected;
+    std::vector<double> cleanOutput = filter(clean, &cleanRejected);
+    std::vector<double> dirtyOutput = filter(dirty, &dirtyRejected);
+    int artifacts = 0;
+    double maxError = 0.0, maxRawError = 0.0, maxLag = 0.0;
+    int settle = 0;
+    for (int i = 0; i < kArtifactTraceSeconds; i++) {
+        if (dirty[i].artifact) artifacts++;
+        if (i < kArtifactWarmUp) continue;
+        maxError = std::max(maxError, fabs(dirtyOutput[i] - cleanOutput[i]));
+        maxRawError = std::max(maxRawError, fabs((double) dirty[i].bpm - clean[i].bpm));
+        double lag = fabs(cleanOutput[i] - truth(i));
+        if (i < 180) maxLag = std::max(maxLag, lag);
+        if (i >= 190 && lag > kArtifactMaxLag) settle = i - 190 + 1;
+    }
+    printf("%d s trace, %d artifacts (%llu rejected, %llu on the clean trace):\n",
+           kArtifactTraceSeconds, artifacts, (unsigned long long) dirtyRejected,
+           (unsigned long long) cleanRejected);
+    printf("  filtered with artifacts:  %6.2f BPM from the clean output\n", maxError);
+    printf("  raw with artifacts:       %6.2f BPM from the clean readings\n", maxRawError);
+    printf("  filtered clean:           %6.2f BPM from the heart rate on the ramp, "
+           "settled %d s after the fall\n", maxLag, settle);
+    bool ok = true;
+    if (maxError > kArtifactMaxError || maxRawError <= kArtifactMaxError) {
+        fprintf(stderr, "FAIL: artifacts move the output by %.2f BPM (max. %.2f BPM)\n",
+                maxError, kArtifactMaxError);
+        ok = false;
+    }
+    if (dirtyRejected < (uint64_t) artifacts) {
+        fprintf(stderr, "FAIL: %llu samples rejected, %d artifacts\n",
+                (unsigned long long) dirtyRejected, artifacts);
+        ok = false;
+    }
+    if (maxLag > kArtifactMaxLag || settle > kArtifactMaxSettle) {
+        fprintf(stderr, "FAIL: the output lags the heart rate by %.2f BPM (max. %.2f BPM), "
+                "settles in %d s (max. %d s)\n", maxLag, kArtifactMaxLag, settle,
+                kArtifactMaxSettle);
+        ok = false;
+    }
+    return ok;
+}
+
+/* @brief Time the filter on the trace with artifacts, repeated. */
+static void bench(long count) {
+    std::vector<ArtifactSample> samples = generate(true);
+    HeartRateFilter heartRateFilter;
+    double checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++) {
+        const ArtifactSample &sample = samples[i % kArtifactTraceSeconds];
+        heartRateFilter.process((double) i, sample.bpm, sample.accuracy);
+        checksum += heartRateFilter.getValue();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                   start).count();
+    printf("%ld samples in %.3f s: %.1f M samples/s, %.1f ns per sample (checksum %.0f)\n",
+           count, seconds, count / seconds / 1e6, seconds * 1e9 / count, checksum);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n samples]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    long count = 10000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': count = atol(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (count < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    bool ok = check();
+    bench(count);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/HrvAccuracy.cpp
+ * @brief Accuracy check and benchmark of the heart-rate variability analysis (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../HrvAnalyzer.h"
+
+/*
+ * Checks the heart-rate variability analysis on a synthetic RR series (800 ms, a 40 ms
+ * respiratory arrhythmia over about 5 beats and 15 ms of noise):
+ * - sums: after each interval, the metrics match a full recompute of the window within
+ *   1e-6 ms (pNN50 exactly), however long the series;
+ * - beats: the beats of the series go through addBeat() with detection artifacts (missed
+ *   beats, extra detections, unsure detections and ectopic beats); at each checkpoint the
+ *   metrics must be within kHrvMaxBeatError of the ones of the clean series, while taking
+ *   every detected interval as is must not;
+ * - rate: the metrics of intervals derived from a 1 Hz heart rate (60000 / BPM, what the
+ *   app used before) are printed for comparison: the rate sensor averages the beats, so
+ *   they miss most of the variability.
+ * Then the analysis is timed: prints intervals/s and beats/s.
+ *
+ * usage: hrv-accuracy [-n intervals]
+ *        intervals is the number of intervals timed (10 million by default).
+ *        Exits with 1 if a check fails.
+ */
+
+/* @brief Number of intervals of the series. */
+static const int kHrvSeriesLength = 4096;
+/* @brief Largest error of the metrics through a full recompute, in ms. */
+static const double kHrvMaxSumError = 1e-6;
+/* @brief Largest relative error of RMSSD and SDNN from the beats with artifacts. */
+static const double kHrvMaxBeatError = 0.1;
+/* @brief Largest error of pNN50 from the beats with artifacts, in points. */
+static const double kHrvMaxPnn50Error = 10.0;
+/* @brief One artifact every this many beats. */
+static const int kHrvArtifactPeriod = 50;
+
+/* @brief Generate the RR series, in ms. */
+static std::vector<double> generate() {
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0.0, 15.0);
+    std::vector<double> intervals;
+    double time = 0.0;
+    for (int i = 0; i < kHrvSeriesLength; i++) {
+        double rr = 800.0 + 40.0 * sin(2.0 * M_PI * time / 4000.0) + noise(random);
+        intervals.push_back(rr);
+        time += rr;
+    }
+    return intervals;
+}
+
+/* @brief Compute the metrics of the last intervals of a series from scratch. */
+static void recompute(const std::vector<double> &intervals, size_t end, double *metrics) {
+    size_t start = end > (size_t) kHrvWindow ? end - kHrvWindow : 0;
+    // the analyzer keeps the intervals in whole microseconds
+    std::vector<double> window;
+    for (size_t i = start; i < end; i++) window.push_back(llround(intervals[i] * 1000.0) / 1e3);
+    size_t n = window.size();
+    double mean = 0.0;
+    for (double rr : window) mean += rr;
+    mean /= n;
+    double variance = 0.0, squares = 0.0;
+    int nn50 = 0;
+    for (size_t i = 0; i < n; i++) {
+        variance += (window[i] - mean) * (window[i] - mean);
+        if (i == 0) continue;
+        double diff = window[i] - window[i - 1];
+        squares += diff * diff;
+        if (fabs(diff) > 50.0) nn50++;
+    }
+    metrics[kHrvMetric_RMSSD] = sqrt(squares / (n - 1));
+    metrics[kHrvMetric_SDNN] = sqrt(variance / (n - 1));
+    metrics[kHrvMetric_PNN50] = 100.0 * nn50 / (n - 1);
+}
+
+/* @brief Check the running sums against a full recompute. */
+static bool checkSums(const std::vector<double> &intervals) {
+    HrvAnalyzer analyzer;
+    double maxError = 0.0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        analyzer.addInterval(intervals[i]);
+        if (i < 1) continue;
+        double expected[kHrvMetricCount];
+        recompute(intervals, i + 1, expected);
+        for (int metric = 0; metric < kHrvMetricCount; metric++) {
+            maxError = std::max(maxError, fabs(analyzer.getMetric(metric) - expected[metric]));
+        }
+    }
+    printf("  sums: largest error from a full recompute %.2e over %zu intervals\n", maxError,
+           intervals.size());
+    return maxError <= kHrvMaxSumError;
+}
+
+/* @brief A detected beat. */
+struct HrvBeat {
+    int64_t timeNs;
+    float confidence;
+};
+
+/* @brief Detect the beats of a series, with an artifact every kHrvArtifactPeriod beats. */
+static std::vector<HrvBeat> detect(const std::vector<double> &intervals) {
+    std::vector<HrvBeat> beats;
+    double time = 0.0;
+    beats.push_back({ 0, 1.0f });
+    for (size_t i = 0; i < intervals.size(); i++) {
+        double next = time + intervals[i];
+        int artifact = (int) (i % (kHrvArtifactPeriod * 4));
+        if (artifact == kHrvArtifactPeriod) {
+            // missed beat: the next interval is doubled
+            time = next;
+            continue;
+        } else if (artifact == kHrvArtifactPeriod * 2) {
+            // extra detection on the T wave
+            beats.push_back({ (int64_t) ((time + 300.0) * 1e6), 1.0f });
+        } else if (artifact == kHrvArtifactPeriod * 3) {
+            // ectopic beat: early, followed by a compensatory pause
+            next = time + intervals[i] * 0.7;
+            beats.push_back({ (int64_t) (next * 1e6), 1.0f });
+            time = next + intervals[i] * 0.3 + intervals[i + 1];
+            beats.push_back({ (int64_t) (time * 1e6), 1.0f });
+            i++;
+            continue;
+        }
+        beats.push_back({ (int64_t) (next * 1e6), artifact == 0 && i > 0 ? 0.2f : 1.0f });
+        time = next;
+    }
+    return beats;
+}
+
+/* @brief Check the metrics from the beats with artifacts. */
+static bool checkBeats(const std::vector<double> &intervals) {
+    std::vector<HrvBeat> beats = detect(intervals);
+    HrvAnalyzer analyzer;
+    HrvAnalyzer raw;
+    HrvAnalyzer clean;
+    double maxError[kHrvMetricCount] = {};
+    double maxRawError[kHrvMetricCount] = {};
+    size_t beat = 0;
+    double time = 0.0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        time += intervals[i];
+        clean.addInterval(intervals[i]);
+        // the detected beats up to the true one
+        for (; beat < beats.size() && beats[beat].timeNs <= (int64_t) (time * 1e6) + 1; beat++) {
+            analyzer.addBeat(beats[beat].timeNs, beats[beat].confidence);
+            if (beat > 0) raw.addInterval((beats[beat].timeNs - beats[beat - 1].timeNs) / 1e6);
+        }
+        // checkpoints once the window is full
+        if (i < (size_t) kHrvWindow * 2 || i % kHrvWindow != 0) continue;
+        for (int metric = 0; metric < kHrvMetricCount; metric++) {
+            double expected = clean.getMetric(metric);
+            double scale = metric == kHrvMetric_PNN50 ? 1.0 : expected;
+            maxError[metric] = std::max(maxError[metric],
+                                        fabs(analyzer.getMetric(metric) - expected) / scale);
+            maxRawError[metric] = std::max(maxRawError[metric],
+                                           fabs(raw.getMetric(metric) - expected) / scale);
+        }
+    }
+    printf("  beats (%zu, %llu left out): RMSSD %.1f%%, SDNN %.1f%%, pNN50 %.1f points off\n",
+           beats.size(), (unsigned long long) analyzer.getRejectedBeats(),
+           maxError[kHrvMetric_RMSSD] * 100.0, maxError[kHrvMetric_SDNN] * 100.0,
+           maxError[kHrvMetric_PNN50]);
+    printf("  beats taken as is:         RMSSD %.1f%%, SDNN %.1f%%, pNN50 %.1f points off\n",
+           maxRawError[kHrvMetric_RMSSD] * 100.0, maxRawError[kHrvMetric_SDNN] * 100.0,
+           maxRawError[kHrvMetric_PNN50]);
+    bool ok = maxError[kHrvMetric_RMSSD] <= kHrvMaxBeatError &&
+              maxError[kHrvMetric_SDNN] <= kHrvMaxBeatError &&
+              maxError[kHrvMetric_PNN50] <= kHrvMaxPnn50Error;
+    // the check must be able to fail
+    bool rawOk = maxRawError[kHrvMetric_RMSSD] <= kHrvMaxBeatError &&
+                 maxRawError[kHrvMetric_SDNN] <= kHrvMaxBeatError;
+    return ok && !rawOk;
+}
+
+/* @brief Print the metrics of the intervals derived from a 1 Hz heart rate. */
+static void showRate(const std::vector<double> &intervals) {
+    HrvAnalyzer clean;
+    HrvAnalyzer rate;
+    // the rate sensor reports the mean rate of the last 5 s, once a second
+    double time = 0.0, nextSample = 1000.0;
+    size_t first = 0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        time += intervals[i];
+        clean.addInterval(intervals[i]);
+        while (time >= nextSample) {
+            double span = 0.0;
+            size_t count = 0;
+            for (size_t j = i + 1; j > first && span < 5000.0; j--, count++) {
+                span += intervals[j - 1];
+            }
+            if (count > 0) rate.addInterval(span / count);
+            nextSample += 1000.0;
+        }
+    }
+    printf("  from a 1 Hz rate:  RMSSD %.1f ms, SDNN %.1f ms, pNN50 %.1f%% "
+           "(beats: %.1f ms, %.1f ms, %.1f%%)\n",
+           rate.getMetric(kHrvMetric_RMSSD), rate.getMetric(kHrvMetric_SDNN),
+           rate.getMetric(kHrvMetric_PNN50), clean.getMetric(kHrvMetric_RMSSD),
+           clean.getMetric(kHrvMetric_SDNN), clean.getMetric(kHrvMetric_PNN50));
+}
+
+/* @brief Time the analysis. */
+static void bench(const std::vector<double> &intervals, long count) {
+    HrvAnalyzer analyzer;
+    double checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++) {
+        analyzer.addInterval(intervals[i % kHrvSeriesLength]);
+        for (int metric = 0; metric < kHrvMetricCount; metric++) {
+            checksum += analyzer.getMetric(metric);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                   start).count();
+    printf("%ld intervals in %.3f s: %.1f M intervals/s, %.1f ns per interval (checksum %.0f)\n",
+           count, seconds, count / seconds / 1e6, seconds * 1e9 / count, checksum);
+    analyzer.reset();
+    int64_t timeNs = 0;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++) {
+        timeNs += (int64_t) (intervals[i % kHrvSeriesLength] * 1e6);
+        if (analyzer.addBeat(timeNs, 1.0f)) checksum += analyzer.getMetric(kHrvMetric_RMSSD);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%ld beats in %.3f s: %.1f M beats/s, %.1f ns per beat (checksum %.0f)\n",
+           count, seconds, count / seconds / 1e6, seconds * 1e9 / count, checksum);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n intervals]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    long count = 10000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': count = atol(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (count < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::vector<double> intervals = generate();
+    printf("%d intervals, window %d:\n", kHrvSeriesLength, kHrvWindow);
+    bool ok = checkSums(intervals);
+    ok = checkBeats(intervals) && ok;
+    showRate(intervals);
+    bench(intervals, count);
+    if (!ok) fprintf(stderr, "FAIL\n");
+    return ok ? 0 : 1;
+}
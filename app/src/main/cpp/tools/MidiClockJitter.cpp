@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/MidiClockJitter.cpp
+ * @brief Timing jitter of the MIDI clock output (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../FrameClock.h"
+#include "../MidiClock.h"
+#include "../MidiSender.h"
+#include "../MidiSpec.h"
+
+/*
+ * Measures the jitter of the MIDI clock as SynthManager sends it. A thread stands in for
+ * the audio callback: it wakes up every period, maps the frames of the period to time with
+ * a FrameClock, and runs the MidiClock over 64-frame blocks. Each pulse is queued to a
+ * MidiSender with the time of its frame plus one period (the output latency), and the sender
+ * thread hands it over when due.
+ *
+ * The FrameClock is not fed the wake-up time read from the host, but the ideal one plus a
+ * pseudo-random wake-up delay (up to 2 ms, with a 15 ms stall every 256 periods): the
+ * timestamps only depend on the frames, and are the same on every run and host.
+ *
+ * The jitter is the error of the pulse intervals against the ideal interval (99th
+ * percentile and largest). It is shown for:
+ * - stamped at the callback: all the pulses of a period leave in one burst (the old path);
+ * - timestamps: the times given to AMidi and the BLE-MIDI encoder;
+ * - sent: the times the sender thread handed the pulses over.
+ * The test fails (exit 1) if the 99th percentile of the timestamps exceeds 0.5 ms, or if the
+ * number of pulses is not the one of the tempo. The other two depend on the host scheduler:
+ * they are only reported.
+ *
+ * usage: midi-clock-jitter [-s seconds] [-b bpm] [-p period_frames]
+ *        seconds is the measured time (5 by default).
+ *        bpm is the clock tempo (120 by default).
+ *        period_frames is the audio callback period (480 by default, about 10.9 ms).
+ */
+
+/* @brief Audio sample rate, in Hz. */
+static const int kJitterSampleRate = 44100;
+/* @brief Control block of the render loop, in frames. */
+static const int kJitterBlockFrames = 64;
+/* @brief Largest 99th percentile of the timestamp interval error, in milliseconds. */
+static const double kMaxStampJitterMs = 0.5;
+/* @brief Largest simulated wake-up delay of the callback, in nanoseconds. */
+static const int64_t kWakeJitterNs = 2000000;
+/* @brief Simulated stall of the callback, in nanoseconds. */
+static const int64_t kWakeStallNs = 15000000;
+/* @brief Periods between simulated stalls. */
+static const int kWakeStallPeriods = 256;
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Simulated wake-up delay of a callback (pseudo-random, the same on every run). */
+static int64_t wakeDelayNs(int64_t period) {
+    if (period > 0 && period % kWakeStallPeriods == 0) return kWakeStallNs;
+    auto hash = (uint32_t) (period * 2654435761u);
+    hash ^= hash >> 15;
+    hash *= 2246822519u;
+    hash ^= hash >> 13;
+    return (int64_t) (hash % 1000) * kWakeJitterNs / 1000;
+}
+
+/* @brief Queues the pulses of the clock (render thread) and collects them (sender thread). */
+class JitterListener : public MidiClockListener, public MidiSenderListener {
+public:
+    explicit JitterListener(int period): sender(this), period(period) {}
+    void onMidiClock(int64_t frame, uint8_t status, uint8_t data1, uint8_t data2) override {
+        if (status != kMIDISysCmd_TimingClock) return;
+        int64_t timeNs = periodNs + (frame - periodFrame + period) * 1000000000LL /
+                kJitterSampleRate;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            callbacks.push_back(nowNs());
+            stamps.push_back(timeNs);
+        }
+        sender.push(timeNs, status, data1, data2);
+    }
+    void onMidiSend(int64_t, uint8_t, uint8_t, uint8_t) override {
+        int64_t sentNs = nowNs();
+        std::lock_guard<std::mutex> lock(mutex);
+        sent.push_back(sentNs);
+    }
+    MidiSender sender;
+    int period;
+    int64_t periodFrame = 0;
+    int64_t periodNs = 0;
+    std::mutex mutex;
+    std::vector<int64_t> callbacks;
+    std::vector<int64_t> stamps;
+    std::vector<int64_t> sent;
+};
+
+/* @brief Print the interval error of a series of pulse times, return its 99th percentile. */
+static double report(const char *name, const std::vector<int64_t> &times, double idealMs) {
+    if (times.size() < 2) {
+        printf("  %-28s too few pulses\n", name);
+        return 0.0;
+    }
+    std::vector<double> errors;
+    for (size_t i = 1; i < times.size(); i++) {
+        errors.push_back(std::fabs((times[i] - times[i - 1]) / 1e6 - idealMs));
+    }
+    std::sort(errors.begin(), errors.end());
+    double p99 = errors[errors.size() * 99 / 100];
+    printf("  %-28s p99 %6.3f ms, max %6.3f ms\n", name, p99, errors.back());
+    return p99;
+}
+
+/* @brief Measure the jitter, return true if the timestamps meet the limits. */
+static bool measure(int seconds, float bpm, int period) {
+    JitterListener listener(period);
+    FrameClock frameClock(kJitterSampleRate);
+    MidiClock clock(&listener, kJitterSampleRate);
+    clock.setTempo(bpm);
+    clock.start(0);
+    listener.sender.start();
+    int64_t startNs = nowNs();
+    int64_t frame = 0;
+    for (int64_t count = 0; frame < (int64_t) seconds * kJitterSampleRate; count++) {
+        // the callback of the period: its wake-up time is the time of its first frame
+        int64_t idealNs = startNs + frame * 1000000000LL / kJitterSampleRate;
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::nanoseconds(idealNs)));
+        listener.periodFrame = frame;
+        listener.periodNs = frameClock.update(frame, idealNs + wakeDelayNs(count));
+        for (int offset = 0; offset < period; offset += kJitterBlockFrames) {
+            int frames = std::min(kJitterBlockFrames, period - offset);
+            clock.process(frame + offset, frames);
+        }
+        frame += period;
+    }
+    // let the last pulses leave
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    listener.sender.stop();
+
+    double idealMs = 60000.0 / bpm / kMidiClockPPQN;
+    // pulses of [0, frame): the first one is at frame 0
+    auto pulseFrames = (double) kJitterSampleRate * 60.0 / bpm / kMidiClockPPQN;
+    auto expected = (size_t) std::ceil(frame / pulseFrames);
+    std::lock_guard<std::mutex> lock(listener.mutex);
+    printf("%d s at %.1f BPM (%.3f ms per pulse), %d-frame periods (%.2f ms), %zu pulses:\n",
+           seconds, bpm, idealMs, period, period * 1000.0 / kJitterSampleRate,
+           listener.stamps.size());
+    report("stamped at the callback:", listener.callbacks, idealMs);
+    double stampJitter = report("timestamps:", listener.stamps, idealMs);
+    report("sent:", listener.sent, idealMs);
+    printf("  %zu pulses sent, %llu dropped (host scheduler, not checked)\n",
+           listener.sent.size(), (unsigned long long) listener.sender.getDropped());
+    bool ok = true;
+    if (listener.stamps.size() + 1 < expected || listener.stamps.size() > expected + 1) {
+        fprintf(stderr, "FAIL: %zu pulses (expected %zu)\n", listener.stamps.size(), expected);
+        ok = false;
+    }
+    if (stampJitter > kMaxStampJitterMs) {
+        fprintf(stderr, "FAIL: timestamp jitter %.3f ms (max. %.3f ms)\n", stampJitter,
+                kMaxStampJitterMs);
+        ok = false;
+    }
+    return ok;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s seconds] [-b bpm] [-p period_frames]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int seconds = 5;
+    float bpm = 120.0f;
+    int period = 480;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:p:")) != -1) {
+        switch (opt) {
+            case 's': seconds = atoi(optarg); break;
+            case 'b': bpm = (float) atof(optarg); break;
+            case 'p': period = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (seconds < 1 || bpm < 20.0f || bpm > 300.0f || period < kJitterBlockFrames) {
+        usage(argv[0]);
+        return 2;
+    }
+    return measure(seconds, bpm, period) ? 0 : 1;
+}
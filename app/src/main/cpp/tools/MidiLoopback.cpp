@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/MidiLoopback.cpp
+ * @brief Round trip of MIDI through a loopback port and the reader thread (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../MidiLoopbackPort.h"
+#include "../MidiReader.h"
+#include "../MidiSpec.h"
+
+/*
+ * Sends MIDI through a MidiLoopbackPort from a writer thread and reads it back with a
+ * MidiReader, as SynthManager does with a device port: channel messages with running
+ * status, realtime bytes, SysEx, and bursts larger than the reader buffer (split over
+ * several reads). Every message must come back in order with the timestamp of the packet
+ * it was sent in (the port time, not the time the reader polled it). Prints the delay of
+ * the reader, which the port timestamps take out of the scheduling.
+ *
+ * usage: midi-loopback [-n packets] [-s seed]
+ *        packets is the number of packets sent (5000 by default).
+ *        Exits with 1 if a message is lost, altered, reordered or wrongly stamped.
+ */
+
+/* @brief Time to wait for the last messages, in milliseconds. */
+static const int kLoopbackTimeoutMs = 5000;
+/* @brief Messages of a burst packet (3 bytes each, over the reader buffer). */
+static const int kLoopbackBurstMessages = 400;
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief A message sent or received. */
+struct LoopbackMessage {
+    /* @brief Status byte, or kMIDISysCmd_SysEx with the payload length in data1. */
+    int status;
+    int data1;
+    int data2;
+    /* @brief Port timestamp (received) or send time bounds (sent), in nanoseconds. */
+    int64_t timeNs;
+    int64_t timeEndNs;
+    /* @brief Time the listener got the message, in nanoseconds (received). */
+    int64_t receivedNs;
+};
+
+/* @brief Collects the messages read by the reader thread. */
+class LoopbackListener : public MidiReaderListener {
+public:
+    void onMidiPortMessage(int64_t timestampNs, uint8_t status, uint8_t data1,
+                           uint8_t data2) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.push_back({ status, data1, data2, timestampNs, 0, nowNs() });
+    }
+    void onMidiPortSysEx(int64_t timestampNs, const uint8_t *, int length) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.push_back({ kMIDISysCmd_SysEx, length, 0, timestampNs, 0, nowNs() });
+    }
+    size_t count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return messages.size();
+    }
+    std::mutex mutex;
+    std::vector<LoopbackMessage> messages;
+};
+
+/* @brief Writes the packets and records what it sent. */
+static void writePackets(MidiLoopbackPort &port, int packets, unsigned seed,
+                         std::vector<LoopbackMessage> &sent) {
+    std::mt19937 random(seed);
+    std::vector<uint8_t> packet;
+    uint8_t running = 0;
+    for (int p = 0; p < packets; p++) {
+        packet.clear();
+        size_t first = sent.size();
+        int kind = (int) (random() % 16);
+        int messages = kind == 0 ? kLoopbackBurstMessages : 1 + (int) (random() % 4);
+        for (int m = 0; m < messages; m++) {
+            if (kind == 1 && m == 0) {
+                // a SysEx ends the running status
+                int length = 1 + (int) (random() % 64);
+                packet.push_back(kMIDISysCmd_SysEx);
+                for (int i = 0; i < length; i++) packet.push_back((uint8_t) (random() % 128));
+                packet.push_back(kMIDISysCmd_EndOfSysEx);
+                sent.push_back({ kMIDISysCmd_SysEx, length, 0, 0, 0, 0 });
+                running = 0;
+                continue;
+            }
+            if (random() % 8 == 0) {
+                packet.push_back(kMIDISysCmd_TimingClock);
+                sent.push_back({ kMIDISysCmd_TimingClock, 0, 0, 0, 0, 0 });
+            }
+            uint8_t status = (uint8_t) (((random() % 2 ? kMIDIChanCmd_NoteOn : kMIDIChanCmd_Control)
+                                         << 4) | (random() % 2));
+            int data1 = (int) (random() % 128), data2 = (int) (random() % 128);
+            if (status != running) packet.push_back(status);
+            running = status;
+            packet.push_back((uint8_t) data1);
+            packet.push_back((uint8_t) data2);
+            sent.push_back({ status, data1, data2, 0, 0, 0 });
+        }
+        int64_t startNs = nowNs();
+        while (!port.send(packet.data(), (int) packet.size(), 0)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            startNs = nowNs();
+        }
+        int64_t endNs = nowNs();
+        for (size_t i = first; i < sent.size(); i++) {
+            sent[i].timeNs = startNs;
+            sent[i].timeEndNs = endNs;
+        }
+        // bursts of packets, then a pause, as a device sends
+        if (random() % 8 == 0) std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n packets] [-s seed]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int packets = 5000;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': packets = atoi(optarg); break;
+            case 's': seed = (unsigned) strtoul(optarg, nullptr, 10); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (packets < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    MidiLoopbackPort port;
+    LoopbackListener listener;
+    MidiReader reader(&listener);
+    if (!reader.start(&port)) {
+        fprintf(stderr, "cannot start the reader\n");
+        return 1;
+    }
+    std::vector<LoopbackMessage> sent;
+    std::thread writer(writePackets, std::ref(port), packets, seed, std::ref(sent));
+    writer.join();
+    int64_t deadline = nowNs() + kLoopbackTimeoutMs * 1000000LL;
+    while (listener.count() < sent.size() && nowNs() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    reader.stop();
+    const std::vector<LoopbackMessage> &received = listener.messages;
+    int errors = 0;
+    std::vector<int64_t> delays;
+    for (size_t i = 0; i < sent.size() && i < received.size(); i++) {
+        const LoopbackMessage &s = sent[i], &r = received[i];
+        if (s.status != r.status || s.data1 != r.data1 || s.data2 != r.data2) {
+            if (errors++ < 10) {
+                printf("message %zu: sent %02x %d %d, received %02x %d %d\n", i, s.status,
+                       s.data1, s.data2, r.status, r.data1, r.data2);
+            }
+            continue;
+        }
+        if (r.timeNs < s.timeNs || r.timeNs > s.timeEndNs) {
+            if (errors++ < 10) {
+                printf("message %zu: stamped %.3f ms after its send\n", i,
+                       (r.timeNs - s.timeNs) / 1e6);
+            }
+            continue;
+        }
+        delays.push_back(r.receivedNs - r.timeNs);
+    }
+    if (received.size() != sent.size()) {
+        printf("sent %zu messages, received %zu\n", sent.size(), received.size());
+        errors++;
+    }
+    if (!delays.empty()) {
+        std::sort(delays.begin(), delays.end());
+        printf("reader delay after the port time: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               delays[delays.size() / 2] / 1e6, delays[delays.size() * 99 / 100] / 1e6,
+               delays.back() / 1e6);
+    }
+    printf("%d packets, %zu messages round trip: %s\n", packets, sent.size(),
+           errors == 0 ? "ok" : "FAILED");
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/MidiMessageQueueStress.cpp
+ * @brief Multi-producer check and cost of the MIDI message queue (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../MidiMessageQueue.h"
+
+/*
+ * Checks the MIDI message queue as the critical native methods use it: several producer
+ * threads post messages while a consumer (the render thread) takes them. Each message
+ * carries its producer and a sequence number; the consumer checks that every message
+ * arrives once and in the order of its producer. The producers post again when the queue
+ * is full, so nothing may be lost, and the queue may never get stuck.
+ *
+ * Prints the cost of a post and of a take without contention, and the cost of a post with
+ * the producers contending.
+ *
+ * usage: midi-message-queue-stress [-p producers] [-n messages]
+ *        producers is the number of producer threads (4 by default).
+ *        messages is the number of messages per producer (1000000 by default).
+ *        Exits with 1 if a message is lost, duplicated or out of order, or if the queue
+ *        gets stuck.
+ */
+
+/* @brief Messages posted and taken to measure the cost without contention. */
+static const int kUncontendedMessages = 1000000;
+/* @brief Longest time without a message before the queue is deemed stuck, in nanoseconds. */
+static const int64_t kStallNs = 1000000000LL;
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-p producers] [-n messages]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int producers = 4;
+    int messages = 1000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:")) != -1) {
+        switch (opt) {
+            case 'p': producers = atoi(optarg); break;
+            case 'n': messages = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (producers < 1 || producers > 16 || messages < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    static MidiMessageQueue queue;
+
+    // without contention: a post, then a take, one thread
+    uint8_t status, data1, data2;
+    int64_t postNs = 0, takeNs = 0;
+    for (int done = 0; done < kUncontendedMessages; done += kMidiMessageQueueSize) {
+        int64_t start = nowNs();
+        for (int i = 0; i < kMidiMessageQueueSize; i++) queue.push(0x80, i & 0x7F, 0);
+        int64_t middle = nowNs();
+        while (queue.pop(status, data1, data2)) {}
+        int64_t end = nowNs();
+        postNs += middle - start;
+        takeNs += end - middle;
+    }
+    int rounds = (kUncontendedMessages + kMidiMessageQueueSize - 1) / kMidiMessageQueueSize;
+    printf("one thread: post %.1f ns, take %.1f ns\n",
+           (double) postNs / rounds / kMidiMessageQueueSize,
+           (double) takeNs / rounds / kMidiMessageQueueSize);
+
+    // with contention: the producers post, the consumer checks the order of each one
+    std::atomic<int> ready(0);
+    std::atomic<int> finished(0);
+    std::atomic<bool> stuck(false);
+    std::vector<int64_t> producerNs(producers, 0);
+    std::vector<uint64_t> fullRetries(producers, 0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            ready.fetch_add(1);
+            while (ready.load() < producers) {}
+            for (int i = 0; i < messages; i++) {
+                // producer in the status, sequence (14 bits) in the data bytes
+                int64_t start = nowNs();
+                bool posted = queue.push(0x80 | p, i & 0x7F, (i >> 7) & 0x7F);
+                producerNs[p] += nowNs() - start;
+                while (!posted && !stuck.load(std::memory_order_relaxed)) {
+                    fullRetries[p]++;
+                    std::this_thread::yield();
+                    posted = queue.push(0x80 | p, i & 0x7F, (i >> 7) & 0x7F);
+                }
+            }
+            finished.fetch_add(1);
+        });
+    }
+    std::vector<int> next(producers, 0);
+    int64_t total = (int64_t) producers * messages;
+    int64_t taken = 0;
+    int errors = 0;
+    int64_t start = nowNs();
+    int64_t lastNs = start;
+    while (true) {
+        // all posted before the last check: an empty queue then means the end
+        bool done = finished.load() == producers;
+        if (!queue.pop(status, data1, data2)) {
+            if (done) break;
+            if (nowNs() - lastNs > kStallNs) {
+                stuck.store(true);
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        lastNs = nowNs();
+        int p = status & 0x0F;
+        int sequence = data1 | (data2 << 7);
+        if (p >= producers || sequence != (next[p] & 0x3FFF)) {
+            if (errors++ < 10) {
+                fprintf(stderr, "FAIL: producer %d sent %d, expected %d\n", p, sequence,
+                        p < producers ? next[p] & 0x3FFF : -1);
+            }
+            if (p < producers) next[p] = sequence;
+        }
+        if (p < producers) next[p]++;
+        taken++;
+    }
+    double seconds = (nowNs() - start) / 1e9;
+    for (std::thread &thread : threads) thread.join();
+    int64_t contendedNs = 0;
+    uint64_t retries = 0;
+    for (int p = 0; p < producers; p++) {
+        contendedNs += producerNs[p];
+        retries += fullRetries[p];
+    }
+    printf("%d producers: %lld messages in %.2f s, post %.1f ns, %llu posts on a full queue\n",
+           producers, (long long) total, seconds, (double) contendedNs / total,
+           (unsigned long long) retries);
+    if (errors > 0 || taken != total) {
+        fprintf(stderr, "FAIL: %d messages out of order, %lld taken of %lld%s\n", errors,
+                (long long) taken, (long long) total, stuck.load() ? ", queue stuck" : "");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/MidiParserBench.cpp
+ * @brief Throughput of the streaming MIDI parser (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../MidiParser.h"
+#include "../MidiSpec.h"
+
+/*
+ * Measures the throughput of the MIDI parser on a stream shaped like the app traffic:
+ * notes and controllers on a few channels (mostly with running status), a timing clock
+ * byte every few messages, interleaved inside the other messages, and a short SysEx now
+ * and then. The stream is parsed in chunks, as the port reader and the BLE decoder
+ * deliver it. Prints MB/s and the cost per decoded message.
+ *
+ * usage: midi-parser-bench [-m megabytes] [-c chunk]
+ *        megabytes is the amount of stream parsed (256 by default).
+ *        chunk is the bytes per parse() call (64 by default, 1 for byte by byte).
+ */
+
+/* @brief Size of the generated stream, in bytes (parsed again until the amount is done). */
+static const int kBenchStreamBytes = 1 << 20;
+
+/* @brief Counts the decoded messages. */
+class BenchListener : public MidiListener {
+public:
+    void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) override {
+        messages++;
+        checksum += status + data1 + data2;
+    }
+    void onMidiSysEx(const uint8_t *, int length) override {
+        messages++;
+        checksum += length;
+    }
+    uint64_t messages = 0;
+    uint64_t checksum = 0;
+};
+
+/* @brief Generate the stream. */
+static std::vector<uint8_t> generate() {
+    std::mt19937 random(1);
+    std::vector<uint8_t> bytes;
+    uint8_t running = 0;
+    while (bytes.size() < kBenchStreamBytes) {
+        int kind = (int) (random() % 16);
+        uint8_t chan = (uint8_t) (random() % 4);
+        uint8_t status;
+        if (kind < 10) {
+            status = (uint8_t) (((random() % 2 ? kMIDIChanCmd_NoteOn : kMIDIChanCmd_NoteOff) << 4) |
+                                chan);
+        } else if (kind < 14) {
+            status = (uint8_t) ((kMIDIChanCmd_Control << 4) | chan);
+        } else if (kind < 15) {
+            status = (uint8_t) ((kMIDIChanCmd_PitchWheel << 4) | chan);
+        } else {
+            bytes.push_back(kMIDISysCmd_SysEx);
+            for (int i = 0; i < 16; i++) bytes.push_back((uint8_t) (random() % 128));
+            bytes.push_back(kMIDISysCmd_EndOfSysEx);
+            running = 0;
+            continue;
+        }
+        if (status != running) bytes.push_back(status);
+        running = status;
+        bytes.push_back((uint8_t) (random() % 128));
+        // a clock byte may land between the data bytes
+        if (random() % 4 == 0) bytes.push_back(kMIDISysCmd_TimingClock);
+        bytes.push_back((uint8_t) (random() % 128));
+    }
+    return bytes;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m megabytes] [-c chunk]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int megabytes = 256;
+    int chunk = 64;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:c:")) != -1) {
+        switch (opt) {
+            case 'm': megabytes = atoi(optarg); break;
+            case 'c': chunk = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (megabytes < 1 || chunk < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> stream = generate();
+    BenchListener listener;
+    MidiParser parser(&listener);
+    int64_t total = (int64_t) megabytes << 20;
+    int64_t parsed = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (parsed < total) {
+        for (size_t offset = 0; offset < stream.size(); offset += chunk) {
+            int length = (int) (stream.size() - offset < (size_t) chunk ? stream.size() - offset
+                                                                          : chunk);
+            parser.parse(stream.data() + offset, length);
+        }
+        parsed += (int64_t) stream.size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+    printf("parsed %.0f MB in %d-byte chunks: %.1f MB/s, %.2f ns per message, "
+           "%.1f M messages/s (checksum %llu)\n", parsed / 1048576.0, chunk,
+           parsed / 1048576.0 / seconds, seconds * 1e9 / listener.messages,
+           listener.messages / seconds / 1e6, (unsigned long long) listener.checksum);
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/MidiParserFuzz.cpp
+ * @brief Randomized check of the streaming MIDI parser (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../MidiParser.h"
+#include "../MidiSpec.h"
+
+/*
+ * Feeds the MIDI parser with random streams split in random chunks (1 byte to a whole
+ * stream) and checks it against what was generated:
+ *   - well-formed streams (channel messages with and without running status, system
+ *     common messages, SysEx up to twice the parser buffer, realtime bytes inserted
+ *     anywhere, also inside other messages and SysEx) must decode to exactly the
+ *     generated messages, oversized SysEx dropped and counted;
+ *   - random bytes must decode the same whatever the chunking, with every data byte
+ *     under 0x80, unused data bytes zero and no SysEx over the buffer.
+ * Built with the address and undefined behaviour sanitizers where the compiler has them.
+ *
+ * usage: midi-parser-fuzz [-n streams] [-s seed]
+ *        streams is the number of streams of each kind (20000 by default).
+ *        Exits with 1 on the first mismatch, printing the seed and the stream.
+ */
+
+/* @brief Largest random stream, in bytes. */
+static const int kFuzzMaxStream = 2048;
+/* @brief Marker of a SysEx in a decoded message list (not a MIDI status). */
+static const int kFuzzSysEx = 0x100;
+
+/* @brief A decoded message: status, data bytes, or a SysEx and its payload. */
+struct FuzzMessage {
+    int status;
+    int data1;
+    int data2;
+    std::vector<uint8_t> payload;
+
+    bool operator==(const FuzzMessage &other) const {
+        return status == other.status && data1 == other.data1 && data2 == other.data2 &&
+               payload == other.payload;
+    }
+};
+
+/* @brief Collects the messages decoded by a parser. */
+class FuzzListener : public MidiListener {
+public:
+    void onMidiMessage(uint8_t status, uint8_t data1, uint8_t data2) override {
+        messages.push_back({ status, data1, data2, {} });
+    }
+    void onMidiSysEx(const uint8_t *data, int length) override {
+        messages.push_back({ kFuzzSysEx, 0, 0, std::vector<uint8_t>(data, data + length) });
+    }
+    std::vector<FuzzMessage> messages;
+};
+
+/* @brief Realtime status bytes. */
+static const uint8_t kFuzzRealtime[] = {
+    kMIDISysCmd_TimingClock, kMIDISysCmd_Start, kMIDISysCmd_Continue, kMIDISysCmd_Stop,
+    kMIDISysCmd_ActiveSensing, kMIDISysCmd_Reset
+};
+
+/* @brief Generator of well-formed streams and the messages they carry. */
+class FuzzStream {
+public:
+    explicit FuzzStream(std::mt19937 &random): random(random), runningStatus(0) {}
+
+    /* @brief Generate a stream of count messages. */
+    void generate(int count) {
+        for (int i = 0; i < count; i++) {
+            int kind = pick(10);
+            if (kind < 6) {
+                channelMessage();
+            } else if (kind < 8) {
+                systemCommon();
+            } else {
+                sysEx();
+            }
+        }
+        // realtime bytes at random positions do not change the other messages
+        int realtime = pick(count + 1);
+        for (int i = 0; i < realtime; i++) {
+            size_t at = (size_t) pick((int) bytes.size() + 1);
+            uint8_t b = kFuzzRealtime[pick(sizeof(kFuzzRealtime))];
+            bytes.insert(bytes.begin() + (long) at, b);
+            // delivered when the byte arrives: before the message it interrupts
+            size_t index = 0;
+            while (index < ends.size() && ends[index] < at) index++;
+            expected.insert(expected.begin() + (long) index, { b, 0, 0, {} });
+            ends.insert(ends.begin() + (long) index, at);
+            for (size_t j = index + 1; j < ends.size(); j++) ends[j]++;
+        }
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<FuzzMessage> expected;
+    uint64_t dropped = 0;
+
+private:
+    int pick(int n) { return (int) (random() % (unsigned) n); }
+
+    void channelMessage() {
+        uint8_t status = (uint8_t) (0x80 | (pick(7) << 4) | pick(16));
+        // running status: the status byte may be left out after the same status
+        if (status != runningStatus || pick(2) == 0) bytes.push_back(status);
+        runningStatus = status;
+        int length = MidiParser::dataLength(status);
+        int data1 = pick(128);
+        int data2 = length > 1 ? pick(128) : 0;
+        bytes.push_back((uint8_t) data1);
+        if (length > 1) bytes.push_back((uint8_t) data2);
+        add({ status, data1, data2, {} });
+    }
+
+    void systemCommon() {
+        static const uint8_t kCommon[] = {
+            kMIDISysCmd_QuarterFrame, kMIDISysCmd_SongPosition, kMIDISysCmd_SongSelect,
+            kMIDISysCmd_TuneRequest
+        };
+        uint8_t status = kCommon[pick(sizeof(kCommon))];
+        int length = MidiParser::dataLength(status);
+        int data1 = length > 0 ? pick(128) : 0;
+        int data2 = length > 1 ? pick(128) : 0;
+        bytes.push_back(status);
+        if (length > 0) bytes.push_back((uint8_t) data1);
+        if (length > 1) bytes.push_back((uint8_t) data2);
+        runningStatus = 0;
+        add({ status, data1, data2, {} });
+    }
+
+    void sysEx() {
+        int length = pick(2 * kMidiParserMaxSysEx + 1);
+        std::vector<uint8_t> payload(length);
+        for (uint8_t &b : payload) b = (uint8_t) pick(128);
+        bytes.push_back(kMIDISysCmd_SysEx);
+        bytes.insert(bytes.end(), payload.begin(), payload.end());
+        bytes.push_back(kMIDISysCmd_EndOfSysEx);
+        runningStatus = 0;
+        if (length > kMidiParserMaxSysEx) {
+            dropped += length;
+            return;
+        }
+        add({ kFuzzSysEx, 0, 0, payload });
+    }
+
+    /* @brief Append an expected message, completed by the last byte so far. */
+    void add(const FuzzMessage &message) {
+        expected.push_back(message);
+        ends.push_back(bytes.size() - 1);
+    }
+
+    std::mt19937 &random;
+    uint8_t runningStatus;
+    /* @brief Byte at which each expected message is complete. */
+    std::vector<size_t> ends;
+};
+
+/* @brief Parse a stream in random chunks. */
+static void parseChunked(const std::vector<uint8_t> &bytes, std::mt19937 &random,
+                         MidiParser &parser) {
+    size_t offset = 0;
+    int maxChunk = 1 + (int) (random() % 64);
+    while (offset < bytes.size()) {
+        size_t chunk = 1 + random() % (unsigned) maxChunk;
+        if (chunk > bytes.size() - offset) chunk = bytes.size() - offset;
+        parser.parse(bytes.data() + offset, (int) chunk);
+        offset += chunk;
+    }
+}
+
+/* @brief Check the invariants of any decoded message. */
+static bool isSane(const FuzzMessage &m) {
+    if (m.status == kFuzzSysEx) {
+        if ((int) m.payload.size() > kMidiParserMaxSysEx) return false;
+        for (uint8_t b : m.payload) if (b >= 0x80) return false;
+        return true;
+    }
+    if (m.status < 0x80 || m.status == kMIDISysCmd_SysEx ||
+        m.status == kMIDISysCmd_EndOfSysEx) return false;
+    if (m.data1 >= 0x80 || m.data2 >= 0x80) return false;
+    int length = m.status >= kMIDISysCmd_TimingClock ? 0 : MidiParser::dataLength(m.status);
+    if (length < 1 && m.data1 != 0) return false;
+    if (length < 2 && m.data2 != 0) return false;
+    return true;
+}
+
+/* @brief Print a stream that failed. */
+static void dump(const char *what, unsigned seed, int index, const std::vector<uint8_t> &bytes) {
+    printf("%s: seed %u, stream %d, %zu bytes:", what, seed, index, bytes.size());
+    for (size_t i = 0; i < bytes.size() && i < 64; i++) printf(" %02x", bytes[i]);
+    printf("%s\n", bytes.size() > 64 ? " ..." : "");
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n streams] [-s seed]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int streams = 20000;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': streams = atoi(optarg); break;
+            case 's': seed = (unsigned) strtoul(optarg, nullptr, 10); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (streams < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::mt19937 random(seed);
+    uint64_t bytesParsed = 0, messages = 0;
+    // well-formed streams decode to the generated messages
+    for (int i = 0; i < streams; i++) {
+        FuzzStream stream(random);
+        stream.generate(1 + (int) (random() % 32));
+        FuzzListener listener;
+        MidiParser parser(&listener);
+        parseChunked(stream.bytes, random, parser);
+        if (!(listener.messages == stream.expected) ||
+            parser.getDroppedBytes() != stream.dropped) {
+            dump("well-formed stream decoded wrong", seed, i, stream.bytes);
+            printf("decoded %zu messages, %llu bytes dropped; expected %zu, %llu\n",
+                   listener.messages.size(), (unsigned long long) parser.getDroppedBytes(),
+                   stream.expected.size(), (unsigned long long) stream.dropped);
+            return 1;
+        }
+        bytesParsed += stream.bytes.size();
+        messages += listener.messages.size();
+    }
+    // random bytes decode the same in one chunk and in random chunks
+    for (int i = 0; i < streams; i++) {
+        std::vector<uint8_t> bytes(1 + random() % kFuzzMaxStream);
+        // mostly data bytes, as real streams are
+        for (uint8_t &b : bytes) b = (uint8_t) (random() % 4 == 0 ? random() : random() % 128);
+        FuzzListener whole, chunked;
+        MidiParser wholeParser(&whole), chunkedParser(&chunked);
+        wholeParser.parse(bytes.data(), (int) bytes.size());
+        parseChunked(bytes, random, chunkedParser);
+        if (!(whole.messages == chunked.messages) ||
+            wholeParser.getDroppedBytes() != chunkedParser.getDroppedBytes()) {
+            dump("chunking changed the decoding", seed, i, bytes);
+            return 1;
+        }
+        for (const FuzzMessage &m : whole.messages) {
+            if (isSane(m)) continue;
+            dump("insane message", seed, i, bytes);
+            printf("status %02x, data %02x %02x, payload %zu bytes\n", m.status, m.data1,
+                   m.data2, m.payload.size());
+            return 1;
+        }
+        bytesParsed += bytes.size();
+        messages += whole.messages.size();
+    }
+    printf("%d well-formed and %d random streams, %llu bytes, %llu messages: ok\n",
+           streams, streams, (unsigned long long) bytesParsed, (unsigned long long) messages);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/OutputBench.cpp
+ * @brief Output stage benchmark per instruction set (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../OutputChain.h"
+#include "../OutputStage.h"
+
+/*
+ * Runs the output stage (gain, limiter, dither) and the 16-bit conversion with the kernels
+ * of each instruction set available on the host, on a test signal that goes well over full
+ * scale. The blocks are split as SynthEngine::render() splits a 441-frame period. Prints
+ * the frames processed per second, checks the peak of the output and compares the output
+ * of each instruction set with the portable C one.
+ *
+ * usage: output-bench [-d seconds] [-n runs]
+ *        seconds is the length of the test signal (60 by default).
+ *        runs is the number of passes of each instruction set; the fastest is kept
+ *        (3 by default).
+ *        Exits with 1 if an output differs or goes over full scale.
+ */
+
+/* @brief Sample rate, in Hz (as the app). */
+static const int kBenchSampleRate = 44100;
+/* @brief Render period, in frames (10 ms, as the app). */
+static const int kBenchPeriod = 441;
+/* @brief Frames rendered per block (a control block, as SynthEngine). */
+static const int kBenchBlockFrames = kControlBlockFrames;
+
+/* @brief Names of the instruction sets, indexed by OutputIsa. */
+static const char *kIsaNames[kOutputIsaCount] = { "scalar", "neon", "sse2", "avx2" };
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Output of an instruction set. */
+struct BenchOutput {
+    /* @brief Processed left channel. */
+    std::vector<float> left;
+    /* @brief Processed right channel. */
+    std::vector<float> right;
+    /* @brief Interleaved 16-bit conversion of the input. */
+    std::vector<int16_t> s16;
+};
+
+/* @brief Run the output stage on the whole signal, returning the time of process(). */
+static int64_t runProcess(int isa, const std::vector<float> &left,
+                          const std::vector<float> &right, BenchOutput &output) {
+    OutputStage stage(kBenchSampleRate);
+    stage.setIsa(isa);
+    output.left = left;
+    output.right = right;
+    int frames = (int) left.size();
+    int64_t start = nowNs();
+    for (int period = 0; period < frames; period += kBenchPeriod) {
+        for (int offset = period; offset < period + kBenchPeriod && offset < frames;
+             offset += kBenchBlockFrames) {
+            int count = period + kBenchPeriod - offset;
+            if (count > kBenchBlockFrames) count = kBenchBlockFrames;
+            if (count > frames - offset) count = frames - offset;
+            stage.process(&output.left[offset], &output.right[offset], count);
+        }
+    }
+    return nowNs() - start;
+}
+
+/* @brief Convert the whole signal to 16 bits, returning the time of convert(). */
+static int64_t runConvert(int isa, const std::vector<float> &left,
+                          const std::vector<float> &right, BenchOutput &output) {
+    OutputStage stage(kBenchSampleRate);
+    stage.setIsa(isa);
+    int frames = (int) left.size();
+    output.s16.resize(2 * frames);
+    int64_t start = nowNs();
+    for (int offset = 0; offset < frames; offset += kBenchBlockFrames) {
+        int count = frames - offset;
+        if (count > kBenchBlockFrames) count = kBenchBlockFrames;
+        stage.convert(&left[offset], &right[offset], &output.s16[2 * offset], count);
+    }
+    return nowNs() - start;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-d seconds] [-n runs]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 60.0;
+    int runs = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+        switch (opt) {
+            case 'd': seconds = atof(optarg); break;
+            case 'n': runs = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (seconds <= 0.0 || runs < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    // chords switching every half second between 12 dB over full scale and quiet,
+    // the conversion input stays within full scale
+    int frames = (int) (seconds * kBenchSampleRate);
+    std::vector<float> left(frames), right(frames), scaledLeft(frames), scaledRight(frames);
+    for (int i = 0; i < frames; i++) {
+        double t = (double) i / kBenchSampleRate;
+        double level = fmod(t, 1.0) < 0.5 ? 4.0 : 0.25;
+        left[i] = (float) (level * (sin(2 * M_PI * 220.0 * t) + sin(2 * M_PI * 277.2 * t)) / 2);
+        right[i] = (float) (level * (sin(2 * M_PI * 329.6 * t) + sin(2 * M_PI * 440.0 * t)) / 2);
+        scaledLeft[i] = left[i] / 4.0f;
+        scaledRight[i] = right[i] / 4.0f;
+    }
+    printf("%d frames, %d runs\n", frames, runs);
+    BenchOutput reference;
+    bool valid = true;
+    for (int isa = 0; isa < kOutputIsaCount; isa++) {
+        if (!OutputStage::isSupported(isa)) {
+            printf("%-7s not available\n", kIsaNames[isa]);
+            continue;
+        }
+        BenchOutput output;
+        int64_t processNs = 0, convertNs = 0;
+        for (int run = 0; run < runs; run++) {
+            int64_t ns = runProcess(isa, left, right, output);
+            if (run == 0 || ns < processNs) processNs = ns;
+            ns = runConvert(isa, scaledLeft, scaledRight, output);
+            if (run == 0 || ns < convertNs) convertNs = ns;
+        }
+        float peak = 0.0f;
+        for (int i = 0; i < frames; i++) {
+            peak = fmaxf(peak, fmaxf(fabsf(output.left[i]), fabsf(output.right[i])));
+        }
+        if (isa == kOutputIsa_Scalar) reference = output;
+        bool exact = output.left == reference.left && output.right == reference.right &&
+                     output.s16 == reference.s16;
+        printf("%-7s process %.1f Mframes/s, convert %.1f Mframes/s, peak %.4f, %s\n",
+               kIsaNames[isa], frames * 1e3 / processNs, frames * 1e3 / convertNs, peak,
+               exact ? "same as scalar" : "DIFFERS from scalar");
+        if (!exact || peak > 1.0f) valid = false;
+    }
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/PatternSequencerBench.cpp
+ * @brief Throughput of the pattern sequencer (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../MidiEventQueue.h"
+#include "../PatternSequencer.h"
+
+/*
+ * Measures the pattern sequencer as SynthManager drives it: each step emits its note on/off
+ * events into the event queue, and the events due before the next step are popped, as the
+ * render thread does. The pattern has the given number of tracks of 16 steps, each step
+ * playing the given number of notes (one step long). Prints the load time of the pattern
+ * in the text and binary formats, steps/s and the cost per event. Exits with 1 if an event
+ * is lost (the queue overflowed) or the two formats load different patterns.
+ *
+ * usage: pattern-sequencer-bench [-s steps] [-t tracks] [-n notes]
+ *        steps is the number of steps played (100000 by default).
+ *        tracks is the number of tracks (16 by default).
+ *        notes is the notes per step of each track (4 by default).
+ */
+
+/* @brief Steps of each track. */
+static const int kBenchTrackSteps = 16;
+/* @brief Audio frames per step (120 BPM, 44.1 kHz, one step per beat). */
+static const double kBenchFramesPerStep = 22050.0;
+/* @brief Times each format is loaded. */
+static const int kBenchLoads = 1000;
+
+/* @brief Append a little-endian 16-bit value. */
+static void put16(std::vector<uint8_t> &data, int value) {
+    data.push_back((uint8_t) (value & 0xFF));
+    data.push_back((uint8_t) (value >> 8));
+}
+
+/* @brief Build the pattern in both formats. */
+static void generate(int tracks, int notes, std::string &text, std::vector<uint8_t> &binary) {
+    binary.assign(kSequencerMagic, kSequencerMagic + 4);
+    binary.push_back((uint8_t) kSequencerVersion);
+    binary.push_back((uint8_t) tracks);
+    for (int t = 0; t < tracks; t++) {
+        text += "track " + std::to_string(kBenchTrackSteps) + "\n";
+        put16(binary, kBenchTrackSteps);
+        put16(binary, kBenchTrackSteps * notes);
+        for (int step = 0; step < kBenchTrackSteps; step++) {
+            for (int n = 0; n < notes; n++) {
+                int note = 36 + (t * 7 + step * 3 + n * 4) % 60;
+                int chan = t % 16;
+                text += std::to_string(step) + " " + std::to_string(note) + " 100 1 " +
+                        std::to_string(chan) + "\n";
+                put16(binary, step);
+                binary.push_back((uint8_t) note);
+                binary.push_back(100);
+                put16(binary, 1);
+                binary.push_back((uint8_t) chan);
+            }
+        }
+    }
+}
+
+/* @brief Time the loads of a pattern, in microseconds per load. */
+static double timeLoad(PatternSequencer &sequencer, const uint8_t *data, int length, bool *ok) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchLoads; i++) *ok = sequencer.load(data, length) && *ok;
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+                                                     start).count() / kBenchLoads;
+}
+
+/* @brief Play a number of steps, return the events popped (and their checksum). */
+static uint64_t play(PatternSequencer &sequencer, long steps, uint64_t *emitted,
+                     uint64_t *checksum) {
+    MidiEventQueue queue;
+    MidiEvent event;
+    uint64_t popped = 0;
+    sequencer.rewind();
+    for (long i = 0; i < steps; i++) {
+        auto frame = (int64_t) (i * kBenchFramesPerStep);
+        *emitted += sequencer.step(frame, kBenchFramesPerStep, queue);
+        // the render thread plays the events of the step, up to the next one
+        while (queue.pop((int64_t) ((i + 1) * kBenchFramesPerStep) + 1, event)) {
+            popped++;
+            *checksum += event.status + event.data1 + event.data2;
+        }
+    }
+    return popped;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s steps] [-t tracks] [-n notes]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    long steps = 100000;
+    int tracks = 16;
+    int notes = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:t:n:")) != -1) {
+        switch (opt) {
+            case 's': steps = atol(optarg); break;
+            case 't': tracks = atoi(optarg); break;
+            case 'n': notes = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (steps < 1 || tracks < 1 || tracks > kSequencerMaxTracks || notes < 1 ||
+            tracks * notes * kBenchTrackSteps > kSequencerMaxNotes) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string text;
+    std::vector<uint8_t> binary;
+    generate(tracks, notes, text, binary);
+    PatternSequencer sequencer;
+    bool ok = true;
+    double textUs = timeLoad(sequencer, (const uint8_t *) text.data(), (int) text.size(), &ok);
+    uint64_t textEmitted = 0, textChecksum = 0;
+    play(sequencer, kBenchTrackSteps, &textEmitted, &textChecksum);
+    double binaryUs = timeLoad(sequencer, binary.data(), (int) binary.size(), &ok);
+    uint64_t binaryEmitted = 0, binaryChecksum = 0;
+    play(sequencer, kBenchTrackSteps, &binaryEmitted, &binaryChecksum);
+    printf("%d tracks x %d steps x %d notes: load %.1f us (text, %zu bytes), "
+           "%.1f us (binary, %zu bytes)\n", tracks, kBenchTrackSteps, notes, textUs,
+           text.size(), binaryUs, binary.size());
+    if (!ok || textChecksum != binaryChecksum) {
+        fprintf(stderr, "FAIL: the text and binary patterns differ\n");
+        return 1;
+    }
+
+    uint64_t emitted = 0, checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t popped = play(sequencer, steps, &emitted, &checksum);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                   start).count();
+    printf("%ld steps in %.3f s: %.2f M steps/s, %llu events, %.1f ns per event "
+           "(checksum %llu)\n", steps, seconds, steps / seconds / 1e6,
+           (unsigned long long) popped, seconds * 1e9 / (double) popped,
+           (unsigned long long) checksum);
+    uint64_t expected = (uint64_t) steps * tracks * notes * 2;
+    if (emitted != expected || popped + (uint64_t) tracks * notes < expected) {
+        fprintf(stderr, "FAIL: %llu events expected, %llu emitted, %llu played\n",
+                (unsigned long long) expected, (unsigned long long) emitted,
+                (unsigned long long) popped);
+        return 1;
+    }
+    return 0;
+}
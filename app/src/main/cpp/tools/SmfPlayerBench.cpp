@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/SmfPlayerBench.cpp
+ * @brief Load time, memory and seek check of the MIDI file player (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../MidiSpec.h"
+#include "../SmfPlayer.h"
+
+/*
+ * Measures the MIDI file player on generated Standard MIDI Files (format 1, 480 ticks per
+ * quarter note): the given number of tracks of notes (an eighth note each) with a
+ * controller every 16 notes, and tempo changes on the first track. Prints the load time
+ * (mapping, tempo map and seek index), the file and index sizes, the seek time and the
+ * playback throughput. Each seek is checked: playing from a random position to the end
+ * must play exactly the notes that start at or after the position.
+ *
+ * A second file holds a single track of notes 0x0FFFFFF ticks apart, about a million
+ * times longer than a song: its index must stay within kSmfMaxIndexPoints points (it grew
+ * with the length before, to gigabytes) and its seeks must be exact too.
+ *
+ * usage: smf-player-bench [-t tracks] [-n notes] [-s seeks]
+ *        tracks is the number of tracks (16 by default).
+ *        notes is the number of notes per track (100000 by default).
+ *        seeks is the number of seeks checked (100 by default).
+ *        Exits with 1 if a check fails.
+ */
+
+/* @brief Ticks per quarter note. */
+static const int kBenchDivision = 480;
+/* @brief Ticks between two notes of the song file (an eighth note). */
+static const uint32_t kBenchNoteTicks = kBenchDivision / 2;
+/* @brief Ticks between two notes of the long file (largest 4-byte delta time). */
+static const uint32_t kBenchLongTicks = 0x0FFFFFFF;
+/* @brief Number of notes of the long file. */
+static const int kBenchLongNotes = 4096;
+/* @brief Times each file is loaded. */
+static const int kBenchLoads = 10;
+/* @brief Audio sample rate, in Hz. */
+static const int kBenchSampleRate = 44100;
+
+/* @brief Counts the note-on messages. */
+class BenchListener : public MidiListener {
+public:
+    void onMidiMessage(uint8_t status, uint8_t, uint8_t data2) override {
+        if ((status >> 4) == kMIDIChanCmd_NoteOn && data2 > 0) notes++;
+        messages++;
+    }
+    void onMidiSysEx(const uint8_t *, int) override {}
+    uint64_t notes = 0;
+    uint64_t messages = 0;
+};
+
+/* @brief Append a variable-length quantity. */
+static void putVarLen(std::vector<uint8_t> &data, uint32_t value) {
+    uint8_t bytes[4];
+    int count = 0;
+    do {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value > 0);
+    while (count > 1) data.push_back(bytes[--count] | 0x80);
+    data.push_back(bytes[0]);
+}
+
+/* @brief Append a big-endian value. */
+static void putBig(std::vector<uint8_t> &data, uint32_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) data.push_back((uint8_t) (value >> (8 * i)));
+}
+
+/* @brief A generated file, with the start tick of every note. */
+struct BenchFile {
+    std::vector<uint8_t> data;
+    std::vector<int64_t> noteTicks;
+};
+
+/* @brief Generate a file of tracks of notes, a given number of ticks apart. */
+static BenchFile generate(int tracks, int notes, uint32_t noteTicks) {
+    BenchFile file;
+    std::vector<uint8_t> &data = file.data;
+    data.insert(data.end(), { 'M', 'T', 'h', 'd' });
+    putBig(data, 6, 4);
+    putBig(data, 1, 2);
+    putBig(data, tracks, 2);
+    putBig(data, kBenchDivision, 2);
+    for (int t = 0; t < tracks; t++) {
+        std::vector<uint8_t> events;
+        uint8_t chan = (uint8_t) (t % 16);
+        int64_t tick = 0;
+        for (int n = 0; n < notes; n++) {
+            if (t == 0 && n % 64 == 0) {
+                // tempo change: 100 to 140 BPM
+                putVarLen(events, 0);
+                events.insert(events.end(), { 0xFF, 0x51, 0x03 });
+                putBig(events, 60000000 / (100 + n / 64 % 5 * 10), 3);
+            }
+            if (n % 16 == 0) {
+                putVarLen(events, 0);
+                events.insert(events.end(), { (uint8_t) ((kMIDIChanCmd_Control << 4) | chan),
+                                              7, (uint8_t) (64 + n / 16 % 64) });
+            }
+            uint8_t note = (uint8_t) (36 + (t * 5 + n) % 60);
+            // note on and off (velocity 0), with running status
+            putVarLen(events, 0);
+            events.insert(events.end(), { (uint8_t) ((kMIDIChanCmd_NoteOn << 4) | chan),
+                                          note, 100 });
+            file.noteTicks.push_back(tick);
+            putVarLen(events, noteTicks);
+            events.insert(events.end(), { note, 0 });
+            tick += noteTicks;
+        }
+        putVarLen(events, 0);
+        events.insert(events.end(), { 0xFF, 0x2F, 0x00 });
+        data.insert(data.end(), { 'M', 'T', 'r', 'k' });
+        putBig(data, (uint32_t) events.size(), 4);
+        data.insert(data.end(), events.begin(), events.end());
+    }
+    std::sort(file.noteTicks.begin(), file.noteTicks.end());
+    return file;
+}
+
+/* @brief Play from the current position to the end, as fast as possible. */
+static void playToEnd(SmfPlayer &player) {
+    player.setBpm(1e12);
+    player.play();
+    while (player.isPlaying()) player.process(kBenchSampleRate);
+}
+
+/* @brief Load, seek and play a file; print the measures and return true if the checks pass. */
+static bool run(const char *name, const BenchFile &file, int seeks) {
+    char path[] = "/tmp/smf-player-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, file.data.data(), file.data.size()) != (ssize_t) file.data.size()) {
+        fprintf(stderr, "FAIL: cannot write %s\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    close(fd);
+    BenchListener listener;
+    SmfPlayer player(&listener, kBenchSampleRate);
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchLoads; i++) ok = player.load(path) && ok;
+    double loadMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / kBenchLoads;
+    if (!ok) {
+        fprintf(stderr, "FAIL: cannot load the %s file\n", name);
+        unlink(path);
+        return false;
+    }
+    printf("%s: %d tracks, %zu notes, %lld ticks, %.1f MB\n", name, player.getTrackCount(),
+           file.noteTicks.size(), (long long) player.getLength(), file.data.size() / 1e6);
+    printf("  load %.2f ms, index %zu bytes\n", loadMs, player.getIndexBytes());
+
+    // the whole file
+    start = std::chrono::steady_clock::now();
+    playToEnd(player);
+    double playSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                       start).count();
+    printf("  play %.1f M messages/s\n", listener.messages / playSeconds / 1e6);
+    if (listener.notes != file.noteTicks.size()) {
+        fprintf(stderr, "FAIL: %llu notes played, %zu in the file\n",
+                (unsigned long long) listener.notes, file.noteTicks.size());
+        ok = false;
+    }
+
+    // random seeks, each checked by playing the rest of the file
+    std::mt19937_64 random(1);
+    double seekUs = 0.0;
+    int wrongSeeks = 0;
+    for (int i = 0; i < seeks; i++) {
+        int64_t tick = (int64_t) (random() % (uint64_t) player.getLength());
+        start = std::chrono::steady_clock::now();
+        player.seek(tick);
+        seekUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() -
+                                                            start).count();
+        listener.notes = 0;
+        playToEnd(player);
+        auto first = std::lower_bound(file.noteTicks.begin(), file.noteTicks.end(), tick);
+        if (listener.notes != (uint64_t) (file.noteTicks.end() - first)) wrongSeeks++;
+    }
+    printf("  seek %.1f us, %d of %d seeks played the wrong notes\n", seekUs / seeks,
+           wrongSeeks, seeks);
+    unlink(path);
+    return ok && wrongSeeks == 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-t tracks] [-n notes] [-s seeks]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int tracks = 16;
+    int notes = 100000;
+    int seeks = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:s:")) != -1) {
+        switch (opt) {
+            case 't': tracks = atoi(optarg); break;
+            case 'n': notes = atoi(optarg); break;
+            case 's': seeks = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (tracks < 1 || tracks > kSmfMaxTracks || notes < 1 || seeks < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    bool ok = run("song file", generate(tracks, notes, kBenchNoteTicks), seeks);
+    ok = run("long file", generate(1, kBenchLongNotes, kBenchLongTicks), seeks) && ok;
+    if (!ok) fprintf(stderr, "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/SmootherRamp.cpp
+ * @brief Click check of the smoothed parameter ramps (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../GlitchDetector.h"
+#include "../OutputChain.h"
+#include "../SmootherBank.h"
+
+/*
+ * Runs the smoother bank of SynthEngine offline (441-frame periods split in control blocks,
+ * levels rounded to MIDI values and sent when they change) and renders what the synth
+ * makes of the values sent: a 440 Hz tone through the channel
+ * volume (CC 7, 40 log10(value / 127) dB as the default modulator of the synth) and the
+ * reverb send, both interpolated over each block as the synth does, and the filter cutoff
+ * in cents. A ramp is click-free if no block moves a gain by more than kRampMaxGainStep or
+ * the cutoff by more than kRampMaxCentsStep, and the glitch detector reports nothing on
+ * the rendered tone. Each case also runs without smoothing, which must break the limits
+ * (the check can fail).
+ *
+ * usage: smoother-ramp
+ *        Exits with 1 if a smoothed ramp clicks or an unsmoothed one does not.
+ */
+
+/* @brief Sample rate, in Hz (as the app). */
+static const int kRampSampleRate = 44100;
+/* @brief Render period, in frames (10 ms, as the app). */
+static const int kRampPeriod = 441;
+/* @brief Frames rendered per block (a control block, as SynthEngine). */
+static const int kRampBlockFrames = kControlBlockFrames;
+/* @brief Controller of the volume cases (channel volume, CC 7). */
+static const int kRampController = 7;
+/* @brief Ramp time of the app (paramRampMs), in milliseconds. */
+static const int kRampAppMs = 800;
+/* @brief Largest gain change in a block, linear (about -26 dB of full scale). */
+static const float kRampMaxGainStep = 0.05f;
+/* @brief Largest filter cutoff change in a block, in cents. */
+static const float kRampMaxCentsStep = 50.0f;
+
+/* @brief Kind of a smoothed parameter. */
+enum RampParam {
+    /* @brief Channel volume (CC 7), 0-127. */
+    kRampParam_Volume,
+    /* @brief Reverb send level, 0-127. */
+    kRampParam_Reverb,
+    /* @brief Filter cutoff offset, in cents. */
+    kRampParam_Cutoff
+};
+
+/* @brief A test case: a start value, a target, and a second target in the middle. */
+struct RampCase {
+    /* @brief Name of the case. */
+    const char *name;
+    /* @brief Parameter (RampParam). */
+    int param;
+    /* @brief Ramp time, in milliseconds. */
+    int rampMs;
+    /* @brief Start value. */
+    float from;
+    /* @brief First target. */
+    float to;
+    /* @brief Time of the second target, in seconds (0 for none). */
+    double retargetAt;
+    /* @brief Second target. */
+    float retarget;
+};
+
+/* @brief The cases: the ranges of the app and full-scale moves. */
+static const RampCase kRampCases[] = {
+    { "volume up (app)",         kRampParam_Volume, kRampAppMs,  90.0f, 127.0f, 0.0, 0.0f },
+    { "volume down (app)",       kRampParam_Volume, kRampAppMs, 127.0f,  90.0f, 0.0, 0.0f },
+    { "volume full fade in",     kRampParam_Volume, 200,          0.0f, 127.0f, 0.0, 0.0f },
+    { "volume full fade out",    kRampParam_Volume, 200,        127.0f,   0.0f, 0.0, 0.0f },
+    { "volume retarget",         kRampParam_Volume, kRampAppMs,  90.0f, 127.0f, 0.4, 60.0f },
+    { "reverb up (app)",         kRampParam_Reverb, kRampAppMs,   0.0f,  80.0f, 0.0, 0.0f },
+    { "reverb retarget",         kRampParam_Reverb, kRampAppMs,  80.0f,   0.0f, 0.3, 127.0f },
+    { "cutoff open (app)",       kRampParam_Cutoff, kRampAppMs, -2400.0f, 0.0f, 0.0, 0.0f },
+    { "cutoff retarget",         kRampParam_Cutoff, kRampAppMs, 0.0f, -2400.0f, 0.5, 0.0f },
+};
+
+/* @brief Result of a run. */
+struct RampResult {
+    /* @brief Largest change of the parameter in a block (gain, or cents). */
+    float maxStep;
+    /* @brief Glitches reported by the detector on the rendered tone. */
+    int64_t glitches;
+};
+
+/* @brief Gain of the synth for a sent value of a parameter. */
+static float gainOf(int param, float value) {
+    switch (param) {
+        case kRampParam_Volume: return (value / 127.0f) * (value / 127.0f);
+        case kRampParam_Reverb: return value / 127.0f;
+        default: return 1.0f;
+    }
+}
+
+/* @brief The synth as the smoothers see it: the last value sent. */
+class RampSynth: public SmootherListener {
+public:
+    explicit RampSynth(float sent): sent(sent) {}
+
+    void onSmoothedParam(int, int, int, float value) override { sent = value; }
+
+    float getSent() const { return sent; }
+
+private:
+    float sent;
+};
+
+/* @brief Run a case through the smoother bank (rampMs 0 jumps, as without smoothing). */
+static RampResult runCase(const RampCase &c, int rampMs) {
+    static const int kSmoothedParams[] = {
+        kSmoothedParam_CC, kSmoothedParam_Reverb, kSmoothedParam_FilterCutoff
+    };
+    int param = kSmoothedParams[c.param];
+    // the bank rounds the MIDI levels and sends the cutoff past its resolution
+    RampSynth synth(c.param == kRampParam_Cutoff ? c.from : roundf(c.from));
+    SmootherBank smoothers(&synth, kRampSampleRate);
+    // the first target is the start value, the second one ramps
+    smoothers.setTarget(param, 0, kRampController, c.from, rampMs);
+    smoothers.setTarget(param, 0, kRampController, c.to, rampMs);
+    GlitchDetector detector(kRampSampleRate);
+    int frames = (int) ((c.retargetAt + 2.0 * c.rampMs / 1000.0 + 0.2) * kRampSampleRate);
+    int retargetFrame = c.retargetAt > 0.0 ? (int) (c.retargetAt * kRampSampleRate) : -1;
+    float sent = synth.getSent();
+    float gain = gainOf(c.param, sent);
+    float left[kRampBlockFrames];
+    float right[kRampBlockFrames];
+    RampResult result = { 0.0f, 0 };
+    double phase = 0.0;
+    int64_t timeNs = 0;
+    for (int period = 0; period < frames; period += kRampPeriod) {
+        timeNs += (int64_t) kRampPeriod * 1000000000 / kRampSampleRate;
+        detector.callback(period, timeNs, kRampPeriod);
+        for (int offset = 0; offset < kRampPeriod; offset += kRampBlockFrames) {
+            int count = kRampPeriod - offset;
+            if (count > kRampBlockFrames) count = kRampBlockFrames;
+            int64_t frame = period + offset;
+            if (retargetFrame >= 0 && frame >= retargetFrame) {
+                smoothers.setTarget(param, 0, kRampController, c.retarget, rampMs);
+                retargetFrame = -1;
+            }
+            smoothers.process(count);
+            float previous = sent;
+            sent = synth.getSent();
+            // the synth moves the gain linearly over the block
+            float newGain = gainOf(c.param, sent);
+            float step = c.param == kRampParam_Cutoff ? fabsf(sent - previous)
+                                                      : fabsf(newGain - gain);
+            if (step > result.maxStep) result.maxStep = step;
+            for (int i = 0; i < count; i++) {
+                float g = gain + (newGain - gain) * (i + 1) / count;
+                float tone = (float) (0.5 * sin(phase));
+                phase += 2 * M_PI * 440.0 / kRampSampleRate;
+                left[i] = g * tone;
+                right[i] = g * tone;
+            }
+            gain = newGain;
+            detector.process(frame, left, right, count);
+        }
+    }
+    for (int type = 0; type < kGlitchTypeCount; type++) result.glitches += detector.getCount(type);
+    return result;
+}
+
+int main() {
+    bool ok = true;
+    for (const RampCase &c : kRampCases) {
+        float limit = c.param == kRampParam_Cutoff ? kRampMaxCentsStep : kRampMaxGainStep;
+        RampResult smoothed = runCase(c, c.rampMs);
+        RampResult jump = runCase(c, 0);
+        bool clean = smoothed.maxStep <= limit && smoothed.glitches == 0;
+        bool detected = jump.maxStep > limit;
+        printf("%-22s %4d ms: max step %8.4f (limit %.2f), %lld glitches; unsmoothed %8.4f %s\n",
+               c.name, c.rampMs, smoothed.maxStep, limit, (long long) smoothed.glitches,
+               jump.maxStep, clean && detected ? "ok" : "FAILED");
+        if (!clean || !detected) ok = false;
+    }
+    printf("smoothed ramps click-free: %s\n", ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
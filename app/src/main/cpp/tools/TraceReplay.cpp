@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/TraceReplay.cpp
+ * @brief Heart-rate trace replay harness (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <fluidsynth.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../AudioCapture.h"
+#include "../BeatTracker.h"
+#include "../FileHeartRateSource.h"
+#include "../HeartRateFilter.h"
+#include "../MidiSpec.h"
+#include "../SynthEngine.h"
+
+/*
+ * Replays a recorded heart-rate trace ("time bpm [accuracy]" per line) through the native
+ * pipeline: filtering, beat tracking, scheduling, and the offline render of SynthEngine (the
+ * render core of the app: synth, output stages and session recorder). The beats play the same
+ * two-note pattern as the app. Prints per-stage timings and events/s.
+ *
+ * usage: trace-replay [-s soundfont.sf2] [-x speed] [-r sampleRate] [-o out.raw]
+ *                     [-m out.mid] [-e out.opus] [-b bitrate] trace.txt
+ *        speed 1 replays in real time, 0 (default) as fast as possible.
+ *        out.raw receives the rendered audio (interleaved stereo float).
+ *        out.mid receives the played events (session recorder of the engine).
+ *        out.opus receives the rendered audio (Ogg/Opus, bitrate in bit/s, 24000 default),
+ *        encoded by the capture thread as in the app.
+ */
+
+/* @brief Default sample rate, in Hz. */
+static const int kReplaySampleRate = 48000;
+/* @brief Gain of the synth (as the app). */
+static const float kReplayGain = 1.0f;
+/* @brief Notes played on the beats (as the app song: C, G). */
+static const int kReplayNotes[] = { 60, 67 };
+
+/* @brief Pipeline stages. */
+enum ReplayStage {
+    kReplayStage_Filter = 0,
+    kReplayStage_Beat,
+    kReplayStage_Schedule,
+    kReplayStage_Render,
+    kReplayStageCount
+};
+
+/* @brief Names of the pipeline stages. */
+static const char *kReplayStageNames[kReplayStageCount] = {
+    "filter", "beat", "schedule", "render"
+};
+
+/* @brief Time and events of a pipeline stage. */
+struct StageStats {
+    /* @brief Time spent, in nanoseconds. */
+    int64_t timeNs = 0;
+    /* @brief Number of events processed. */
+    uint64_t events = 0;
+};
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------------------------
+
+/* @brief The native pipeline, driven by the samples of the trace (replay thread). */
+class ReplayPipeline: public HeartRateListener, public SynthEngineListener {
+public:
+    ReplayPipeline(int sampleRate, FILE *output):
+        engine(this, sampleRate, kReplayGain, kQualityTier_High), sampleRate(sampleRate),
+        output(output), capture(nullptr), firstNs(-1), renderFrame(0), noteIndex(0),
+        peak(0.0f), sumSquares(0.0) {}
+
+    /* @brief The engine rendering the beats (to open before the replay). */
+    SynthEngine* getEngine() { return &engine; }
+
+    /* @brief Capture the rendered audio. */
+    void setCapture(AudioCapture *audioCapture) { capture = audioCapture; }
+
+    void onHeartRateSample(int64_t timeNs, float bpm, int accuracy) override {
+        if (firstNs < 0) firstNs = timeNs;
+        double time = (timeNs - firstNs) * 1e-9;
+        // filtering
+        int64_t start = nowNs();
+        bool accepted = filter.process(time, bpm, accuracy);
+        int64_t end = nowNs();
+        account(kReplayStage_Filter, start, end, 1);
+        // beat tracking: each beat due before the sample is scheduled at its own time,
+        // then the new tempo applies from the sample on
+        start = end;
+        int beats = 0;
+        double beatTimes[kMidiEventQueueSize / 4];
+        for (double next = tracker.getNextBeatTime(); next <= time;
+                next = tracker.getNextBeatTime()) {
+            if (tracker.advance(next + 1e-9) > 0 && beats < kMidiEventQueueSize / 4) {
+                beatTimes[beats++] = next;
+            }
+        }
+        tracker.advance(time);
+        if (accepted) tracker.update(time, filter.getValue());
+        end = nowNs();
+        account(kReplayStage_Beat, start, end, 1);
+        // scheduling
+        start = end;
+        for (int i = 0; i < beats; i++) schedule(beatTimes[i]);
+        end = nowNs();
+        account(kReplayStage_Schedule, start, end, beats * 2);
+        // synth and offline render up to the sample
+        start = end;
+        int64_t frames = render((int64_t) (time * sampleRate));
+        account(kReplayStage_Render, start, nowNs(), frames);
+    }
+
+    // the traces hold rates only
+    void onHeartBeat(int64_t, float) override {}
+
+    void onEngineBlock(int64_t, int) override {}
+
+    void onEngineMidiOut(int64_t, uint8_t, uint8_t, uint8_t) override {}
+
+    void onEngineOutput(int64_t, const float *left, const float *right, int frames) override {
+        float interleaved[kControlBlockFrames * 2];
+        for (int i = 0; i < frames; i++) {
+            float l = fabsf(left[i]), r = fabsf(right[i]);
+            if (l > peak) peak = l;
+            if (r > peak) peak = r;
+            sumSquares += (double) left[i] * left[i] + (double) right[i] * right[i];
+            interleaved[2 * i] = left[i];
+            interleaved[2 * i + 1] = right[i];
+        }
+        if (output) fwrite(interleaved, sizeof(float), frames * 2, output);
+        // offline: wait for the encoder instead of dropping audio
+        while (capture && !capture->write(left, right, frames)) usleep(1000);
+    }
+
+    /* @brief Render the events left in the queue. */
+    void finish() {
+        int64_t start = nowNs();
+        int64_t frames = render(renderFrame + sampleRate);
+        account(kReplayStage_Render, start, nowNs(), frames);
+    }
+
+    void print(int64_t wallNs) const {
+        printf("%-10s %12s %12s %14s\n", "stage", "time (ms)", "events", "events/s");
+        int64_t totalNs = 0;
+        for (int i = 0; i < kReplayStageCount; i++) {
+            const StageStats &s = stages[i];
+            totalNs += s.timeNs;
+            printf("%-10s %12.3f %12llu %14.0f\n", kReplayStageNames[i], s.timeNs / 1e6,
+                   (unsigned long long) s.events,
+                   s.timeNs > 0 ? s.events * 1e9 / s.timeNs : 0.0);
+        }
+        double audioSeconds = (double) renderFrame / sampleRate;
+        printf("pipeline   %12.3f ms, wall %.3f ms\n", totalNs / 1e6, wallNs / 1e6);
+        printf("samples %llu, rejected %llu, beats %llu, final %.2f BPM\n",
+               (unsigned long long) stages[kReplayStage_Filter].events,
+               (unsigned long long) filter.getRejectedCount(),
+               (unsigned long long) tracker.getBeatCount(), filter.getValue());
+        printf("audio %.3f s, %.1fx real time, peak %.6f, rms %.6f\n", audioSeconds,
+               totalNs > 0 ? audioSeconds * 1e9 / totalNs : 0.0, peak,
+               renderFrame > 0 ? sqrt(sumSquares / (2.0 * renderFrame)) : 0.0);
+    }
+
+private:
+    void account(int stage, int64_t start, int64_t end, int64_t events) {
+        stages[stage].timeNs += end - start;
+        stages[stage].events += events;
+    }
+
+    void schedule(double beatTime) {
+        int64_t frame = (int64_t) (beatTime * sampleRate);
+        int note = kReplayNotes[noteIndex];
+        noteIndex = (noteIndex + 1) % (int) (sizeof(kReplayNotes) / sizeof(kReplayNotes[0]));
+        int64_t length = (int64_t) (tracker.getPeriod() * sampleRate / 2);
+        engine.scheduleMidi(frame, (kMIDIChanCmd_NoteOn << 4) | 1, note, 100);
+        engine.scheduleMidi(frame + length, (kMIDIChanCmd_NoteOff << 4) | 1, note, 0);
+    }
+
+    int64_t render(int64_t endFrame) {
+        int64_t frames = 0;
+        float left[kControlBlockFrames];
+        float right[kControlBlockFrames];
+        float *out[] = { left, right };
+        while (renderFrame + kControlBlockFrames <= endFrame) {
+            // the synth mixes into the buffers, as the driver clears them
+            memset(left, 0, sizeof(left));
+            memset(right, 0, sizeof(right));
+            engine.render(kControlBlockFrames, 0, nullptr, 2, out,
+                          renderFrame * 1000000000 / sampleRate);
+            renderFrame += kControlBlockFrames;
+            frames += kControlBlockFrames;
+        }
+        return frames;
+    }
+
+private:
+    SynthEngine engine;
+    int sampleRate;
+    FILE *output;
+    AudioCapture *capture;
+    HeartRateFilter filter;
+    BeatTracker tracker;
+    int64_t firstNs;
+    int64_t renderFrame;
+    int noteIndex;
+    float peak;
+    double sumSquares;
+    StageStats stages[kReplayStageCount];
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s soundfont.sf2] [-x speed] [-r sampleRate] [-o out.raw] "
+                    "[-m out.mid] [-e out.opus] [-b bitrate] trace.txt\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *soundfont = nullptr;
+    const char *outputPath = nullptr;
+    const char *midiPath = nullptr;
+    const char *opusPath = nullptr;
+    int bitrate = kAudioCaptureBitrate;
+    double speed = 0.0;
+    int sampleRate = kReplaySampleRate;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:x:r:o:m:e:b:")) != -1) {
+        switch (opt) {
+            case 's': soundfont = optarg; break;
+            case 'x': speed = atof(optarg); break;
+            case 'r': sampleRate = atoi(optarg); break;
+            case 'o': outputPath = optarg; break;
+            case 'm': midiPath = optarg; break;
+            case 'e': opusPath = optarg; break;
+            case 'b': bitrate = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || speed < 0.0 || sampleRate <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    FILE *output = outputPath ? fopen(outputPath, "wb") : nullptr;
+    // the capture and recorder rings are too large for the stack
+    static AudioCapture capture;
+    static ReplayPipeline pipeline(sampleRate, output);
+    // synth without audio driver: the pipeline renders offline
+    fluid_settings_t *settings = new_fluid_settings();
+    SynthEngine *engine = pipeline.getEngine();
+    if (!engine->open(settings)) {
+        fprintf(stderr, "cannot create the synth\n");
+        delete_fluid_settings(settings);
+        if (output) fclose(output);
+        return 1;
+    }
+    if (soundfont && !engine->loadSF(soundfont)) fprintf(stderr, "cannot load %s\n", soundfont);
+    if (midiPath && !engine->startRecording(midiPath, 0)) {
+        fprintf(stderr, "cannot create %s\n", midiPath);
+    }
+    if (opusPath && !capture.start(opusPath, sampleRate, bitrate)) {
+        fprintf(stderr, "cannot create %s\n", opusPath);
+    }
+    if (capture.isCapturing()) pipeline.setCapture(&capture);
+    int result = 0;
+    FileHeartRateSource source(argv[optind], speed);
+    int64_t start = nowNs();
+    if (source.start(&pipeline)) {
+        source.join();
+        pipeline.finish();
+        engine->stopRecording();
+        capture.stop();
+        pipeline.print(nowNs() - start);
+        printf("wakeups %llu, recorder drops %llu\n", (unsigned long long) source.getWakeups(),
+               (unsigned long long) engine->getRecordingDropped());
+        if (opusPath) {
+            double audioNs = capture.getEncodedFrames() * 1e9 / sampleRate;
+            printf("encoder cpu %.3f ms (%.2f%% of audio time), %lld bytes, %.1f kbit/s\n",
+                   capture.getEncoderCpuNs() / 1e6,
+                   audioNs > 0 ? capture.getEncoderCpuNs() * 100.0 / audioNs : 0.0,
+                   (long long) capture.getBytesWritten(),
+                   audioNs > 0 ? capture.getBytesWritten() * 8e6 / audioNs : 0.0);
+        }
+    } else {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        result = 1;
+    }
+    engine->close();
+    delete_fluid_settings(settings);
+    if (output) fclose(output);
+    return result;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2024 Robson Martins
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// -----------------------------------------------------------------------------------------------
+/**
+ * @file cpp/tools/VoiceBench.cpp
+ * @brief Voice cost benchmark: procedural heartbeat voices vs. FluidSynth (Linux CLI).
+ *
+ * @author Robson Martins (https://www.robsonmartins.com)
+ */
+// -----------------------------------------------------------------------------------------------
+
+#include <fluidsynth.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../SynthEngine.h"
+
+/*
+ * Renders the same beats through SynthEngine, the render core of the app, on a soundfont
+ * channel (FluidSynth voices) and on the heartbeat channel (procedural heartbeat voices), and
+ * compares the render time per sounding voice. Every beat starts a chord of voices; the cost
+ * is the render time divided by the voice-frames actually sounding, so voices of different
+ * lengths compare fairly. The time of the engine without voices (a run without notes) is
+ * taken off both.
+ *
+ * usage: voice-bench -s soundfont.sf2 [-p program] [-n note] [-v voices] [-d seconds]
+ *        program is the soundfont program of the FluidSynth voices (0 by default).
+ *        note is the lowest note of each beat (36 by default).
+ *        voices is the number of notes per beat (4 by default, up to kHeartbeatVoices).
+ *        seconds is the length rendered by each engine (30 by default).
+ *        Prints the time per voice-frame and the voices rendered in real time by one core.
+ */
+
+/* @brief Sample rate, in Hz (as the app). */
+static const int kBenchSampleRate = 44100;
+/* @brief Gain (as the app). */
+static const float kBenchGain = 1.0f;
+/* @brief Frames rendered per block (a control block of the engine). */
+static const int kBenchBlockFrames = kControlBlockFrames;
+/* @brief Channel of the beats. */
+static const int kBenchChannel = 0;
+/* @brief Interval between two beats, in seconds (100 BPM). */
+static const double kBenchBeat = 0.6;
+/* @brief Length of the notes, in seconds. */
+static const double kBenchNoteLength = 0.3;
+
+/* @brief Read the steady clock, in nanoseconds. */
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* @brief Render time and sounding voices of a benchmark. */
+struct BenchResult {
+    /* @brief Render time, in nanoseconds. */
+    int64_t renderNs;
+    /* @brief Rendered frames. */
+    int64_t frames;
+    /* @brief Sum of the sounding voices of each frame. */
+    int64_t voiceFrames;
+};
+
+/* @brief Call a beat renderer for each block, timing it and counting the sounding voices.
+ * @param render Renders a block (left, right, frames, beat note on, beat note off) and
+ *        returns the sounding voices. */
+template <typename Render>
+static BenchResult runBench(double seconds, Render render) {
+    BenchResult result = {};
+    float left[kBenchBlockFrames];
+    float right[kBenchBlockFrames];
+    int64_t beatFrames = (int64_t) (kBenchBeat * kBenchSampleRate);
+    int64_t noteFrames = (int64_t) (kBenchNoteLength * kBenchSampleRate);
+    int64_t end = (int64_t) (seconds * kBenchSampleRate);
+    for (int64_t frame = 0; frame < end; frame += kBenchBlockFrames) {
+        int64_t position = frame % beatFrames;
+        bool noteOn = position < kBenchBlockFrames;
+        bool noteOff = position >= noteFrames && position - noteFrames < kBenchBlockFrames;
+        memset(left, 0, sizeof(left));
+        memset(right, 0, sizeof(right));
+        int64_t start = nowNs();
+        int voices = render(left, right, kBenchBlockFrames, noteOn, noteOff);
+        result.renderNs += nowNs() - start;
+        result.frames += kBenchBlockFrames;
+        result.voiceFrames += (int64_t) voices * kBenchBlockFrames;
+    }
+    return result;
+}
+
+/* @brief The engine playing the beats on a channel. */
+class BenchEngine: public SynthEngineListener {
+public:
+    /* @brief The notes play heartbeat voices if heartbeat, none if voices is 0. */
+    BenchEngine(int note, int voices, bool heartbeat):
+        engine(this, kBenchSampleRate, kBenchGain, kQualityTier_High), note(note),
+        voices(voices), heartbeat(heartbeat), frame(0), noteOn(false), noteOff(false) {
+        settings = new_fluid_settings();
+    }
+
+    ~BenchEngine() {
+        engine.close();
+        delete_fluid_settings(settings);
+    }
+
+    bool open(const char *soundfont, int program) {
+        if (!engine.open(settings, 1) || !engine.loadSF(soundfont)) return false;
+        // voices only: the heartbeat voices have no effects either, and no voice is stolen
+        engine.reverb(0);
+        engine.chorus(0);
+        engine.setVoiceBudget(false);
+        engine.programChange(kBenchChannel, program);
+        if (heartbeat) engine.setHeartbeatChannel(kBenchChannel);
+        engine.setHeart((float) (60.0 / kBenchBeat), 40.0f);
+        return true;
+    }
+
+    /* @brief Render a block, returning the sounding voices. */
+    int render(float *left, float *right, int frames, bool beatOn, bool beatOff) {
+        noteOn = beatOn;
+        noteOff = beatOff;
+        float *out[] = { left, right };
+        engine.render(frames, 0, nullptr, 2, out, frame * 1000000000 / kBenchSampleRate);
+        frame += frames;
+        if (heartbeat) return engine.getOutputChain()->getHeartbeat()->getActiveVoices();
+        return fluid_synth_get_active_voice_count(engine.getSynth());
+    }
+
+    void onEngineBlock(int64_t, int) override {
+        for (int i = 0; i < voices; i++) {
+            if (noteOff) engine.noteOff(kBenchChannel, note + i);
+            if (noteOn) engine.noteOn(kBenchChannel, note + i, 100);
+        }
+    }
+
+    void onEngineMidiOut(int64_t, uint8_t, uint8_t, uint8_t) override {}
+
+    void onEngineOutput(int64_t, const float*, const float*, int) override {}
+
+private:
+    fluid_settings_t *settings;
+    SynthEngine engine;
+    int note;
+    int voices;
+    bool heartbeat;
+    int64_t frame;
+    bool noteOn;
+    bool noteOff;
+};
+
+/* @brief Run the beats on an engine (heap: the engine rings are too large for the stack). */
+static bool runEngine(const char *soundfont, int program, int note, int voices, bool heartbeat,
+                      double seconds, BenchResult &result) {
+    auto *bench = new BenchEngine(note, voices, heartbeat);
+    bool valid = bench->open(soundfont, program);
+    if (valid) {
+        result = runBench(seconds, [&](float *left, float *right, int frames, bool noteOn,
+                                       bool noteOff) {
+            return bench->render(left, right, frames, noteOn, noteOff);
+        });
+    }
+    delete bench;
+    return valid;
+}
+
+/* @brief Print a benchmark result.
+ * @return The time per voice-frame, in ns (0 if no voice sounded). */
+static double printResult(const char *name, const BenchResult &result) {
+    if (result.voiceFrames == 0) {
+        printf("%-10s no voice sounded\n", name);
+        return 0.0;
+    }
+    double nsPerVoiceFrame = (double) result.renderNs / result.voiceFrames;
+    // sounding voices that one core renders in real time (1 ms of audio per ms)
+    double voicesPerMs = 1e6 / (nsPerVoiceFrame * kBenchSampleRate / 1000.0);
+    printf("%-10s render %.3f ms, %.2f voices on average, %.3f ns per voice-frame, "
+           "%.0f voices per ms\n", name, result.renderNs / 1e6,
+           (double) result.voiceFrames / result.frames, nsPerVoiceFrame, voicesPerMs);
+    return nsPerVoiceFrame;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s -s soundfont.sf2 [-p program] [-n note] [-v voices] "
+                    "[-d seconds]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *soundfont = nullptr;
+    int program = 0;
+    int note = 36;
+    int voices = 4;
+    double seconds = 30.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:n:v:d:")) != -1) {
+        switch (opt) {
+            case 's': soundfont = optarg; break;
+            case 'p': program = atoi(optarg); break;
+            case 'n': note = atoi(optarg); break;
+            case 'v': voices = atoi(optarg); break;
+            case 'd': seconds = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (soundfont == nullptr || voices < 1 || voices > kHeartbeatVoices || seconds <= 0.0) {
+        usage(argv[0]);
+        return 2;
+    }
+    printf("%d voices per beat, note %d, %.0f BPM, %.1f s per engine\n", voices, note,
+           60.0 / kBenchBeat, seconds);
+    BenchResult idle, fluid, heartbeat;
+    if (!runEngine(soundfont, program, note, 0, false, seconds, idle) ||
+            !runEngine(soundfont, program, note, voices, false, seconds, fluid) ||
+            !runEngine(soundfont, program, note, voices, true, seconds, heartbeat)) {
+        fprintf(stderr, "cannot load %s\n", soundfont);
+        return 1;
+    }
+    printf("%-10s render %.3f ms (taken off the voices)\n", "idle", idle.renderNs / 1e6);
+    fluid.renderNs = std::max<int64_t>(0, fluid.renderNs - idle.renderNs);
+    heartbeat.renderNs = std::max<int64_t>(0, heartbeat.renderNs - idle.renderNs);
+    double fluidNs = printResult("fluidsynth", fluid);
+    double heartbeatNs = printResult("heartbeat", heartbeat);
+    if (fluidNs > 0.0 && heartbeatNs > 0.0) {
+        printf("heartbeat voice cost: 1/%.1f of a soundfont voice\n", fluidNs / heartbeatNs);
+    }
+    return 0;
+}
@@ -32,11 +32,17 @@ package com.robsonmartins.androidmidisynth
 
 import android.content.Context
 import android.content.Context.MODE_PRIVATE
+import android.media.midi.MidiDevice
+import dalvik.annotation.optimization.CriticalNative
 import java.io.IOException
 
 /**
  * @brief SynthManager class.
  * @details The SynthManager encapsulates a FluidSynth synthesizer.
+ *          noteOn(), noteOff(), cc() and programChange() are posted to the render thread and
+ *          played in order on the next audio block. The fluidsynth*() calls act at once: a
+ *          fluidsynth*() call made after a posted one may reach the synth first, so a
+ *          sequence of channel calls should go through the same path.
  * @param context The context object.
  */
 class SynthManager(private val context: Context) {
@@ -44,11 +50,20 @@ class SynthManager(private val context: Context) {
     /* @brief Soundfont file path. */
     private var soundFontPath: String? = null
 
+    /* @brief Native engine handle, passed to the critical native methods (0 when freed). */
+    private var handle: Long = 0
+
     /** @brief Initialize the instance. */
-    init { fluidsynthInit() }
+    init {
+        fluidsynthInit()
+        handle = fluidsynthHandle()
+    }
 
     /** @brief Finalize the instance. */
-    fun finalize()  { fluidsynthFree() }
+    fun finalize()  {
+        handle = 0
+        fluidsynthFree()
+    }
 
     /**
      * @brief Load a soundfont file.
@@ -66,12 +81,100 @@ class SynthManager(private val context: Context) {
         }
     }
 
+    /**
+     * @brief Load a sequencer pattern.
+     * @param filename The pattern filename (asset, binary or text format).
+     */
+    fun loadPattern(filename: String) {
+        val data = context.assets.open(filename).use { it.readBytes() }
+        if (!fluidsynthSequencerLoad(data)) {
+            throw RuntimeException("Error loading $filename")
+        }
+    }
+
+    /**
+     * @brief Load a Standard MIDI File into the tempo-following player.
+     * @param filename The MIDI filename (asset).
+     */
+    fun loadMidiFile(filename: String) {
+        try {
+            if (!fluidsynthSmfLoad(copyAssetToTmpFile(filename))) {
+                throw IOException("Error loading $filename")
+            }
+        } catch (e: IOException) {
+            throw RuntimeException(e)
+        }
+    }
+
     /**
      * @brief Set synth volume.
      * @param volume The volume level.
      */
     fun setVolume(channel : Int,    volume: Int) {
-        fluidsynthCC(0,7, volume)
+        cc(0, 7, volume)
+    }
+
+    /**
+     * @brief Play a note on the next audio block (critical native call).
+     * @param channel The channel.
+     * @param note The note to be played.
+     * @param velocity The velocity of the note.
+     */
+    fun noteOn(channel: Int, note: Int, velocity: Int) {
+        nativeNoteOn(handle, channel, note, velocity)
+    }
+
+    /**
+     * @brief Stop a note on the next audio block (critical native call).
+     * @param channel The channel.
+     * @param note The note to be stopped.
+     */
+    fun noteOff(channel: Int, note: Int) {
+        nativeNoteOff(handle, channel, note)
+    }
+
+    /**
+     * @brief Send a control change on the next audio block (critical native call).
+     * @param channel The channel.
+     * @param controller Number of the controller.
+     * @param value Value to send.
+     */
+    fun cc(channel: Int, controller: Int, value: Int) {
+        nativeCC(handle, channel, controller, value)
+    }
+
+    /**
+     * @brief Change the program on the next audio block (critical native call).
+     * @param channel The channel.
+     * @param program The program.
+     */
+    fun programChange(channel: Int, program: Int) {
+        nativeProgramChange(handle, channel, program)
+    }
+
+    /**
+     * @brief Measure the cost of a native call, regular and critical.
+     * @details Sends note offs of an unused note, so the synth does almost nothing. The
+     *          critical calls are posted to the render thread: they are made in batches that
+     *          fit in its queue, and it empties the queue between them (not timed).
+     * @param calls Number of calls of each kind.
+     * @return The cost of a regular and of a critical call, in nanoseconds.
+     */
+    fun measureCallCost(calls: Int): DoubleArray {
+        val start = System.nanoTime()
+        for (i in 0 until calls) fluidsynthNoteOff(15, 0)
+        val regular = (System.nanoTime() - start).toDouble() / calls
+        var elapsed = 0L
+        var done = 0
+        while (done < calls) {
+            val batch = minOf(calls - done, criticalCallBatch)
+            val batchStart = System.nanoTime()
+            for (i in 0 until batch) nativeNoteOff(handle, 15, 0)
+            elapsed += System.nanoTime() - batchStart
+            done += batch
+            Thread.sleep(criticalCallDrainMs)
+        }
+        return doubleArrayOf(regular, elapsed.toDouble() / calls)
     }
 
     @Throws(IOException::class)
@@ -112,10 +215,10 @@ class SynthManager(private val context: Context) {
      */
     private external fun fluidsynthFree()
     /*
-     * @brief   Import of the native implementation of SynthManager.fluidsynthNoteOn() method.
-     * @details Plays the note.
-     * @param   note      The note to be played.
-     * @param   velocity  The velocity of the note to be played.
+     * @brief   Import of the native implementation of SynthManager.fluidsynthProgramChange() method.
+     * @details Changes the program at once, ahead of the posted calls not yet played.
+     * @param   channel   The channel.
+     * @param   program   The program.
      */
     external fun fluidsynthProgramChange(channel: Int, program: Int)
     /*
@@ -135,4 +238,453 @@ class SynthManager(private val context: Context) {
      * @param   level The reverb level (0 to 127).
      */
     private external fun fluidsynthReverb(level: Int)
-}
\ No newline at end of file
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthChorus() method.
+     * @details Sets the chorus level.
+     * @param   level The chorus level (0 to 127).
+     */
+    external fun fluidsynthChorus(level: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthPitchBend() method.
+     * @details Sets the pitch bend of a channel.
+     * @param   value The pitch bend value (0 to 16383).
+     */
+    external fun fluidsynthPitchBend(channel: Int, value: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmoothCC() method.
+     * @details Ramps a controller of a channel to a new value in the render loop.
+     * @param   value  Target value (0 to 127).
+     * @param   rampMs Ramp duration, in milliseconds.
+     * @return  0 if successful, -1 if there is no free smoother.
+     */
+    external fun fluidsynthSmoothCC(channel: Int, controller: Int, value: Float, rampMs: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmoothReverb() method.
+     * @details Ramps the reverb level to a new value in the render loop.
+     * @param   level  Target reverb level (0 to 127).
+     * @param   rampMs Ramp duration, in milliseconds.
+     * @return  0 if successful, -1 if there is no free smoother.
+     */
+    external fun fluidsynthSmoothReverb(level: Float, rampMs: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmoothFilterCutoff() method.
+     * @details Ramps the filter cutoff offset of a channel to a new value in the render loop.
+     * @param   cents  Target cutoff offset, in cents.
+     * @param   rampMs Ramp duration, in milliseconds.
+     * @return  0 if successful, -1 if there is no free smoother.
+     */
+    external fun fluidsynthSmoothFilterCutoff(channel: Int, cents: Float, rampMs: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSendMidi() method.
+     * @details Plays a raw MIDI byte stream (may be split at any byte between calls).
+     * @param   data   MIDI bytes.
+     * @param   offset Offset of the first byte.
+     * @param   length Number of bytes.
+     */
+    external fun fluidsynthSendMidi(data: ByteArray, offset: Int, length: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthOpenMidiDevice() method.
+     * @details Connects a MIDI device to the synth: its MIDI is played natively and the notes
+     *          played by the app are sent to it.
+     * @param   device     The opened MIDI device.
+     * @param   inputPort  Device input port to send MIDI to, or -1 for none.
+     * @param   outputPort Device output port to receive MIDI from, or -1 for none.
+     * @return  0 if successful, -1 otherwise.
+     */
+    external fun fluidsynthOpenMidiDevice(device: MidiDevice, inputPort: Int, outputPort: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthCloseMidiDevice() method.
+     * @details Disconnects the MIDI device from the synth.
+     */
+    external fun fluidsynthCloseMidiDevice()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthMidiOut() method.
+     * @details Sends a MIDI message to the MIDI outputs only (not played by the synth).
+     */
+    external fun fluidsynthMidiOut(status: Int, data1: Int, data2: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiConfigure() method.
+     * @details Enables (packetSize > 0) or disables the BLE-MIDI encoder of the MIDI output.
+     * @param   packetSize Maximum packet size, in bytes (ATT MTU - 3).
+     * @param   maxDelayMs Maximum time a message waits for other messages, in milliseconds.
+     */
+    external fun fluidsynthBleMidiConfigure(packetSize: Int, maxDelayMs: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiFlush() method.
+     * @details Completes the pending BLE-MIDI packet (e.g. at the end of a beat).
+     */
+    external fun fluidsynthBleMidiFlush()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiPoll() method.
+     * @details Gets the next completed BLE-MIDI packet, ready for a single GATT write.
+     * @return  The packet length, or 0 if there is no packet.
+     */
+    external fun fluidsynthBleMidiPoll(packet: ByteArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiListen() method.
+     * @details Queues the MIDI output messages for a BLE library that encodes them itself.
+     * @param   enabled True to queue the messages, false to stop and clear the queue.
+     */
+    external fun fluidsynthBleMidiListen(enabled: Boolean)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiMessages() method.
+     * @details Waits for the MIDI output messages queued for the BLE library. They are released
+     *          when they are due, so they can be sent at once.
+     * @param   messages Receives the messages (status | data1 << 8 | data2 << 16).
+     * @param   timeoutMs Longest wait, in milliseconds.
+     * @return  The number of messages (0 on timeout).
+     */
+    external fun fluidsynthBleMidiMessages(messages: IntArray, timeoutMs: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiReceive() method.
+     * @details Plays a received BLE-MIDI packet with the sender timing (behind an adaptive jitter
+     *          buffer).
+     * @param   packet The packet (value of a characteristic write or notification).
+     * @param   length Packet length, in bytes.
+     * @return  0 if successful, -1 if the packet is invalid.
+     */
+    external fun fluidsynthBleMidiReceive(packet: ByteArray, length: Int): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBleMidiReset() method.
+     * @details Forgets the clock offset and the delivery delays of the BLE-MIDI input (e.g. when
+     *          another central connects).
+     */
+    external fun fluidsynthBleMidiReset()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthMidiClockTempo() method.
+     * @details Sets the tempo followed by the 24 PPQN MIDI clock.
+     * @param   bpm     Tempo, in BPM.
+     * @param   maxSlew Maximum tempo change, in BPM per second (0 follows at once).
+     */
+    external fun fluidsynthMidiClockTempo(bpm: Float, maxSlew: Float)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthMidiClockStart() method.
+     * @details Starts the MIDI clock (Start, or Song Position Pointer and Continue).
+     * @param   songPosition Position to start from, in MIDI beats (sixteenth notes).
+     */
+    external fun fluidsynthMidiClockStart(songPosition: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthMidiClockStop() method.
+     * @details Stops the MIDI clock.
+     */
+    external fun fluidsynthMidiClockStop()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBeatTrackerUpdate() method.
+     * @details Feeds a heart-rate sample to the phase-locked beat tracker.
+     * @param   bpm Heart rate, in BPM.
+     */
+    external fun fluidsynthBeatTrackerUpdate(bpm: Float)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartRateSample() method.
+     * @details Feeds a raw heart-rate sensor sample to the native signal pipeline (accuracy
+     *          gating, outlier rejection, smoothing), which also updates the beat tracker.
+     * @param   bpm Raw heart rate, in BPM.
+     * @param   accuracy Sensor accuracy (SensorManager.SENSOR_STATUS_*).
+     * @return  The filtered heart rate, in BPM, or 0 if the sample was gated out.
+     */
+    external fun fluidsynthHeartRateSample(bpm: Float, accuracy: Int): Float
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartBeat() method.
+     * @details Feeds a beat of the heart-beat sensor to the heart-rate variability analysis.
+     * @param   timeNs Time of the beat (System.nanoTime()), in nanoseconds.
+     * @param   confidence Confidence of the detection (0 to 1).
+     */
+    external fun fluidsynthHeartBeat(timeNs: Long, confidence: Float)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartRateSensorStart() method.
+     * @details Starts reading the heart-rate sensor natively, with FIFO batching; the samples
+     *          feed the native signal pipeline without waking the JVM.
+     * @param   packageName Package name of the application.
+     * @param   batchLatencyMs Maximum report latency of the sensor, in milliseconds.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthHeartRateSensorStart(packageName: String, batchLatencyMs: Int): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartRateSensorStop() method.
+     * @details Stops reading the heart-rate sensor natively.
+     */
+    external fun fluidsynthHeartRateSensorStop()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartRateSensorWakeups() method.
+     * @details Gets the wakeups of the native sensor reader.
+     * @return  Wakeups per minute, or 0 if the native reader is not running.
+     */
+    external fun fluidsynthHeartRateSensorWakeups(): Float
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartRateValue() method.
+     * @details Gets the last filtered heart rate.
+     * @return  Heart rate, in BPM, or 0 if no sample was accepted yet.
+     */
+    external fun fluidsynthHeartRateValue(): Float
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGetHrv() method.
+     * @details Copies the heart-rate variability metrics: RMSSD (ms), SDNN (ms), pNN50 (%).
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthGetHrv(metrics: FloatArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHrvRoute() method.
+     * @details Routes a heart-rate variability metric (0 RMSSD, 1 SDNN, 2 pNN50, -1 clears
+     *          the slot) to a controller, mapping [minValue, maxValue] to 0-127.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthHrvRoute(slot: Int, metric: Int, chan: Int, controller: Int,
+                                    minValue: Float, maxValue: Float): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBeatTrackerAdvance() method.
+     * @details Advances the beat tracker to now.
+     * @return  The number of beats since the previous call.
+     */
+    external fun fluidsynthBeatTrackerAdvance(): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthBeatTrackerNextBeat() method.
+     * @details Gets the time of the next beat.
+     * @return  Time of the next beat, in the SystemClock.uptimeMillis() base.
+     */
+    external fun fluidsynthBeatTrackerNextBeat(): Long
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSequencerLoad() method.
+     * @details Loads a pattern into the sequencer (binary or text format).
+     * @return  True if successful, false otherwise.
+     */
+    private external fun fluidsynthSequencerLoad(data: ByteArray): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSequencerStart() method.
+     * @details Starts the pattern sequencer from the first step, playing on the beat tracker.
+     * @param   stepsPerBeat Number of steps played on each beat.
+     */
+    external fun fluidsynthSequencerStart(stepsPerBeat: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSequencerStop() method.
+     * @details Stops the pattern sequencer.
+     */
+    external fun fluidsynthSequencerStop()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSequencerVelocity() method.
+     * @details Sets the factor applied to the velocities of the pattern.
+     */
+    external fun fluidsynthSequencerVelocity(scale: Float)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmfLoad() method.
+     * @details Loads a Standard MIDI File (memory-mapped) into the tempo-following player.
+     * @param   path The MIDI file full path.
+     * @return  True if successful, false otherwise.
+     */
+    private external fun fluidsynthSmfLoad(path: String): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmfPlay() method.
+     * @details Starts (or resumes) playing the MIDI file, one quarter note per heart beat.
+     * @param   loop True to restart at the end of the file.
+     */
+    external fun fluidsynthSmfPlay(loop: Boolean)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmfStop() method.
+     * @details Stops playing the MIDI file.
+     */
+    external fun fluidsynthSmfStop()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmfSeek() method.
+     * @details Moves the playback position of the MIDI file.
+     * @param   tick Position, in ticks.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthSmfSeek(tick: Long): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthSmfInfo() method.
+     * @details Copies load time (us), seek index memory (bytes), tracks, length (ticks) and
+     *          position (ticks) of the MIDI file.
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthSmfInfo(info: LongArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthRecordStart() method.
+     * @details Starts recording the messages played by the synth to a Standard MIDI File.
+     * @param   path The MIDI file full path (overwritten).
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthRecordStart(path: String): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthRecordStop() method.
+     * @details Stops recording and closes the MIDI file.
+     * @return  The number of messages lost by the recorder.
+     */
+    external fun fluidsynthRecordStop(): Long
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthAudioCaptureStart() method.
+     * @details Starts capturing the rendered audio to an Ogg/Opus file (encoded in background).
+     * @param   path The Ogg/Opus file full path (overwritten).
+     * @param   bitrate Bitrate, in bits per second.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthAudioCaptureStart(path: String, bitrate: Int): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthAudioCaptureStop() method.
+     * @details Stops capturing the rendered audio and closes the file.
+     */
+    external fun fluidsynthAudioCaptureStop()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthAudioCaptureStats() method.
+     * @details Copies encoder CPU time (us), encoded audio (ms), bytes written and dropped blocks.
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthAudioCaptureStats(stats: LongArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthTraceStart() method.
+     * @details Starts tracing the calls made to the synth, for offline replay (api-replay).
+     * @param   path The trace file full path (overwritten).
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthTraceStart(path: String): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthTraceStop() method.
+     * @details Stops tracing and closes the trace file.
+     * @return  The number of calls lost by the trace.
+     */
+    external fun fluidsynthTraceStop(): Long
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHeartbeatChannel() method.
+     * @details Plays a channel with the procedural heartbeat voices instead of the soundfont.
+     * @param   chan Channel number, or -1 to play every channel with the soundfont.
+     */
+    external fun fluidsynthHeartbeatChannel(chan: Int)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthOutputGain() method.
+     * @details Sets the gain of the output stage (ramped, peaks limited below full scale).
+     * @param   gain Linear gain.
+     */
+    external fun fluidsynthOutputGain(gain: Float)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthOutputDither() method.
+     * @details Enables the dither and 16-bit conversion of the output stage.
+     * @param   enabled True to convert the output to 16 bits, false to keep floats.
+     */
+    external fun fluidsynthOutputDither(enabled: Boolean)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthLimiterGain() method.
+     * @details Gets the lowest gain of the output limiter since the last call.
+     * @return  Linear gain (1 if the limiter did not act).
+     */
+    external fun fluidsynthLimiterGain(): Float
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthLevels() method.
+     * @details Copies the levels of the output: block peak and RMS (dBFS), momentary,
+     *          short-term and integrated loudness (LUFS), peak since the reset (dBFS) and
+     *          time metered since the reset (seconds).
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthLevels(levels: FloatArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthLevelsReset() method.
+     * @details Restarts the integrated levels (loudness and peak) of the output.
+     */
+    external fun fluidsynthLevelsReset()
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGlitchDetection() method.
+     * @details Enables the glitch detector of the output (enabled by default).
+     */
+    external fun fluidsynthGlitchDetection(enabled: Boolean)
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGlitchCounts() method.
+     * @details Copies the number of glitches per type since the start: discontinuities,
+     *          clipping, dropouts, late callbacks (underruns), then the events not logged.
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthGlitchCounts(counts: LongArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGlitchEvents() method.
+     * @details Takes the glitches logged since the last call, oldest first: time at which the
+     *          glitch is heard (steady clock, nanoseconds), type (0 discontinuity, 1 clipping,
+     *          2 dropout, 3 late callback) and magnitude.
+     * @return  The number of events copied.
+     */
+    external fun fluidsynthGlitchEvents(times: LongArray, types: IntArray, values: FloatArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthQualityTier() method.
+     * @details Sets the quality tier of the synth (0 eco, 1 balanced, 2 high): interpolation,
+     *          polyphony, reverb and chorus, applied live. In automatic mode the tier is a
+     *          ceiling, and the synth steps down while the render load is too high.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthQualityTier(tier: Int, automatic: Boolean): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGetQualityTier() method.
+     * @details Gets the quality tier in use (0 eco, 1 balanced, 2 high).
+     * @return  The tier.
+     */
+    external fun fluidsynthGetQualityTier(): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthRenderLoad() method.
+     * @details Gets the render time over the period time, measured over the last half second.
+     * @return  The load (1 takes the whole period).
+     */
+    external fun fluidsynthRenderLoad(): Float
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthVoicePriority() method.
+     * @details Sets the voice priority of a channel (0 low, 1 normal, 2 protected) and its
+     *          voice budget (0 for no limit). The voices of a protected channel are never taken.
+     * @return  True if successful, false otherwise.
+     */
+    external fun fluidsynthVoicePriority(chan: Int, priority: Int, budget: Int): Boolean
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthVoiceStats() method.
+     * @details Copies the voices playing, the voices faded out early and the voices taken for
+     *          the budgets since the start.
+     * @return  The number of values copied.
+     */
+    external fun fluidsynthVoiceStats(stats: LongArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthHandle() method.
+     * @details Gets the engine handle passed to the critical native methods.
+     * @return  The handle.
+     */
+    private external fun fluidsynthHandle(): Long
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGetChannelState() method.
+     * @details Copies program, bank, pitch bend and the 128 controller values of a channel
+     *          (-1 for values never sent).
+     * @return  The number of values copied, or -1 on error.
+     */
+    external fun fluidsynthGetChannelState(channel: Int, state: IntArray): Int
+    /*
+     * @brief   Import of the native implementation of SynthManager.fluidsynthGetStats() method.
+     * @details Copies the statistics counters: forwarded calls, elided calls, BLE-MIDI packets,
+     *          BLE-MIDI bytes.
+     */
+    external fun fluidsynthGetStats(stats: LongArray)
+
+    companion object {
+        /* @brief Critical calls made by measureCallCost() between two waits (half the native
+         *        queue, kMidiMessageQueueSize). */
+        private const val criticalCallBatch = 512
+        /* @brief Wait of measureCallCost() for the render thread to empty the queue, in ms. */
+        private const val criticalCallDrainMs = 20L
+        /*
+         * @brief   Import of the critical native implementation of SynthManager.nativeNoteOn().
+         * @details Posts the note to the render thread, without JNIEnv (registered in
+         *          JNI_OnLoad). Lock-free: played on the next block.
+         */
+        @JvmStatic @CriticalNative
+        private external fun nativeNoteOn(handle: Long, channel: Int, note: Int, velocity: Int)
+        /*
+         * @brief   Import of the critical native implementation of SynthManager.nativeNoteOff().
+         * @details Posts the note off to the render thread, without JNIEnv (registered in
+         *          JNI_OnLoad). Lock-free: played on the next block.
+         */
+        @JvmStatic @CriticalNative
+        private external fun nativeNoteOff(handle: Long, channel: Int, note: Int)
+        /*
+         * @brief   Import of the critical native implementation of SynthManager.nativeCC().
+         * @details Posts the control change to the render thread, without JNIEnv (registered
+         *          in JNI_OnLoad). Lock-free: played on the next block.
+         */
+        @JvmStatic @CriticalNative
+        private external fun nativeCC(handle: Long, channel: Int, controller: Int, value: Int)
+        /*
+         * @brief   Import of the critical native implementation of SynthManager.nativeProgramChange().
+         * @details Posts the program change to the render thread, without JNIEnv (registered
+         *          in JNI_OnLoad). Lock-free: played on the next block.
+         */
+        @JvmStatic @CriticalNative
+        private external fun nativeProgramChange(handle: Long, channel: Int, program: Int)
+    }
+}
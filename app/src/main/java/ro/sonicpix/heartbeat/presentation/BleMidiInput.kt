@@ -0,0 +1,86 @@
+package ro.sonicpix.heartbeat.presentation
+
+import com.robsonmartins.androidmidisynth.SynthManager
+import jp.kshoji.blemidi.device.MidiInputDevice
+import jp.kshoji.blemidi.listener.OnMidiInputEventListener
+
+// Plays the messages of a BLE-MIDI central on the synth, through the native MIDI parser.
+// The BLE library decodes the packets (and their timestamps) itself and has no raw packet
+// callback, so its events are turned back into MIDI bytes
+class BleMidiInput(private val synthManager: SynthManager) : OnMidiInputEventListener {
+    private val message = ByteArray(3)
+
+    private fun send(status: Int, data1: Int, data2: Int, length: Int) {
+        synchronized(message) {
+            message[0] = status.toByte()
+            message[1] = (data1 and 0x7F).toByte()
+            message[2] = (data2 and 0x7F).toByte()
+            synthManager.fluidsynthSendMidi(message, 0, length)
+        }
+    }
+
+    private fun controlChange(channel: Int, controller: Int, value: Int) {
+        send(0xB0 or channel, controller, value, 3)
+    }
+
+    override fun onMidiSystemExclusive(sender: MidiInputDevice, systemExclusive: ByteArray) {
+        synthManager.fluidsynthSendMidi(systemExclusive, 0, systemExclusive.size)
+    }
+
+    override fun onMidiNoteOff(sender: MidiInputDevice, channel: Int, note: Int, velocity: Int) {
+        send(0x80 or channel, note, velocity, 3)
+    }
+
+    override fun onMidiNoteOn(sender: MidiInputDevice, channel: Int, note: Int, velocity: Int) {
+        send(0x90 or channel, note, velocity, 3)
+    }
+
+    override fun onMidiPolyphonicAftertouch(sender: MidiInputDevice, channel: Int, note: Int,
+                                            pressure: Int) {
+        send(0xA0 or channel, note, pressure, 3)
+    }
+
+    override fun onMidiControlChange(sender: MidiInputDevice, channel: Int, function: Int,
+                                     value: Int) {
+        controlChange(channel, function, value)
+    }
+
+    override fun onMidiProgramChange(sender: MidiInputDevice, channel: Int, program: Int) {
+        send(0xC0 or channel, program, 0, 2)
+    }
+
+    override fun onMidiChannelAftertouch(sender: MidiInputDevice, channel: Int, pressure: Int) {
+        send(0xD0 or channel, pressure, 0, 2)
+    }
+
+    override fun onMidiPitchWheel(sender: MidiInputDevice, channel: Int, amount: Int) {
+        send(0xE0 or channel, amount, amount shr 7, 3)
+    }
+
+    // the same controllers again: the values are absolute, repeating them changes nothing
+    override fun onRPNMessage(sender: MidiInputDevice, channel: Int, function: Int, value: Int) {
+        controlChange(channel, 101, function shr 7)
+        controlChange(channel, 100, function)
+        controlChange(channel, 6, value shr 7)
+        controlChange(channel, 38, value)
+    }
+
+    override fun onNRPNMessage(sender: MidiInputDevice, channel: Int, function: Int, value: Int) {
+        controlChange(channel, 99, function shr 7)
+        controlChange(channel, 98, function)
+        controlChange(channel, 6, value shr 7)
+        controlChange(channel, 38, value)
+    }
+
+    // system common and realtime messages do not change what the synth plays
+    override fun onMidiTimeCodeQuarterFrame(sender: MidiInputDevice, timing: Int) {}
+    override fun onMidiSongSelect(sender: MidiInputDevice, song: Int) {}
+    override fun onMidiSongPositionPointer(sender: MidiInputDevice, position: Int) {}
+    override fun onMidiTuneRequest(sender: MidiInputDevice) {}
+    override fun onMidiTimingClock(sender: MidiInputDevice) {}
+    override fun onMidiStart(sender: MidiInputDevice) {}
+    override fun onMidiContinue(sender: MidiInputDevice) {}
+    override fun onMidiStop(sender: MidiInputDevice) {}
+    override fun onMidiActiveSensing(sender: MidiInputDevice) {}
+    override fun onMidiReset(sender: MidiInputDevice) {}
+}
@@ -0,0 +1,128 @@
+package ro.sonicpix.heartbeat.presentation
+
+import android.os.Handler
+import android.os.HandlerThread
+import android.util.Log
+import com.robsonmartins.androidmidisynth.SynthManager
+import java.lang.reflect.Method
+import jp.kshoji.blemidi.device.MidiOutputDevice
+
+// Largest BLE-MIDI packet polled from the native encoder, in bytes
+const val bleMidiMaxPacket = 514
+
+// Longest wait for the MIDI output messages sent through the BLE library, in milliseconds
+const val bleMidiWaitMs = 50
+
+// Sends the native MIDI output to the connected BLE-MIDI central, from its own thread
+class BleMidiOutput(private val synthManager: SynthManager) {
+    private val thread = HandlerThread("BleMidiOutput").apply { start() }
+    private val handler = Handler(thread.looper)
+    private var device: MidiOutputDevice? = null
+    @Volatile private var transferData: Method? = null
+    private val packet = ByteArray(bleMidiMaxPacket)
+    private val messages = IntArray(256)
+
+    private val poll = object : Runnable {
+        override fun run() {
+            drain()
+            handler.postDelayed(this, bleMidiMaxDelayMs.toLong())
+        }
+    }
+
+    // the native sender releases the messages when they are due: send them at once
+    private val listen = object : Runnable {
+        override fun run() {
+            val count = synthManager.fluidsynthBleMidiMessages(messages, bleMidiWaitMs)
+            val output = device ?: return
+            for (i in 0 until count) send(output, messages[i])
+            handler.post(this)
+        }
+    }
+
+    fun attach(device: MidiOutputDevice) {
+        handler.post {
+            handler.removeCallbacks(poll)
+            handler.removeCallbacks(listen)
+            this.device = device
+            transferData = if (nativeBleMidiOutput) findTransferData(device) else null
+            if (transferData != null) {
+                synthManager.fluidsynthBleMidiConfigure(bleMidiPacketSize, bleMidiMaxDelayMs)
+                handler.post(poll)
+            } else {
+                synthManager.fluidsynthBleMidiListen(true)
+                handler.post(listen)
+            }
+            Log.d(debugTag, "BLE-MIDI output: " +
+                    if (transferData != null) "native packets" else "library messages")
+        }
+    }
+
+    fun detach() {
+        // wakes up a wait for messages, so the detach below runs soon
+        synthManager.fluidsynthBleMidiListen(false)
+        handler.post {
+            handler.removeCallbacks(poll)
+            handler.removeCallbacks(listen)
+            if (transferData != null) synthManager.fluidsynthBleMidiConfigure(0, 0)
+            synthManager.fluidsynthBleMidiListen(false)
+            transferData = null
+            device = null
+        }
+    }
+
+    fun terminate() {
+        detach()
+        thread.quitSafely()
+        thread.join()
+    }
+
+    // the MIDI output of the synth: the clock and the notes of the sequencer
+    private fun send(output: MidiOutputDevice, message: Int) {
+        val status = message and 0xFF
+        val data1 = (message shr 8) and 0x7F
+        val data2 = (message shr 16) and 0x7F
+        val channel = status and 0x0F
+        when (status and 0xF0) {
+            0x80 -> output.sendMidiNoteOff(channel, data1, data2)
+            0x90 -> output.sendMidiNoteOn(channel, data1, data2)
+            0xA0 -> output.sendMidiPolyphonicAftertouch(channel, data1, data2)
+            0xB0 -> output.sendMidiControlChange(channel, data1, data2)
+            0xC0 -> output.sendMidiProgramChange(channel, data1)
+            0xD0 -> output.sendMidiChannelAftertouch(channel, data1)
+            0xE0 -> output.sendMidiPitchWheel(channel, data1 or (data2 shl 7))
+            0xF0 -> when (status) {
+                0xF8 -> output.sendMidiTimingClock()
+                0xFA -> output.sendMidiStart()
+                0xFB -> output.sendMidiContinue()
+                0xFC -> output.sendMidiStop()
+                0xF2 -> output.sendMidiSongPositionPointer(data1 or (data2 shl 7))
+            }
+        }
+    }
+
+    private fun drain() {
+        val write = transferData ?: return
+        while (true) {
+            val length = synthManager.fluidsynthBleMidiPoll(packet)
+            if (length <= 0) break
+            // one packet per characteristic notification
+            write.invoke(device, packet.copyOf(length))
+        }
+    }
+
+    // the library has no public raw write of the characteristic, only one call per message
+    private fun findTransferData(device: MidiOutputDevice): Method? {
+        var type: Class<*>? = device.javaClass
+        while (type != null) {
+            try {
+                val method = type.getDeclaredMethod("transferData", ByteArray::class.java)
+                method.isAccessible = true
+                return method
+            } catch (e: NoSuchMethodException) {
+                type = type.superclass
+            }
+        }
+        Log.w(debugTag, "BLE-MIDI raw write not found, sending through the library")
+        return null
+    }
+}
@@ -3,17 +3,30 @@ package ro.sonicpix.heartbeat.presentation
 import android.hardware.Sensor
 import android.hardware.SensorEvent
 import android.hardware.SensorEventListener
+import android.os.SystemClock
 import android.util.Log
 
 interface HeartBeatListener {
-    fun onHeartRateUpdated(heartRate: Int)
+    fun onHeartRateUpdated(heartRate: Float, accuracy: Int)
+    // a detected beat: time on the System.nanoTime() clock, confidence 0 to 1
+    fun onHeartBeat(timeNs: Long, confidence: Float)
 }
 
 class HeartRateSensorListener  (): SensorEventListener  {
     private var heartBeatListener: HeartBeatListener? = null
+    private var wakeups = 0L
+    private var startTimeMs = 0L
 
     fun registerListener(heartBeatListener: HeartBeatListener) {
         this.heartBeatListener = heartBeatListener
+        wakeups = 0L
+        startTimeMs = SystemClock.uptimeMillis()
+    }
+
+    // each sensor callback is a wakeup of the main thread
+    fun getWakeupsPerMinute(): Float {
+        val elapsedMs = SystemClock.uptimeMillis() - startTimeMs
+        return if (elapsedMs > 0) wakeups * 60000f / elapsedMs else 0f
     }
 
     fun unregisterListener() {
@@ -21,9 +34,13 @@ class HeartRateSensorListener  (): SensorEventListener  {
     }
 
     override fun onSensorChanged(event: SensorEvent?) {
+        wakeups++
         if (event?.sensor?.type == Sensor.TYPE_HEART_RATE) {
-            val heartRate = event.values[0].toInt()
-            heartBeatListener?.onHeartRateUpdated(heartRate)
+            heartBeatListener?.onHeartRateUpdated(event.values[0], event.accuracy)
+        } else if (event?.sensor?.type == Sensor.TYPE_HEART_BEAT) {
+            // the event time is the peak of the beat, on the elapsedRealtimeNanos() clock
+            val timeNs = event.timestamp - SystemClock.elapsedRealtimeNanos() + System.nanoTime()
+            heartBeatListener?.onHeartBeat(timeNs, event.values[0])
         }
     }
 
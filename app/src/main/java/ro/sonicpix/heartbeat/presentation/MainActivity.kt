@@ -5,6 +5,9 @@ import android.content.Context
 import android.content.pm.PackageManager
 import android.hardware.Sensor
 import android.hardware.SensorManager
+import android.media.midi.MidiDevice
+import android.media.midi.MidiDeviceInfo
+import android.media.midi.MidiManager
 import android.os.Build
 import android.os.Bundle
 import android.os.Handler
@@ -41,6 +44,7 @@ import androidx.wear.compose.material.Text
 import androidx.wear.compose.material.TimeText
 import androidx.wear.tooling.preview.devices.WearDevices
 import com.robsonmartins.androidmidisynth.SynthManager
+import java.io.File
 import jp.kshoji.blemidi.device.MidiInputDevice
 import jp.kshoji.blemidi.device.MidiOutputDevice
 import jp.kshoji.blemidi.listener.OnMidiDeviceAttachedListener
@@ -48,22 +52,54 @@ import jp.kshoji.blemidi.listener.OnMidiDeviceDetachedListener
 import jp.kshoji.blemidi.peripheral.BleMidiPeripheralProvider
 import ro.sonicpix.heartbeat.R
 import ro.sonicpix.heartbeat.presentation.theme.HeartBeatTheme
+import kotlin.math.roundToInt
 
 
 const val debugTag = "HeartBeatz"
 
-val song: Array<IntArray> = arrayOf(
-    intArrayOf(60, 60), // C, C (Twinkle, twinkle)
-    intArrayOf(67, 67), // G, G (little star)
-    intArrayOf(69, 69), // A, A (How I wonder)
-    intArrayOf(67),     // G, (what you are)
-    intArrayOf(65, 65), // F, F (Up above the)
-    intArrayOf(64, 64), // E, E (world so high)
-    intArrayOf(62, 62), // D, D (Like a diamond)
-    intArrayOf(60)      // C, (in the sky)
-)
+// Ramp time of the synth parameters driven by heart rate
+const val paramRampMs = 800
+
+// Maximum tempo change of the MIDI clock, in BPM per second
+const val clockSlewBpmPerSecond = 4f
+
+// Send the MIDI output to the BLE central as natively encoded packets, several messages per
+// write, instead of one BLE library call per message (needs the raw write of the library)
+const val nativeBleMidiOutput = false
+
+// BLE-MIDI packet size (default ATT MTU of 23 bytes - 3), in bytes
+const val bleMidiPacketSize = 20
+
+// Maximum time a message waits to share a BLE-MIDI packet with others, in milliseconds
+const val bleMidiMaxDelayMs = 10
+
+// Read the heart-rate sensor natively (batched, off the main thread) instead of SensorManager
+const val nativeHeartRateSensor = true
+
+// Maximum report latency of the native heart-rate sensor (FIFO batching), in milliseconds
+const val sensorBatchLatencyMs = 5000
+
+// Record what the synth plays to a MIDI file in the app files directory (session.mid);
+// opt-in, for debugging: the file grows for as long as the session runs
+const val recordSession = false
+
+// Capture the synth audio to an Ogg/Opus file in the app files directory (session.opus)
+const val captureAudio = false
+
+// Bitrate of the captured audio, in bits per second
+const val captureBitrate = 24000
+
+// Trace the synth calls to a file in the app files directory (session.trace), for api-replay
+const val traceSynthCalls = false
+
+// Log the cost of the regular and critical native calls at startup
+const val measureNativeCalls = false
 
-var currentSongIndex = 0
+// Play the heartbeat (channel 0) with the procedural voices instead of the soundfont
+const val proceduralHeartbeat = false
+
+// Highest quality tier of the synth (0 eco, 1 balanced, 2 high), lowered under CPU load
+const val qualityTier = 2
 
 val permissions = mapOf(
     Manifest.permission.BLUETOOTH to "Bluetooth",
@@ -91,11 +127,26 @@ class MainActivity : ComponentActivity() {
     private lateinit var heartRateSensorListener: HeartRateSensorListener
 
     private var heartBeatIntervalMs = 1000L
+    private var heartRate = 0f
+    private var nativeSensorStarted = false
 
     private var mainText by mutableStateOf(".")
 
     private lateinit var bleMidiPeripheralProvider: BleMidiPeripheralProvider
-    private var midiOutputDevice: MidiOutputDevice? = null
+    private lateinit var bleMidiOutput: BleMidiOutput
+    private lateinit var bleMidiInput: BleMidiInput
+
+    private var midiManager: MidiManager? = null
+    private var nativeMidiDevice: MidiDevice? = null
+    private val midiDeviceCallback = object : MidiManager.DeviceCallback() {
+        override fun onDeviceAdded(device: MidiDeviceInfo) {
+            openNativeMidiDevice(device)
+        }
+
+        override fun onDeviceRemoved(device: MidiDeviceInfo) {
+            if (nativeMidiDevice?.info?.id == device.id) closeNativeMidiDevice()
+        }
+    }
 
 
     @RequiresApi(Build.VERSION_CODES.S)
@@ -107,6 +158,7 @@ class MainActivity : ComponentActivity() {
         window.addFlags(WindowManager.LayoutParams.FLAG_KEEP_SCREEN_ON)
 
         sensorManager = getSystemService(Context.SENSOR_SERVICE) as SensorManager
+        midiManager = getSystemService(Context.MIDI_SERVICE) as MidiManager?
         heartRateSensorListener = HeartRateSensorListener()
         bleMidiPeripheralProvider = BleMidiPeripheralProvider(this)
         bleMidiPeripheralProvider.setAutoStartDevice(true)
@@ -115,8 +167,23 @@ class MainActivity : ComponentActivity() {
 
         synthManager = SynthManager(this)
         synthManager.loadSF("gm.sf2")
+        synthManager.loadPattern("song.txt")
+        bleMidiOutput = BleMidiOutput(synthManager)
+        bleMidiInput = BleMidiInput(synthManager)
+        if (measureNativeCalls) {
+            val cost = synthManager.measureCallCost(10000)
+            Log.d(debugTag, "Native call: regular ${"%.1f".format(cost[0])} ns, " +
+                    "critical ${"%.1f".format(cost[1])} ns")
+        }
+        // more heart-rate variability (RMSSD 5-60 ms): more modulation (vibrato) on the melody
+        for (channel in 1..2) synthManager.fluidsynthHrvRoute(channel - 1, 0, channel, 1, 5f, 60f)
+        if (proceduralHeartbeat) synthManager.fluidsynthHeartbeatChannel(0)
+        synthManager.fluidsynthQualityTier(qualityTier, true)
+        // the heartbeat (channel 0) is never cut to make room for other voices
+        synthManager.fluidsynthVoicePriority(0, 2, 0)
+        // both posted: played in this order on the first block
         synthManager.setVolume(0,127)
-        synthManager.fluidsynthProgramChange(1, 24)
+        synthManager.programChange(1, 24)
 
         setContent {
             MainScreen(mainText = mainText)
@@ -142,6 +209,7 @@ class MainActivity : ComponentActivity() {
         bleMidiPeripheralProvider.setOnMidiDeviceAttachedListener(null)
         bleMidiPeripheralProvider.setOnMidiDeviceDetachedListener(null)
         bleMidiPeripheralProvider.stopAdvertising()
+        bleMidiOutput.detach()
     }
 
     private fun startBluetoothIfAllPermissionsAreGranted() {
@@ -150,6 +218,7 @@ class MainActivity : ComponentActivity() {
             val detachedListener = object :
                 OnMidiDeviceDetachedListener {
                 override fun onMidiInputDeviceDetached(midiInputDevice: MidiInputDevice) {
+                    midiInputDevice.setOnMidiInputEventListener(null)
                 }
 
                 override fun onMidiOutputDeviceDetached(midiOutputDevice: MidiOutputDevice) {
@@ -157,12 +226,17 @@ class MainActivity : ComponentActivity() {
                         debugTag,
                         "Midi ${midiOutputDevice.deviceName} Output Detached"
                     )
-                    this@MainActivity.midiOutputDevice = null
+                    bleMidiOutput.detach()
                 }
             }
             val attachedListener = object :
                 OnMidiDeviceAttachedListener {
                 override fun onMidiInputDeviceAttached(midiInputDevice: MidiInputDevice) {
+                    Log.d(
+                        debugTag,
+                        "Midi ${midiInputDevice.deviceName} Input Attached"
+                    )
+                    midiInputDevice.setOnMidiInputEventListener(bleMidiInput)
                 }
 
                 override fun onMidiOutputDeviceAttached(midiOutputDevice: MidiOutputDevice) {
@@ -170,7 +244,7 @@ class MainActivity : ComponentActivity() {
                         debugTag,
                         "Midi ${midiOutputDevice.deviceName} Output Attached"
                     )
-                    this@MainActivity.midiOutputDevice = midiOutputDevice
+                    bleMidiOutput.attach(midiOutputDevice)
                 }
             }
 
@@ -183,56 +257,199 @@ class MainActivity : ComponentActivity() {
         }
     }
 
+    private fun openNativeMidiDevice(info: MidiDeviceInfo) {
+        // BLE MIDI is handled by the peripheral provider
+        if (info.type != MidiDeviceInfo.TYPE_USB && info.type != MidiDeviceInfo.TYPE_VIRTUAL) return
+        if (nativeMidiDevice != null) return
+        midiManager?.openDevice(info, { device ->
+            if (device == null) return@openDevice
+            val inputPort = if (info.inputPortCount > 0) 0 else -1
+            val outputPort = if (info.outputPortCount > 0) 0 else -1
+            if (synthManager.fluidsynthOpenMidiDevice(device, inputPort, outputPort) == 0) {
+                Log.d(debugTag, "Midi ${info.id} connected to synth")
+                nativeMidiDevice = device
+            } else {
+                device.close()
+            }
+        }, handler)
+    }
+
+    private fun closeNativeMidiDevice() {
+        nativeMidiDevice?.let {
+            synthManager.fluidsynthCloseMidiDevice()
+            it.close()
+        }
+        nativeMidiDevice = null
+    }
+
+    private fun startNativeMidi() {
+        val manager = midiManager ?: return
+        manager.registerDeviceCallback(midiDeviceCallback, handler)
+        @Suppress("DEPRECATION")
+        manager.devices.forEach { openNativeMidiDevice(it) }
+    }
+
+    private fun stopNativeMidi() {
+        midiManager?.unregisterDeviceCallback(midiDeviceCallback)
+        closeNativeMidiDevice()
+    }
+
     override fun onDestroy() {
+        // onPause() already stopped the interval
+        bleMidiOutput.terminate()
         synthManager.finalize()
         bleMidiPeripheralProvider.terminate()
         sensorManager.unregisterListener(heartRateSensorListener)
-        stopInterval()
         super.onDestroy()
     }
 
-    fun sendMidiNote( channel: Int, note: Int, velocity: Int) {
-        midiOutputDevice?.sendMidiNoteOn(channel, note, velocity)
-        synthManager.fluidsynthNoteOn(channel, note, velocity)
-        handler.postDelayed({
-            midiOutputDevice?.sendMidiNoteOff(channel, note, velocity)
-            synthManager.fluidsynthNoteOff(channel, note)
-        }, heartBeatIntervalMs)
+    private fun startInterval() {
+        synthManager.fluidsynthMidiClockTempo(60000f / heartBeatIntervalMs, clockSlewBpmPerSecond)
+        synthManager.fluidsynthMidiClockStart(0)
+        synthManager.fluidsynthSequencerStart(1)
+        synthManager.fluidsynthLevelsReset()
+        if (recordSession) {
+            synthManager.fluidsynthRecordStart(File(filesDir, "session.mid").path)
+        }
+        if (traceSynthCalls) {
+            synthManager.fluidsynthTraceStart(File(filesDir, "session.trace").path)
+        }
+        if (captureAudio) {
+            val path = File(filesDir, "session.opus").path
+            synthManager.fluidsynthAudioCaptureStart(path, captureBitrate)
+        }
+        // the beat tracker keeps the beat phase continuous across heart rate changes;
+        // a slowing tempo can wake us up early, the sequencer only plays when a beat passed
+        runnable = Runnable {
+            // the native sensor reader does not call back, pick up its value once per beat
+            if (nativeSensorStarted) applyHeartRate(synthManager.fluidsynthHeartRateValue())
+            // the native sequencer plays the song on each beat
+            synthManager.fluidsynthBeatTrackerAdvance()
+            handler.postAtTime(runnable!!, synthManager.fluidsynthBeatTrackerNextBeat())
+        }
+        synthManager.fluidsynthBeatTrackerAdvance()
+        handler.postAtTime(runnable!!, synthManager.fluidsynthBeatTrackerNextBeat())
     }
 
-    private fun playHeartBeat() {
+    private fun stopInterval() {
+        synthManager.fluidsynthMidiClockStop()
+        synthManager.fluidsynthSequencerStop()
+        val levels = FloatArray(7)
+        synthManager.fluidsynthLevels(levels)
+        Log.d(debugTag, "Session loudness ${"%.1f".format(levels[4])} LUFS, " +
+                "peak ${"%.1f".format(levels[5])} dBFS over ${"%.0f".format(levels[6])} s")
+        val glitches = LongArray(5)
+        synthManager.fluidsynthGlitchCounts(glitches)
+        Log.d(debugTag, "Glitches: ${glitches[0]} clicks, ${glitches[1]} clipped blocks, " +
+                "${glitches[2]} dropouts, ${glitches[3]} underruns")
+        Log.d(debugTag, "Quality tier ${synthManager.fluidsynthGetQualityTier()}, render load " +
+                "${"%.0f".format(synthManager.fluidsynthRenderLoad() * 100)}%")
+        val voices = LongArray(3)
+        synthManager.fluidsynthVoiceStats(voices)
+        Log.d(debugTag, "Voices: ${voices[0]} playing, ${voices[1]} faded out early, " +
+                "${voices[2]} taken")
+        val times = LongArray(256)
+        val types = IntArray(256)
+        val values = FloatArray(256)
+        val count = synthManager.fluidsynthGlitchEvents(times, types, values)
+        for (i in 0 until count) {
+            Log.d(debugTag, "Glitch ${types[i]} at ${times[i] / 1000000} ms: ${values[i]}")
+        }
+        if (recordSession) {
+            val lost = synthManager.fluidsynthRecordStop()
+            Log.d(debugTag, "Session recorded, lost messages: $lost")
+        }
+        if (traceSynthCalls) {
+            val lost = synthManager.fluidsynthTraceStop()
+            Log.d(debugTag, "Synth calls traced, lost calls: $lost")
+        }
+        if (captureAudio) {
+            synthManager.fluidsynthAudioCaptureStop()
+            val stats = LongArray(4)
+            synthManager.fluidsynthAudioCaptureStats(stats)
+            val load = if (stats[1] > 0) 100.0 * stats[0] / (stats[1] * 1000) else 0.0
+            Log.d(debugTag, "Audio captured: ${stats[1]} ms, ${stats[2]} bytes, " +
+                    "encoder CPU ${stats[0]} us (${"%.2f".format(load)}%), dropped ${stats[3]}")
+        }
+        runnable?.let { handler.removeCallbacks(it) }
+        runnable = null
+    }
 
-        var channel = 1
-        val notes = song[currentSongIndex]
-        currentSongIndex = (currentSongIndex + 1) % song.size
+    private fun applyHeartRate(filtered: Float) {
+        if (filtered <= 0f || filtered == heartRate) return
+        heartRate = filtered
+        val intervalMs = (60000f / filtered).toLong()
+        updateInterval(intervalMs)
+        updateSynthParams(filtered.roundToInt())
+        mainText = "${filtered.roundToInt()} BPM"
+    }
 
-        val velocity = (heartBeatIntervalMs/10).toInt()
+    private fun startHeartRateSensor() {
+        if (nativeHeartRateSensor) {
+            nativeSensorStarted =
+                synthManager.fluidsynthHeartRateSensorStart(packageName, sensorBatchLatencyMs)
+            if (nativeSensorStarted) return
+        }
+        heartRateSensorListener.registerListener(object : HeartBeatListener {
+            override fun onHeartRateUpdated(rawHeartRate: Float, accuracy: Int) {
+                // native pipeline: accuracy gating, outlier rejection, smoothing, beat tracker
+                applyHeartRate(synthManager.fluidsynthHeartRateSample(rawHeartRate, accuracy))
+            }
 
-        midiOutputDevice?.sendMidiTimingClock()
+            override fun onHeartBeat(timeNs: Long, confidence: Float) {
+                // the intervals between the beats feed the heart-rate variability
+                synthManager.fluidsynthHeartBeat(timeNs, confidence)
+            }
+        })
 
-        for (note in notes) {
-            Log.d(debugTag, "Note ${note} ${velocity}   ")
-            sendMidiNote(channel, note, velocity)
-            channel++;
+        val heartRateSensor = sensorManager.getDefaultSensor(Sensor.TYPE_HEART_RATE)
+        if (heartRateSensor != null) {
+            sensorManager.registerListener(
+                heartRateSensorListener,
+                heartRateSensor,
+                SensorManager.SENSOR_DELAY_FASTEST
+            )
+        } else {
+            mainText = "Sensor not found"
+        }
+        // optional: without it there are no RR intervals, and no heart-rate variability
+        val heartBeatSensor = sensorManager.getDefaultSensor(Sensor.TYPE_HEART_BEAT)
+        if (heartBeatSensor != null) {
+            sensorManager.registerListener(
+                heartRateSensorListener,
+                heartBeatSensor,
+                SensorManager.SENSOR_DELAY_FASTEST
+            )
         }
-        Log.d(debugTag, "---")
     }
 
-    private fun startInterval() {
-        runnable = Runnable {
-            playHeartBeat()
-            handler.postDelayed(runnable!!, heartBeatIntervalMs)
+    private fun stopHeartRateSensor() {
+        if (nativeSensorStarted) {
+            Log.d(debugTag, "Sensor wakeups/min (native): ${synthManager.fluidsynthHeartRateSensorWakeups()}")
+            synthManager.fluidsynthHeartRateSensorStop()
+            nativeSensorStarted = false
+        } else {
+            Log.d(debugTag, "Sensor wakeups/min (java): ${heartRateSensorListener.getWakeupsPerMinute()}")
         }
-        handler.postDelayed(runnable!!, heartBeatIntervalMs)
+        heartRateSensorListener.unregisterListener()
+        sensorManager.unregisterListener(heartRateSensorListener)
     }
 
-    private fun stopInterval() {
-        runnable?.let { handler.removeCallbacks(it) }
-        runnable = null
+    private fun updateSynthParams(heartRate: Int) {
+        // calm heart: quieter, darker and more reverb; racing heart: louder and brighter
+        val intensity = ((heartRate - 50) / 100f).coerceIn(0f, 1f)
+        for (channel in 1..2) {
+            synthManager.fluidsynthSmoothCC(channel, 7, 90f + 37f * intensity, paramRampMs)
+            synthManager.fluidsynthSmoothFilterCutoff(channel, -2400f * (1f - intensity), paramRampMs)
+        }
+        synthManager.fluidsynthSmoothReverb(80f * (1f - intensity), paramRampMs)
     }
 
     private fun updateInterval(newIntervalMillis: Long) {
         heartBeatIntervalMs = newIntervalMillis
+        // slower heart: louder notes (velocity 100 at 60 BPM)
+        synthManager.fluidsynthSequencerVelocity(newIntervalMillis / 1000f)
+        synthManager.fluidsynthMidiClockTempo(60000f / newIntervalMillis, clockSlewBpmPerSecond)
         Log.d(debugTag, "updateInterval $heartBeatIntervalMs")
     }
 
@@ -240,8 +457,8 @@ class MainActivity : ComponentActivity() {
         Log.d(debugTag, "onPause")
         super.onPause()
         stopBluetooth()
-        heartRateSensorListener.unregisterListener()
-        sensorManager.unregisterListener(heartRateSensorListener)
+        stopNativeMidi()
+        stopHeartRateSensor()
         stopInterval()
     }
 
@@ -249,26 +466,9 @@ class MainActivity : ComponentActivity() {
         Log.d(debugTag, "onResume")
         super.onResume()
         startBluetoothIfAllPermissionsAreGranted()
+        startNativeMidi()
 
-        heartRateSensorListener.registerListener(object : HeartBeatListener {
-            override fun onHeartRateUpdated(heartRate: Int) {
-                if (heartRate == 0) return
-                val intervalMs = 60000 / heartRate.toLong()
-                updateInterval(intervalMs)
-                this@MainActivity.mainText = "$heartRate BPM"
-            }
-        })
-
-        val heartRateSensor = sensorManager.getDefaultSensor(Sensor.TYPE_HEART_RATE)
-        if (heartRateSensor != null) {
-            sensorManager.registerListener(
-                heartRateSensorListener,
-                heartRateSensor,
-                SensorManager.SENSOR_DELAY_FASTEST
-            )
-        } else {
-            mainText = "Sensor not found"
-        }
+        startHeartRateSensor()
         startInterval()
     }
 }